@@ -74,7 +74,6 @@
 #endif
 
 #include <random>
-#include <thread>
 
 #if defined(_MSC_VER) && defined(_UNICODE)
 typedef std::wstring path_t;
@@ -126,6 +125,9 @@ void print_usage(bool suggest_help = true)
 #endif
 		<< "  .ifc   IFC-SPF        Industry Foundation Classes\n"
 		<< "\n"
+		<< "The input file can be compressed as .ifczip or .ifc.gz (when built with zlib)\n"
+		<< "or as .ifc.zst (when built with zstd).\n"
+		<< "\n"
         << "If no output filename given, <input>" << IfcUtil::path::from_utf8(DEFAULT_EXTENSION) << " will be used as the output file.\n";
     if (suggest_help) {
         cout_ << "\nRun 'IfcConvert --help' for more information.";
@@ -157,6 +159,19 @@ T change_extension(const T& fn, const T& ext) {
 	}
 }
 
+// Removes the extension of a compressed file, so that model.ifc.gz is
+// converted to model.obj rather than model.ifc.obj.
+template <typename T>
+T strip_compression_extension(const T& fn) {
+	for (const char* ext : {".gz", ".zst"}) {
+		const T ext_t = IfcUtil::path::from_utf8(ext);
+		if (boost::iends_with(fn, ext_t)) {
+			return fn.substr(0, fn.size() - ext_t.size());
+		}
+	}
+	return fn;
+}
+
 bool file_exists(const std::string& filename) {
     std::ifstream file(IfcUtil::path::from_utf8(filename).c_str());
     return file.good();
@@ -249,7 +264,8 @@ int main(int argc, char** argv) {
     po::options_description fileio_options;
 	fileio_options.add_options()
 #ifdef USE_MMAP
-		("mmap", "use memory-mapped file for input")
+		("mmap", "use memory-mapped file for input (default)")
+		("no-mmap", "read the input file into memory instead of memory-mapping it")
 #endif
 		("input-file", new po::typed_value<path_t, char_t>(0), "input IFC file")
 		("output-file", new po::typed_value<path_t, char_t>(0), "output geometry file")
@@ -514,7 +530,7 @@ int main(int argc, char** argv) {
 
     po::notify(vmap);
 
-	const bool mmap = vmap.count("mmap") != 0;
+	const bool mmap = vmap.count("no-mmap") == 0;
 	const bool no_progress = vmap.count("no-progress") != 0;
 	const bool quiet = vmap.count("quiet") != 0;
 	const bool stderr_progress = vmap.count("stderr-progress") != 0;
@@ -587,7 +603,7 @@ int main(int argc, char** argv) {
 #endif
 
 	if (num_threads <= 0) {
-		num_threads = std::thread::hardware_concurrency();
+		num_threads = IfcParse::IfcFile::effective_num_threads();
 		Logger::Notice("Using " + std::to_string(num_threads) + " threads");
 	}
     
@@ -674,7 +690,7 @@ int main(int argc, char** argv) {
 	// to maintain backwards compatibility with the obsolete IfcObj executable.
 	const path_t output_filename = vmap.count("output-file") == 1 
 		? vmap["output-file"].as<path_t>()
-		: change_extension(input_filename, IfcUtil::path::from_utf8(DEFAULT_EXTENSION));
+		: change_extension(strip_compression_extension(input_filename), IfcUtil::path::from_utf8(DEFAULT_EXTENSION));
 	
 	if (output_filename.size() < 5) {
         cerr_ << "[Error] Invalid or unsupported output file '" << output_filename << "' given" << std::endl;
@@ -1597,50 +1613,26 @@ namespace latebound_access {
 
 void fix_quantities(IfcParse::IfcFile& f, bool no_progress, bool quiet, bool stderr_progress) {
 	{
-		auto delete_reversed = [&f](const aggregate_of_instance::ptr& insts) {
-			if (!insts) {
-				return;
-			}
-			// Lists are traversed back to front as the list may be mutated when
-			// instances are removed from the grouping by type.
-			for (auto it = insts->end() - 1; it >= insts->begin(); --it) {
-				IfcUtil::IfcBaseClass* const inst = *it;
-				f.removeEntity(inst);
-			}
-		};
+		// Deletions are batched, so that the lists by type of the file are
+		// iterated in place and only updated once when the batch ends.
+		f.batch();
 
-		// Delete quantities
-		auto quantities = f.instances_by_type("IfcPhysicalQuantity");
-		if (quantities) {
-			quantities = quantities->filtered({ f.schema()->declaration_by_name("IfcPhysicalComplexQuantity") });
-			delete_reversed(quantities);
+		// Delete quantities, including complexes
+		for (auto& inst : f.instances_by_type_range(f.schema()->declaration_by_name("IfcPhysicalQuantity"))) {
+			f.removeEntity(inst);
 		}
 
-		// Delete complexes
-		delete_reversed(f.instances_by_type("IfcPhysicalComplexQuantity"));
-
-		auto element_quantities = f.instances_by_type("IfcElementQuantity");
-
-		// Capture relationship nodes
-		std::vector<IfcUtil::IfcBaseClass*> relationships;
+		// Delete element quantities and their relationship nodes
 		auto IfcRelDefinesByProperties = f.schema()->declaration_by_name("IfcRelDefinesByProperties");
-		if (element_quantities) {
-			for (auto& eq : *element_quantities) {
-				auto rels = eq->data().getInverse(IfcRelDefinesByProperties, -1);
-				for (auto& rel : *rels) {
-					relationships.push_back(rel);
-				}
+		for (auto& eq : f.instances_by_type_range(f.schema()->declaration_by_name("IfcElementQuantity"))) {
+			auto rels = eq->data().getInverse(IfcRelDefinesByProperties, -1);
+			for (auto& rel : *rels) {
+				f.removeEntity(rel);
 			}
-
-			// Delete element quantities
-			delete_reversed(element_quantities);
+			f.removeEntity(eq);
 		}
 
-
-		// Delete relationship nodes
-		for (auto& rel : relationships) {
-			f.removeEntity(rel);
-		}
+		f.unbatch();
 	}
 
 	IfcGeom::IteratorSettings settings;
@@ -30,10 +30,13 @@ void fix_storeycontainment(IfcParse::IfcFile& f, bool no_progress, bool quiet, b
 
 	// latebound inverse attribute lookup not working
 	auto rels = f.instances_by_type("IfcRelContainedInSpatialStructure");
+	auto rel_type = f.schema()->declaration_by_name("IfcRelContainedInSpatialStructure")->as_entity();
+	const auto related_elements = rel_type->resolve_attribute("RelatedElements");
+	const auto relating_structure = rel_type->resolve_attribute("RelatingStructure");
 	std::map<const IfcUtil::IfcBaseClass*, const IfcUtil::IfcBaseClass*> elem_to_storey;
-	std::for_each(rels->begin(), rels->end(), [&elem_to_storey](IfcUtil::IfcBaseClass* r) {
-		auto elems = ((IfcUtil::IfcBaseEntity*)r)->get_value<aggregate_of_instance::ptr>("RelatedElements");
-		auto storey = ((IfcUtil::IfcBaseEntity*)r)->get_value<IfcUtil::IfcBaseClass*>("RelatingStructure");
+	std::for_each(rels->begin(), rels->end(), [&elem_to_storey, &related_elements, &relating_structure](IfcUtil::IfcBaseClass* r) {
+		auto elems = ((IfcUtil::IfcBaseEntity*)r)->get_value<aggregate_of_instance::ptr>(related_elements);
+		auto storey = ((IfcUtil::IfcBaseEntity*)r)->get_value<IfcUtil::IfcBaseClass*>(relating_structure);
 
 		if (storey->declaration().name() == "IfcBuildingStorey") {
 			for (auto it = elems->begin(); it != elems->end(); ++it) {
@@ -27,10 +27,13 @@ void fix_wallconnectivity(IfcParse::IfcFile& f, bool no_progress, bool quiet, bo
 	ifcopenshell::geometry::Converter c("cgal", &f, settings);
 
 	auto rels = f.instances_by_type("IfcRelConnectsPathElements");
+	auto rel_type = f.schema()->declaration_by_name("IfcRelConnectsPathElements")->as_entity();
+	const auto relating_element = rel_type->resolve_attribute("RelatingElement");
+	const auto related_element = rel_type->resolve_attribute("RelatedElement");
 	std::map<std::set<const IfcUtil::IfcBaseClass*>, const IfcUtil::IfcBaseClass*> rel_by_elem;
-	std::for_each(rels->begin(), rels->end(), [&rel_by_elem](const IfcUtil::IfcBaseClass* rel) {
-		auto x = ((IfcUtil::IfcBaseEntity*)rel)->get_value<IfcUtil::IfcBaseClass*>("RelatingElement");
-		auto y = ((IfcUtil::IfcBaseEntity*)rel)->get_value<IfcUtil::IfcBaseClass*>("RelatedElement");
+	std::for_each(rels->begin(), rels->end(), [&rel_by_elem, &relating_element, &related_element](const IfcUtil::IfcBaseClass* rel) {
+		auto x = ((IfcUtil::IfcBaseEntity*)rel)->get_value<IfcUtil::IfcBaseClass*>(relating_element);
+		auto y = ((IfcUtil::IfcBaseEntity*)rel)->get_value<IfcUtil::IfcBaseClass*>(related_element);
 		rel_by_elem.insert({{ x,y }, rel});
 	});
 
@@ -655,11 +655,9 @@ void mapping::initialize_settings() {
 	double lowest_precision_encountered = std::numeric_limits<double>::infinity();
 	bool any_precision_encountered = false;
 
-	IfcSchema::IfcGeometricRepresentationContext::list::it it;
-	IfcSchema::IfcGeometricRepresentationContext::list::ptr contexts =
-		file_->instances_by_type_excl_subtypes<IfcSchema::IfcGeometricRepresentationContext>();
+	auto contexts = file_->instances_by_type_excl_subtypes_view<IfcSchema::IfcGeometricRepresentationContext>();
 
-	for (it = contexts->begin(); it != contexts->end(); ++it) {
+	for (auto it = contexts.begin(); it != contexts.end(); ++it) {
 		IfcSchema::IfcGeometricRepresentationContext* context = *it;
 
 		// See if there is a context_id filter and whether the context is selected
@@ -944,13 +942,11 @@ void mapping::addRepresentationsFromDefaultContexts(IfcSchema::IfcRepresentation
 
 	IfcSchema::IfcGeometricRepresentationContext::list::it it;
 	IfcSchema::IfcGeometricRepresentationSubContext::list::it jt;
-	IfcSchema::IfcGeometricRepresentationContext::list::ptr contexts =
-		file_->instances_by_type<IfcSchema::IfcGeometricRepresentationContext>();
+	auto contexts = file_->instances_by_type_view<IfcSchema::IfcGeometricRepresentationContext>();
 
 	IfcSchema::IfcGeometricRepresentationContext::list::ptr filtered_contexts(new IfcSchema::IfcGeometricRepresentationContext::list);
 
-	for (it = contexts->begin(); it != contexts->end(); ++it) {
-		IfcSchema::IfcGeometricRepresentationContext* context = *it;
+	for (IfcSchema::IfcGeometricRepresentationContext* context : contexts) {
 		if (context->declaration().is(IfcSchema::IfcGeometricRepresentationSubContext::Class())) {
 			// Continue, as the list of subcontexts will be considered
 			// by the parent's context inverse attributes.
@@ -976,8 +972,7 @@ void mapping::addRepresentationsFromDefaultContexts(IfcSchema::IfcRepresentation
 	// In case no contexts are identified based on their ContextType, all contexts are
 	// considered. Note that sub contexts are excluded as they are considered later on.
 	if (filtered_contexts->size() == 0) {
-		for (it = contexts->begin(); it != contexts->end(); ++it) {
-			IfcSchema::IfcGeometricRepresentationContext* context = *it;
+		for (IfcSchema::IfcGeometricRepresentationContext* context : contexts) {
 			if (!context->declaration().is(IfcSchema::IfcGeometricRepresentationSubContext::Class())) {
 				filtered_contexts->push(context);
 			}
@@ -1000,7 +995,9 @@ void mapping::addRepresentationsFromDefaultContexts(IfcSchema::IfcRepresentation
 
 	if (representations->size() == 0) {
 		Logger::Warning("No representations encountered in relevant contexts, using all");
-		representations->push(file_->instances_by_type<IfcSchema::IfcRepresentation>());
+		for (auto* rep : file_->instances_by_type_view<IfcSchema::IfcRepresentation>()) {
+			representations->push(rep);
+		}
 	}
 }
 
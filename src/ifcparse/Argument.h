@@ -21,6 +21,7 @@
 #define ARGUMENT_H
 
 #include "ArgumentType.h"
+#include "IfcArena.h"
 #include "ifc_parse_api.h"
 
 #include <algorithm>
@@ -30,6 +31,7 @@
 #include <set>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 class aggregate_of_instance;
@@ -44,7 +46,7 @@ IFC_PARSE_API const char* ArgumentTypeToString(ArgumentType argument_type);
 IFC_PARSE_API bool valid_binary_string(const std::string& s);
 } // namespace IfcUtil
 
-class IFC_PARSE_API Argument {
+class IFC_PARSE_API Argument : public IfcParse::arena_allocated {
   public:
     virtual operator int() const;
     virtual operator bool() const;
@@ -54,6 +56,18 @@ class IFC_PARSE_API Argument {
     virtual operator boost::dynamic_bitset<>() const;
     virtual operator IfcUtil::IfcBaseClass*() const;
 
+    /// Returns the same characters as the conversion to std::string, without
+    /// allocating a string for every access. Strings parsed from a file are
+    /// interned in the string pool of the file, see IfcFile::strings(), and
+    /// remain valid as long as the file. For attributes that were assigned
+    /// after parsing, the view is valid until the attribute is replaced.
+    virtual std::string_view interned_string() const;
+
+    /// Returns the id of the entity instance that the argument refers to, e.g.
+    /// 2 for #2, without resolving the instance in the file. This is how the
+    /// references of instances passed by IfcFile::stream_instances() are read.
+    virtual unsigned int reference_id() const;
+
     virtual operator std::vector<int>() const;
     virtual operator std::vector<double>() const;
     virtual operator std::vector<std::string>() const;
@@ -71,6 +85,9 @@ class IFC_PARSE_API Argument {
     virtual Argument* operator[](unsigned int i) const = 0;
     virtual std::string toString(bool upper = false) const = 0;
 
+    /// Appends the same representation as toString() to out
+    virtual void write(std::string& out, bool upper = false) const { out += toString(upper); }
+
     virtual ~Argument(){};
 };
 
@@ -0,0 +1,244 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Appending the instances of one file to another, optionally reusing the
+// units, owner history and representation contexts already in the file.
+
+#include "IfcContentHash.h"
+#include "IfcFile.h"
+#include "IfcInstanceVisitor.h"
+#include "IfcLogger.h"
+#include "IfcParallel.h"
+#include "IfcWriteUtils.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
+
+using namespace IfcParse;
+
+namespace {
+// The instances referenced by the attributes of instance, in attribute order
+std::vector<IfcUtil::IfcBaseClass*> references_of(IfcUtil::IfcBaseClass* instance) {
+    std::vector<IfcUtil::IfcBaseClass*> references;
+    auto collect = [&references](IfcUtil::IfcBaseClass* inst, int) { references.push_back(inst); };
+    apply_individual_instance_visitor(&instance->data()).apply(collect);
+    return references;
+}
+
+// Pairs instance a with instance b when they have the same type and
+// attributes and reference instances that pair likewise, recursively.
+// Returns false when the subgraphs differ, pairs then is incomplete.
+bool match_subgraph(IfcUtil::IfcBaseClass* a, IfcUtil::IfcBaseClass* b, std::map<IfcUtil::IfcBaseClass*, IfcUtil::IfcBaseClass*>& pairs) {
+    auto it = pairs.find(a);
+    if (it != pairs.end()) {
+        return it->second == b;
+    }
+    if (&a->declaration() != &b->declaration()) {
+        return false;
+    }
+    // References are compared by the recursion rather than by content hash
+    auto no_hash = [](int) -> uint64_t { return 0; };
+    if (instance_content(a, no_hash) != instance_content(b, no_hash)) {
+        return false;
+    }
+    pairs[a] = b;
+    const std::vector<IfcUtil::IfcBaseClass*> references_a = references_of(a);
+    const std::vector<IfcUtil::IfcBaseClass*> references_b = references_of(b);
+    if (references_a.size() != references_b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < references_a.size(); ++i) {
+        if (!match_subgraph(references_a[i], references_b[i], pairs)) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+void IfcFile::unify_resources_(IfcFile& other, std::vector<IfcUtil::IfcBaseClass*>& mapped) {
+    for (auto& name : {"IfcUnitAssignment", "IfcOwnerHistory", "IfcGeometricRepresentationContext"}) {
+        const IfcParse::declaration* decl = schema_->declaration_by_name(name);
+        std::multimap<uint64_t, IfcUtil::IfcBaseClass*> candidates;
+        for (auto* inst : instances_by_type_range(decl)) {
+            candidates.insert({content_hash(inst), inst});
+        }
+        for (auto* inst : other.instances_by_type_range(decl)) {
+            if (mapped[inst->data().id()]) {
+                continue;
+            }
+            auto range = candidates.equal_range(other.content_hash(inst));
+            for (auto it = range.first; it != range.second; ++it) {
+                std::map<IfcUtil::IfcBaseClass*, IfcUtil::IfcBaseClass*> pairs;
+                if (match_subgraph(inst, it->second, pairs)) {
+                    for (auto& p : pairs) {
+                        const unsigned int id = p.first->data().id();
+                        // Instances of simple types are copied along with the instances that refer to them
+                        if (p.first->declaration().as_entity() && id < mapped.size() && !mapped[id]) {
+                            mapped[id] = p.second;
+                        }
+                    }
+                    break;
+                }
+            }
+        }
+    }
+}
+
+size_t IfcFile::append(IfcFile& other, bool unify_resources) {
+    if (&other == this) {
+        throw IfcParse::IfcException("Unable to append a file to itself");
+    }
+    if (other.schema() != schema()) {
+        throw IfcParse::IfcException("Unable to append file with " + other.schema()->name() + " schema to file with " + schema()->name() + " schema");
+    }
+
+    const unsigned int n_threads = effective_num_threads();
+
+    unsigned int other_max_id = 0;
+    for (auto& p : other.byid) {
+        other_max_id = (std::max)(other_max_id, p.first);
+    }
+
+    // The instances in this file for the instances of other, by id in other
+    std::vector<IfcUtil::IfcBaseClass*> mapped((size_t)other_max_id + 1, nullptr);
+    if (unify_resources) {
+        unify_resources_(other, mapped);
+    }
+
+    std::vector<IfcUtil::IfcBaseClass*> sources;
+    sources.reserve(other.byid.size());
+    for (auto& p : other.byid) {
+        if (!mapped[p.first]) {
+            sources.push_back(p.second);
+        }
+    }
+    std::sort(sources.begin(), sources.end(), [](IfcUtil::IfcBaseClass* a, IfcUtil::IfcBaseClass* b) {
+        return a->data().id() < b->data().id();
+    });
+
+    // The copies are created up front, so that references can be mapped
+    // while their attributes are copied in any order.
+    const unsigned int offset = MaxId;
+    for (auto* inst : sources) {
+        IfcEntityInstanceData* data = new IfcEntityInstanceData(&inst->declaration());
+        data->set_id(inst->data().id() + offset);
+        mapped[inst->data().id()] = schema_->instantiate(data);
+    }
+
+    const double conversion_factor = IfcWrite::length_unit_conversion(*this, other);
+    const IfcParse::declaration& length_measure = *schema_->declaration_by_name("IfcLengthMeasure");
+
+    // Copies do not have a file yet while their attributes are set, so that
+    // their inverse references are not registered one at a time.
+    std::mutex simple_type_mutex;
+    auto map_instance = [this, &other, &mapped, &simple_type_mutex](IfcUtil::IfcBaseClass* inst) -> IfcUtil::IfcBaseClass* {
+        if (inst->declaration().as_entity()) {
+            const unsigned int id = inst->data().id();
+            if (inst->data().file != &other || id >= mapped.size() || !mapped[id]) {
+                throw IfcParse::IfcException("Unable to map instance to file");
+            }
+            return mapped[id];
+        }
+        IfcEntityInstanceData* data = new IfcEntityInstanceData(inst->data());
+        data->file = this;
+        IfcUtil::IfcBaseClass* copy = schema_->instantiate(data);
+        std::lock_guard<std::mutex> lk(simple_type_mutex);
+        byidentity[copy->identity()] = copy;
+        return copy;
+    };
+    parallel_for(
+        sources.size(), n_threads, [&](size_t k) {
+            const IfcEntityInstanceData& from = sources[k]->data();
+            IfcEntityInstanceData& to = mapped[from.id()]->data();
+            for (size_t i = 0; i < from.getArgumentCount(); ++i) {
+                Argument* attr = from.getArgument(i);
+                IfcWrite::IfcWriteArgument* copy = IfcWrite::replace_instances(attr, map_instance);
+                if (!copy && conversion_factor != 1. && IfcWrite::is_length_measure(*from.type(), i, length_measure)) {
+                    copy = IfcWrite::scaled_length(attr, attr->type(), conversion_factor);
+                }
+                if (copy) {
+                    to.setArgument(i, copy);
+                } else {
+                    to.setArgument(i, attr, IfcWrite::get_argument_type(from.type(), i), true);
+                }
+            }
+        },
+        min_instances_per_thread);
+
+    byid.reserve(byid.size() + sources.size());
+    const IfcParse::declaration* type = nullptr;
+    aggregate_of_instance::ptr instances_of_type;
+    for (auto* inst : sources) {
+        IfcUtil::IfcBaseClass* copy = mapped[inst->data().id()];
+        copy->data().file = this;
+        byid[copy->data().id()] = copy;
+
+        // Sources are ordered by id, not by type, the list is only looked up when the type changes
+        if (&copy->declaration() != type) {
+            type = &copy->declaration();
+            aggregate_of_instance::ptr& list = bytype_excl[type];
+            if (!list) {
+                list.reset(new aggregate_of_instance);
+            }
+            instances_of_type = list;
+        }
+        instances_of_type->push(copy);
+
+        if (ifcroot_type_ && type->is(*ifcroot_type_)) {
+            try {
+                const std::string guid = *copy->data().getArgument(0);
+                if (byguid.assign(guid, copy) != nullptr) {
+                    Logger::Message(Logger::LOG_WARNING, "Overwriting entity with guid " + guid);
+                }
+            } catch (const IfcException& ex) {
+                Logger::Message(Logger::LOG_ERROR, ex.what());
+            }
+        }
+    }
+    MaxId = (std::max)(MaxId, offset + other_max_id);
+
+    // The compact inverse index is rebuilt once, including the references of
+    // the copies, otherwise these are added to the inverse maps.
+    if (has_inverse_index_) {
+        for (size_t i = 0; i + 1 < inverse_offsets_.size(); ++i) {
+            for (size_t j = inverse_offsets_[i]; j < inverse_offsets_[i + 1]; ++j) {
+                pending_inverses_.push_back({(int)i, inverse_references_[j]});
+            }
+        }
+        for (auto* inst : sources) {
+            IfcUtil::IfcBaseClass* copy = mapped[inst->data().id()];
+            auto collect = [this, copy](IfcUtil::IfcBaseClass* referenced, int index) {
+                if (referenced->declaration().as_entity()) {
+                    pending_inverses_.push_back({(int)referenced->data().id(), {(int)copy->data().id(), (int)copy->declaration().index_in_schema(), index}});
+                }
+            };
+            apply_individual_instance_visitor(&copy->data()).apply(collect);
+        }
+        build_inverse_index_();
+    } else {
+        for (auto* inst : sources) {
+            build_inverses_(mapped[inst->data().id()]);
+        }
+    }
+
+    return sources.size();
+}
@@ -0,0 +1,263 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#include "IfcArena.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace {
+// Allocations larger than this fraction of the block size get a block of
+// their own, so that they do not waste the remainder of the current block.
+const size_t oversized_fraction = 4;
+
+size_t align_up(size_t n) {
+    return (n + IfcParse::arena::alignment - 1) & ~(IfcParse::arena::alignment - 1);
+}
+
+// The tag that precedes every arena_allocated object and argument array:
+// the owning arena, or nullptr for heap allocations.
+const size_t tag_size = IfcParse::arena::alignment;
+
+static_assert(sizeof(IfcParse::arena*) <= tag_size, "Arena tag does not fit");
+
+void* tag_allocation(void* p, IfcParse::arena* a) {
+    *static_cast<IfcParse::arena**>(p) = a;
+    return static_cast<char*>(p) + tag_size;
+}
+
+void* allocation_start(void* p) {
+    return static_cast<char*>(p) - tag_size;
+}
+
+IfcParse::arena* allocation_tag(void* p) {
+    return *static_cast<IfcParse::arena**>(allocation_start(p));
+}
+
+void* allocate_tagged(size_t n, IfcParse::arena* a) {
+    void* p = a ? a->allocate(n + tag_size) : ::operator new(n + tag_size);
+    return tag_allocation(p, a);
+}
+
+void free_tagged(void* p) {
+    if (p && allocation_tag(p) == nullptr) {
+        ::operator delete(allocation_start(p));
+    }
+}
+} // namespace
+
+IfcParse::arena::arena(size_t block_size)
+    : current_(nullptr),
+      oversized_(nullptr),
+      block_size_(align_up(block_size)) {}
+
+namespace {
+template <typename T>
+void free_blocks(T* b) {
+    while (b) {
+        T* next = b->next;
+        ::operator delete(b);
+        b = next;
+    }
+}
+} // namespace
+
+IfcParse::arena::~arena() {
+    free_blocks(current_.load());
+    free_blocks(oversized_);
+}
+
+IfcParse::arena::block* IfcParse::arena::allocate_block_(size_t capacity, block* next) {
+    static_assert(sizeof(block) % alignment == 0, "Arena block header breaks alignment");
+    block* b = static_cast<block*>(::operator new(sizeof(block) + capacity));
+    b->next = next;
+    b->capacity = capacity;
+    new (&b->used) std::atomic<size_t>(0);
+    return b;
+}
+
+void* IfcParse::arena::allocate(size_t n) {
+    n = align_up(n);
+
+    if (n > block_size_ / oversized_fraction) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        oversized_ = allocate_block_(n, oversized_);
+        oversized_->used = n;
+        return oversized_->data();
+    }
+
+    for (;;) {
+        block* b = current_.load(std::memory_order_acquire);
+        if (b) {
+            // A failed attempt leaves `used` beyond capacity, which is harmless
+            // as the block is retired by the thread that grabs the lock below.
+            size_t offset = b->used.fetch_add(n, std::memory_order_relaxed);
+            if (offset + n <= b->capacity) {
+                return b->data() + offset;
+            }
+        }
+        std::lock_guard<std::mutex> lk(mutex_);
+        if (current_.load(std::memory_order_relaxed) == b) {
+            current_.store(allocate_block_(block_size_, b), std::memory_order_release);
+        }
+    }
+}
+
+size_t IfcParse::arena::capacity() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    size_t n = 0;
+    for (block* b : {current_.load(), oversized_}) {
+        for (; b; b = b->next) {
+            n += b->capacity;
+        }
+    }
+    return n;
+}
+
+IfcParse::arena::marker IfcParse::arena::mark() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    block* b = current_.load(std::memory_order_relaxed);
+    return {b, b ? (std::min)(b->used.load(std::memory_order_relaxed), b->capacity) : 0, oversized_};
+}
+
+void IfcParse::arena::rewind(const marker& m) {
+    std::lock_guard<std::mutex> lk(mutex_);
+    block* b = current_.load(std::memory_order_relaxed);
+    if (b != m.current) {
+        // When nothing was allocated at m the most recent block is kept for reuse
+        if (m.current == nullptr) {
+            free_blocks(b->next);
+            b->next = nullptr;
+        } else {
+            while (b->next != m.current) {
+                block* next = b->next;
+                ::operator delete(b);
+                b = next;
+            }
+            ::operator delete(b);
+            b = m.current;
+        }
+        current_.store(b, std::memory_order_relaxed);
+    }
+    if (b) {
+        b->used.store(b == m.current ? m.used : 0, std::memory_order_relaxed);
+    }
+    while (oversized_ != m.oversized) {
+        block* next = oversized_->next;
+        ::operator delete(oversized_);
+        oversized_ = next;
+    }
+}
+
+namespace {
+// Hashes eight characters at a time, the strings in a file are mostly short
+uint64_t hash_characters(const char* data, size_t size) {
+    uint64_t h = 0x9e3779b97f4a7c15ULL ^ size;
+    uint64_t w;
+    for (; size >= 8; data += 8, size -= 8) {
+        std::memcpy(&w, data, 8);
+        h = (h ^ w) * 0xff51afd7ed558ccdULL;
+        h ^= h >> 32;
+    }
+    w = 0;
+    std::memcpy(&w, data, size);
+    h = (h ^ w) * 0xc4ceb9fe1a85ec53ULL;
+    return h ^ (h >> 29);
+}
+} // namespace
+
+IfcParse::string_pool::string_pool()
+    : arena_(1 << 16),
+      slots_(1 << 10, slot{0, nullptr, 0}),
+      size_(0) {}
+
+void IfcParse::string_pool::grow_() {
+    std::vector<slot> previous(slots_.size() * 2, slot{0, nullptr, 0});
+    previous.swap(slots_);
+    const size_t mask = slots_.size() - 1;
+    for (const auto& s : previous) {
+        if (s.data) {
+            size_t i = s.hash & mask;
+            while (slots_[i].data) {
+                i = (i + 1) & mask;
+            }
+            slots_[i] = s;
+        }
+    }
+}
+
+std::string_view IfcParse::string_pool::intern(std::string_view s) {
+    if (s.empty()) {
+        return std::string_view();
+    }
+    const uint64_t h = hash_characters(s.data(), s.size());
+    std::lock_guard<std::mutex> lk(mutex_);
+    size_t mask = slots_.size() - 1;
+    size_t i = h & mask;
+    for (; slots_[i].data; i = (i + 1) & mask) {
+        if (slots_[i].hash == h && slots_[i].size == s.size() && std::memcmp(slots_[i].data, s.data(), s.size()) == 0) {
+            return std::string_view(slots_[i].data, slots_[i].size);
+        }
+    }
+    // Keep the load factor at or below one half
+    if ((size_ + 1) * 2 > slots_.size()) {
+        grow_();
+        mask = slots_.size() - 1;
+        for (i = h & mask; slots_[i].data; i = (i + 1) & mask) {
+        }
+    }
+    char* data = static_cast<char*>(arena_.allocate(s.size()));
+    std::memcpy(data, s.data(), s.size());
+    slots_[i] = slot{h, data, s.size()};
+    ++size_;
+    return std::string_view(data, s.size());
+}
+
+size_t IfcParse::string_pool::size() const {
+    std::lock_guard<std::mutex> lk(mutex_);
+    return size_;
+}
+
+void* IfcParse::arena_allocated::operator new(size_t n) {
+    return allocate_tagged(n, nullptr);
+}
+
+void* IfcParse::arena_allocated::operator new(size_t n, arena& a) {
+    return allocate_tagged(n, &a);
+}
+
+void IfcParse::arena_allocated::operator delete(void* p) {
+    free_tagged(p);
+}
+
+void IfcParse::arena_allocated::operator delete(void* p, arena&) {
+    // Only invoked when a constructor throws, the arena reclaims the memory.
+    free_tagged(p);
+}
+
+Argument** IfcParse::allocate_argument_array(size_t n, arena* a) {
+    void* p = allocate_tagged(n * sizeof(Argument*), a);
+    std::memset(p, 0, n * sizeof(Argument*));
+    return static_cast<Argument**>(p);
+}
+
+void IfcParse::free_argument_array(Argument** arr) {
+    free_tagged(arr);
+}
@@ -0,0 +1,147 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#ifndef IFCARENA_H
+#define IFCARENA_H
+
+#include "ifc_parse_api.h"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+class Argument;
+
+namespace IfcParse {
+
+/// A monotonic allocator that owns the memory of the instances and
+/// attributes parsed from a single file. Allocations are never returned
+/// individually, all blocks are released at once when the arena is
+/// destroyed. Allocation is thread-safe so that the scanning and lazy
+/// loading threads can share the arena of their file.
+class IFC_PARSE_API arena {
+  private:
+    struct block {
+        block* next;
+        size_t capacity;
+        std::atomic<size_t> used;
+        char* data() { return reinterpret_cast<char*>(this + 1); }
+    };
+
+    std::atomic<block*> current_;
+    block* oversized_;
+    size_t block_size_;
+    mutable std::mutex mutex_;
+
+    static block* allocate_block_(size_t capacity, block* next);
+
+  public:
+    static const size_t alignment = 8;
+
+    explicit arena(size_t block_size = 1 << 20);
+    ~arena();
+
+    arena(const arena&) = delete;
+    arena& operator=(const arena&) = delete;
+
+    /// Returns uninitialized memory of at least n bytes aligned to `alignment`
+    void* allocate(size_t n);
+
+    /// The number of bytes reserved from the system for this arena
+    size_t capacity() const;
+
+    /// A point in the allocation history of the arena
+    struct marker {
+        block* current;
+        size_t used;
+        block* oversized;
+    };
+
+    /// Returns the current position, to which the arena can be rewound
+    marker mark() const;
+
+    /// Makes the memory allocated after m available for reuse. Only valid
+    /// when none of the objects allocated after m are alive anymore.
+    void rewind(const marker& m);
+};
+
+/// Base class for objects that can be placed in an arena with
+/// `new (arena) T(...)`. Every allocation is prefixed with a tag that
+/// records its origin, so that `delete` on such an object runs its
+/// destructor in both cases, but only returns heap memory to the system.
+/// Objects allocated without an arena behave as before.
+class IFC_PARSE_API arena_allocated {
+  public:
+    static void* operator new(size_t n);
+    static void* operator new(size_t n, arena& a);
+    static void operator delete(void* p);
+    static void operator delete(void* p, arena& a);
+};
+
+/// A set of distinct strings, such as the names, labels and enumeration
+/// literals that repeat throughout a file. The characters of each distinct
+/// string are copied once into an arena of the pool, so that the views
+/// returned by intern() remain valid until the pool is destroyed. A pool
+/// has its own arena, as the arena of a file is rewound while streaming.
+/// Interning is thread-safe.
+class IFC_PARSE_API string_pool {
+  private:
+    // An open addressing table with linear probing, of which the slots keep
+    // the hash so that most mismatches are rejected without comparing the
+    // characters.
+    struct slot {
+        uint64_t hash;
+        const char* data;
+        size_t size;
+    };
+
+    arena arena_;
+    std::vector<slot> slots_;
+    size_t size_;
+    mutable std::mutex mutex_;
+
+    void grow_();
+
+  public:
+    string_pool();
+
+    string_pool(const string_pool&) = delete;
+    string_pool& operator=(const string_pool&) = delete;
+
+    /// Returns a view of the pooled copy of s, copying s when it is first encountered
+    std::string_view intern(std::string_view s);
+
+    /// The number of distinct strings in the pool
+    size_t size() const;
+};
+
+/// Allocates a zero-initialized array of n argument pointers, in the arena
+/// when one is provided. Release with free_argument_array().
+IFC_PARSE_API Argument** allocate_argument_array(size_t n, arena* a = nullptr);
+
+/// Releases an array obtained from allocate_argument_array(), which is a
+/// no-op for arrays that live in an arena.
+IFC_PARSE_API void free_argument_array(Argument** arr);
+
+} // namespace IfcParse
+
+#endif
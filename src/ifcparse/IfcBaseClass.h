@@ -131,12 +131,23 @@ class IFC_PARSE_API IfcBaseEntity : public IfcBaseClass {
 
     Argument* get(const std::string& name) const;
 
+    /// Same as get() by name, for an attribute that is resolved once, e.g.
+    /// outside of a loop. Throws an IfcException when the instance is not of
+    /// the entity the handle was resolved on, or one of its subtypes.
+    Argument* get(const IfcParse::attribute_handle& attr) const;
+
     template <typename T>
     T get_value(const std::string& name) const;
 
     template <typename T>
     T get_value(const std::string& name, const T& default_value) const;
 
+    template <typename T>
+    T get_value(const IfcParse::attribute_handle& attr) const;
+
+    template <typename T>
+    T get_value(const IfcParse::attribute_handle& attr, const T& default_value) const;
+
     boost::shared_ptr<aggregate_of_instance> get_inverse(const std::string& a) const;
 };
 
@@ -166,6 +177,20 @@ T IfcBaseEntity::get_value(const std::string& name, const T& default_value) cons
     }
     return (T)*attr;
 }
+
+template <typename T>
+T IfcBaseEntity::get_value(const IfcParse::attribute_handle& attr) const {
+    return (T)*get(attr);
+}
+
+template <typename T>
+T IfcBaseEntity::get_value(const IfcParse::attribute_handle& attr, const T& default_value) const {
+    auto arg = get(attr);
+    if (arg->isNull()) {
+        return default_value;
+    }
+    return (T)*arg;
+}
 } // namespace IfcUtil
 
 #endif
@@ -73,20 +73,19 @@ using namespace IfcWrite;
 
 IfcCharacterDecoder::IfcCharacterDecoder(IfcParse::IfcSpfStream* f) {
     file = f;
-    codepage_ = 0;
 }
 
 IfcCharacterDecoder::~IfcCharacterDecoder() {
 }
 
 namespace {
-static unsigned int reference_helper = 0;
+static size_t reference_helper = 0;
 
 class pure_impure_helper {
   private:
     bool pure_;
     IfcParse::IfcSpfStream* stream_;
-    unsigned int& pointer_;
+    size_t& pointer_;
     std::wstring builder_;
 
     char peek() {
@@ -97,7 +96,7 @@ class pure_impure_helper {
         }
     }
 
-    unsigned int tell() {
+    size_t tell() {
         if (pure_) {
             return pointer_;
         } else {
@@ -119,7 +118,7 @@ class pure_impure_helper {
           stream_(stream),
           pointer_(reference_helper) {}
 
-    pure_impure_helper(IfcParse::IfcSpfStream* stream, unsigned int& pointer)
+    pure_impure_helper(IfcParse::IfcSpfStream* stream, size_t& pointer)
         : pure_(true),
           stream_(stream),
           pointer_(pointer) {}
@@ -248,7 +247,7 @@ IfcCharacterDecoder::operator std::string() {
     return pure_impure_helper(file).get(mode, substitution_character);
 }
 
-std::string IfcCharacterDecoder::get(unsigned int& ptr) {
+std::string IfcCharacterDecoder::get(size_t& ptr) const {
     return pure_impure_helper(file, ptr).get(mode, substitution_character);
 }
 
@@ -44,7 +44,6 @@ namespace IfcParse {
 class IFC_PARSE_API IfcCharacterDecoder {
   private:
     IfcParse::IfcSpfStream* file;
-    int codepage_;
 
   public:
     enum ConversionMode {
@@ -64,7 +63,8 @@ class IFC_PARSE_API IfcCharacterDecoder {
     operator std::string();
     // Gets a decoded string representation at the offset provided,
     // does not mutate the underlying token stream read pointer.
-    std::string get(unsigned int&);
+    // The code page selected by \S\ and \P directives is local to the call.
+    std::string get(size_t&) const;
 };
 
 } // namespace IfcParse
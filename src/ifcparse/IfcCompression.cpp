@@ -0,0 +1,497 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#include "IfcCompression.h"
+
+#include "IfcException.h"
+#include "IfcParallel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+
+#ifdef WITH_ZSTD
+#include <zstd.h>
+#endif
+
+using IfcParse::IfcException;
+
+namespace {
+
+#if defined(WITH_ZLIB) || defined(WITH_ZSTD)
+
+// A buffer allocated with new[] that grows while decompressing data of
+// which the size is not known in advance.
+class output_buffer {
+  private:
+    std::unique_ptr<char[]> data_;
+    size_t size_;
+    size_t capacity_;
+
+  public:
+    explicit output_buffer(size_t capacity)
+        : data_(new char[capacity]),
+          size_(0),
+          capacity_(capacity) {}
+
+    char* end() { return data_.get() + size_; }
+    size_t available() const { return capacity_ - size_; }
+    void commit(size_t n) { size_ += n; }
+
+    void grow() {
+        const size_t capacity = (std::max)(capacity_ * 2, (size_t)1 << 20);
+        char* data = new char[capacity];
+        std::memcpy(data, data_.get(), size_);
+        data_.reset(data);
+        capacity_ = capacity;
+    }
+
+    char* release(size_t& size) {
+        size = size_;
+        return data_.release();
+    }
+};
+
+#endif
+
+#ifdef WITH_ZLIB
+
+uint16_t read_u16(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return (uint16_t)(u[0] | (u[1] << 8));
+}
+
+uint32_t read_u32(const char* p) {
+    return read_u16(p) | ((uint32_t)read_u16(p + 2) << 16);
+}
+
+uint64_t read_u64(const char* p) {
+    return read_u32(p) | ((uint64_t)read_u32(p + 4) << 32);
+}
+
+// The counters in zlib are 32 bits, larger buffers are processed in chunks
+const size_t max_zlib_chunk = (std::numeric_limits<uInt>::max)();
+
+uint32_t crc32_of(const char* data, size_t size) {
+    uLong crc = crc32(0L, Z_NULL, 0);
+    for (size_t offset = 0; offset < size; offset += max_zlib_chunk) {
+        crc = crc32(crc, reinterpret_cast<const Bytef*>(data + offset), (uInt)(std::min)(size - offset, max_zlib_chunk));
+    }
+    return (uint32_t)crc;
+}
+
+class inflater {
+  private:
+    z_stream z_;
+
+  public:
+    explicit inflater(int window_bits) {
+        std::memset(&z_, 0, sizeof(z_));
+        if (inflateInit2(&z_, window_bits) != Z_OK) {
+            throw IfcException("Failed to initialize zlib");
+        }
+    }
+
+    ~inflater() { inflateEnd(&z_); }
+
+    inflater(const inflater&) = delete;
+    inflater& operator=(const inflater&) = delete;
+
+    void reset() { inflateReset(&z_); }
+
+    // Inflates as much as possible in one call, advancing in_pos and out_pos,
+    // and returns the zlib status.
+    int step(const char* in, size_t in_size, size_t& in_pos, char* out, size_t out_size, size_t& out_pos) {
+        const uInt avail_in = (uInt)(std::min)(in_size - in_pos, max_zlib_chunk);
+        const uInt avail_out = (uInt)(std::min)(out_size - out_pos, max_zlib_chunk);
+        z_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in + in_pos));
+        z_.avail_in = avail_in;
+        z_.next_out = reinterpret_cast<Bytef*>(out + out_pos);
+        z_.avail_out = avail_out;
+        const int status = inflate(&z_, Z_NO_FLUSH);
+        in_pos += avail_in - z_.avail_in;
+        out_pos += avail_out - z_.avail_out;
+        return status;
+    }
+};
+
+// Inflates a raw deflate stream of which the decompressed size is known
+void inflate_exact(const char* in, size_t in_size, char* out, size_t out_size) {
+    inflater z(-MAX_WBITS);
+    size_t in_pos = 0, out_pos = 0;
+    int status;
+    do {
+        status = z.step(in, in_size, in_pos, out, out_size, out_pos);
+    } while (status == Z_OK);
+    if (status != Z_STREAM_END || out_pos != out_size) {
+        throw IfcException("Corrupt deflate stream");
+    }
+}
+
+bool is_gzip_member(const char* data, size_t size) {
+    return size >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b;
+}
+
+struct gzip_member {
+    size_t data_offset;
+    size_t data_size;
+    size_t output_offset;
+    size_t output_size;
+    uint32_t crc;
+};
+
+// Returns the members of a block gzip (BGZF) file, in which the header of every
+// member records its compressed size, or nothing when the file is not one.
+std::vector<gzip_member> bgzf_members(const char* data, size_t size) {
+    const size_t header_size = 12;
+    const size_t trailer_size = 8;
+    const unsigned char fextra = 4;
+
+    std::vector<gzip_member> members;
+    size_t offset = 0, output_offset = 0;
+    while (offset < size) {
+        const char* member = data + offset;
+        if (size - offset < header_size || !is_gzip_member(member, size - offset) || member[2] != Z_DEFLATED || member[3] != fextra) {
+            return {};
+        }
+        const size_t xlen = read_u16(member + 10);
+        if (size - offset < header_size + xlen) {
+            return {};
+        }
+        size_t member_size = 0;
+        for (size_t p = header_size; p + 4 <= header_size + xlen;) {
+            const size_t len = read_u16(member + p + 2);
+            if (member[p] == 'B' && member[p + 1] == 'C' && len == 2 && p + 6 <= header_size + xlen) {
+                member_size = (size_t)read_u16(member + p + 4) + 1;
+            }
+            p += 4 + len;
+        }
+        if (member_size < header_size + xlen + trailer_size || member_size > size - offset) {
+            return {};
+        }
+        gzip_member m;
+        m.data_offset = offset + header_size + xlen;
+        m.data_size = member_size - header_size - xlen - trailer_size;
+        m.output_offset = output_offset;
+        m.output_size = read_u32(member + member_size - 4);
+        m.crc = read_u32(member + member_size - 8);
+        members.push_back(m);
+        output_offset += m.output_size;
+        offset += member_size;
+    }
+    return members;
+}
+
+char* decompress_gzip(const char* data, size_t size, size_t& decompressed_size, unsigned num_threads) {
+    const std::vector<gzip_member> members = bgzf_members(data, size);
+
+    if (!members.empty()) {
+        const size_t total = members.back().output_offset + members.back().output_size;
+        std::unique_ptr<char[]> buffer(new char[total]);
+        IfcParse::parallel_for(members.size(), num_threads, [data, &members, &buffer](size_t i) {
+            const gzip_member& m = members[i];
+            char* out = buffer.get() + m.output_offset;
+            inflate_exact(data + m.data_offset, m.data_size, out, m.output_size);
+            if (crc32_of(out, m.output_size) != m.crc) {
+                throw IfcException("Checksum mismatch in gzip member");
+            }
+        });
+        decompressed_size = total;
+        return buffer.release();
+    }
+
+    // A regular gzip file is a single deflate stream that can only be inflated
+    // sequentially. The size modulo 2^32 of the last member is stored at the end.
+    size_t estimate = size >= 4 ? read_u32(data + size - 4) : 0;
+    if (estimate < size) {
+        estimate = size * 4;
+    }
+    output_buffer out(estimate + 1);
+
+    inflater z(MAX_WBITS + 16);
+    size_t in_pos = 0;
+    for (;;) {
+        if (out.available() == 0) {
+            out.grow();
+        }
+        size_t out_pos = 0;
+        const int status = z.step(data, size, in_pos, out.end(), out.available(), out_pos);
+        out.commit(out_pos);
+        if (status == Z_STREAM_END) {
+            // Concatenated members form a single file, trailing padding is ignored
+            if (!is_gzip_member(data + in_pos, size - in_pos)) {
+                break;
+            }
+            z.reset();
+        } else if (status != Z_OK) {
+            throw IfcException(status == Z_BUF_ERROR ? "Truncated gzip file" : "Corrupt gzip file");
+        }
+    }
+
+    return out.release(decompressed_size);
+}
+
+bool has_ifc_extension(const std::string& name) {
+    if (name.size() < 4) {
+        return false;
+    }
+    std::string extension = name.substr(name.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char)::tolower((unsigned char)c); });
+    return extension == ".ifc";
+}
+
+// Extracts the first .ifc entry from a ZIP archive, including ZIP64 archives
+char* decompress_ifczip(const char* data, size_t size, size_t& decompressed_size) {
+    const uint32_t end_of_central_directory = 0x06054b50;
+    const uint32_t zip64_end_of_central_directory_locator = 0x07064b50;
+    const uint32_t zip64_end_of_central_directory = 0x06064b50;
+    const uint32_t central_directory_header = 0x02014b50;
+    const uint32_t local_file_header = 0x04034b50;
+
+    // The end of central directory record is followed by a comment of at most 64k
+    const size_t eocd_size = 22;
+    size_t eocd = std::string::npos;
+    if (size >= eocd_size) {
+        const size_t lowest = size - eocd_size - (std::min)(size - eocd_size, (size_t)0xffff);
+        for (size_t i = size - eocd_size + 1; i-- > lowest;) {
+            if (read_u32(data + i) == end_of_central_directory) {
+                eocd = i;
+                break;
+            }
+        }
+    }
+    if (eocd == std::string::npos) {
+        throw IfcException("Not a valid ifcZIP archive");
+    }
+
+    uint64_t num_entries = read_u16(data + eocd + 10);
+    uint64_t central_directory = read_u32(data + eocd + 16);
+    if (eocd >= 20 && read_u32(data + eocd - 20) == zip64_end_of_central_directory_locator) {
+        const uint64_t record = read_u64(data + eocd - 20 + 8);
+        if (size < 56 || record > size - 56 || read_u32(data + record) != zip64_end_of_central_directory) {
+            throw IfcException("Corrupt ZIP64 end of central directory in ifcZIP archive");
+        }
+        num_entries = read_u64(data + record + 32);
+        central_directory = read_u64(data + record + 48);
+    }
+
+    size_t p = (size_t)central_directory;
+    for (uint64_t entry = 0; entry < num_entries; ++entry) {
+        if (p > size || size - p < 46 || read_u32(data + p) != central_directory_header) {
+            throw IfcException("Corrupt central directory in ifcZIP archive");
+        }
+        const unsigned flags = read_u16(data + p + 8);
+        const unsigned method = read_u16(data + p + 10);
+        const uint32_t crc = read_u32(data + p + 16);
+        uint64_t compressed_size = read_u32(data + p + 20);
+        uint64_t uncompressed_size = read_u32(data + p + 24);
+        const size_t name_length = read_u16(data + p + 28);
+        const size_t extra_length = read_u16(data + p + 30);
+        const size_t comment_length = read_u16(data + p + 32);
+        uint64_t local_header = read_u32(data + p + 42);
+        if (size - p - 46 < name_length + extra_length + comment_length) {
+            throw IfcException("Corrupt central directory in ifcZIP archive");
+        }
+        const std::string name(data + p + 46, name_length);
+
+        // The ZIP64 extended information holds, in this order, the values
+        // that did not fit in their 32 bit fields in the header.
+        const char* extra = data + p + 46 + name_length;
+        for (size_t x = 0; x + 4 <= extra_length;) {
+            const size_t field_end = x + 4 + read_u16(extra + x + 2);
+            if (field_end > extra_length) {
+                break;
+            }
+            if (read_u16(extra + x) == 0x0001) {
+                size_t q = x + 4;
+                for (uint64_t* value : {&uncompressed_size, &compressed_size, &local_header}) {
+                    if (*value == 0xffffffff && q + 8 <= field_end) {
+                        *value = read_u64(extra + q);
+                        q += 8;
+                    }
+                }
+            }
+            x = field_end;
+        }
+
+        p += 46 + name_length + extra_length + comment_length;
+
+        if (!has_ifc_extension(name)) {
+            continue;
+        }
+
+        if (flags & 1) {
+            throw IfcException("Encrypted ifcZIP archives are not supported");
+        }
+        if (size < 30 || local_header > size - 30 || read_u32(data + local_header) != local_file_header) {
+            throw IfcException("Corrupt local file header in ifcZIP archive");
+        }
+        const uint64_t offset = local_header + 30 + read_u16(data + local_header + 26) + read_u16(data + local_header + 28);
+        if (offset > size || compressed_size > size - offset || uncompressed_size > (std::numeric_limits<size_t>::max)()) {
+            throw IfcException("Corrupt local file header in ifcZIP archive");
+        }
+
+        std::unique_ptr<char[]> buffer(new char[(size_t)uncompressed_size]);
+        if (method == 0 && compressed_size == uncompressed_size) {
+            std::memcpy(buffer.get(), data + offset, (size_t)uncompressed_size);
+        } else if (method == Z_DEFLATED) {
+            inflate_exact(data + offset, (size_t)compressed_size, buffer.get(), (size_t)uncompressed_size);
+        } else {
+            throw IfcException("Unsupported compression method " + std::to_string(method) + " in ifcZIP archive");
+        }
+        if (crc32_of(buffer.get(), (size_t)uncompressed_size) != crc) {
+            throw IfcException("Checksum mismatch in ifcZIP archive");
+        }
+        decompressed_size = (size_t)uncompressed_size;
+        return buffer.release();
+    }
+
+    throw IfcException("No .ifc file found in ifcZIP archive");
+}
+
+#endif
+
+#ifdef WITH_ZSTD
+
+char* decompress_zstd(const char* data, size_t size, size_t& decompressed_size, unsigned num_threads) {
+    struct frame {
+        size_t offset;
+        size_t size;
+        size_t output_offset;
+        size_t output_size;
+    };
+
+    // Frames written with their content size are decompressed concurrently
+    std::vector<frame> frames;
+    size_t offset = 0, output_offset = 0;
+    bool sizes_known = true;
+    while (offset < size) {
+        const size_t frame_size = ZSTD_findFrameCompressedSize(data + offset, size - offset);
+        if (ZSTD_isError(frame_size)) {
+            throw IfcException(std::string("Corrupt zstd file: ") + ZSTD_getErrorName(frame_size));
+        }
+        const unsigned long long content_size = ZSTD_getFrameContentSize(data + offset, frame_size);
+        if (content_size == ZSTD_CONTENTSIZE_ERROR) {
+            throw IfcException("Corrupt zstd file");
+        }
+        if (content_size == ZSTD_CONTENTSIZE_UNKNOWN) {
+            sizes_known = false;
+            break;
+        }
+        frames.push_back({offset, frame_size, output_offset, (size_t)content_size});
+        output_offset += (size_t)content_size;
+        offset += frame_size;
+    }
+
+    if (sizes_known) {
+        std::unique_ptr<char[]> buffer(new char[output_offset]);
+        IfcParse::parallel_for(frames.size(), num_threads, [data, &frames, &buffer](size_t i) {
+            const frame& f = frames[i];
+            std::unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx*)> context(ZSTD_createDCtx(), ZSTD_freeDCtx);
+            const size_t n = ZSTD_decompressDCtx(context.get(), buffer.get() + f.output_offset, f.output_size, data + f.offset, f.size);
+            if (ZSTD_isError(n) || n != f.output_size) {
+                throw IfcException("Corrupt zstd frame");
+            }
+        });
+        decompressed_size = output_offset;
+        return buffer.release();
+    }
+
+    std::unique_ptr<ZSTD_DStream, size_t (*)(ZSTD_DStream*)> stream(ZSTD_createDStream(), ZSTD_freeDStream);
+    ZSTD_initDStream(stream.get());
+
+    output_buffer out((std::max)(size * 4, ZSTD_DStreamOutSize()));
+    ZSTD_inBuffer in = {data, size, 0};
+    size_t remaining = 0;
+    for (;;) {
+        if (out.available() == 0) {
+            out.grow();
+        }
+        ZSTD_outBuffer o = {out.end(), out.available(), 0};
+        remaining = ZSTD_decompressStream(stream.get(), &o, &in);
+        if (ZSTD_isError(remaining)) {
+            throw IfcException(std::string("Corrupt zstd file: ") + ZSTD_getErrorName(remaining));
+        }
+        out.commit(o.pos);
+        if (in.pos == in.size && (remaining == 0 || (o.pos == 0 && out.available() != 0))) {
+            break;
+        }
+    }
+    if (remaining != 0) {
+        throw IfcException("Truncated zstd file");
+    }
+
+    return out.release(decompressed_size);
+}
+
+#endif
+
+} // namespace
+
+IfcParse::compression_format IfcParse::detect_compression(const char* data, size_t size) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(data);
+    if (size >= 2 && u[0] == 0x1f && u[1] == 0x8b) {
+        return COMPRESSION_GZIP;
+    }
+    if (size >= 4 && u[0] == 0x28 && u[1] == 0xb5 && u[2] == 0x2f && u[3] == 0xfd) {
+        return COMPRESSION_ZSTD;
+    }
+    if (size >= 4 && u[0] == 'P' && u[1] == 'K' && u[2] == 3 && u[3] == 4) {
+        return COMPRESSION_IFCZIP;
+    }
+    return COMPRESSION_NONE;
+}
+
+char* IfcParse::decompress(compression_format format, const char* data, size_t size, size_t& decompressed_size, unsigned num_threads) {
+    switch (format) {
+    case COMPRESSION_GZIP:
+#ifdef WITH_ZLIB
+        return decompress_gzip(data, size, decompressed_size, num_threads);
+#else
+        throw IfcException("Reading gzip compressed files requires IfcOpenShell to be built with zlib");
+#endif
+    case COMPRESSION_IFCZIP:
+#ifdef WITH_ZLIB
+        return decompress_ifczip(data, size, decompressed_size);
+#else
+        throw IfcException("Reading ifcZIP files requires IfcOpenShell to be built with zlib");
+#endif
+    case COMPRESSION_ZSTD:
+#ifdef WITH_ZSTD
+        return decompress_zstd(data, size, decompressed_size, num_threads);
+#else
+        throw IfcException("Reading zstd compressed files requires IfcOpenShell to be built with zstd");
+#endif
+    default:
+        break;
+    }
+    (void)data;
+    (void)size;
+    (void)decompressed_size;
+    (void)num_threads;
+    throw IfcException("Data is not compressed");
+}
@@ -0,0 +1,52 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#ifndef IFCCOMPRESSION_H
+#define IFCCOMPRESSION_H
+
+#include "ifc_parse_api.h"
+
+#include <cstddef>
+
+namespace IfcParse {
+
+/// The compressed containers that are read in place of a plain
+/// ISO 10303-21 file, recognized by their leading bytes.
+enum compression_format {
+    COMPRESSION_NONE,
+    COMPRESSION_GZIP,
+    COMPRESSION_ZSTD,
+    /// ifcZIP, a ZIP archive that holds a single IFC-SPF file
+    COMPRESSION_IFCZIP
+};
+
+IFC_PARSE_API compression_format detect_compression(const char* data, size_t size);
+
+/// Decompresses data into a buffer allocated with new[], of which the size is
+/// stored in decompressed_size. Blocks that are compressed independently, i.e.
+/// the members of a block gzip (BGZF) file and the frames of a zstd file, are
+/// decompressed concurrently on up to num_threads threads, each directly into
+/// its place in the resulting buffer. Throws an IfcException when the data is
+/// corrupt or when the format is not supported by this build, gzip and ifcZIP
+/// require zlib (WITH_ZLIB) and zstd requires libzstd (WITH_ZSTD).
+IFC_PARSE_API char* decompress(compression_format format, const char* data, size_t size, size_t& decompressed_size, unsigned num_threads);
+
+} // namespace IfcParse
+
+#endif
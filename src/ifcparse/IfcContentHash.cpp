@@ -0,0 +1,276 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#include "IfcContentHash.h"
+
+#include "IfcHash.h"
+#include "IfcParallel.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace IfcParse;
+
+namespace {
+template <typename Fn>
+uint64_t instance_content_hash(const IfcUtil::IfcBaseClass* instance, Fn&& hash_of) {
+    const std::string buffer = instance_content(instance, hash_of);
+    return hash_buffer(buffer.data(), buffer.size());
+}
+} // namespace
+
+void content_hash_table::compute(std::vector<IfcUtil::IfcBaseClass*>&& insts, unsigned int n_threads) {
+    instances = std::move(insts);
+    index_by_id.reserve(instances.size());
+    for (size_t i = 0; i < instances.size(); ++i) {
+        if (const unsigned int id = instances[i]->data().id()) {
+            index_by_id[id] = (uint32_t)i;
+        }
+    }
+    const size_t n = instances.size();
+
+    // The instances referenced by every instance
+    std::vector<std::vector<uint32_t>> children(n);
+    parallel_for(
+        n, n_threads, [&](size_t i) {
+            instance_content_hash(instances[i], [&](int ref) -> uint64_t {
+                auto it = index_by_id.find(ref);
+                if (it != index_by_id.end()) {
+                    children[i].push_back(it->second);
+                }
+                return 0;
+            });
+            std::sort(children[i].begin(), children[i].end());
+            children[i].erase(std::unique(children[i].begin(), children[i].end()), children[i].end());
+        },
+        min_instances_per_thread);
+
+    std::vector<uint32_t> pending(n);
+    std::vector<std::vector<uint32_t>> parents(n);
+    std::vector<uint32_t> frontier;
+    for (size_t i = 0; i < n; ++i) {
+        pending[i] = (uint32_t)children[i].size();
+        for (auto& c : children[i]) {
+            parents[c].push_back((uint32_t)i);
+        }
+        if (pending[i] == 0) {
+            frontier.push_back((uint32_t)i);
+        }
+    }
+
+    hashes.assign(n, 0);
+    acyclic.assign(n, 0);
+    wave.assign(n, 0);
+    auto known_hash = [this](int ref) -> uint64_t {
+        auto it = index_by_id.find(ref);
+        return it != index_by_id.end() && acyclic[it->second] ? hashes[it->second] : 0;
+    };
+
+    // Instances are hashed in waves of which all references are hashed
+    for (uint32_t w = 0; !frontier.empty(); ++w) {
+        parallel_for(
+            frontier.size(), n_threads, [&](size_t k) {
+                hashes[frontier[k]] = instance_content_hash(instances[frontier[k]], known_hash);
+            },
+            min_instances_per_thread);
+        std::vector<uint32_t> next;
+        for (auto& i : frontier) {
+            acyclic[i] = 1;
+            wave[i] = w;
+        }
+        for (auto& i : frontier) {
+            for (auto& p : parents[i]) {
+                if (--pending[p] == 0) {
+                    next.push_back(p);
+                }
+            }
+        }
+        frontier.swap(next);
+    }
+
+    hash_cycles_(children);
+}
+
+// Finds the strongly connected components among the instances that are
+// not hashed yet with Tarjan's algorithm, iteratively. A component is
+// only completed after the components it references, so that it is
+// hashed once, when it is completed.
+void content_hash_table::hash_cycles_(const std::vector<std::vector<uint32_t>>& children) {
+    const size_t n = instances.size();
+    const uint32_t unvisited = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> index(n, unvisited), lowlink(n);
+    std::vector<char> on_stack(n);
+    std::vector<uint32_t> stack, component;
+    // The instances being visited, with the position of the next reference
+    std::vector<std::pair<uint32_t, size_t>> path;
+    uint32_t counter = 0;
+
+    for (size_t root = 0; root < n; ++root) {
+        if (acyclic[root] || index[root] != unvisited) {
+            continue;
+        }
+        path.emplace_back((uint32_t)root, 0);
+        index[root] = lowlink[root] = counter++;
+        stack.push_back((uint32_t)root);
+        on_stack[root] = 1;
+
+        while (!path.empty()) {
+            const uint32_t v = path.back().first;
+            if (path.back().second < children[v].size()) {
+                const uint32_t w = children[v][path.back().second++];
+                if (acyclic[w]) {
+                    continue;
+                }
+                if (index[w] == unvisited) {
+                    index[w] = lowlink[w] = counter++;
+                    stack.push_back(w);
+                    on_stack[w] = 1;
+                    path.emplace_back(w, 0);
+                } else if (on_stack[w]) {
+                    lowlink[v] = (std::min)(lowlink[v], index[w]);
+                }
+                continue;
+            }
+
+            path.pop_back();
+            if (!path.empty()) {
+                const uint32_t u = path.back().first;
+                lowlink[u] = (std::min)(lowlink[u], lowlink[v]);
+            }
+            if (lowlink[v] == index[v]) {
+                component.clear();
+                uint32_t w;
+                do {
+                    w = stack.back();
+                    stack.pop_back();
+                    on_stack[w] = 0;
+                    component.push_back(w);
+                } while (w != v);
+                hash_component_(component, children);
+            }
+        }
+    }
+}
+
+// References within a reference cycle are first represented by a fixed
+// value. The hash of every member is then refined by the hashes of the
+// members it references, in the order of its references, until this no
+// longer distinguishes more members, so that members are told apart by
+// how the cycle is wired. The members are finally hashed together with
+// the hashes of all members, so that their hashes do not depend on where
+// the cycle is entered.
+void content_hash_table::hash_component_(const std::vector<uint32_t>& component, const std::vector<std::vector<uint32_t>>& children) {
+    const uint32_t first = component.front();
+    if (component.size() == 1 && !std::binary_search(children[first].begin(), children[first].end(), first)) {
+        hashes[first] = instance_content_hash(instances[first], [this](int ref) { return hash_of(ref); });
+        return;
+    }
+
+    boost::unordered_map<uint32_t, uint32_t> position;
+    for (size_t k = 0; k < component.size(); ++k) {
+        position[component[k]] = (uint32_t)k;
+    }
+    const uint64_t in_cycle = 0x9E3779B97F4A7C15ULL;
+    std::vector<uint64_t> own(component.size());
+    // The positions of the members referenced by every member
+    std::vector<std::vector<uint32_t>> targets(component.size());
+    for (size_t k = 0; k < component.size(); ++k) {
+        own[k] = instance_content_hash(instances[component[k]], [this, &position, &targets, k, in_cycle](int ref) -> uint64_t {
+            auto it = index_by_id.find(ref);
+            if (it == index_by_id.end()) {
+                return 0;
+            }
+            auto member = position.find(it->second);
+            if (member == position.end()) {
+                return hashes[it->second];
+            }
+            targets[k].push_back(member->second);
+            return in_cycle;
+        });
+    }
+
+    auto num_distinct = [](std::vector<uint64_t> values) {
+        std::sort(values.begin(), values.end());
+        return (size_t)(std::unique(values.begin(), values.end()) - values.begin());
+    };
+
+    std::vector<uint64_t> refined = own, next(component.size()), buffer;
+    size_t n_distinct = num_distinct(refined);
+    for (size_t round = 0; round < component.size(); ++round) {
+        for (size_t k = 0; k < component.size(); ++k) {
+            buffer.assign(1, own[k]);
+            for (auto& t : targets[k]) {
+                buffer.push_back(refined[t]);
+            }
+            next[k] = hash_buffer(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(uint64_t));
+        }
+        refined.swap(next);
+        const size_t n = num_distinct(refined);
+        if (n == n_distinct) {
+            break;
+        }
+        n_distinct = n;
+    }
+
+    std::vector<uint64_t> sorted = refined;
+    std::sort(sorted.begin(), sorted.end());
+    const uint64_t component_hash = hash_buffer(reinterpret_cast<const char*>(sorted.data()), sorted.size() * sizeof(uint64_t));
+    for (size_t k = 0; k < component.size(); ++k) {
+        const uint64_t pair[2] = {refined[k], component_hash};
+        hashes[component[k]] = hash_buffer(reinterpret_cast<const char*>(pair), sizeof(pair));
+    }
+}
+
+std::vector<IfcUtil::IfcBaseClass*> IfcParse::all_instances(const IfcFile::entity_by_id_t& byid) {
+    std::vector<IfcUtil::IfcBaseClass*> instances;
+    instances.reserve(byid.size());
+    for (auto& p : byid) {
+        instances.push_back(p.second);
+    }
+    return instances;
+}
+
+uint64_t IfcFile::content_hash(IfcUtil::IfcBaseClass* instance) {
+    // The instance followed by the instances of the file that it references
+    std::vector<IfcUtil::IfcBaseClass*> instances;
+    IfcParse::traverse(std::vector<IfcUtil::IfcBaseClass*>{instance}, [this, instance, &instances](IfcUtil::IfcBaseClass* inst, int) {
+        auto it = byid.find(inst->data().id());
+        if (inst == instance || (it != byid.end() && it->second == inst)) {
+            instances.push_back(inst);
+        }
+    });
+
+    content_hash_table table;
+    table.compute(std::move(instances), 1);
+    return table.hashes[0];
+}
+
+IfcFile::content_hash_by_id_t IfcFile::content_hashes() {
+    const unsigned int n_threads = effective_num_threads();
+
+    content_hash_table table;
+    table.compute(all_instances(byid), n_threads);
+
+    content_hash_by_id_t result;
+    result.reserve(table.instances.size());
+    for (size_t i = 0; i < table.instances.size(); ++i) {
+        result[table.instances[i]->data().id()] = table.hashes[i];
+    }
+    return result;
+}
@@ -0,0 +1,90 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#ifndef IFCCONTENTHASH_H
+#define IFCCONTENTHASH_H
+
+#include "IfcFile.h"
+#include "IfcSnapshot.h"
+
+#include <boost/unordered_map.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace IfcParse {
+
+/// The type of instance and its attributes encoded as snapshot cells, in
+/// which references hold hash_of(id) of the referenced instance.
+template <typename Fn>
+std::string instance_content(const IfcUtil::IfcBaseClass* instance, Fn&& hash_of) {
+    snapshot::encoder encoder;
+    const IfcEntityInstanceData& data = instance->data();
+    const size_t n = data.getArgumentCount();
+    encoder.allocate(n);
+    for (size_t i = 0; i < n; ++i) {
+        encoder.encode(i, data.getArgument(i));
+    }
+    for (auto& c : encoder.cells) {
+        if (c.kind == snapshot::CELL_REFERENCE) {
+            c.value = hash_of((int)c.size);
+            c.size = 0;
+        } else if (c.kind == snapshot::CELL_DOUBLE && c.value == (uint64_t)1 << 63) {
+            // -0.0
+            c.value = 0;
+        }
+    }
+    std::string buffer = instance->declaration().name();
+    buffer.push_back('\0');
+    buffer.append(reinterpret_cast<const char*>(encoder.cells.data()), encoder.cells.size() * sizeof(snapshot::cell));
+    buffer += encoder.strings;
+    return buffer;
+}
+
+/// The content hashes of a set of instances, of which acyclic is set for the
+/// instances that are hashed after all the instances they reference, in the
+/// wave after the last of the waves of the instances they reference. The
+/// other instances are part of, or refer to, a reference cycle.
+struct content_hash_table {
+    std::vector<IfcUtil::IfcBaseClass*> instances;
+    boost::unordered_map<unsigned int, uint32_t> index_by_id;
+    std::vector<uint64_t> hashes;
+    std::vector<char> acyclic;
+    std::vector<uint32_t> wave;
+
+    uint64_t hash_of(int id) const {
+        auto it = index_by_id.find(id);
+        return it != index_by_id.end() ? hashes[it->second] : 0;
+    }
+
+    /// Hashes insts, which need to include the instances they reference for
+    /// these to be represented by their hashes.
+    void compute(std::vector<IfcUtil::IfcBaseClass*>&& insts, unsigned int n_threads);
+
+  private:
+    void hash_cycles_(const std::vector<std::vector<uint32_t>>& children);
+    void hash_component_(const std::vector<uint32_t>& component, const std::vector<std::vector<uint32_t>>& children);
+};
+
+/// The instances of a file, in the order of the map
+std::vector<IfcUtil::IfcBaseClass*> all_instances(const IfcFile::entity_by_id_t& byid);
+
+} // namespace IfcParse
+
+#endif
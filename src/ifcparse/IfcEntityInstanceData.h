@@ -21,7 +21,9 @@
 #define IFCENTITYINSTANCEDATA_H
 
 #include "ArgumentType.h"
+#include "IfcArena.h"
 
+#include <atomic>
 #include <boost/optional.hpp>
 #include <boost/shared_ptr.hpp>
 #include <vector>
@@ -30,24 +32,31 @@ class Argument;
 class aggregate_of_instance;
 namespace IfcParse {
 class IfcFile;
+class IfcSpfLexer;
 }
 
-class IFC_PARSE_API IfcEntityInstanceData {
+class IFC_PARSE_API IfcEntityInstanceData : public IfcParse::arena_allocated {
   public:
     // Public for backwards compatibility
     IfcParse::IfcFile* file;
 
   protected:
     unsigned id_;
+    // Set when the attributes or id differ from the text at offset_in_file_
+    bool modified_ = false;
     const IfcParse::declaration* type_;
-    mutable Argument** attributes_;
-    unsigned offset_in_file_;
+    // Published with release semantics once completely parsed, so that
+    // concurrent readers never observe a partially loaded instance.
+    mutable std::atomic<Argument**> attributes_;
+    size_t offset_in_file_;
+
+    Argument** loaded_attributes_() const;
 
   public:
     IfcEntityInstanceData(const IfcParse::declaration* type,
                           IfcParse::IfcFile* file_,
                           unsigned id = 0,
-                          unsigned offset_in_file = 0)
+                          size_t offset_in_file = 0)
         : file(file_),
           id_(id),
           type_(type),
@@ -58,18 +67,25 @@ class IFC_PARSE_API IfcEntityInstanceData {
         : file(file_),
           id_(0),
           type_(0),
-          attributes_(new Argument* [size] { 0 }),
+          attributes_(IfcParse::allocate_argument_array(size)),
           offset_in_file_(0) {}
 
     IfcEntityInstanceData(const IfcParse::declaration* type)
         : file(0),
           id_(0),
           type_(type),
-          attributes_(new Argument* [getArgumentCount()] { 0 }),
+          attributes_(IfcParse::allocate_argument_array(getArgumentCount())),
           offset_in_file_(0) {}
 
+    /// Parses the attributes from the file if this has not happened yet. Can
+    /// be called concurrently, every thread reads with its own cursor on the
+    /// file buffer, and instances are only locked while being parsed.
     void load() const;
 
+    /// Parses the attributes from the current position of lexer, which
+    /// is expected to be directly after the entity keyword.
+    void load(IfcParse::IfcSpfLexer* lexer) const;
+
     IfcEntityInstanceData(const IfcEntityInstanceData& e);
 
     virtual ~IfcEntityInstanceData();
@@ -100,11 +116,18 @@ class IFC_PARSE_API IfcEntityInstanceData {
 
     std::string toString(bool upper = false) const;
 
+    /// Appends the same representation as toString() to out
+    void write(std::string& out, bool upper = false) const;
+
     unsigned int id() const { return id_; }
-    unsigned int offset_in_file() const { return offset_in_file_; }
+    size_t offset_in_file() const { return offset_in_file_; }
+
+    /// Whether setArgument() or set_id() has been called on this instance,
+    /// i.e. whether it can no longer be written by copying it from the file.
+    bool modified() const { return modified_; }
 
-    // NB: const ommitted for lazy loading
-    Argument**& attributes() const { return attributes_; }
+    // NB: does not trigger lazy loading
+    Argument** attributes() const { return attributes_.load(std::memory_order_acquire); }
 
     unsigned set_id(boost::optional<unsigned> i = boost::none);
 };
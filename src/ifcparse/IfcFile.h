@@ -21,6 +21,7 @@
 #define IFCFILE_H
 
 #include "ifc_parse_api.h"
+#include "IfcGlobalId.h"
 #include "IfcParse.h"
 #include "IfcSchema.h"
 #include "IfcSpfHeader.h"
@@ -30,8 +31,10 @@
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/unordered_map.hpp>
+#include <functional>
 #include <iterator>
 #include <map>
+#include <mutex>
 #include <set>
 
 namespace IfcParse {
@@ -72,7 +75,7 @@ class IFC_PARSE_API IfcFile {
     typedef std::map<const IfcParse::declaration*, aggregate_of_instance::ptr> entities_by_type_t;
     typedef boost::unordered_map<unsigned int, IfcUtil::IfcBaseClass*> entity_by_id_t;
     typedef boost::unordered_map<uint32_t, IfcUtil::IfcBaseClass*> entity_by_iden_t;
-    typedef std::map<std::string, IfcUtil::IfcBaseClass*> entity_by_guid_t;
+    typedef guid_index entity_by_guid_t;
     typedef std::tuple<int, int, int> inverse_attr_record;
     enum INVERSE_ATTR {
         INSTANCE_ID,
@@ -84,23 +87,43 @@ class IFC_PARSE_API IfcFile {
     typedef std::map<unsigned int, aggregate_of_instance::ptr> ref_map_t;
     typedef entity_by_id_t::const_iterator const_iterator;
 
-    class type_iterator : private entities_by_type_t::const_iterator {
-      public:
-        type_iterator() : entities_by_type_t::const_iterator(){};
+    /// Iterates over the entities of the schema of which the file has
+    /// instances, either of exactly that entity or including subtypes.
+    class type_iterator {
+        const IfcFile* file_;
+        bool incl_subtypes_;
+        std::vector<const IfcParse::declaration*>::const_iterator it_, end_;
+
+        void skip_() {
+            while (it_ != end_ && !file_->has_instances_(*it_, incl_subtypes_)) {
+                ++it_;
+            }
+        }
 
-        type_iterator(const entities_by_type_t::const_iterator& it)
-            : entities_by_type_t::const_iterator(it){};
+      public:
+        type_iterator()
+            : file_(nullptr),
+              incl_subtypes_(false) {}
+
+        type_iterator(const IfcFile* file, bool incl_subtypes, std::vector<const IfcParse::declaration*>::const_iterator it, std::vector<const IfcParse::declaration*>::const_iterator end)
+            : file_(file),
+              incl_subtypes_(incl_subtypes),
+              it_(it),
+              end_(end) {
+            skip_();
+        }
 
-        entities_by_type_t::key_type const* operator->() const {
-            return &entities_by_type_t::const_iterator::operator->()->first;
+        const IfcParse::declaration* const* operator->() const {
+            return &*it_;
         }
 
-        entities_by_type_t::key_type const& operator*() const {
-            return entities_by_type_t::const_iterator::operator*().first;
+        const IfcParse::declaration* const& operator*() const {
+            return *it_;
         }
 
         type_iterator& operator++() {
-            entities_by_type_t::const_iterator::operator++();
+            ++it_;
+            skip_();
             return *this;
         }
 
@@ -111,9 +134,7 @@ class IFC_PARSE_API IfcFile {
         }
 
         bool operator!=(const type_iterator& other) const {
-            const entities_by_type_t::const_iterator& self_ = *this;
-            const entities_by_type_t::const_iterator& other_ = other;
-            return self_ != other_;
+            return it_ != other.it_;
         }
     };
 
@@ -125,6 +146,57 @@ class IFC_PARSE_API IfcFile {
     static bool guid_map() { return guid_map_; }
     static void guid_map(bool b) { guid_map_ = b; }
 
+    /// The number of threads used to decompress, scan, load, traverse, hash
+    /// and write files. Zero, the default, selects the number of hardware
+    /// threads. Files smaller than a few megabytes are always scanned
+    /// sequentially.
+    static unsigned num_threads_;
+    static unsigned num_threads() { return num_threads_; }
+    static void num_threads(unsigned n) { num_threads_ = n; }
+    /// num_threads(), or the number of hardware threads when it is zero,
+    /// which is at least one.
+    static unsigned effective_num_threads();
+
+    /// When set, the inverse references found while parsing are frozen into
+    /// a compressed sparse row index, rather than the byref and byref_excl
+    /// maps, which makes looking up the references to an instance a constant
+    /// time operation. The maps are rebuilt on the first modification of the
+    /// inverse references of the file.
+    static bool compact_inverses_;
+    static bool compact_inverses() { return compact_inverses_; }
+    static void compact_inverses(bool b) { compact_inverses_ = b; }
+
+    /// When set, files opened by filename are accompanied by a binary index,
+    /// stored next to them with .idx appended to the filename. It holds the
+    /// offsets and types of the instances, the GlobalIds and the inverse
+    /// references. It is written after scanning a file and used instead of
+    /// scanning when the file is opened again with the same size,
+    /// modification time and content hash. For .ifc.gz, .ifc.zst and .ifczip
+    /// files the size and modification time are those of the compressed file
+    /// and the hash is computed over the decompressed contents.
+    static bool sidecar_index_;
+    static bool sidecar_index() { return sidecar_index_; }
+    static void sidecar_index(bool b) { sidecar_index_ = b; }
+
+    /// When not empty, only the instances of these entity types and their
+    /// subtypes are read from files, together with all instances they refer
+    /// to, directly or indirectly. The spatial structure they are contained
+    /// in is included as well, by means of the IfcRelContainedInSpatialStructure
+    /// and IfcRelAggregates relationships that lead up to the project. The
+    /// other instances are skipped. References to skipped instances cannot be
+    /// resolved. Type names that are not part of the schema are ignored.
+    static std::vector<std::string> type_filter_;
+    static const std::vector<std::string>& type_filter() { return type_filter_; }
+    static void type_filter(const std::vector<std::string>& types) { type_filter_ = types; }
+
+    /// When set, instances that were read from a file and are not modified()
+    /// are written by copying their text from the file buffer, rather than by
+    /// decoding and formatting their attributes. Their content is then written
+    /// exactly as it appears in the original file.
+    static bool passthrough_unmodified_;
+    static bool passthrough_unmodified() { return passthrough_unmodified_; }
+    static void passthrough_unmodified(bool b) { passthrough_unmodified_ = b; }
+
   private:
     typedef std::map<uint32_t, IfcUtil::IfcBaseClass*> entity_entity_map_t;
 
@@ -134,28 +206,129 @@ class IFC_PARSE_API IfcFile {
     const IfcParse::schema_definition* schema_;
     const IfcParse::declaration* ifcroot_type_;
 
-    std::vector<Argument*> internal_attribute_vector_, internal_attribute_vector_simple_type_;
+    /// Instances encountered inline in attribute values, e.g. the
+    /// IfcLabel in IfcPropertySingleValue, only kept to be freed with the
+    /// file. They are not part of byidentity, as attribute values may be
+    /// loaded concurrently with lookups in the file.
+    std::vector<IfcUtil::IfcBaseClass*> inline_instances_;
+    std::mutex inline_entity_mutex_;
+    void add_inline_instance_(IfcUtil::IfcBaseClass* instance);
+    void delete_inline_instances_();
+
+    /// Owns the instance data and attributes read from the file, released
+    /// in bulk when the file is destroyed.
+    IfcParse::arena arena_;
+
+    /// Distinct strings and enumeration literals read from the file, see
+    /// Argument::interned_string().
+    IfcParse::string_pool strings_;
 
     entity_by_id_t byid;
     // this is for simple types
     entity_by_iden_t byidentity;
-    entities_by_type_t bytype;
+    /// Instances by their exact type, the instances of an entity including
+    /// its subtypes are the concatenation of the lists of entity::subtypes_incl_self().
     entities_by_type_t bytype_excl;
     entities_by_ref_t byref;
     entities_by_ref_excl_t byref_excl;
     entity_by_guid_t byguid;
     entity_entity_map_t entity_file_map;
 
+    /// A reference in the compact inverse index, type is the index in the
+    /// schema of the entity of the referring instance, or -1 when unknown.
+    struct inverse_reference {
+        int referrer;
+        int type;
+        int attribute_index;
+    };
+
+    /// The references to instance #i are inverse_references_ from
+    /// inverse_offsets_[i] up to inverse_offsets_[i + 1], in file order.
+    /// Only used when has_inverse_index_ is set, replacing byref and byref_excl.
+    std::vector<size_t> inverse_offsets_;
+    std::vector<inverse_reference> inverse_references_;
+    bool has_inverse_index_ = false;
+
+    /// Serializes getInverse() on the inverse maps, per file
+    std::mutex inverse_mutex_;
+
+    /// References collected while scanning when defer_inverses_ is set,
+    /// paired with the id of the referenced instance.
+    std::vector<std::pair<int, inverse_reference>> pending_inverses_;
+    bool defer_inverses_ = false;
+
+    void build_inverse_index_();
+    void expand_inverse_index_();
+    std::pair<const inverse_reference*, const inverse_reference*> inverse_index_range_(int id) const;
+
     unsigned int MaxId;
 
     IfcSpfHeader _header;
 
     void setDefaultHeaderValues();
 
-    void initialize_(IfcParse::IfcSpfStream* f);
+    void initialize_(IfcParse::IfcSpfStream* f, const std::string& fn = "");
+    bool read_header_(IfcParse::IfcSpfStream* f);
+
+    void scan_selection_(const std::vector<const IfcParse::declaration*>& types);
+
+    bool read_sidecar_index_(const std::string& fn, const std::string& index_fn);
+    void write_sidecar_index_(const std::string& fn, const std::string& index_fn);
+
+    /// Set when the file was opened from a snapshot written by write_snapshot()
+    bool from_snapshot_ = false;
+    void read_snapshot_();
+
+    bool has_instances_(const IfcParse::declaration* decl, bool incl_subtypes) const;
+    Argument* snapshot_argument_(size_t offset, int depth = 0);
+
+    /// Instances, guids and inverse references found in a range of the
+    /// DATA section, collected so that ranges can be scanned concurrently.
+    struct scan_fragment {
+        struct reference {
+            // Index into the instances vector of the fragment
+            unsigned int from;
+            int id_to;
+            int attribute_index;
+        };
+
+        std::vector<IfcUtil::IfcBaseClass*> instances;
+        // GlobalIds by their decoded bits, values that are not valid GlobalIds are kept as strings
+        std::vector<std::pair<IfcUtil::IfcBaseClass*, IfcGlobalId::key>> guids;
+        std::vector<std::pair<IfcUtil::IfcBaseClass*, std::string>> undecodable_guids;
+        std::vector<reference> references;
+        std::vector<std::string> errors;
+
+        // Offset of the first token that was not part of the range, only
+        // assigned when the end of the range has been reached successfully.
+        size_t end_of_scan = 0;
+
+        void clear() {
+            instances.clear();
+            guids.clear();
+            undecodable_guids.clear();
+            references.clear();
+            errors.clear();
+        }
+
+        void add_guid(IfcUtil::IfcBaseClass* instance, const char* data, size_t size) {
+            IfcGlobalId::key k;
+            if (IfcGlobalId::decode(data, size, k)) {
+                guids.emplace_back(instance, k);
+            } else {
+                undecodable_guids.emplace_back(instance, std::string(data, size));
+            }
+        }
+    };
+
+    void scan_(IfcParse::IfcSpfLexer* lexer, size_t end, bool incremental, scan_fragment& fragment);
+    void merge_(scan_fragment& fragment);
 
     void build_inverses_(IfcUtil::IfcBaseClass*);
 
+    /// Sets mapped[id] for the instances of other that append() does not copy
+    void unify_resources_(IfcFile& other, std::vector<IfcUtil::IfcBaseClass*>& mapped);
+
     typedef boost::multi_index_container<
         int,
         boost::multi_index::indexed_by<
@@ -171,19 +344,51 @@ class IFC_PARSE_API IfcFile {
     IfcParse::IfcSpfLexer* tokens;
     IfcParse::IfcSpfStream* stream;
 
+    IfcParse::arena& instance_arena() { return arena_; }
+
+    /// The pool in which the strings read from the file are interned
+    IfcParse::string_pool& strings() { return strings_; }
+
+    /// Invoked by stream_instances() for every entity instance in the file
+    typedef std::function<void(const IfcEntityInstanceData&)> instance_visitor;
+
+  private:
+    IfcFile(IfcParse::IfcSpfStream* f, const instance_visitor& visitor);
+
+    /// Calls fn with the id, type and offsets of the name and keyword of every
+    /// entity instance in the DATA section, without parsing their attributes.
+    void walk_instances_(const std::function<void(unsigned, const IfcParse::declaration*, size_t, size_t)>& fn);
+    void visit_instances_(const instance_visitor& visitor);
+
+  public:
 #ifdef USE_MMAP
-    IfcFile(const std::string& fn, bool mmap = false);
+    IfcFile(const std::string& fn, bool mmap = true);
 #else
     IfcFile(const std::string& fn);
 #endif
-    IfcFile(std::istream& fn, int len);
-    IfcFile(void* data, int len);
+    IfcFile(std::istream& fn, size_t len);
+    IfcFile(void* data, size_t len);
     IfcFile(IfcParse::IfcSpfStream* f);
     IfcFile(const IfcParse::schema_definition* schema = IfcParse::schema_by_name("IFC4"));
 
     /// Deleting the file will also delete all new instances that were added to the file (via memory allocation)
     virtual ~IfcFile();
 
+    /// Reads the entity instances of a file one at a time in file order and passes
+    /// them to visitor, without building a model. The memory used for an instance
+    /// and its attributes is reused for the next, so that no memory is held per
+    /// instance. This is not constant memory: the stream holds the whole file, or
+    /// its decompressed contents, unless it is memory mapped with USE_MMAP, and
+    /// the distinct strings read with Argument::interned_string() are kept in the
+    /// string pool of the file until the call returns. Attributes are decoded
+    /// when first accessed and, like the instance data itself, are only valid
+    /// during the call to visitor.
+    /// References to other instances cannot be resolved to IfcBaseClass and are
+    /// read as ids with Argument::reference_id(). Returns the status of opening
+    /// the file, the visitor is not invoked when it is unsuccessful.
+    static file_open_status stream_instances(IfcParse::IfcSpfStream* f, const instance_visitor& visitor);
+    static file_open_status stream_instances(const std::string& fn, const instance_visitor& visitor);
+
     file_open_status good() const { return good_; }
 
     /// Returns the first entity in the file, this probably is the entity
@@ -204,12 +409,22 @@ class IFC_PARSE_API IfcFile {
     /// IfcWall will also return IfcWallStandardCase entities
     template <class T>
     typename T::list::ptr instances_by_type() {
-        aggregate_of_instance::ptr untyped_list = instances_by_type(&T::Class());
-        if (untyped_list) {
-            return untyped_list->as<T>();
-        } else {
-            return typename T::list::ptr(new typename T::list);
+        typename T::list::ptr list(new typename T::list);
+        // The instances are all of T or its subtypes, so they are copied
+        // without checking their type as as<T>() would.
+        aggregate_of_instance::ptr instances = instances_by_type_range(&T::Class()).flatten();
+        if (!instances) {
+            return list;
         }
+        list->reserve(instances->size());
+        for (auto* inst : *instances) {
+            if constexpr (std::is_base_of<IfcUtil::IfcBaseEntity, T>::value) {
+                list->push(static_cast<T*>(inst));
+            } else {
+                list->push(inst->template as<T>());
+            }
+        }
+        return list;
     }
 
     template <class T>
@@ -222,6 +437,30 @@ class IFC_PARSE_API IfcFile {
         }
     }
 
+    /// Same as instances_by_type<T>(), but returns a view of the list that is
+    /// maintained by the file, without copying it or checking the types of
+    /// the instances, see typed_instance_view.
+    /// Unlike the list, the view is grouped by exact type, the requested type
+    /// first followed by its subtypes in depth-first schema order, and is
+    /// therefore not in file order when subtypes are present.
+    template <class T>
+    typed_instance_view<T> instances_by_type_view() {
+        return typed_instance_view<T>(instances_by_type_range(&T::Class()));
+    }
+
+    template <class T>
+    typed_instance_view<T> instances_by_type_excl_subtypes_view() {
+        joined_instance_range range;
+        range.push(instances_by_type_excl_subtypes(&T::Class()));
+        return typed_instance_view<T>(range);
+    }
+
+    /// Returns the lists by exact type that together make up the instances
+    /// of an entity including its subtypes, without copying them into a
+    /// single list as instances_by_type() does. The instances are grouped by
+    /// exact type as described for instances_by_type_view<T>().
+    joined_instance_range instances_by_type_range(const IfcParse::declaration*) const;
+
     /// Returns all entities in the file that match the positional argument.
     /// NOTE: This also returns subtypes of the requested type, for example:
     /// IfcWall will also return IfcWallStandardCase entities
@@ -256,6 +495,51 @@ class IFC_PARSE_API IfcFile {
     /// breadth-first search
     aggregate_of_instance::ptr traverse_breadth_first(IfcUtil::IfcBaseClass* instance, int max_level = -1);
 
+    typedef boost::unordered_map<unsigned int, uint64_t> content_hash_by_id_t;
+
+    /// Returns a hash of the type and attribute values of instance, in which
+    /// references are represented by the content hashes of the referenced
+    /// instances rather than by their ids. Instances that define identical
+    /// subgraphs therefore hash equal, also across files and revisions. The
+    /// instances of a reference cycle are hashed together, with references
+    /// within the cycle represented by a fixed value, so that their hashes do
+    /// not depend on where the cycle is entered. A reference to an instance
+    /// that is not in the file is represented by a fixed value as well.
+    uint64_t content_hash(IfcUtil::IfcBaseClass* instance);
+
+    /// Computes content_hash() of all instances by id, in parallel on
+    /// num_threads() threads. Instances are hashed after the instances they
+    /// reference and reference cycles as a whole, so that every instance is
+    /// hashed once. The hashes are not updated when the file is modified.
+    content_hash_by_id_t content_hashes();
+
+    /// Merges instances that are structurally identical, i.e. of which the
+    /// type and attributes are equal and which reference structurally
+    /// identical instances, such as repeated points, directions, colours and
+    /// property values. Duplicates are found by content_hashes() and
+    /// confirmed by comparing their attributes, after the duplicates they
+    /// reference are merged. References to them are redirected to the
+    /// instance with the lowest id, after which they are removed in batch
+    /// mode. Instances of IfcRoot subtypes, which are identified by their
+    /// GlobalId, are not merged. Neither are instances in or leading into
+    /// reference cycles, as the members of a cycle cannot be confirmed one
+    /// after the other, and are only identical when the cycles as a whole
+    /// are. Returns the number of instances that were removed.
+    size_t merge_duplicates();
+
+    /// Adds copies of all instances of other to this file in one pass, rather
+    /// than one addEntity() call per instance. The copies keep the ids they
+    /// have in other, offset by getMaxId() of this file. When unify_resources
+    /// is set, the unit assignments, owner histories and representation
+    /// contexts of other that are structurally identical to one in this file,
+    /// including the instances they reference, are not copied, references to
+    /// them refer to the instances in this file instead. Attributes are copied
+    /// on num_threads() threads and the inverse references of the copies are
+    /// registered in one batch. Like addEntity(), length measures are
+    /// converted when the files have different length units. Returns the
+    /// number of instances that were added.
+    size_t append(IfcFile& other, bool unify_resources = false);
+
     /// Get the attribute indices corresponding to the list of entity instances
     /// returned by getInverse().
     std::vector<int> get_inverse_indices(int instance_id);
@@ -302,10 +586,41 @@ class IFC_PARSE_API IfcFile {
 
     std::string createTimestamp() const;
 
-    size_t load(unsigned entity_instance_name, const IfcParse::entity* entity, Argument**& attributes, size_t num_attributes, int attribute_index = -1);
-    void seek_to(const IfcEntityInstanceData& data);
-    void try_read_semicolon();
-
+    /// Writes a binary snapshot of the file, see IfcSnapshot.h, which the
+    /// constructors open in place of an IFC-SPF file. Opening a snapshot involves
+    /// no parsing: the instances, GlobalIds and inverse references are read from
+    /// tables and attribute values are decoded from fixed size cells in the file
+    /// buffer when accessed, with USE_MMAP directly from the mapped pages. The
+    /// type_filter() and sidecar_index() options do not apply to snapshots.
+    void write_snapshot(std::ostream& os) const;
+
+    /// Whether the file was opened from a snapshot
+    bool from_snapshot() const { return from_snapshot_; }
+
+    /// Writes the instances in roots and the instances they reference,
+    /// directly or indirectly, as an IFC-SPF file with the header of this
+    /// file, without adding them to another file. The instances are found by
+    /// a single traverse_breadth_first() from all roots, so that shared
+    /// instances are written once, and are renumbered from 1 in the order of
+    /// their ids. Instances that were read from the file and are not
+    /// modified() are copied from the file buffer with their references
+    /// renumbered, regardless of passthrough_unmodified(), other instances
+    /// are formatted. Instances that only refer to roots, such as
+    /// relationships, are not included unless they are roots themselves.
+    /// Returns the number of instances written.
+    size_t write_subset(std::ostream& os, const std::vector<IfcUtil::IfcBaseClass*>& roots) const;
+
+    /// Creates the attributes of an instance from the cells at offset in a
+    /// snapshot, the counterpart of load() for files opened from a snapshot.
+    Argument** load_snapshot(size_t offset, size_t num_attributes);
+
+    /// Reads attribute values from lexer, or the token cursor of the file when
+    /// none is provided, registering inverse references while parsing.
+    size_t load(unsigned entity_instance_name, const IfcParse::entity* entity, Argument**& attributes, size_t num_attributes, int attribute_index = -1, IfcParse::IfcSpfLexer* lexer = nullptr);
+    void seek_to(const IfcEntityInstanceData& data, IfcParse::IfcSpfLexer* lexer = nullptr);
+    void try_read_semicolon(IfcParse::IfcSpfLexer* lexer = nullptr);
+
+    void register_inverse(unsigned, const IfcParse::entity* from_entity, int id_to, int attribute_index);
     void register_inverse(unsigned, const IfcParse::entity* from_entity, Token, int attribute_index);
     void register_inverse(unsigned, const IfcParse::entity* from_entity, IfcUtil::IfcBaseClass*, int attribute_index);
     void unregister_inverse(unsigned, const IfcParse::entity* from_entity, IfcUtil::IfcBaseClass*, int attribute_index);
@@ -142,3 +142,201 @@ IfcParse::IfcGlobalId::operator const boost::uuids::uuid&() const {
 const std::string& IfcParse::IfcGlobalId::formatted() const {
     return formatted_string;
 }
+
+namespace {
+// Maps characters to their value in the base64 alphabet or to 0xff
+struct base64_table {
+    unsigned char values[256];
+    base64_table() {
+        std::fill(values, values + 256, (unsigned char)0xff);
+        for (unsigned i = 0; i < 64; ++i) {
+            values[(unsigned char)chars[i]] = (unsigned char)i;
+        }
+    }
+};
+
+const base64_table& base64_values() {
+    static const base64_table table;
+    return table;
+}
+
+size_t hash_key(const IfcParse::IfcGlobalId::key& k) {
+    uint64_t h = (k.hi * 0x9e3779b97f4a7c15ULL) ^ k.lo;
+    h ^= h >> 32;
+    h *= 0xd6e8feb86659fd93ULL;
+    h ^= h >> 32;
+    return (size_t)h;
+}
+} // namespace
+
+bool IfcParse::IfcGlobalId::decode(const char* data, size_t size, key& k) {
+    // The base64 representation is the 128 bit value in big endian order,
+    // with the first character only encoding the two most significant bits.
+    if (size != length) {
+        return false;
+    }
+    const unsigned char* values = base64_values().values;
+    uint64_t hi = 0, lo = 0;
+    for (size_t i = 0; i < length; ++i) {
+        const unsigned char v = values[(unsigned char)data[i]];
+        if (v == 0xff || (i == 0 && v > 3)) {
+            return false;
+        }
+        hi = (hi << 6) | (lo >> 58);
+        lo = (lo << 6) | v;
+    }
+    k.hi = hi;
+    k.lo = lo;
+    return true;
+}
+
+std::string IfcParse::IfcGlobalId::encode(const key& k) {
+    std::string r(length, '0');
+    uint64_t hi = k.hi, lo = k.lo;
+    for (size_t i = length; i > 0; --i) {
+        r[i - 1] = chars[lo & 63];
+        lo = (lo >> 6) | (hi << 58);
+        hi >>= 6;
+    }
+    return r;
+}
+
+size_t IfcParse::guid_index::slot_of_(const IfcGlobalId::key& k) const {
+    const size_t mask = slots_.size() - 1;
+    size_t i = hash_key(k) & mask;
+    while (slots_[i].instance != nullptr && slots_[i].key != k) {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void IfcParse::guid_index::grow_() {
+    std::vector<slot> previous;
+    previous.swap(slots_);
+    slots_.assign(previous.empty() ? 64 : previous.size() * 2, slot{{0, 0}, nullptr});
+    for (const auto& s : previous) {
+        if (s.instance != nullptr) {
+            slots_[slot_of_(s.key)] = s;
+        }
+    }
+}
+
+IfcUtil::IfcBaseClass* IfcParse::guid_index::find(const IfcGlobalId::key& k) const {
+    if (slots_.empty()) {
+        return nullptr;
+    }
+    return slots_[slot_of_(k)].instance;
+}
+
+IfcUtil::IfcBaseClass* IfcParse::guid_index::find(const std::string& guid) const {
+    IfcGlobalId::key k;
+    if (IfcGlobalId::decode(guid, k)) {
+        return find(k);
+    }
+    auto it = undecodable_.find(guid);
+    return it == undecodable_.end() ? nullptr : it->second;
+}
+
+IfcUtil::IfcBaseClass* IfcParse::guid_index::assign(const IfcGlobalId::key& k, IfcUtil::IfcBaseClass* instance) {
+    if (instance == nullptr) {
+        IfcUtil::IfcBaseClass* previous = find(k);
+        erase(k);
+        return previous;
+    }
+    // Keep the load factor at or below one half
+    if ((size_ + 1) * 2 > slots_.size()) {
+        grow_();
+    }
+    slot& s = slots_[slot_of_(k)];
+    IfcUtil::IfcBaseClass* previous = s.instance;
+    if (previous == nullptr) {
+        ++size_;
+    }
+    s.key = k;
+    s.instance = instance;
+    return previous;
+}
+
+IfcUtil::IfcBaseClass* IfcParse::guid_index::assign(const std::string& guid, IfcUtil::IfcBaseClass* instance) {
+    IfcGlobalId::key k;
+    if (IfcGlobalId::decode(guid, k)) {
+        return assign(k, instance);
+    }
+    IfcUtil::IfcBaseClass* previous = nullptr;
+    auto it = undecodable_.find(guid);
+    if (it != undecodable_.end()) {
+        previous = it->second;
+        if (instance == nullptr) {
+            undecodable_.erase(it);
+        } else {
+            it->second = instance;
+        }
+    } else if (instance != nullptr) {
+        undecodable_.insert({guid, instance});
+    }
+    return previous;
+}
+
+bool IfcParse::guid_index::erase(const IfcGlobalId::key& k) {
+    if (slots_.empty()) {
+        return false;
+    }
+    size_t i = slot_of_(k);
+    if (slots_[i].instance == nullptr) {
+        return false;
+    }
+    // Shift subsequent entries of the probe sequence back, so that no
+    // tombstones are needed.
+    const size_t mask = slots_.size() - 1;
+    size_t j = i;
+    for (;;) {
+        j = (j + 1) & mask;
+        if (slots_[j].instance == nullptr) {
+            break;
+        }
+        const size_t home = hash_key(slots_[j].key) & mask;
+        const bool stays = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if (!stays) {
+            slots_[i] = slots_[j];
+            i = j;
+        }
+    }
+    slots_[i].instance = nullptr;
+    --size_;
+    return true;
+}
+
+bool IfcParse::guid_index::erase(const std::string& guid) {
+    IfcGlobalId::key k;
+    if (IfcGlobalId::decode(guid, k)) {
+        return erase(k);
+    }
+    return undecodable_.erase(guid) > 0;
+}
+
+void IfcParse::guid_index::reserve(size_t n) {
+    while (n * 2 > slots_.size()) {
+        grow_();
+    }
+}
+
+void IfcParse::guid_index::clear() {
+    slots_.clear();
+    size_ = 0;
+    undecodable_.clear();
+}
+
+std::vector<std::pair<std::string, IfcUtil::IfcBaseClass*>> IfcParse::guid_index::sorted() const {
+    std::vector<std::pair<std::string, IfcUtil::IfcBaseClass*>> r;
+    r.reserve(size());
+    for (const auto& s : slots_) {
+        if (s.instance != nullptr) {
+            r.emplace_back(IfcGlobalId::encode(s.key), s.instance);
+        }
+    }
+    r.insert(r.end(), undecodable_.begin(), undecodable_.end());
+    std::sort(r.begin(), r.end(), [](const std::pair<std::string, IfcUtil::IfcBaseClass*>& a, const std::pair<std::string, IfcUtil::IfcBaseClass*>& b) {
+        return a.first < b.first;
+    });
+    return r;
+}
@@ -23,7 +23,14 @@
 #include "ifc_parse_api.h"
 
 #include <boost/uuid/uuid.hpp>
+#include <cstdint>
+#include <map>
 #include <string>
+#include <vector>
+
+namespace IfcUtil {
+class IfcBaseClass;
+}
 
 namespace IfcParse {
 
@@ -40,6 +47,65 @@ class IFC_PARSE_API IfcGlobalId {
     operator const std::string&() const;
     operator const boost::uuids::uuid&() const;
     const std::string& formatted() const;
+
+    /// The 128 bits of a GlobalId, most significant half first
+    struct key {
+        uint64_t hi, lo;
+
+        bool operator==(const key& other) const { return hi == other.hi && lo == other.lo; }
+        bool operator!=(const key& other) const { return !(*this == other); }
+    };
+
+    /// Decodes the base64 representation of a GlobalId without intermediate
+    /// allocations. Returns false when the characters are not a valid
+    /// GlobalId, i.e. not 22 characters from the IFC base64 alphabet of
+    /// which the first encodes at most two bits.
+    static bool decode(const char* data, size_t size, key& k);
+    static bool decode(const std::string& s, key& k) { return decode(s.data(), s.size(), k); }
+
+    /// Encodes a key into the base64 representation of the GlobalId
+    static std::string encode(const key& k);
+};
+
+/// Maps GlobalIds to instances. Valid GlobalIds are stored by their decoded
+/// 128 bits in an open addressing hash table, so that lookups do not
+/// allocate and keys occupy 16 bytes rather than a heap allocated string.
+/// Values that do not decode as a GlobalId are kept in a separate ordered
+/// map, so that files with malformed GlobalIds can still be queried.
+class IFC_PARSE_API guid_index {
+  private:
+    struct slot {
+        IfcGlobalId::key key;
+        IfcUtil::IfcBaseClass* instance;
+    };
+
+    std::vector<slot> slots_;
+    size_t size_ = 0;
+    std::map<std::string, IfcUtil::IfcBaseClass*> undecodable_;
+
+    size_t slot_of_(const IfcGlobalId::key& k) const;
+    void grow_();
+
+  public:
+    /// Returns the instance with GlobalId k or nullptr
+    IfcUtil::IfcBaseClass* find(const IfcGlobalId::key& k) const;
+    IfcUtil::IfcBaseClass* find(const std::string& guid) const;
+
+    /// Associates the GlobalId with instance, replacing any previous
+    /// association. Returns the instance previously associated or nullptr.
+    IfcUtil::IfcBaseClass* assign(const IfcGlobalId::key& k, IfcUtil::IfcBaseClass* instance);
+    IfcUtil::IfcBaseClass* assign(const std::string& guid, IfcUtil::IfcBaseClass* instance);
+
+    /// Removes the GlobalId, returns whether it was present
+    bool erase(const IfcGlobalId::key& k);
+    bool erase(const std::string& guid);
+
+    void reserve(size_t n);
+    void clear();
+    size_t size() const { return size_ + undecodable_.size(); }
+
+    /// Returns the GlobalIds and their instances ordered by GlobalId string
+    std::vector<std::pair<std::string, IfcUtil::IfcBaseClass*>> sorted() const;
 };
 
 } // namespace IfcParse
@@ -0,0 +1,55 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#ifndef IFCHASH_H
+#define IFCHASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace IfcParse {
+
+/// A multiplicative hash over four interleaved lanes of 64-bit words, which
+/// runs at memory bandwidth and is insignificant compared to scanning the file.
+/// Used by sidecar indices, snapshots and content hashes, which are stored,
+/// so the result must not change.
+inline uint64_t hash_buffer(const char* data, size_t n) {
+    const uint64_t m = 0x9E3779B97F4A7C15ULL;
+    uint64_t h[4] = {n, n ^ 0x0123456789ABCDEFULL, ~n, n * m};
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        for (int j = 0; j < 4; ++j) {
+            uint64_t w;
+            std::memcpy(&w, data + i + j * 8, 8);
+            h[j] = (h[j] ^ w) * m;
+            h[j] ^= h[j] >> 29;
+        }
+    }
+    uint64_t r = h[0] ^ (h[1] * 3) ^ (h[2] * 5) ^ (h[3] * 7);
+    for (; i < n; ++i) {
+        r = (r ^ (unsigned char)data[i]) * 0x100000001B3ULL;
+    }
+    r ^= r >> 31;
+    return r * m;
+}
+
+} // namespace IfcParse
+
+#endif
@@ -0,0 +1,117 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#ifndef IFCINSTANCEVISITOR_H
+#define IFCINSTANCEVISITOR_H
+
+#include "IfcEntityInstanceData.h"
+#include "IfcException.h"
+#include "IfcLogger.h"
+#include "IfcParse.h"
+
+// Calls a function for every instance referenced by an attribute, or by all
+// attributes of an instance, with the index of the attribute.
+class apply_individual_instance_visitor {
+  private:
+    Argument* attribute_;
+    IfcEntityInstanceData* data_;
+    int attribute_index_;
+
+    // Visits the elements of a parsed list in place, rather than copying
+    // them into an aggregate_of_instance first, with the same handling of
+    // elements that are not instances as that conversion.
+    template <typename T>
+    void apply_list_(T& t, IfcParse::ArgumentList* list, int index) const {
+        for (unsigned int i = 0; i < list->size(); ++i) {
+            IfcUtil::IfcBaseClass* inst = nullptr;
+            try {
+                inst = *(*list)[i];
+            } catch (IfcParse::IfcException& e) {
+                Logger::Error(e);
+            }
+            if (inst) {
+                t(inst, index);
+            }
+        }
+    }
+
+    template <typename T>
+    void apply_attribute_(T& t, Argument* attr, int index) const {
+        if (!attr) {
+            return;
+        }
+
+        if (attr->type() == IfcUtil::Argument_ENTITY_INSTANCE) {
+            IfcUtil::IfcBaseClass* inst = *attr;
+            t(inst, index);
+        } else if (attr->type() == IfcUtil::Argument_AGGREGATE_OF_ENTITY_INSTANCE) {
+            if (auto* list = dynamic_cast<IfcParse::ArgumentList*>(attr)) {
+                apply_list_(t, list, index);
+                return;
+            }
+            aggregate_of_instance::ptr entity_list_attribute = *attr;
+            for (aggregate_of_instance::it it = entity_list_attribute->begin(); it != entity_list_attribute->end(); ++it) {
+                t(*it, index);
+            }
+        } else if (attr->type() == IfcUtil::Argument_AGGREGATE_OF_AGGREGATE_OF_ENTITY_INSTANCE) {
+            if (auto* list = dynamic_cast<IfcParse::ArgumentList*>(attr)) {
+                bool nested = true;
+                for (unsigned int i = 0; i < list->size() && nested; ++i) {
+                    nested = dynamic_cast<IfcParse::ArgumentList*>((*list)[i]) != nullptr;
+                }
+                if (nested) {
+                    for (unsigned int i = 0; i < list->size(); ++i) {
+                        apply_list_(t, static_cast<IfcParse::ArgumentList*>((*list)[i]), index);
+                    }
+                    return;
+                }
+            }
+            aggregate_of_aggregate_of_instance::ptr entity_list_attribute = *attr;
+            for (aggregate_of_aggregate_of_instance::outer_it it = entity_list_attribute->begin(); it != entity_list_attribute->end(); ++it) {
+                for (aggregate_of_aggregate_of_instance::inner_it jt = it->begin(); jt != it->end(); ++jt) {
+                    t(*jt, index);
+                }
+            }
+        }
+    };
+
+  public:
+    apply_individual_instance_visitor(Argument* attribute, int idx)
+        : attribute_(attribute),
+          data_(0),
+          attribute_index_(idx) {}
+
+    apply_individual_instance_visitor(IfcEntityInstanceData* data)
+        : attribute_(0),
+          data_(data) {}
+
+    template <typename T>
+    void apply(T& t) const {
+        if (attribute_) {
+            apply_attribute_(t, attribute_, attribute_index_);
+        } else {
+            for (size_t i = 0; i < data_->getArgumentCount(); ++i) {
+                Argument* attr = data_->getArgument(i);
+                apply_attribute_(t, attr, i);
+            }
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,150 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#include "IfcContentHash.h"
+#include "IfcParallel.h"
+#include "IfcWriteUtils.h"
+
+#include <algorithm>
+#include <numeric>
+#include <set>
+
+using namespace IfcParse;
+
+namespace {
+typedef boost::unordered_map<IfcUtil::IfcBaseClass*, IfcUtil::IfcBaseClass*> replacement_map_t;
+
+IfcUtil::IfcBaseClass* replaced(IfcUtil::IfcBaseClass* instance, const replacement_map_t& replacements) {
+    auto it = replacements.find(instance);
+    return it == replacements.end() ? instance : it->second;
+}
+} // namespace
+
+size_t IfcFile::merge_duplicates() {
+    const unsigned int n_threads = effective_num_threads();
+
+    content_hash_table table;
+    table.compute(all_instances(byid), n_threads);
+
+    // Instances with equal hashes, ordered by id, of which the first is kept
+    std::vector<uint32_t> candidates;
+    for (size_t i = 0; i < table.instances.size(); ++i) {
+        const IfcParse::declaration& decl = table.instances[i]->declaration();
+        if (table.acyclic[i] && decl.as_entity() && !(ifcroot_type_ && decl.is(*ifcroot_type_))) {
+            candidates.push_back((uint32_t)i);
+        }
+    }
+    std::sort(candidates.begin(), candidates.end(), [&table](uint32_t a, uint32_t b) {
+        return std::make_pair(table.hashes[a], table.instances[a]->data().id()) < std::make_pair(table.hashes[b], table.instances[b]->data().id());
+    });
+
+    std::vector<std::pair<uint32_t, uint32_t>> duplicates;
+    for (size_t i = 0; i < candidates.size();) {
+        size_t j = i + 1;
+        for (; j < candidates.size() && table.hashes[candidates[j]] == table.hashes[candidates[i]]; ++j) {
+            duplicates.push_back({candidates[j], candidates[i]});
+        }
+        i = j;
+    }
+
+    // Guards against hash collisions by comparing the attributes themselves,
+    // with references represented by the id of the instance that they are
+    // redirected to. The duplicates are compared in the order of the waves in
+    // which they were hashed, so that the duplicates they reference are known.
+    auto wave_of = [&table](const std::pair<uint32_t, uint32_t>& d) {
+        return (std::max)(table.wave[d.first], table.wave[d.second]);
+    };
+    std::stable_sort(duplicates.begin(), duplicates.end(), [&wave_of](const std::pair<uint32_t, uint32_t>& a, const std::pair<uint32_t, uint32_t>& b) {
+        return wave_of(a) < wave_of(b);
+    });
+    std::vector<uint32_t> canonical(table.instances.size());
+    std::iota(canonical.begin(), canonical.end(), 0);
+    auto canonical_id = [&table, &canonical](int id) -> uint64_t {
+        auto it = table.index_by_id.find(id);
+        return it != table.index_by_id.end() ? table.instances[canonical[it->second]]->data().id() : (unsigned int)id;
+    };
+    std::vector<char> identical(duplicates.size());
+    for (size_t begin = 0; begin < duplicates.size();) {
+        size_t end = begin + 1;
+        while (end < duplicates.size() && wave_of(duplicates[end]) == wave_of(duplicates[begin])) {
+            ++end;
+        }
+        parallel_for(
+            end - begin, n_threads, [&](size_t k) {
+                const auto& d = duplicates[begin + k];
+                identical[begin + k] = instance_content(table.instances[d.first], canonical_id) == instance_content(table.instances[d.second], canonical_id);
+            },
+            min_instances_per_thread);
+        for (size_t k = begin; k < end; ++k) {
+            if (identical[k]) {
+                canonical[duplicates[k].first] = duplicates[k].second;
+            }
+        }
+        begin = end;
+    }
+
+    replacement_map_t replacements;
+    std::vector<uint32_t> removed;
+    for (size_t k = 0; k < duplicates.size(); ++k) {
+        if (identical[k]) {
+            replacements[table.instances[duplicates[k].first]] = table.instances[duplicates[k].second];
+            removed.push_back(duplicates[k].first);
+        }
+    }
+
+    // References to the duplicates are redirected to the instances that are
+    // kept, which updates the inverse references, so that the duplicates are
+    // no longer referenced when they are removed.
+    std::set<unsigned int> referrers;
+    for (auto& p : replacements) {
+        aggregate_of_instance::ptr references = instances_by_reference(p.first->data().id());
+        for (aggregate_of_instance::it it = references->begin(); it != references->end(); ++it) {
+            if (replacements.find(*it) == replacements.end()) {
+                referrers.insert((*it)->data().id());
+            }
+        }
+    }
+    for (auto& id : referrers) {
+        IfcEntityInstanceData& data = byid[id]->data();
+        for (size_t i = 0; i < data.getArgumentCount(); ++i) {
+            IfcWrite::IfcWriteArgument* copy = IfcWrite::replace_instances(data.getArgument(i), [&replacements](IfcUtil::IfcBaseClass* instance) {
+                return replaced(instance, replacements);
+            });
+            if (copy) {
+                data.setArgument(i, copy);
+            }
+        }
+    }
+
+    // Duplicates are removed before the duplicates that reference them, as
+    // process_deletion_() looks up the instances that reference an instance.
+    std::sort(removed.begin(), removed.end(), [&table](uint32_t a, uint32_t b) {
+        return table.wave[a] < table.wave[b];
+    });
+    const bool was_batch_mode = batch_mode_;
+    batch();
+    for (auto& i : removed) {
+        removeEntity(table.instances[i]);
+    }
+    if (!was_batch_mode) {
+        unbatch();
+    }
+
+    return replacements.size();
+}
@@ -0,0 +1,89 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#ifndef IFCPARALLEL_H
+#define IFCPARALLEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <future>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace IfcParse {
+
+/// The least number of instances for which another thread is used to
+/// traverse, hash or copy instances with parallel_for()
+const size_t min_instances_per_thread = 1 << 10;
+
+/// Calls fn(i) for the indices [0, n), contiguous ranges of which are
+/// distributed over at most num_threads threads, one of which is the calling
+/// thread. A thread is only used for at least min_per_thread indices, so
+/// that small amounts of cheap work are not spread over threads.
+template <typename Fn>
+void parallel_for(size_t n, unsigned num_threads, Fn fn, size_t min_per_thread = 1) {
+    const size_t n_tasks = (std::max)((size_t)1, (std::min)((size_t)num_threads, n / (std::max)((size_t)1, min_per_thread)));
+    std::vector<std::future<void>> tasks;
+    for (size_t t = 1; t < n_tasks; ++t) {
+        tasks.push_back(std::async(std::launch::async, [&fn, n, n_tasks, t]() {
+            for (size_t i = n * t / n_tasks; i < n * (t + 1) / n_tasks; ++i) {
+                fn(i);
+            }
+        }));
+    }
+    for (size_t i = 0; i < n / n_tasks; ++i) {
+        fn(i);
+    }
+    for (auto& t : tasks) {
+        t.get();
+    }
+}
+
+/// Formats the items [0, n_items) with format(i, buffer) in chunks, on at
+/// most num_threads threads, and writes the chunks to the stream in order.
+template <typename Fn>
+void write_in_chunks(std::ostream& os, size_t n_items, unsigned num_threads, Fn format) {
+    const size_t chunk_size = 1 << 14;
+    const size_t n_chunks = (n_items + chunk_size - 1) / chunk_size;
+    const size_t n_buffers = (std::max)((size_t)1, (std::min)((size_t)num_threads, n_chunks));
+
+    auto format_chunk = [&format, n_items, chunk_size](size_t chunk, std::string& buffer) {
+        buffer.clear();
+        const size_t end = (std::min)((chunk + 1) * chunk_size, n_items);
+        for (size_t i = chunk * chunk_size; i < end; ++i) {
+            format(i, buffer);
+        }
+    };
+
+    std::vector<std::string> buffers(n_buffers);
+    for (size_t first = 0; first < n_chunks; first += n_buffers) {
+        const size_t n = (std::min)(n_buffers, n_chunks - first);
+        parallel_for(n, num_threads, [&format_chunk, &buffers, first](size_t i) {
+            format_chunk(first + i, buffers[i]);
+        });
+        for (size_t i = 0; i < n; ++i) {
+            os.write(buffers[i].data(), buffers[i].size());
+        }
+    }
+}
+
+} // namespace IfcParse
+
+#endif
@@ -21,23 +21,37 @@
 
 #include "IfcBaseClass.h"
 #include "IfcCharacterDecoder.h"
+#include "IfcCompression.h"
 #include "IfcException.h"
 #include "IfcFile.h"
+#include "IfcGlobalId.h"
+#include "IfcHash.h"
+#include "IfcInstanceVisitor.h"
+#include "IfcParallel.h"
 #include "IfcSchema.h"
 #include "IfcSIPrefix.h"
+#include "IfcSnapshot.h"
 #include "IfcSpfStream.h"
+#include "IfcWriteUtils.h"
 #include "utils.h"
 
 #include <algorithm>
+#include <array>
 #include <boost/algorithm/string.hpp>
 #include <boost/circular_buffer.hpp>
 #include <boost/math/special_functions/fpclassify.hpp>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
 #include <ctime>
+#include <iterator>
 #include <mutex>
+#include <numeric>
 #include <set>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string>
+#include <thread>
 
 #ifdef USE_MMAP
 #include <boost/filesystem/path.hpp>
@@ -101,6 +115,174 @@ void init_locale() {
 
 #endif
 
+// The lexer skips over whitespace and over the characters that make up a token
+// until one of the token delimiters is encountered. Instead of one character at a
+// time, these ranges are classified 16 or 32 characters at a time when SSE2 or AVX2
+// instructions are available at compile time, with a scalar loop for the remainder.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define IFCPARSE_LEXER_AVX2
+#define IFCPARSE_LEXER_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IFCPARSE_LEXER_SSE2
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+inline bool is_delimiter(char c) {
+    return c == '(' || c == ')' || c == '=' || c == ',' || c == ';' || c == '/' || c == '\'';
+}
+
+#ifdef IFCPARSE_LEXER_SSE2
+inline unsigned trailing_zeros(unsigned mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned)index;
+#else
+    return (unsigned)__builtin_ctz(mask);
+#endif
+}
+
+inline unsigned separator_mask_sse2(__m128i c) {
+    const __m128i m = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(c, _mm_set1_epi8('\r'))),
+        _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(c, _mm_set1_epi8('\t'))));
+    return (unsigned)_mm_movemask_epi8(m);
+}
+
+inline unsigned delimiter_mask_sse2(__m128i c) {
+    const __m128i m = _mm_or_si128(
+        _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('(')), _mm_cmpeq_epi8(c, _mm_set1_epi8(')'))),
+            _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('=')), _mm_cmpeq_epi8(c, _mm_set1_epi8(',')))),
+        _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8(';')), _mm_cmpeq_epi8(c, _mm_set1_epi8('/'))),
+            _mm_cmpeq_epi8(c, _mm_set1_epi8('\''))));
+    return (unsigned)_mm_movemask_epi8(m);
+}
+#endif
+
+#ifdef IFCPARSE_LEXER_AVX2
+inline unsigned separator_mask_avx2(__m256i c) {
+    const __m256i m = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\r'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\t'))));
+    return (unsigned)_mm256_movemask_epi8(m);
+}
+
+inline unsigned delimiter_mask_avx2(__m256i c) {
+    const __m256i m = _mm256_or_si256(
+        _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('(')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8(')'))),
+            _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8('=')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8(',')))),
+        _mm256_or_si256(
+            _mm256_or_si256(_mm256_cmpeq_epi8(c, _mm256_set1_epi8(';')), _mm256_cmpeq_epi8(c, _mm256_set1_epi8('/'))),
+            _mm256_cmpeq_epi8(c, _mm256_set1_epi8('\''))));
+    return (unsigned)_mm256_movemask_epi8(m);
+}
+#endif
+
+// Returns the offset of the first character in [offset, end) that is not whitespace, or end
+size_t find_non_separator(const char* data, size_t offset, size_t end) {
+#ifdef IFCPARSE_LEXER_AVX2
+    for (; offset + 32 <= end; offset += 32) {
+        const unsigned mask = ~separator_mask_avx2(_mm256_loadu_si256((const __m256i*)(data + offset)));
+        if (mask) {
+            return offset + trailing_zeros(mask);
+        }
+    }
+#endif
+#ifdef IFCPARSE_LEXER_SSE2
+    for (; offset + 16 <= end; offset += 16) {
+        const unsigned mask = separator_mask_sse2(_mm_loadu_si128((const __m128i*)(data + offset))) ^ 0xffffU;
+        if (mask) {
+            return offset + trailing_zeros(mask);
+        }
+    }
+#endif
+    for (; offset < end; ++offset) {
+        if (!is_separator(data[offset])) {
+            return offset;
+        }
+    }
+    return end;
+}
+
+// Returns the offset of the first token delimiter or quote in [offset, end), or end
+size_t find_delimiter(const char* data, size_t offset, size_t end) {
+#ifdef IFCPARSE_LEXER_AVX2
+    for (; offset + 32 <= end; offset += 32) {
+        const unsigned mask = delimiter_mask_avx2(_mm256_loadu_si256((const __m256i*)(data + offset)));
+        if (mask) {
+            return offset + trailing_zeros(mask);
+        }
+    }
+#endif
+#ifdef IFCPARSE_LEXER_SSE2
+    for (; offset + 16 <= end; offset += 16) {
+        const unsigned mask = delimiter_mask_sse2(_mm_loadu_si128((const __m128i*)(data + offset)));
+        if (mask) {
+            return offset + trailing_zeros(mask);
+        }
+    }
+#endif
+    for (; offset < end; ++offset) {
+        if (is_delimiter(data[offset])) {
+            return offset;
+        }
+    }
+    return end;
+}
+
+// Returns the offset of the first character in [offset, end) that ends a
+// string literal or needs to be decoded: an apostrophe, a backslash or a
+// character outside of printable ASCII, or end
+size_t find_string_special(const char* data, size_t offset, size_t end) {
+#ifdef IFCPARSE_LEXER_SSE2
+    for (; offset + 16 <= end; offset += 16) {
+        const __m128i c = _mm_loadu_si128((const __m128i*)(data + offset));
+        // The signed comparison also matches the bytes of multibyte sequences
+        const __m128i m = _mm_or_si128(
+            _mm_or_si128(_mm_cmplt_epi8(c, _mm_set1_epi8(0x20)), _mm_cmpeq_epi8(c, _mm_set1_epi8(0x7f))),
+            _mm_or_si128(_mm_cmpeq_epi8(c, _mm_set1_epi8('\'')), _mm_cmpeq_epi8(c, _mm_set1_epi8('\\'))));
+        const unsigned mask = (unsigned)_mm_movemask_epi8(m);
+        if (mask) {
+            return offset + trailing_zeros(mask);
+        }
+    }
+#endif
+    for (; offset < end; ++offset) {
+        const unsigned char c = (unsigned char)data[offset];
+        if (c < 0x20 || c > 0x7e || c == '\'' || c == '\\') {
+            return offset;
+        }
+    }
+    return end;
+}
+
+// Returns whether [offset, end) contains whitespace
+bool contains_separator(const char* data, size_t offset, size_t end) {
+#ifdef IFCPARSE_LEXER_SSE2
+    for (; offset + 16 <= end; offset += 16) {
+        if (separator_mask_sse2(_mm_loadu_si128((const __m128i*)(data + offset)))) {
+            return true;
+        }
+    }
+#endif
+    for (; offset < end; ++offset) {
+        if (is_separator(data[offset])) {
+            return true;
+        }
+    }
+    return false;
+}
+} // namespace
+
 //
 // Opens the file and gets the filesize
 //
@@ -111,6 +293,7 @@ IfcSpfStream::IfcSpfStream(const std::string& fn)
 #endif
     : stream(0),
       buffer(0),
+      owns_buffer(true),
       valid(false),
       eof(false) {
 #ifdef _MSC_VER
@@ -150,7 +333,7 @@ IfcSpfStream::IfcSpfStream(const std::string& fn)
         valid = true;
         buffer = mfs.data();
         ptr = 0;
-        len = mfs.size();
+        len = size = mfs.size();
     } else {
 #endif
         if (stream == NULL) {
@@ -158,11 +341,16 @@ IfcSpfStream::IfcSpfStream(const std::string& fn)
         }
 
         valid = true;
-        fseek(stream, 0, SEEK_END);
-        size = (unsigned int)ftell(stream);
+#ifdef _MSC_VER
+        _fseeki64(stream, 0, SEEK_END);
+        size = (size_t)_ftelli64(stream);
+#else
+        fseeko(stream, 0, SEEK_END);
+        size = (size_t)ftello(stream);
+#endif
         rewind(stream);
         char* buffer_rw = new char[size];
-        len = (unsigned int)fread(buffer_rw, 1, size, stream);
+        len = fread(buffer_rw, 1, size, stream);
         buffer = buffer_rw;
         eof = len == 0;
         ptr = 0;
@@ -171,30 +359,88 @@ IfcSpfStream::IfcSpfStream(const std::string& fn)
 #ifdef USE_MMAP
     }
 #endif
+
+    decompress_();
 }
 
-IfcSpfStream::IfcSpfStream(std::istream& f, int l)
+IfcSpfStream::IfcSpfStream(std::istream& f, size_t l)
     : stream(0),
-      buffer(0) {
+      buffer(0),
+      owns_buffer(true) {
     eof = false;
     size = l;
     char* buffer_rw = new char[size];
     f.read(buffer_rw, size);
     buffer = buffer_rw;
-    valid = f.gcount() == size;
+    valid = (size_t)f.gcount() == size;
     ptr = 0;
     len = l;
+
+    decompress_();
 }
 
-IfcSpfStream::IfcSpfStream(void* data, int l)
+IfcSpfStream::IfcSpfStream(void* data, size_t l)
     : stream(0),
-      buffer(0) {
+      buffer(0),
+      owns_buffer(true) {
     eof = false;
     size = l;
     buffer = (char*)data;
     valid = true;
     ptr = 0;
     len = l;
+
+    decompress_();
+}
+
+void IfcSpfStream::decompress_() {
+    if (!valid) {
+        return;
+    }
+    const compression_format format = detect_compression(buffer, len);
+    if (format == COMPRESSION_NONE) {
+        return;
+    }
+
+    const unsigned num_threads = IfcFile::effective_num_threads();
+    char* decompressed = nullptr;
+    size_t decompressed_size = 0;
+    try {
+        decompressed = decompress(format, buffer, len, decompressed_size, num_threads);
+    } catch (const IfcException& e) {
+        Logger::Error(e);
+        valid = false;
+        return;
+    }
+
+#ifdef USE_MMAP
+    const bool mapped = mfs.is_open();
+    if (mapped) {
+        mfs.close();
+    }
+#else
+    const bool mapped = false;
+#endif
+    if (owns_buffer && !mapped) {
+        delete[] buffer;
+    }
+
+    owns_buffer = true;
+    buffer = decompressed;
+    ptr = 0;
+    len = size = decompressed_size;
+    eof = len == 0;
+}
+
+IfcSpfStream::IfcSpfStream(const IfcSpfStream& other, size_t offset)
+    : stream(0),
+      buffer(other.buffer),
+      ptr(offset),
+      len(other.len),
+      owns_buffer(false),
+      valid(other.valid),
+      eof(offset >= other.len),
+      size(other.size) {
 }
 
 IfcSpfStream::~IfcSpfStream() {
@@ -208,7 +454,9 @@ void IfcSpfStream::Close() {
         return;
     }
 #endif
-    delete[] buffer;
+    if (owns_buffer) {
+        delete[] buffer;
+    }
     if (stream) {
         fclose(stream);
     }
@@ -217,7 +465,7 @@ void IfcSpfStream::Close() {
 //
 // Seeks an arbitrary position in the file
 //
-void IfcSpfStream::Seek(unsigned int o) {
+void IfcSpfStream::Seek(size_t o) {
     ptr = o;
     if (ptr >= len) {
         throw IfcException("Reading outside of file limits");
@@ -235,14 +483,14 @@ char IfcSpfStream::Peek() {
 //
 // Returns the character at specified offset
 //
-char IfcSpfStream::Read(unsigned int o) {
+char IfcSpfStream::Read(size_t o) {
     return buffer[o];
 }
 
 //
 // Returns the cursor position
 //
-unsigned int IfcSpfStream::Tell() {
+size_t IfcSpfStream::Tell() {
     return ptr;
 }
 
@@ -261,53 +509,90 @@ void IfcSpfStream::Inc() {
     }
 }
 
-IfcSpfLexer::IfcSpfLexer(IfcParse::IfcSpfStream* s, IfcParse::IfcFile* f) {
-    file = f;
-    stream = s;
-    decoder = new IfcCharacterDecoder(s);
+//
+// Moves the cursor to an offset in the file or to its end
+//
+void IfcSpfStream::move_to(size_t o) {
+    ptr = (std::min)(o, len);
+    eof = ptr == len;
 }
 
-IfcSpfLexer::~IfcSpfLexer() {
-    delete decoder;
+size_t IfcSpfStream::skip_whitespace_at(size_t o) {
+    return find_non_separator(buffer, o, len);
 }
 
-unsigned int IfcSpfLexer::skipWhitespace() {
-    unsigned int n = 0;
-    while (!stream->eof) {
-        char c = stream->Peek();
-        if ((c == ' ' || c == '\r' || c == '\n' || c == '\t')) {
-            stream->Inc();
-            ++n;
-        } else {
+size_t IfcSpfStream::find_delimiter_at(size_t o) {
+    return find_delimiter(buffer, o, len);
+}
+
+size_t IfcSpfStream::find_string_special_at(size_t o) {
+    return find_string_special(buffer, o, len);
+}
+
+//
+// Returns the offset of the solidus that terminates a comment for which
+// the asterisk of the opening sequence is at the specified offset. Like
+// the cursor increments, line breaks in between are disregarded.
+//
+size_t IfcSpfStream::find_comment_end_at(size_t asterisk) {
+    size_t o = asterisk + 1;
+    while (o < len) {
+        const char* solidus = (const char*)memchr(buffer + o, '/', len - o);
+        if (solidus == nullptr) {
             break;
         }
+        o = solidus - buffer;
+        size_t p = o - 1;
+        while (p > asterisk && (buffer[p] == '\n' || buffer[p] == '\r')) {
+            --p;
+        }
+        // The asterisk of the opening sequence does not close the comment
+        if (p > asterisk && buffer[p] == '*') {
+            return o;
+        }
+        ++o;
     }
-    return n;
+    return len;
+}
+
+IfcSpfLexer::IfcSpfLexer(IfcParse::IfcSpfStream* s, IfcParse::IfcFile* f)
+    : decoder(s),
+      stream(s),
+      file(f) {}
+
+IfcSpfLexer::~IfcSpfLexer() {}
+
+size_t IfcSpfLexer::skipWhitespace() {
+    if (stream->eof) {
+        return 0;
+    }
+    const size_t start = stream->Tell();
+    const size_t end = stream->skip_whitespace_at(start);
+    if (end != start) {
+        stream->move_to(end);
+    }
+    return end - start;
 }
 
-unsigned int IfcSpfLexer::skipComment() {
+size_t IfcSpfLexer::skipComment() {
     char c = stream->Peek();
     if (c != '/') {
         return 0;
     }
+    const size_t start = stream->Tell();
     stream->Inc();
     c = stream->Peek();
     if (c != '*') {
         stream->Seek(stream->Tell() - 1);
         return 0;
     }
-    unsigned int n = 2;
-    char p = 0;
-    while (!stream->eof) {
-        c = stream->Peek();
+    const size_t end = stream->find_comment_end_at(stream->Tell());
+    stream->move_to(end);
+    if (!stream->eof) {
+        // Consume the solidus
         stream->Inc();
-        ++n;
-        if (c == '/' && p == '*') {
-            break;
-        }
-        p = c;
     }
-    return n;
+    return stream->Tell() - start;
 }
 
 //
@@ -325,7 +610,7 @@ Token IfcSpfLexer::Next() {
     if (stream->eof) {
         return NoneTokenPtr();
     }
-    unsigned int pos = stream->Tell();
+    size_t pos = stream->Tell();
 
     char c = stream->Peek();
 
@@ -349,7 +634,10 @@ Token IfcSpfLexer::Next() {
 
         // If a string is encountered defer processing to the IfcCharacterDecoder
         if (c == '\'') {
-            decoder->skip();
+            decoder.skip();
+        } else if (!stream->eof) {
+            // Skip ahead to the next character that can terminate the token
+            stream->move_to(stream->find_delimiter_at(stream->Tell()));
         }
     }
     if (len) {
@@ -359,11 +647,11 @@ Token IfcSpfLexer::Next() {
     }
 }
 
-bool IfcSpfStream::is_eof_at(unsigned int local_ptr) {
+bool IfcSpfStream::is_eof_at(size_t local_ptr) {
     return local_ptr >= len;
 }
 
-void IfcSpfStream::increment_at(unsigned int& local_ptr) {
+void IfcSpfStream::increment_at(size_t& local_ptr) {
     if (++local_ptr == len) {
         return;
     }
@@ -373,7 +661,7 @@ void IfcSpfStream::increment_at(unsigned int& local_ptr) {
     }
 }
 
-char IfcSpfStream::peek_at(unsigned int local_ptr) {
+char IfcSpfStream::peek_at(size_t local_ptr) {
     return buffer[local_ptr];
 }
 
@@ -381,8 +669,30 @@ char IfcSpfStream::peek_at(unsigned int local_ptr) {
 // Reads a std::string from the file at specified offset
 // Omits whitespace and comments
 //
-void IfcSpfLexer::TokenString(unsigned int offset, std::string& buffer) {
+void IfcSpfLexer::TokenString(size_t offset, std::string& buffer) const {
+    std::string_view plain;
+    if (PlainString(offset, plain)) {
+        // Including the apostrophes, as would have been returned by the decoder
+        buffer.assign(plain.data() - 1, plain.size() + 2);
+        return;
+    }
     buffer.clear();
+    if (!stream->is_eof_at(offset)) {
+        const char c = stream->peek_at(offset);
+        if (!is_separator(c) && !is_delimiter(c)) {
+            // Tokens without string literals are copied in one go
+            const size_t end = stream->find_delimiter_at(offset + 1);
+            if (stream->is_eof_at(end) || stream->peek_at(end) != '\'') {
+                const char* data = stream->data_at(0);
+                if (contains_separator(data, offset, end)) {
+                    std::remove_copy_if(data + offset, data + end, std::back_inserter(buffer), is_separator);
+                } else {
+                    buffer.assign(data + offset, end - offset);
+                }
+                return;
+            }
+        }
+    }
     while (!stream->is_eof_at(offset)) {
         char c = stream->peek_at(offset);
         if (buffer.size() && (c == '(' || c == ')' || c == '=' || c == ',' || c == ';' || c == '/')) {
@@ -392,8 +702,9 @@ void IfcSpfLexer::TokenString(unsigned int offset, std::string& buffer) {
         if (c == ' ' || c == '\r' || c == '\n' || c == '\t') {
             continue;
         } else if (c == '\'') {
-            // todo, make decoder use local offset ptr
-            buffer = decoder->get(offset);
+            // A decoder of its own, as values are read from several threads
+            // through the same lexer, see IfcFile::load().
+            buffer = IfcCharacterDecoder(stream).get(offset);
             break;
         } else {
             buffer.push_back(c);
@@ -401,10 +712,27 @@ void IfcSpfLexer::TokenString(unsigned int offset, std::string& buffer) {
     }
 }
 
+bool IfcSpfLexer::PlainString(size_t offset, std::string_view& result) const {
+    if (stream->is_eof_at(offset) || stream->peek_at(offset) != '\'') {
+        return false;
+    }
+    const size_t end = stream->find_string_special_at(offset + 1);
+    if (stream->is_eof_at(end) || stream->peek_at(end) != '\'' || (!stream->is_eof_at(end + 1) && stream->peek_at(end + 1) == '\'')) {
+        return false;
+    }
+    result = std::string_view(stream->data_at(offset + 1), end - offset - 1);
+    return true;
+}
+
 //Note: according to STEP standard, there may be newlines in tokens
-inline void RemoveTokenSeparators(IfcSpfStream* stream, unsigned start, unsigned end, std::string& oDestination) {
+inline void RemoveTokenSeparators(IfcSpfStream* stream, size_t start, size_t end, std::string& oDestination) {
+    const char* data = stream->data_at(0);
+    if (!contains_separator(data, start, end)) {
+        oDestination.assign(data + start, end - start);
+        return;
+    }
     oDestination.clear();
-    for (unsigned i = start; i < end; i++) {
+    for (size_t i = start; i < end; i++) {
         char c = stream->Read(i);
         if (c == ' ' || c == '\r' || c == '\n' || c == '\t') {
             continue;
@@ -423,7 +751,10 @@ bool ParseInt(const char* pStart, int& val) {
     return true;
 }
 
-bool ParseFloat(const char* pStart, double& val) {
+namespace {
+bool parse_float_strtod(const char* pStart, double& val) {
+    // ParseFloat() can be used without an IfcFile having initialized the locale
+    init_locale();
     char* pEnd;
 #ifdef _MSC_VER
     double result = _strtod_l(pStart, &pEnd, locale);
@@ -436,6 +767,39 @@ bool ParseFloat(const char* pStart, double& val) {
     val = result;
     return true;
 }
+} // namespace
+
+bool IfcParse::ParseFloat(const char* pStart, double& val) {
+#ifdef __cpp_lib_to_chars
+    // std::from_chars() is locale-independent and correctly rounded, so the
+    // result is identical to strtod_l() in the "C" locale, but it does not
+    // accept the leading plus sign that the SPF grammar allows.
+    const char* first = pStart;
+    if (*first == '+') {
+        ++first;
+        if (*first == '-') {
+            return false;
+        }
+    }
+    const char* last = first + strlen(first);
+    double result;
+    auto r = std::from_chars(first, last, result, std::chars_format::general);
+    if (r.ptr != last) {
+        return false;
+    }
+    if (r.ec == std::errc::result_out_of_range) {
+        // strtod() rounds these to zero or infinity, from_chars() leaves the result unassigned
+        return parse_float_strtod(pStart, val);
+    }
+    if (r.ec != std::errc()) {
+        return false;
+    }
+    val = result;
+    return true;
+#else
+    return parse_float_strtod(pStart, val);
+#endif
+}
 
 bool ParseBool(const char* pStart, int& val) {
     if (strlen(pStart) != 3 || pStart[0] != '.' || pStart[2] != '.') {
@@ -456,14 +820,14 @@ bool ParseBool(const char* pStart, int& val) {
     return true;
 }
 
-Token IfcParse::OperatorTokenPtr(IfcSpfLexer* lexer, unsigned start, unsigned end) {
+Token IfcParse::OperatorTokenPtr(IfcSpfLexer* lexer, size_t start, size_t end) {
     char first = lexer->stream->Read(start);
     Token token(lexer, start, end, Token_OPERATOR);
     token.value_char = first;
     return token;
 }
 
-Token IfcParse::GeneralTokenPtr(IfcSpfLexer* lexer, unsigned start, unsigned end) {
+Token IfcParse::GeneralTokenPtr(IfcSpfLexer* lexer, size_t start, size_t end) {
     Token token(lexer, start, end, Token_NONE);
 
     //extract token into temp buffer (remove eol-s, no encoding changes)
@@ -602,6 +966,11 @@ const std::string& TokenFunc::asStringRef(const Token& t) {
         throw IfcParse::IfcException("Null token encountered, premature end of file?");
     }
     std::string& str = t.lexer->GetTempString();
+    std::string_view plain;
+    if (t.lexer->PlainString(t.startPos, plain)) {
+        str.assign(plain.data(), plain.size());
+        return str;
+    }
     t.lexer->TokenString(t.startPos, str);
     if ((isString(t) || isEnumeration(t) || isBinary(t)) && !str.empty()) {
         //remove start+end characters in-place
@@ -611,6 +980,20 @@ const std::string& TokenFunc::asStringRef(const Token& t) {
     return str;
 }
 
+std::string_view TokenFunc::asInternedString(const Token& t) {
+    if (!(isString(t) || isEnumeration(t) || isBinary(t))) {
+        throw IfcInvalidTokenException(t.startPos, toString(t), "string");
+    }
+    if (!t.lexer->file) {
+        throw IfcException("Strings can only be interned for tokens read from a file");
+    }
+    std::string_view plain;
+    if (t.lexer->PlainString(t.startPos, plain)) {
+        return t.lexer->file->strings().intern(plain);
+    }
+    return t.lexer->file->strings().intern(asStringRef(t));
+}
+
 std::string TokenFunc::asString(const Token& t) {
     if (isString(t) || isEnumeration(t) || isBinary(t)) {
         return asStringRef(t);
@@ -663,10 +1046,11 @@ TokenArgument::TokenArgument(const Token& t) {
 
 EntityArgument::EntityArgument(const Token& t) {
     IfcParse::IfcFile* file = t.lexer->file;
-    IfcEntityInstanceData* data = read(0, file, t.startPos);
-    // Data needs to be loaded, for the tokens
-    // to be consumed and parsing to continue.
-    data->load();
+    const IfcParse::declaration* ty = file->schema()->declaration_by_name(TokenFunc::asStringRef(t));
+    IfcEntityInstanceData* data = new (file->instance_arena()) IfcEntityInstanceData(ty, file, 0, t.startPos);
+    // Data needs to be loaded from the lexer that produced the keyword
+    // token, for the tokens to be consumed and parsing to continue.
+    data->load(t.lexer);
     entity = file->schema()->instantiate(data);
 }
 
@@ -713,20 +1097,26 @@ class vector_or_array {
 // Reads the arguments from a list of token
 // Aditionally, registers the ids (i.e. #[\d]+) in the inverse map
 //
-size_t IfcParse::IfcFile::load(unsigned entity_instance_name, const IfcParse::entity* entity, Argument**& attributes, size_t num_attributes, int attribute_index) {
-    Token next = tokens->Next();
+size_t IfcParse::IfcFile::load(unsigned entity_instance_name, const IfcParse::entity* entity, Argument**& attributes, size_t num_attributes, int attribute_index, IfcSpfLexer* lexer) {
+    if (lexer == nullptr) {
+        lexer = tokens;
+    }
+
+    static my_thread_local std::vector<Argument*> internal_attribute_vector, internal_attribute_vector_simple_type;
+
+    Token next = lexer->Next();
 
     std::vector<Argument*>* vector = 0;
     vector_or_array<Argument*> filler(attributes, num_attributes);
     if (attributes == 0) {
         if (num_attributes != 0) {
             // If num_attributes is zero we know this is a top-level entity instance (or header entity) being parsed.
-            // There can only be parsed one of these at a time, so we can reuse the vector we have defined at the file
-            // scope.
+            // There can only be parsed one of these at a time on every thread, so we can reuse the vector we have
+            // defined at the thread scope.
             if (entity) {
-                vector = &internal_attribute_vector_;
+                vector = &internal_attribute_vector;
             } else {
-                vector = &internal_attribute_vector_simple_type_;
+                vector = &internal_attribute_vector_simple_type;
             }
             vector->clear();
         } else {
@@ -744,10 +1134,10 @@ size_t IfcParse::IfcFile::load(unsigned entity_instance_name, const IfcParse::en
             break;
         } else if (TokenFunc::isOperator(next, '(')) {
             return_value++;
-            ArgumentList* alist = new ArgumentList();
+            ArgumentList* alist = new (arena_) ArgumentList();
             // entity is passed along here, after all the it is the type of the instance
             // that owns the list that is significant for inverse attributes
-            alist->size() = load(entity_instance_name, entity, alist->arguments(), 0, attribute_index == -1 ? (int)filler.index() : attribute_index);
+            alist->size() = load(entity_instance_name, entity, alist->arguments(), 0, attribute_index == -1 ? (int)filler.index() : attribute_index, lexer);
             filler.push_back(alist);
         } else {
             return_value++;
@@ -759,17 +1149,20 @@ size_t IfcParse::IfcFile::load(unsigned entity_instance_name, const IfcParse::en
 
             if (TokenFunc::isKeyword(next)) {
                 try {
-                    auto ea = new EntityArgument(next);
-                    addEntity(((IfcUtil::IfcBaseClass*)*ea));
+                    auto ea = new (arena_) EntityArgument(next);
+                    add_inline_instance_((IfcUtil::IfcBaseClass*)*ea);
                     filler.push_back(ea);
                 } catch (IfcException& e) {
                     Logger::Message(Logger::LOG_ERROR, e.what());
                 }
             } else {
-                filler.push_back(new TokenArgument(next));
+                // Token values are read by offset later on, which the token
+                // cursor of the file can do for the lifetime of the file.
+                next.lexer = tokens;
+                filler.push_back(new (arena_) TokenArgument(next));
             }
         }
-        next = tokens->Next();
+        next = lexer->Next();
     }
 
     if (vector) {
@@ -778,7 +1171,7 @@ size_t IfcParse::IfcFile::load(unsigned entity_instance_name, const IfcParse::en
             // @todo figure out whether all this logic is still necessary, since we know the
             // expected amount of attributes and shouldn't be able to access more than allowed
             // by the schema.
-            attributes = new Argument* [(std::max)(num_attributes, vector->size())] { nullptr };
+            attributes = allocate_argument_array((std::max)(num_attributes, vector->size()), &arena_);
 
             // @todo this appears unnecessary, we increment this in the loop already,
             // which is more accurate as the filler can't go above it's size in case
@@ -790,7 +1183,7 @@ size_t IfcParse::IfcFile::load(unsigned entity_instance_name, const IfcParse::en
             }
         }
 
-        if ((vector != &internal_attribute_vector_) && (vector != &internal_attribute_vector_simple_type_)) {
+        if ((vector != &internal_attribute_vector) && (vector != &internal_attribute_vector_simple_type)) {
             delete vector;
         }
     }
@@ -910,16 +1303,20 @@ void ArgumentList::set(unsigned int i, Argument* argument) {
 */
 
 std::string ArgumentList::toString(bool upper) const {
-    std::stringstream ss;
-    ss << "(";
+    std::string result;
+    write(result, upper);
+    return result;
+}
+
+void ArgumentList::write(std::string& out, bool upper) const {
+    out += '(';
     for (size_t i = 0; i < size_; ++i) {
         if (i != 0) {
-            ss << ",";
+            out += ',';
         }
-        ss << list_[i]->toString(upper);
+        list_[i]->write(out, upper);
     }
-    ss << ")";
-    return ss.str();
+    out += ')';
 }
 
 bool ArgumentList::isNull() const { return false; }
@@ -928,7 +1325,7 @@ ArgumentList::~ArgumentList() {
     for (size_t i = 0; i < size_; ++i) {
         delete list_[i];
     }
-    delete[] list_;
+    free_argument_array(list_);
 }
 
 IfcUtil::ArgumentType TokenArgument::type() const {
@@ -965,8 +1362,10 @@ TokenArgument::operator bool() const { return TokenFunc::asBool(token); }
 TokenArgument::operator boost::logic::tribool() const { return TokenFunc::asLogical(token); }
 TokenArgument::operator double() const { return TokenFunc::asFloat(token); }
 TokenArgument::operator std::string() const { return TokenFunc::asString(token); }
+std::string_view TokenArgument::interned_string() const { return TokenFunc::asInternedString(token); }
 TokenArgument::operator boost::dynamic_bitset<>() const { return TokenFunc::asBinary(token); }
 TokenArgument::operator IfcUtil::IfcBaseClass*() const { return token.lexer->file->instance_by_id(TokenFunc::asIdentifier(token)); }
+unsigned int TokenArgument::reference_id() const { return TokenFunc::asIdentifier(token); }
 unsigned int TokenArgument::size() const { return 1; }
 Argument* TokenArgument::operator[](unsigned int /*i*/) const { throw IfcException("Argument is not a list of attributes"); }
 std::string TokenArgument::toString(bool upper) const {
@@ -976,6 +1375,15 @@ std::string TokenArgument::toString(bool upper) const {
         return TokenFunc::toString(token);
     }
 }
+void TokenArgument::write(std::string& out, bool upper) const {
+    if (upper && TokenFunc::isString(token)) {
+        out += static_cast<std::string>(IfcWrite::IfcCharacterEncoder(TokenFunc::asString(token)));
+    } else {
+        std::string& str = token.lexer->GetTempString();
+        token.lexer->TokenString(token.startPos, str);
+        out += str;
+    }
+}
 bool TokenArgument::isNull() const { return TokenFunc::isOperator(token, '$'); }
 
 IfcUtil::ArgumentType EntityArgument::type() const {
@@ -1001,6 +1409,10 @@ std::string EntityArgument::toString(bool upper) const {
     return entity->data().toString(upper);
 }
 
+void EntityArgument::write(std::string& out, bool upper) const {
+    entity->data().write(out, upper);
+}
+
 bool EntityArgument::isNull() const { return false; }
 EntityArgument::~EntityArgument() {
     // We don't delete it here, rather it will be freed as part of the entity_file_map.
@@ -1014,7 +1426,7 @@ EntityArgument::~EntityArgument() {
 //
 // Reads an Entity from the list of Tokens at the specified offset in the file
 //
-IfcEntityInstanceData* IfcParse::read(unsigned int i, IfcFile* f, boost::optional<unsigned> offset) {
+IfcEntityInstanceData* IfcParse::read(unsigned int i, IfcFile* f, boost::optional<size_t> offset) {
     if (offset) {
         f->tokens->stream->Seek(*offset);
     }
@@ -1023,40 +1435,109 @@ IfcEntityInstanceData* IfcParse::read(unsigned int i, IfcFile* f, boost::optiona
         throw IfcException("Unexpected token while parsing entity");
     }
     const IfcParse::declaration* ty = f->schema()->declaration_by_name(TokenFunc::asStringRef(datatype));
-    IfcEntityInstanceData* e = new IfcEntityInstanceData(ty, f, i, offset.get_value_or(0));
+    IfcEntityInstanceData* e = new (f->instance_arena()) IfcEntityInstanceData(ty, f, i, offset.get_value_or(0));
     return e;
 }
 
-void IfcParse::IfcFile::seek_to(const IfcEntityInstanceData& data) {
-    if (tokens->stream->Tell() != data.offset_in_file()) {
-        tokens->stream->Seek(data.offset_in_file());
-        Token datatype = tokens->Next();
+void IfcParse::IfcFile::seek_to(const IfcEntityInstanceData& data, IfcSpfLexer* lexer) {
+    if (lexer == nullptr) {
+        lexer = tokens;
+    }
+    if (lexer->stream->Tell() != data.offset_in_file()) {
+        lexer->stream->Seek(data.offset_in_file());
+        Token datatype = lexer->Next();
         if (!TokenFunc::isKeyword(datatype)) {
             throw IfcException("Unexpected token while parsing entity instance");
         }
     }
-    tokens->Next();
+    lexer->Next();
 }
 
-void IfcParse::IfcFile::try_read_semicolon() {
-    unsigned int old_offset = tokens->stream->Tell();
-    Token semilocon = tokens->Next();
+void IfcParse::IfcFile::try_read_semicolon(IfcSpfLexer* lexer) {
+    if (lexer == nullptr) {
+        lexer = tokens;
+    }
+    size_t old_offset = lexer->stream->Tell();
+    Token semilocon = lexer->Next();
     if (!TokenFunc::isOperator(semilocon, ';')) {
-        tokens->stream->Seek(old_offset);
+        lexer->stream->Seek(old_offset);
     }
 }
 
-void IfcParse::IfcFile::register_inverse(unsigned id_from, const IfcParse::entity* from_entity, Token t, int attribute_index) {
-    // Assume a check on token type has already been performed
+void IfcParse::IfcFile::build_inverse_index_() {
+    int max_id = -1;
+    for (auto& p : pending_inverses_) {
+        max_id = (std::max)(max_id, p.first);
+    }
+
+    // A counting sort on the referenced id, which is stable and therefore
+    // retains the order of the references in the file.
+    inverse_offsets_.assign((size_t)max_id + 2, 0);
+    for (auto& p : pending_inverses_) {
+        if (p.first >= 0) {
+            ++inverse_offsets_[p.first + 1];
+        }
+    }
+    for (size_t i = 1; i < inverse_offsets_.size(); ++i) {
+        inverse_offsets_[i] += inverse_offsets_[i - 1];
+    }
+    inverse_references_.resize(inverse_offsets_.back());
+    for (auto& p : pending_inverses_) {
+        if (p.first >= 0) {
+            inverse_references_[inverse_offsets_[p.first]++] = p.second;
+        }
+    }
+    // Offsets have been advanced to the end of every range in the process
+    for (size_t i = inverse_offsets_.size() - 1; i > 0; --i) {
+        inverse_offsets_[i] = inverse_offsets_[i - 1];
+    }
+    inverse_offsets_[0] = 0;
+
+    std::vector<std::pair<int, inverse_reference>>().swap(pending_inverses_);
+    has_inverse_index_ = true;
+}
+
+void IfcParse::IfcFile::expand_inverse_index_() {
+    if (!has_inverse_index_) {
+        return;
+    }
+    has_inverse_index_ = false;
+    for (size_t i = 0; i + 1 < inverse_offsets_.size(); ++i) {
+        for (size_t j = inverse_offsets_[i]; j < inverse_offsets_[i + 1]; ++j) {
+            const inverse_reference& r = inverse_references_[j];
+            const IfcParse::entity* e = r.type == -1 ? nullptr : schema_->declaration_by_name(r.type)->as_entity();
+            register_inverse(r.referrer, e, (int)i, r.attribute_index);
+        }
+    }
+    std::vector<size_t>().swap(inverse_offsets_);
+    std::vector<inverse_reference>().swap(inverse_references_);
+}
+
+std::pair<const IfcParse::IfcFile::inverse_reference*, const IfcParse::IfcFile::inverse_reference*> IfcParse::IfcFile::inverse_index_range_(int id) const {
+    if (id < 0 || (size_t)id + 1 >= inverse_offsets_.size()) {
+        return {nullptr, nullptr};
+    }
+    const inverse_reference* data = inverse_references_.data();
+    return {data + inverse_offsets_[id], data + inverse_offsets_[id + 1]};
+}
+
+void IfcParse::IfcFile::register_inverse(unsigned id_from, const IfcParse::entity* from_entity, int id_to, int attribute_index) {
+    expand_inverse_index_();
     auto e = from_entity;
-    byref_excl[t.value_int].push_back(id_from);
+    byref_excl[id_to].push_back(id_from);
     while (e) {
-        byref[{t.value_int, e->index_in_schema(), attribute_index}].push_back(id_from);
+        byref[{id_to, e->index_in_schema(), attribute_index}].push_back(id_from);
         e = e->supertype();
     }
 }
 
+void IfcParse::IfcFile::register_inverse(unsigned id_from, const IfcParse::entity* from_entity, Token t, int attribute_index) {
+    // Assume a check on token type has already been performed
+    register_inverse(id_from, from_entity, t.value_int, attribute_index);
+}
+
 void IfcParse::IfcFile::register_inverse(unsigned id_from, const IfcParse::entity* from_entity, IfcUtil::IfcBaseClass* inst, int attribute_index) {
+    expand_inverse_index_();
     auto e = from_entity;
     byref_excl[inst->data().id()].push_back(id_from);
     while (e) {
@@ -1066,6 +1547,7 @@ void IfcParse::IfcFile::register_inverse(unsigned id_from, const IfcParse::entit
 }
 
 void IfcParse::IfcFile::unregister_inverse(unsigned id_from, const IfcParse::entity* from_entity, IfcUtil::IfcBaseClass* inst, int attribute_index) {
+    expand_inverse_index_();
     auto e = from_entity;
     while (e) {
         std::vector<int>& ids = byref[{inst->data().id(), e->index_in_schema(), attribute_index}];
@@ -1094,49 +1576,46 @@ void IfcParse::IfcFile::unregister_inverse(unsigned id_from, const IfcParse::ent
 // Note that this initializes the entity if it is not initialized
 //
 std::string IfcEntityInstanceData::toString(bool upper) const {
-    if (attributes_ == 0) {
-        load();
-    }
+    std::string result;
+    write(result, upper);
+    return result;
+}
 
-    std::stringstream ss;
-    ss.imbue(std::locale::classic());
+void IfcEntityInstanceData::write(std::string& out, bool upper) const {
+    Argument** attributes = loaded_attributes_();
 
-    std::string dt;
     if (type_) {
-        dt = type()->name();
-        if (upper) {
-            boost::to_upper(dt);
-        }
-
         if (type()->as_entity() || id_ != 0) {
-            ss << "#" << id_ << "=";
+            char buffer[16];
+            out += '#';
+            out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), id_).ptr);
+            out += '=';
         }
+        out += upper ? type()->name_uc() : type()->name();
     }
 
-    ss << dt << "(";
+    out += '(';
 
     for (size_t i = 0; i < getArgumentCount(); ++i) {
         if (i != 0) {
-            ss << ",";
+            out += ',';
         }
-        if (attributes_[i] == 0) {
-            ss << "$";
+        if (attributes[i] == 0) {
+            out += '$';
         } else {
-            ss << attributes_[i]->toString(upper);
+            attributes[i]->write(out, upper);
         }
     }
-    ss << ")";
-
-    return ss.str();
+    out += ')';
 }
 
 void IfcEntityInstanceData::clearArguments() {
-    if (attributes_ != NULL) {
+    Argument** attributes = attributes_.exchange(nullptr);
+    if (attributes != NULL) {
         for (size_t i = 0; i < getArgumentCount(); ++i) {
-            delete attributes_[i];
+            delete attributes[i];
         }
-        delete[] attributes_;
-        attributes_ = NULL;
+        IfcParse::free_argument_array(attributes);
     }
 }
 
@@ -1145,6 +1624,7 @@ IfcEntityInstanceData::~IfcEntityInstanceData() {
 }
 
 unsigned IfcEntityInstanceData::set_id(boost::optional<unsigned> i) {
+    modified_ = true;
     if (i) {
         return id_ = *i;
     } else {
@@ -1156,31 +1636,56 @@ unsigned IfcEntityInstanceData::set_id(boost::optional<unsigned> i) {
 // Returns the entities of Entity type that have this entity in their ArgumentList
 //
 aggregate_of_instance::ptr IfcEntityInstanceData::getInverse(const IfcParse::declaration* type, int attribute_index) const {
-    static std::mutex m;
-    std::lock_guard<std::mutex> lk(m);
-
     return file->getInverse(id_, type, attribute_index);
 }
 
+namespace {
+// Instances are locked while their attributes are parsed, so that concurrent
+// loads of the same instance do not both register inline entity instances.
+// A fixed set of mutexes is shared by all instances to keep them small.
+std::mutex& instance_load_mutex(const IfcEntityInstanceData* data) {
+    static std::mutex mutexes[64];
+    return mutexes[(reinterpret_cast<std::uintptr_t>(data) / sizeof(IfcEntityInstanceData)) % 64];
+}
+} // namespace
+
 void IfcEntityInstanceData::load() const {
-    static std::recursive_mutex m;
-    std::lock_guard<std::recursive_mutex> lk(m);
+    if (attributes_.load(std::memory_order_acquire) != nullptr) {
+        return;
+    }
 
-    Argument** tmp_data = nullptr;
+    std::lock_guard<std::mutex> lk(instance_load_mutex(this));
 
-    if (file->parsing_complete()) {
-        // only when parsing is fully complete we need to seek to the instance, otherwise
-        // we know the token cursor is currently at the keyword token
-        file->seek_to(*this);
-    } else {
-        // Apparently the load() function assumes one token later after the opening parenthesis
-        file->tokens->Next();
+    if (attributes_.load(std::memory_order_relaxed) != nullptr) {
+        return;
+    }
+
+    if (type_ && file->from_snapshot()) {
+        attributes_.store(file->load_snapshot(offset_in_file_, getArgumentCount()), std::memory_order_release);
+        return;
     }
 
+    // Every load uses its own cursor on the immutable file buffer, the
+    // token cursor of the file is only used while reading the header.
+    IfcSpfStream cursor(*file->stream, offset_in_file_);
+    IfcSpfLexer lexer(&cursor, file);
+    Token datatype = lexer.Next();
+    if (!TokenFunc::isKeyword(datatype)) {
+        throw IfcException("Unexpected token while parsing entity instance");
+    }
+
+    load(&lexer);
+}
+
+void IfcEntityInstanceData::load(IfcSpfLexer* lexer) const {
+    // Skip the opening parenthesis
+    lexer->Next();
+
     // type_ is 0 for header entities which have their size predetermined in code
     // in that we have attributes_ pre-constructed to the correct size in the constructor
     // in the other case load() will use a vector internally to grow to the size found in the file
-    size_t n = file->load(id(), type_ ? type_->as_entity() : nullptr, type_ ? tmp_data : attributes_, getArgumentCount());
+    Argument** attributes = type_ ? nullptr : attributes_.load(std::memory_order_relaxed);
+    size_t n = file->load(id(), type_ ? type_->as_entity() : nullptr, attributes, getArgumentCount(), -1, lexer);
     if (n != getArgumentCount()) {
         Logger::Error("Wrong number of attributes on instance with id #" + std::to_string(id_) +
                       " at offset " + std::to_string(this->offset_in_file()) +
@@ -1188,18 +1693,25 @@ void IfcEntityInstanceData::load() const {
                       " got " + std::to_string(n));
     }
 
-    file->try_read_semicolon();
+    file->try_read_semicolon(lexer);
 
-    // @todo does this need to be atomic somehow?
-    if (tmp_data) {
-        attributes_ = tmp_data;
+    if (type_) {
+        attributes_.store(attributes, std::memory_order_release);
     }
 }
 
-namespace {
+Argument** IfcEntityInstanceData::loaded_attributes_() const {
+    Argument** attributes = attributes_.load(std::memory_order_acquire);
+    if (attributes == nullptr) {
+        load();
+        attributes = attributes_.load(std::memory_order_acquire);
+    }
+    return attributes;
+}
+
 // @todo remove redundancy with python wrapper code (which is not identical due to
 // different handling of enumerations)
-IfcUtil::ArgumentType get_argument_type(const IfcParse::declaration* decl, size_t i) {
+IfcUtil::ArgumentType IfcWrite::get_argument_type(const IfcParse::declaration* decl, size_t i) {
     const IfcParse::parameter_type* pt = 0;
     if (decl->as_entity()) {
         pt = decl->as_entity()->attribute_by_index(i)->type_of_attribute();
@@ -1218,35 +1730,32 @@ IfcUtil::ArgumentType get_argument_type(const IfcParse::declaration* decl, size_
         return IfcUtil::from_parameter_type(pt);
     }
 }
-} // namespace
 
 IfcEntityInstanceData::IfcEntityInstanceData(const IfcEntityInstanceData& e) {
     file = 0;
     type_ = e.type_;
     id_ = 0;
+    offset_in_file_ = 0;
 
     const size_t count = e.getArgumentCount();
 
     // In order not to have the instance read from file
-    attributes_ = new Argument*[count];
+    attributes_ = IfcParse::allocate_argument_array(count);
 
     for (unsigned int i = 0; i < count; ++i) {
-        attributes_[i] = 0;
-        this->setArgument(i, e.getArgument(i), get_argument_type(e.type(), i), true);
+        this->setArgument(i, e.getArgument(i), IfcWrite::get_argument_type(e.type(), i), true);
     }
 }
 
 static IfcParse::NullArgument static_null_attribute;
 
 Argument* IfcEntityInstanceData::getArgument(size_t i) const {
-    if (attributes_ == 0) {
-        load();
-    }
+    Argument** attributes = loaded_attributes_();
     if (i < getArgumentCount()) {
-        if (attributes_[i] == nullptr) {
+        if (attributes[i] == nullptr) {
             return &static_null_attribute;
         } else {
-            return attributes_[i];
+            return attributes[i];
         }
     } else {
         throw IfcParse::IfcException("Attribute index out of range");
@@ -1296,63 +1805,9 @@ class add_to_instance_list_visitor {
     }
 };
 
-class apply_individual_instance_visitor {
-  private:
-    Argument* attribute_;
-    IfcEntityInstanceData* data_;
-    int attribute_index_;
-
-    template <typename T>
-    void apply_attribute_(T& t, Argument* attr, int index) const {
-        if (!attr) {
-            return;
-        }
-
-        if (attr->type() == IfcUtil::Argument_ENTITY_INSTANCE) {
-            IfcUtil::IfcBaseClass* inst = *attr;
-            t(inst, index);
-        } else if (attr->type() == IfcUtil::Argument_AGGREGATE_OF_ENTITY_INSTANCE) {
-            aggregate_of_instance::ptr entity_list_attribute = *attr;
-            for (aggregate_of_instance::it it = entity_list_attribute->begin(); it != entity_list_attribute->end(); ++it) {
-                t(*it, index);
-            }
-        } else if (attr->type() == IfcUtil::Argument_AGGREGATE_OF_AGGREGATE_OF_ENTITY_INSTANCE) {
-            aggregate_of_aggregate_of_instance::ptr entity_list_attribute = *attr;
-            for (aggregate_of_aggregate_of_instance::outer_it it = entity_list_attribute->begin(); it != entity_list_attribute->end(); ++it) {
-                for (aggregate_of_aggregate_of_instance::inner_it jt = it->begin(); jt != it->end(); ++jt) {
-                    t(*jt, index);
-                }
-            }
-        }
-    };
-
-  public:
-    apply_individual_instance_visitor(Argument* attribute, int idx)
-        : attribute_(attribute),
-          data_(0),
-          attribute_index_(idx) {}
-
-    apply_individual_instance_visitor(IfcEntityInstanceData* data)
-        : attribute_(0),
-          data_(data) {}
-
-    template <typename T>
-    void apply(T& t) const {
-        if (attribute_) {
-            apply_attribute_(t, attribute_, attribute_index_);
-        } else {
-            for (size_t i = 0; i < data_->getArgumentCount(); ++i) {
-                Argument* attr = data_->getArgument(i);
-                apply_attribute_(t, attr, i);
-            }
-        }
-    };
-};
-
 void IfcEntityInstanceData::setArgument(size_t i, Argument* a, IfcUtil::ArgumentType attr_type, bool make_copy) {
-    if (attributes_ == 0) {
-        load();
-    }
+    Argument** attributes = loaded_attributes_();
+    modified_ = true;
     Argument* new_attribute = a;
     if (make_copy) {
         if (attr_type == IfcUtil::Argument_UNKNOWN) {
@@ -1491,17 +1946,17 @@ void IfcEntityInstanceData::setArgument(size_t i, Argument* a, IfcUtil::Argument
         new_attribute = copy;
     }
 
-    if (attributes_[i] != 0) {
-        Argument* current_attribute = attributes_[i];
+    if (attributes[i] != 0) {
+        Argument* current_attribute = attributes[i];
         if (this->file) {
 
             // Deregister old attribute guid in file guid map.
             if (i == 0 && this->type() && this->file->ifcroot_type() && this->type()->is(*this->file->ifcroot_type())) {
                 try {
                     auto guid = (std::string)*current_attribute;
-                    auto it = this->file->internal_guid_map().find(guid);
-                    if (it != this->file->internal_guid_map().end() && &it->second->data() == this) {
-                        this->file->internal_guid_map().erase(it);
+                    auto instance = this->file->internal_guid_map().find(guid);
+                    if (instance != nullptr && &instance->data() == this) {
+                        this->file->internal_guid_map().erase(guid);
                     }
                 } catch (IfcParse::IfcException& e) {
                     Logger::Error(e);
@@ -1512,7 +1967,7 @@ void IfcEntityInstanceData::setArgument(size_t i, Argument* a, IfcUtil::Argument
             unregister_inverse_visitor visitor(*this->file, *this);
             apply_individual_instance_visitor(current_attribute, i).apply(visitor);
         }
-        delete attributes_[i];
+        delete attributes[i];
     }
 
     if (this->file) {
@@ -1521,18 +1976,16 @@ void IfcEntityInstanceData::setArgument(size_t i, Argument* a, IfcUtil::Argument
         apply_individual_instance_visitor(new_attribute, i).apply(visitor);
     }
 
-    attributes_[i] = new_attribute;
+    attributes[i] = new_attribute;
 
     // Register new attribute guid in guid map
     if (this->file) {
         if (i == 0 && this->type() && this->file->ifcroot_type() && this->type()->is(*this->file->ifcroot_type())) {
             try {
                 auto guid = (std::string)*new_attribute;
-                auto it = this->file->internal_guid_map().find(guid);
-                if (it != this->file->internal_guid_map().end()) {
+                if (this->file->internal_guid_map().assign(guid, this->file->instance_by_id(this->id())) != nullptr) {
                     Logger::Warning("Duplicate guid " + guid);
                 }
-                this->file->internal_guid_map()[guid] = this->file->instance_by_id(this->id());
             } catch (IfcParse::IfcException& e) {
                 Logger::Error(e);
             }
@@ -1546,19 +1999,19 @@ void IfcEntityInstanceData::setArgument(size_t i, Argument* a, IfcUtil::Argument
 //
 #ifdef USE_MMAP
 IfcFile::IfcFile(const std::string& fn, bool mmap) {
-    initialize_(new IfcSpfStream(fn, mmap));
+    initialize_(new IfcSpfStream(fn, mmap), fn);
 }
 #else
 IfcFile::IfcFile(const std::string& fn) {
-    initialize_(new IfcSpfStream(fn));
+    initialize_(new IfcSpfStream(fn), fn);
 }
 #endif
 
-IfcFile::IfcFile(std::istream& f, int len) {
+IfcFile::IfcFile(std::istream& f, size_t len) {
     initialize_(new IfcSpfStream(f, len));
 }
 
-IfcFile::IfcFile(void* data, int len) {
+IfcFile::IfcFile(void* data, size_t len) {
     initialize_(new IfcSpfStream(data, len));
 }
 
@@ -1576,15 +2029,160 @@ IfcFile::IfcFile(const IfcParse::schema_definition* schema)
     setDefaultHeaderValues();
 }
 
-void IfcFile::initialize_(IfcParse::IfcSpfStream* s) {
-    // Initialize a "C" locale for locale-independent
+IfcFile::IfcFile(IfcParse::IfcSpfStream* s, const instance_visitor& visitor) {
+    if (read_header_(s)) {
+        // Instances are not part of the model, so inverse references are not registered
+        parsing_complete_ = true;
+        visit_instances_(visitor);
+    }
+}
+
+file_open_status IfcFile::stream_instances(IfcParse::IfcSpfStream* s, const instance_visitor& visitor) {
+    IfcFile file(s, visitor);
+    return file.good();
+}
+
+file_open_status IfcFile::stream_instances(const std::string& fn, const instance_visitor& visitor) {
+    return stream_instances(new IfcSpfStream(fn), visitor);
+}
+
+//
+// Walks the instances in the DATA section using the token cursor of the file,
+// the attributes are skipped after fn has been called for an instance.
+//
+void IfcFile::walk_instances_(const std::function<void(unsigned, const IfcParse::declaration*, size_t, size_t)>& fn) {
+    if (from_snapshot_) {
+        Logger::Error("Snapshots can not be read instance by instance");
+        return;
+    }
+
+    // The header has been read up to and including FILE_SCHEMA
+    while (!tokens->stream->eof) {
+        Token t = tokens->Next();
+        if (TokenFunc::isKeyword(t) && TokenFunc::asStringRef(t) == "DATA") {
+            break;
+        }
+    }
+
+    while (!tokens->stream->eof) {
+        Token t = tokens->Next();
+        if (TokenFunc::isKeyword(t) && TokenFunc::asStringRef(t) == "ENDSEC") {
+            break;
+        }
+        if (!TokenFunc::isIdentifier(t)) {
+            continue;
+        }
+
+        const unsigned id = (unsigned)TokenFunc::asIdentifier(t);
+        Token keyword;
+        if (!TokenFunc::isOperator(tokens->Next(), '=') || !TokenFunc::isKeyword(keyword = tokens->Next())) {
+            Logger::Error("Unexpected token while parsing entity instance #" + std::to_string(id) + " at offset " + std::to_string(t.startPos));
+            continue;
+        }
+
+        const IfcParse::declaration* entity_type = nullptr;
+        try {
+            entity_type = schema_->declaration_by_name(TokenFunc::asStringRef(keyword));
+        } catch (const IfcException& ex) {
+            Logger::Error(std::string(ex.what()) + " at offset " + std::to_string(keyword.startPos));
+        }
+
+        if (entity_type != nullptr) {
+            fn(id, entity_type, t.startPos, keyword.startPos);
+        }
+
+        int depth = 0;
+        while (!tokens->stream->eof) {
+            Token a = tokens->Next();
+            if (TokenFunc::isOperator(a, '(')) {
+                ++depth;
+            } else if (TokenFunc::isOperator(a, ')')) {
+                --depth;
+            } else if (depth == 0 && TokenFunc::isOperator(a, ';')) {
+                break;
+            }
+        }
+    }
+}
+
+void IfcFile::add_inline_instance_(IfcUtil::IfcBaseClass* instance) {
+    std::lock_guard<std::mutex> lk(inline_entity_mutex_);
+    inline_instances_.push_back(instance);
+}
+
+void IfcFile::delete_inline_instances_() {
+    std::lock_guard<std::mutex> lk(inline_entity_mutex_);
+    for (auto* instance : inline_instances_) {
+        delete instance;
+    }
+    inline_instances_.clear();
+}
+
+//
+// Every instance is only kept alive during the call to the visitor, the memory
+// for its attributes and inline simple type instances is reused afterwards.
+// Attributes are read by a separate cursor when accessed.
+//
+void IfcFile::visit_instances_(const instance_visitor& visitor) {
+    // Memory allocated after this point is reused for every instance, the
+    // attributes of the header entities precede it.
+    const arena::marker start = arena_.mark();
+
+    walk_instances_([this, &visitor, &start](unsigned id, const IfcParse::declaration* entity_type, size_t, size_t keyword_offset) {
+        {
+            IfcEntityInstanceData data(entity_type, this, id, keyword_offset);
+            visitor(data);
+        }
+
+        delete_inline_instances_();
+        arena_.rewind(start);
+    });
+}
+
+namespace {
+bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+// Returns the offset of the first entity instance name at or after offset
+// that directly follows a semicolon, i.e. a likely start of an instance.
+size_t next_instance_boundary(IfcSpfStream* stream, size_t offset) {
+    const size_t n = stream->size;
+    for (size_t i = offset; i < n; ++i) {
+        if (stream->Read(i) != ';') {
+            continue;
+        }
+        size_t j = i + 1;
+        while (j < n && is_separator(stream->Read(j))) {
+            ++j;
+        }
+        if (j == n || stream->Read(j) != '#') {
+            continue;
+        }
+        const size_t name_offset = j++;
+        const size_t digits_offset = j;
+        while (j < n && is_digit(stream->Read(j))) {
+            ++j;
+        }
+        if (j == digits_offset) {
+            continue;
+        }
+        while (j < n && is_separator(stream->Read(j))) {
+            ++j;
+        }
+        if (j < n && stream->Read(j) == '=') {
+            return name_offset;
+        }
+    }
+    return n;
+}
+} // namespace
+
+bool IfcFile::read_header_(IfcParse::IfcSpfStream* s) {
+    // Initialize a "C" locale for locale-independent
     // number parsing. See comment above on line 41.
     init_locale();
 
-    // prevent heap allocations during parse
-    internal_attribute_vector_.reserve(64);
-    internal_attribute_vector_simple_type_.reserve(16);
-
     parsing_complete_ = false;
     MaxId = 0;
     tokens = 0;
@@ -1596,7 +2194,20 @@ void IfcFile::initialize_(IfcParse::IfcSpfStream* s) {
     stream = s;
     if (!stream->valid) {
         good_ = file_open_status::READ_ERROR;
-        return;
+        return false;
+    }
+
+    // The header section of a snapshot follows its table of contents
+    size_t header_offset = 0;
+    try {
+        from_snapshot_ = snapshot::locate_header(stream->data_at(0), stream->size, header_offset);
+    } catch (const IfcException& e) {
+        Logger::Error(e);
+        good_ = file_open_status::READ_ERROR;
+        return false;
+    }
+    if (from_snapshot_) {
+        stream->Seek(header_offset);
     }
 
     tokens = new IfcSpfLexer(stream, this);
@@ -1625,24 +2236,174 @@ void IfcFile::initialize_(IfcParse::IfcSpfStream* s) {
 
     if (schema_ == 0) {
         Logger::Message(Logger::LOG_ERROR, "No support for file schema encountered (" + boost::algorithm::join(schemas, ", ") + ")");
-        return;
+        return false;
     }
 
     ifcroot_type_ = schema_->declaration_by_name("IfcRoot");
 
+    return true;
+}
+
+void IfcFile::initialize_(IfcParse::IfcSpfStream* s, const std::string& fn) {
+    if (!read_header_(s)) {
+        return;
+    }
+
+    const unsigned int n_threads = effective_num_threads();
+
+    // For the compact inverse index and the sidecar index the inverse references
+    // are collected in file order while scanning and registered afterwards.
+    // A partial model is not written to or read from the sidecar index
+    const std::string index_fn = sidecar_index_ && !fn.empty() && type_filter_.empty() && !from_snapshot_ ? fn + ".idx" : std::string();
+    defer_inverses_ = compact_inverses_ || !index_fn.empty();
+
+    const bool from_index = !index_fn.empty() && read_sidecar_index_(fn, index_fn);
+
+    if (from_snapshot_) {
+        read_snapshot_();
+    } else if (!type_filter_.empty()) {
+        std::vector<const IfcParse::declaration*> types;
+        for (auto& name : type_filter_) {
+            try {
+                types.push_back(schema_->declaration_by_name(name));
+            } catch (const IfcException&) {
+            }
+        }
+
+        Logger::Status("Scanning file...");
+        scan_selection_(types);
+        Logger::Status("\rDone scanning file   ");
+    } else if (!from_index) {
+        Logger::Status("Scanning file...");
+
+        const size_t data_begin = stream->Tell();
+
+        // The DATA section is divided into ranges that start at an entity instance
+        // name, which are scanned by independent lexers on a view of the stream.
+        std::vector<size_t> boundaries{data_begin};
+        const size_t min_range_size = (size_t)1 << 22;
+        if (n_threads > 1 && !stream->eof && stream->size > data_begin && (stream->size - data_begin) / n_threads > min_range_size) {
+            for (unsigned int i = 1; i < n_threads; ++i) {
+                size_t b = next_instance_boundary(stream, data_begin + (stream->size - data_begin) / n_threads * i);
+                if (b > boundaries.back() && b < stream->size) {
+                    boundaries.push_back(b);
+                }
+            }
+        }
+
+        bool scanned = false;
+
+        if (boundaries.size() > 1) {
+            boundaries.push_back(stream->size);
+            std::vector<scan_fragment> fragments(boundaries.size() - 1);
+            parallel_for(fragments.size(), n_threads, [this, &boundaries, &fragments](size_t i) {
+                IfcSpfStream view(*stream, boundaries[i]);
+                IfcSpfLexer lexer(&view, this);
+                scan_(&lexer, boundaries[i + 1], false, fragments[i]);
+            });
+
+            // A range boundary is only valid when the lexer of the preceding range
+            // arrived at it exactly. Otherwise it was located inside a string literal
+            // or the file is malformed, in which case the file is rescanned sequentially.
+            scanned = true;
+            for (size_t i = 0; i < fragments.size(); ++i) {
+                if (fragments[i].end_of_scan != boundaries[i + 1]) {
+                    scanned = false;
+                }
+            }
+
+            if (scanned) {
+                for (auto& f : fragments) {
+                    merge_(f);
+                }
+            } else {
+                for (auto& f : fragments) {
+                    for (auto& inst : f.instances) {
+                        delete inst;
+                    }
+                }
+            }
+        }
+
+        if (!scanned) {
+            scan_fragment fragment;
+            scan_(tokens, (std::numeric_limits<size_t>::max)(), true, fragment);
+            merge_(fragment);
+        }
+
+        Logger::Status("\rDone scanning file   ");
+
+        if (!index_fn.empty()) {
+            write_sidecar_index_(fn, index_fn);
+        }
+    }
+
+    if (compact_inverses_) {
+        build_inverse_index_();
+    } else if (defer_inverses_) {
+        for (auto& p : pending_inverses_) {
+            const IfcParse::entity* e = p.second.type == -1 ? nullptr : schema_->declaration_by_name(p.second.type)->as_entity();
+            register_inverse(p.second.referrer, e, p.first, p.second.attribute_index);
+        }
+        std::vector<std::pair<int, inverse_reference>>().swap(pending_inverses_);
+    }
+    defer_inverses_ = false;
+
+    parsing_complete_ = true;
+
+    if (!lazy_load_) {
+        std::vector<std::pair<unsigned int, IfcUtil::IfcBaseClass*>> sorted(byid.begin(), byid.end());
+        std::sort(sorted.begin(), sorted.end(), [](const std::pair<unsigned int, IfcUtil::IfcBaseClass*>& a, const std::pair<unsigned int, IfcUtil::IfcBaseClass*>& b) {
+            return a.second->data().offset_in_file() < b.second->data().offset_in_file();
+        });
+        // Loading is thread-safe, contiguous ranges of instances are loaded
+        // concurrently using the same number of threads as for scanning.
+        const size_t min_instances_per_thread = 1 << 14;
+        parallel_for(
+            sorted.size(), n_threads, [&sorted](size_t j) {
+                sorted[j].second->data().load();
+            },
+            min_instances_per_thread);
+    }
+}
+
+//
+// Scans entity instances up to offset end, the stream of the lexer needs to be
+// positioned at the start of an entity instance or the start of the DATA section.
+// When incremental is set the results are merged into the file along the way.
+//
+void IfcFile::scan_(IfcParse::IfcSpfLexer* lexer, size_t end, bool incremental, scan_fragment& fragment) {
     boost::circular_buffer<Token> token_stream(3, Token());
 
-    IfcEntityInstanceData* data;
     IfcUtil::IfcBaseClass* instance = 0;
 
     unsigned current_id = 0;
     int progress = 0;
-    Logger::Status("Scanning file...");
 
     int paren_stack_depth = 0;
     int attribute_index = -1;
+    bool read_guid = false;
+
+    while (!lexer->stream->eof) {
+        if (token_stream[0].lexer && token_stream[0].startPos >= end) {
+            fragment.end_of_scan = token_stream[0].startPos;
+            return;
+        }
+
+        if (read_guid && paren_stack_depth == 1) {
+            // The GlobalId is read from the token directly so that the instance does not need to be loaded
+            read_guid = false;
+            try {
+                if (!TokenFunc::isString(token_stream[0]) && !TokenFunc::isEnumeration(token_stream[0]) && !TokenFunc::isBinary(token_stream[0])) {
+                    throw IfcInvalidTokenException(token_stream[0].startPos, TokenFunc::toString(token_stream[0]), "string");
+                }
+                const std::string& guid = TokenFunc::asStringRef(token_stream[0]);
+                fragment.add_guid(instance, guid.data(), guid.size());
+            } catch (const IfcException& ex) {
+                fragment.errors.push_back(ex.what());
+            }
+        }
 
-    while (!stream->eof) {
         if (token_stream[0].type == IfcParse::Token_IDENTIFIER &&
             token_stream[1].type == IfcParse::Token_OPERATOR &&
             token_stream[1].value_char == '=' &&
@@ -1654,78 +2415,30 @@ void IfcFile::initialize_(IfcParse::IfcSpfStream* s) {
             try {
                 entity_type = schema_->declaration_by_name(TokenFunc::asStringRef(token_stream[2]));
             } catch (const IfcException& ex) {
-                Logger::Message(Logger::LOG_ERROR, std::string(ex.what()) + " at offset " + std::to_string(token_stream[2].startPos));
+                fragment.errors.push_back(std::string(ex.what()) + " at offset " + std::to_string(token_stream[2].startPos));
+                instance = 0;
+                read_guid = false;
                 goto advance;
             }
 
-            data = new IfcEntityInstanceData(entity_type, this, current_id, token_stream[2].startPos);
-            instance = schema()->instantiate(data);
+            if (incremental && fragment.instances.size() >= 4096) {
+                merge_(fragment);
+                fragment.clear();
+            }
+
+            instance = schema()->instantiate(new (arena_) IfcEntityInstanceData(entity_type, this, current_id, token_stream[2].startPos));
+            fragment.instances.push_back(instance);
+            read_guid = instance->declaration().is(*ifcroot_type_);
 
             /// @todo Printing to stdout in a library class feels weird. Maybe move the progress prints to the client code?
             // Update the status after every 1000 instances parsed
-            if (!((++progress) % 1000)) {
+            if (incremental && !((++progress) % 1000)) {
                 std::stringstream ss;
                 ss << "\r#" << current_id;
                 Logger::Status(ss.str(), false);
             }
-
-            if (!lazy_load_) {
-                data->load();
-            }
-
-            if (instance->declaration().is(*ifcroot_type_)) {
-                try {
-                    const std::string guid = *instance->data().getArgument(0);
-                    if (byguid.find(guid) != byguid.end()) {
-                        std::stringstream ss;
-                        ss << "Instance encountered with non-unique GlobalId " << guid;
-                        Logger::Message(Logger::LOG_WARNING, ss.str());
-                    }
-                    byguid[guid] = instance;
-                } catch (const IfcException& ex) {
-                    Logger::Message(Logger::LOG_ERROR, ex.what());
-                }
-                // this has consumed the instance tokens, set stack depth to 0
-                paren_stack_depth = 0;
-                attribute_index = -1;
-            }
-
-            const IfcParse::declaration* ty = &instance->declaration();
-
-            {
-                aggregate_of_instance::ptr insts = instances_by_type_excl_subtypes(ty);
-                if (!insts) {
-                    insts = aggregate_of_instance::ptr(new aggregate_of_instance());
-                    bytype_excl[ty] = insts;
-                }
-                insts->push(instance);
-            }
-
-            for (;;) {
-                aggregate_of_instance::ptr insts = instances_by_type(ty);
-                if (!insts) {
-                    insts = aggregate_of_instance::ptr(new aggregate_of_instance());
-                    bytype[ty] = insts;
-                }
-                insts->push(instance);
-                const IfcParse::declaration* pt = ty->as_entity()->supertype();
-                if (pt) {
-                    ty = pt;
-                } else {
-                    break;
-                }
-            }
-
-            if (byid.find(current_id) != byid.end()) {
-                std::stringstream ss;
-                ss << "Overwriting instance with name #" << current_id;
-                Logger::Message(Logger::LOG_WARNING, ss.str());
-            }
-            byid[current_id] = instance;
-
-            MaxId = (std::max)(MaxId, current_id);
         } else if (token_stream[0].type == IfcParse::Token_IDENTIFIER && instance) {
-            register_inverse(current_id, instance->declaration().as_entity(), token_stream[0], attribute_index);
+            fragment.references.push_back({(unsigned int)fragment.instances.size() - 1, token_stream[0].value_int, attribute_index});
         } else if (token_stream[0].type == IfcParse::Token_OPERATOR && token_stream[0].value_char == '(') {
             paren_stack_depth++;
         } else if (token_stream[0].type == IfcParse::Token_OPERATOR && token_stream[0].value_char == ')') {
@@ -1740,11 +2453,13 @@ void IfcFile::initialize_(IfcParse::IfcSpfStream* s) {
     advance:
         Token next_token;
         try {
-            next_token = tokens->Next();
+            next_token = lexer->Next();
         } catch (const IfcException& e) {
-            Logger::Message(Logger::LOG_ERROR, std::string(e.what()) + ". Parsing terminated");
+            fragment.errors.push_back(std::string(e.what()) + ". Parsing terminated");
+            return;
         } catch (...) {
-            Logger::Message(Logger::LOG_ERROR, "Parsing terminated");
+            fragment.errors.push_back("Parsing terminated");
+            return;
         }
 
         if (next_token.type == Token_NONE) {
@@ -1754,120 +2469,71 @@ void IfcFile::initialize_(IfcParse::IfcSpfStream* s) {
         token_stream.push_back(next_token);
     }
 
-    Logger::Status("\rDone scanning file   ");
-
-    parsing_complete_ = true;
-
-    return;
+    fragment.end_of_scan = lexer->stream->size;
 }
 
-void IfcFile::recalculate_id_counter() {
-    entity_by_id_t::key_type k = 0;
-    for (auto& p : byid) {
-        if (p.first > k) {
-            k = p.first;
-        }
+void IfcFile::merge_(scan_fragment& fragment) {
+    for (auto& message : fragment.errors) {
+        Logger::Message(Logger::LOG_ERROR, message);
     }
-    MaxId = (unsigned int)k;
-}
 
-class traversal_recorder {
-    aggregate_of_instance::ptr list_;
-    std::map<int, aggregate_of_instance::ptr> instances_by_level_;
-    int mode_;
+    for (auto& instance : fragment.instances) {
+        const IfcParse::declaration* ty = &instance->declaration();
 
-  public:
-    traversal_recorder(int mode) : mode_(mode) {
-        if (mode == 0) {
-            list_.reset(new aggregate_of_instance);
+        // Instances are only stored by their exact type, see instances_by_type_range()
+        aggregate_of_instance::ptr insts = instances_by_type_excl_subtypes(ty);
+        if (!insts) {
+            insts = aggregate_of_instance::ptr(new aggregate_of_instance());
+            bytype_excl[ty] = insts;
         }
-    };
+        insts->push(instance);
 
-    void push_back(int level, IfcUtil::IfcBaseClass* instance) {
-        if (mode_ == 0) {
-            list_->push(instance);
-        } else {
-            auto& l = instances_by_level_[level];
-            if (!l) {
-                l.reset(new aggregate_of_instance);
-            }
-            l->push(instance);
+        const unsigned int current_id = instance->data().id();
+        if (byid.find(current_id) != byid.end()) {
+            std::stringstream ss;
+            ss << "Overwriting instance with name #" << current_id;
+            Logger::Message(Logger::LOG_WARNING, ss.str());
         }
+        byid[current_id] = instance;
+
+        MaxId = (std::max)(MaxId, current_id);
     }
 
-    aggregate_of_instance::ptr get_list() const {
-        if (mode_ == 0) {
-            return list_;
-        } else {
-            aggregate_of_instance::ptr l(new aggregate_of_instance);
-            for (auto& p : instances_by_level_) {
-                l->push(p.second);
-            }
-            return l;
+    byguid.reserve(byguid.size() + fragment.guids.size());
+    for (auto& p : fragment.guids) {
+        if (byguid.assign(p.second, p.first) != nullptr) {
+            std::stringstream ss;
+            ss << "Instance encountered with non-unique GlobalId " << IfcGlobalId::encode(p.second);
+            Logger::Message(Logger::LOG_WARNING, ss.str());
         }
     }
-};
-
-class traversal_visitor {
-  private:
-    std::set<IfcUtil::IfcBaseClass*>& visited_;
-    traversal_recorder& list_;
-    int level_;
-    int max_level_;
-
-  public:
-    traversal_visitor(std::set<IfcUtil::IfcBaseClass*>& visited, traversal_recorder& list, int level, int max_level)
-        : visited_(visited),
-          list_(list),
-          level_(level),
-          max_level_(max_level) {}
-
-    void operator()(IfcUtil::IfcBaseClass* inst, int index);
-};
-
-void traverse_(IfcUtil::IfcBaseClass* instance, std::set<IfcUtil::IfcBaseClass*>& visited, traversal_recorder& list, int level, int max_level) {
-    if (visited.find(instance) != visited.end()) {
-        return;
+    for (auto& p : fragment.undecodable_guids) {
+        if (byguid.assign(p.second, p.first) != nullptr) {
+            std::stringstream ss;
+            ss << "Instance encountered with non-unique GlobalId " << p.second;
+            Logger::Message(Logger::LOG_WARNING, ss.str());
+        }
     }
-    visited.insert(instance);
-    list.push_back(level, instance);
 
-    if (level >= max_level && max_level > 0) {
-        return;
+    for (auto& r : fragment.references) {
+        const IfcUtil::IfcBaseClass* instance = fragment.instances[r.from];
+        if (defer_inverses_) {
+            const IfcParse::entity* e = instance->declaration().as_entity();
+            pending_inverses_.push_back({r.id_to, {(int)instance->data().id(), e ? e->index_in_schema() : -1, r.attribute_index}});
+        } else {
+            register_inverse(instance->data().id(), instance->declaration().as_entity(), r.id_to, r.attribute_index);
+        }
     }
-
-    traversal_visitor visit(visited, list, level + 1, max_level);
-    apply_individual_instance_visitor(&instance->data()).apply(visit);
-}
-
-void traversal_visitor::operator()(IfcUtil::IfcBaseClass* inst, int /* index */) {
-    traverse_(inst, visited_, list_, level_, max_level_);
-}
-
-aggregate_of_instance::ptr IfcParse::traverse(IfcUtil::IfcBaseClass* instance, int max_level) {
-    std::set<IfcUtil::IfcBaseClass*> visited;
-    traversal_recorder r(0);
-    traverse_(instance, visited, r, 0, max_level);
-    return r.get_list();
-}
-
-// I'm cheating this isn't breadth-first, but rather we record visited instances
-// keeping track of their rank and return a list ordered by rank. Is this equivalent?
-aggregate_of_instance::ptr IfcParse::traverse_breadth_first(IfcUtil::IfcBaseClass* instance, int max_level) {
-    std::set<IfcUtil::IfcBaseClass*> visited;
-    traversal_recorder r(1);
-    traverse_(instance, visited, r, 0, max_level);
-    return r.get_list();
 }
 
-/// @note: for backwards compatibility
-aggregate_of_instance::ptr IfcFile::traverse(IfcUtil::IfcBaseClass* instance, int max_level) {
-    return IfcParse::traverse(instance, max_level);
-}
-
-/// @note: for backwards compatibility
-aggregate_of_instance::ptr IfcFile::traverse_breadth_first(IfcUtil::IfcBaseClass* instance, int max_level) {
-    return IfcParse::traverse_breadth_first(instance, max_level);
+void IfcFile::recalculate_id_counter() {
+    entity_by_id_t::key_type k = 0;
+    for (auto& p : byid) {
+        if (p.first > k) {
+            k = p.first;
+        }
+    }
+    MaxId = (unsigned int)k;
 }
 
 void IfcFile::addEntities(aggregate_of_instance::ptr es) {
@@ -1940,18 +2606,6 @@ IfcUtil::IfcBaseClass* IfcFile::addEntity(IfcUtil::IfcBaseClass* entity, int id)
             Argument* attr = we->getArgument(i);
             IfcUtil::ArgumentType attr_type = attr->type();
 
-            IfcParse::declaration* decl = 0;
-            if (entity->declaration().as_entity()) {
-                decl = 0;
-                const parameter_type* pt = entity->declaration().as_entity()->attribute_by_index(i)->type_of_attribute();
-                while (pt->as_aggregation_type()) {
-                    pt = pt->as_aggregation_type()->type_of_element();
-                }
-                if (pt->as_named_type()) {
-                    decl = pt->as_named_type()->declared_type();
-                }
-            }
-
             if (attr_type == IfcUtil::Argument_ENTITY_INSTANCE) {
                 entity_entity_map_t::const_iterator eit = entity_file_map.find(((IfcUtil::IfcBaseClass*)(*attr))->identity());
                 if (eit == entity_file_map.end()) {
@@ -1993,48 +2647,12 @@ IfcUtil::IfcBaseClass* IfcFile::addEntity(IfcUtil::IfcBaseClass* entity, int id)
                 IfcWrite::IfcWriteArgument* copy = new IfcWrite::IfcWriteArgument();
                 copy->set(new_instances);
                 we->setArgument(i, copy);
-            } else if (decl && decl->is(*schema()->declaration_by_name("IfcLengthMeasure"))) {
+            } else if (IfcWrite::is_length_measure(entity->declaration(), i, *schema()->declaration_by_name("IfcLengthMeasure"))) {
                 if (boost::math::isnan(conversion_factor)) {
-                    std::pair<IfcUtil::IfcBaseClass*, double> this_file_unit = {nullptr, 1.0};
-                    std::pair<IfcUtil::IfcBaseClass*, double> other_file_unit = {nullptr, 1.0};
-                    try {
-                        this_file_unit = getUnit("LENGTHUNIT");
-                        other_file_unit = other_file->getUnit("LENGTHUNIT");
-                    } catch (IfcParse::IfcException&) {
-                    }
-                    if (this_file_unit.first && other_file_unit.first) {
-                        conversion_factor = other_file_unit.second / this_file_unit.second;
-                    } else {
-                        conversion_factor = 1.;
-                    }
+                    conversion_factor = IfcWrite::length_unit_conversion(*this, *other_file);
                 }
-                if (attr_type == IfcUtil::Argument_DOUBLE) {
-                    double v = *attr;
-                    v *= conversion_factor;
-
-                    IfcWrite::IfcWriteArgument* copy = new IfcWrite::IfcWriteArgument();
-                    copy->set(v);
-                    we->setArgument(i, copy);
-                } else if (attr_type == IfcUtil::Argument_AGGREGATE_OF_DOUBLE) {
-                    std::vector<double> v = *attr;
-                    for (std::vector<double>::iterator it = v.begin(); it != v.end(); ++it) {
-                        (*it) *= conversion_factor;
-                    }
-
-                    IfcWrite::IfcWriteArgument* copy = new IfcWrite::IfcWriteArgument();
-                    copy->set(v);
-                    we->setArgument(i, copy);
-                } else if (attr_type == IfcUtil::Argument_AGGREGATE_OF_AGGREGATE_OF_DOUBLE) {
-                    std::vector<std::vector<double>> v = *attr;
-                    for (std::vector<std::vector<double>>::iterator it = v.begin(); it != v.end(); ++it) {
-                        std::vector<double>& v2 = (*it);
-                        for (std::vector<double>::iterator jt = v2.begin(); jt != v2.end(); ++jt) {
-                            (*jt) *= conversion_factor;
-                        }
-                    }
-
-                    IfcWrite::IfcWriteArgument* copy = new IfcWrite::IfcWriteArgument();
-                    copy->set(v);
+                IfcWrite::IfcWriteArgument* copy = IfcWrite::scaled_length(attr, attr_type, conversion_factor);
+                if (copy) {
                     we->setArgument(i, copy);
                 }
             }
@@ -2061,12 +2679,11 @@ IfcUtil::IfcBaseClass* IfcFile::addEntity(IfcUtil::IfcBaseClass* entity, int id)
     if (new_entity->declaration().is(*ifcroot_type_)) {
         try {
             const std::string guid = *new_entity->data().getArgument(0);
-            if (byguid.find(guid) != byguid.end()) {
+            if (byguid.assign(guid, new_entity) != nullptr) {
                 std::stringstream ss;
                 ss << "Overwriting entity with guid " << guid;
                 Logger::Message(Logger::LOG_WARNING, ss.str());
             }
-            byguid[guid] = new_entity;
         } catch (const IfcException& ex) {
             Logger::Message(Logger::LOG_ERROR, ex.what());
         }
@@ -2084,22 +2701,6 @@ IfcUtil::IfcBaseClass* IfcFile::addEntity(IfcUtil::IfcBaseClass* entity, int id)
         insts->push(new_entity);
     }
 
-    for (; ty->as_entity();) {
-        aggregate_of_instance::ptr insts = instances_by_type(ty);
-        if (!insts) {
-            insts = aggregate_of_instance::ptr(new aggregate_of_instance());
-            bytype[ty] = insts;
-        }
-        insts->push(new_entity);
-
-        const IfcParse::declaration* pt = ty->as_entity()->supertype();
-        if (pt) {
-            ty = pt;
-        } else {
-            break;
-        }
-    }
-
     if (ty->as_entity()) {
         int new_id = -1;
         if (!new_entity->data().file) {
@@ -2175,6 +2776,10 @@ void IfcFile::removeEntity(IfcUtil::IfcBaseClass* entity) {
 }
 
 void IfcFile::process_deletion_() {
+    expand_inverse_index_();
+
+    std::set<IfcUtil::IfcBaseClass*> deleted_instances;
+    std::set<const IfcParse::declaration*> deleted_types;
 
     for (auto& id : batch_deletion_ids_.get<0>()) {
         auto entity = instance_by_id(id);
@@ -2190,7 +2795,7 @@ void IfcFile::process_deletion_() {
             for (aggregate_of_instance::it iit = references->begin(); iit != references->end(); ++iit) {
                 IfcUtil::IfcBaseEntity* related_instance = (IfcUtil::IfcBaseEntity*)*iit;
 
-                if (std::find(batch_deletion_ids_.begin(), batch_deletion_ids_.end(), related_instance->data().id()) != batch_deletion_ids_.end()) {
+                if (batch_deletion_ids_.get<1>().find(related_instance->data().id()) != batch_deletion_ids_.get<1>().end()) {
                     continue;
                 }
 
@@ -2289,10 +2894,7 @@ void IfcFile::process_deletion_() {
 
         if (entity->declaration().is(*ifcroot_type_)) {
             const std::string global_id = *entity->data().getArgument(0);
-            auto it = byguid.find(global_id);
-            if (it != byguid.end()) {
-                byguid.erase(it);
-            } else {
+            if (!byguid.erase(global_id)) {
                 Logger::Warning("GlobalId on rooted instance not encountered in map");
             }
         }
@@ -2301,7 +2903,12 @@ void IfcFile::process_deletion_() {
 
         const IfcParse::declaration* ty = &entity->declaration();
 
-        {
+        if (batch_mode_) {
+            // In batch mode the instances are removed from the lists by type
+            // together, rather than by a linear search for every instance.
+            deleted_instances.insert(entity);
+            deleted_types.insert(ty);
+        } else {
             aggregate_of_instance::ptr instances_of_same_type = instances_by_type_excl_subtypes(ty);
             instances_of_same_type->remove(entity);
             if (instances_of_same_type->size() == 0) {
@@ -2309,23 +2916,6 @@ void IfcFile::process_deletion_() {
             }
         }
 
-        for (;;) {
-            aggregate_of_instance::ptr instances_of_same_type = instances_by_type(ty);
-            if (instances_of_same_type) {
-                instances_of_same_type->remove(entity);
-            }
-            if (instances_of_same_type->size() == 0) {
-                bytype.erase(ty);
-            }
-
-            const IfcParse::declaration* pt = ty->as_entity()->supertype();
-            if (pt) {
-                ty = pt;
-            } else {
-                break;
-            }
-        }
-
         // entity_file_map is in place to prevent duplicate definitions with usage of add().
         // Upon deletion the pairs need to be erased.
         for (auto it = entity_file_map.begin(); it != entity_file_map.end();) {
@@ -2339,6 +2929,16 @@ void IfcFile::process_deletion_() {
         delete entity;
     }
 
+    for (auto& t : deleted_types) {
+        auto it = bytype_excl.find(t);
+        if (it != bytype_excl.end()) {
+            it->second->remove(deleted_instances);
+            if (it->second->size() == 0) {
+                bytype_excl.erase(it);
+            }
+        }
+    }
+
     if (batch_mode_) {
         for (auto it = byref.begin(); it != byref.end();) {
             bool do_delete = batch_deletion_ids_.get<1>().find(std::get<INSTANCE_ID>(it->first)) != batch_deletion_ids_.get<1>().end();
@@ -2376,9 +2976,21 @@ void IfcFile::process_deletion_() {
     batch_deletion_ids_.clear();
 }
 
+joined_instance_range IfcFile::instances_by_type_range(const IfcParse::declaration* t) const {
+    joined_instance_range range;
+    if (t && t->as_entity()) {
+        for (auto& e : t->as_entity()->subtypes_incl_self()) {
+            entities_by_type_t::const_iterator it = bytype_excl.find(e);
+            if (it != bytype_excl.end()) {
+                range.push(it->second);
+            }
+        }
+    }
+    return range;
+}
+
 aggregate_of_instance::ptr IfcFile::instances_by_type(const IfcParse::declaration* t) {
-    entities_by_type_t::const_iterator it = bytype.find(t);
-    return (it == bytype.end()) ? aggregate_of_instance::ptr() : it->second;
+    return instances_by_type_range(t).flatten();
 }
 
 aggregate_of_instance::ptr IfcFile::instances_by_type_excl_subtypes(const IfcParse::declaration* t) {
@@ -2396,6 +3008,13 @@ aggregate_of_instance::ptr IfcFile::instances_by_type_excl_subtypes(const std::s
 
 aggregate_of_instance::ptr IfcFile::instances_by_reference(int t) {
     aggregate_of_instance::ptr ret(new aggregate_of_instance);
+    if (has_inverse_index_) {
+        auto range = inverse_index_range_(t);
+        for (auto it = range.first; it != range.second; ++it) {
+            ret->push(instance_by_id(it->referrer));
+        }
+        return ret;
+    }
     for (auto& i : byref_excl[t]) {
         ret->push(instance_by_id(i));
     }
@@ -2411,23 +3030,28 @@ IfcUtil::IfcBaseClass* IfcFile::instance_by_id(int id) {
 }
 
 IfcUtil::IfcBaseClass* IfcFile::instance_by_guid(const std::string& guid) {
-    entity_by_guid_t::const_iterator it = byguid.find(guid);
-    if (it == byguid.end()) {
+    IfcUtil::IfcBaseClass* instance = byguid.find(guid);
+    if (instance == nullptr) {
         throw IfcException("Instance with GlobalId '" + guid + "' not found");
-    } else {
-        return it->second;
     }
+    return instance;
 }
 
 // FIXME: Test destructor to delete entity and arg allocations
 IfcFile::~IfcFile() {
-    std::set<IfcUtil::IfcBaseClass*> entities_to_delete;
+    std::vector<IfcUtil::IfcBaseClass*> entities_to_delete;
+    entities_to_delete.reserve(byid.size() + byidentity.size() + inline_instances_.size());
     for (const auto& pair : byid) {
-        entities_to_delete.insert(pair.second);
+        entities_to_delete.push_back(pair.second);
     }
     for (const auto& pair : byidentity) {
-        entities_to_delete.insert(pair.second);
+        entities_to_delete.push_back(pair.second);
     }
+    entities_to_delete.insert(entities_to_delete.end(), inline_instances_.begin(), inline_instances_.end());
+    std::sort(entities_to_delete.begin(), entities_to_delete.end());
+    entities_to_delete.erase(std::unique(entities_to_delete.begin(), entities_to_delete.end()), entities_to_delete.end());
+    // Instance data and attributes parsed from the file live in arena_, so this
+    // only runs their destructors. The memory is released in bulk with arena_.
     for (auto entity : entities_to_delete) {
         delete entity;
     }
@@ -2443,20 +3067,46 @@ IfcFile::entity_by_id_t::const_iterator IfcFile::end() const {
     return byid.end();
 }
 
+bool IfcFile::has_instances_(const IfcParse::declaration* decl, bool incl_subtypes) const {
+    if (!decl->as_entity()) {
+        return false;
+    }
+    if (!incl_subtypes) {
+        return bytype_excl.find(decl) != bytype_excl.end();
+    }
+    for (auto& e : decl->as_entity()->subtypes_incl_self()) {
+        if (bytype_excl.find(e) != bytype_excl.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+namespace {
+const std::vector<const IfcParse::declaration*>& declarations_of(const IfcParse::schema_definition* schema) {
+    static const std::vector<const IfcParse::declaration*> none;
+    return schema ? schema->declarations() : none;
+}
+} // namespace
+
 IfcFile::type_iterator IfcFile::types_begin() const {
-    return bytype_excl.begin();
+    const auto& decls = declarations_of(schema_);
+    return type_iterator(this, false, decls.begin(), decls.end());
 }
 
 IfcFile::type_iterator IfcFile::types_end() const {
-    return bytype_excl.end();
+    const auto& decls = declarations_of(schema_);
+    return type_iterator(this, false, decls.end(), decls.end());
 }
 
 IfcFile::type_iterator IfcFile::types_incl_super_begin() const {
-    return bytype.begin();
+    const auto& decls = declarations_of(schema_);
+    return type_iterator(this, true, decls.begin(), decls.end());
 }
 
 IfcFile::type_iterator IfcFile::types_incl_super_end() const {
-    return bytype.end();
+    const auto& decls = declarations_of(schema_);
+    return type_iterator(this, true, decls.end(), decls.end());
 }
 
 namespace {
@@ -2465,6 +3115,32 @@ struct id_instance_pair_sorter {
         return a.first < b.first;
     }
 };
+
+// Appends the instance by copying its text from the file it was read from,
+// returns false when the end of the instance cannot be found.
+bool write_unmodified(const IfcEntityInstanceData& data, std::string& out) {
+    IfcSpfStream view(*data.file->stream, data.offset_in_file());
+    IfcSpfLexer lexer(&view, data.file);
+    // Skip the keyword
+    lexer.Next();
+    int depth = 0;
+    for (;;) {
+        Token t = lexer.Next();
+        if (t.type == Token_NONE) {
+            return false;
+        } else if (TokenFunc::isOperator(t, '(')) {
+            ++depth;
+        } else if (TokenFunc::isOperator(t, ')') && --depth == 0) {
+            break;
+        }
+    }
+    char buffer[16];
+    out += '#';
+    out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), data.id()).ptr);
+    out += '=';
+    out.append(view.data_at(data.offset_in_file()), view.Tell() - data.offset_in_file());
+    return true;
+}
 } // namespace
 
 std::ostream& operator<<(std::ostream& os, const IfcParse::IfcFile& f) {
@@ -2474,14 +3150,21 @@ std::ostream& operator<<(std::ostream& os, const IfcParse::IfcFile& f) {
     vector_t sorted(f.begin(), f.end());
     std::sort(sorted.begin(), sorted.end(), id_instance_pair_sorter());
 
-    for (vector_t::const_iterator it = sorted.begin(); it != sorted.end(); ++it) {
-        const IfcUtil::IfcBaseClass* e = it->second;
+    write_in_chunks(os, sorted.size(), IfcFile::effective_num_threads(), [&f, &sorted](size_t i, std::string& buffer) {
+        const IfcUtil::IfcBaseClass* e = sorted[i].second;
         if (e->declaration().as_entity()) {
-            os << e->data().toString(true) << ";" << std::endl;
+            const IfcEntityInstanceData& data = e->data();
+            const bool copied = IfcParse::IfcFile::passthrough_unmodified() &&
+                                data.file == &f && !f.from_snapshot() && data.offset_in_file() != 0 && !data.modified() &&
+                                write_unmodified(data, buffer);
+            if (!copied) {
+                data.write(buffer, true);
+            }
+            buffer += ";\n";
         }
-    }
+    });
 
-    os << "ENDSEC;" << std::endl;
+    os << "ENDSEC;\n";
     os << "END-ISO-10303-21;" << std::endl;
 
     return os;
@@ -2506,6 +3189,14 @@ std::string IfcFile::createTimestamp() const {
 std::vector<int> IfcFile::get_inverse_indices(int instance_id) {
     std::vector<int> return_value;
 
+    if (has_inverse_index_) {
+        auto range = inverse_index_range_(instance_id);
+        for (auto it = range.first; it != range.second; ++it) {
+            return_value.push_back(it->attribute_index);
+        }
+        return return_value;
+    }
+
     auto lower = byref.lower_bound({instance_id, -1, -1});
     auto upper = byref.upper_bound({instance_id, std::numeric_limits<int>::max(), std::numeric_limits<int>::max()});
 
@@ -2545,12 +3236,39 @@ std::vector<int> IfcFile::get_inverse_indices(int instance_id) {
 }
 
 aggregate_of_instance::ptr IfcFile::getInverse(int instance_id, const IfcParse::declaration* type, int attribute_index) {
+    // The compact inverse index is immutable until it is expanded by a
+    // modification of the file, so only lookups in the maps are serialized.
+    std::unique_lock<std::mutex> lk(inverse_mutex_, std::defer_lock);
+    if (!has_inverse_index_) {
+        lk.lock();
+    }
+
     if (type == nullptr && attribute_index == -1) {
         return instances_by_reference(instance_id);
     }
 
     aggregate_of_instance::ptr return_value(new aggregate_of_instance);
 
+    if (has_inverse_index_) {
+        std::vector<const inverse_reference*> matches;
+        auto range = inverse_index_range_(instance_id);
+        for (auto it = range.first; it != range.second; ++it) {
+            if ((attribute_index == -1 || it->attribute_index == attribute_index) && it->type != -1 && schema_->declaration_by_name(it->type)->is(*type)) {
+                matches.push_back(it);
+            }
+        }
+        // Consistent with the ordering of byref, by attribute and then file order
+        if (attribute_index == -1) {
+            std::stable_sort(matches.begin(), matches.end(), [](const inverse_reference* a, const inverse_reference* b) {
+                return a->attribute_index < b->attribute_index;
+            });
+        }
+        for (auto& m : matches) {
+            return_value->push(instance_by_id(m->referrer));
+        }
+        return return_value;
+    }
+
     if (attribute_index == -1) {
         auto lower = byref.lower_bound({instance_id, type->index_in_schema(), -1});
         auto upper = byref.upper_bound({instance_id, type->index_in_schema(), std::numeric_limits<int>::max()});
@@ -2573,6 +3291,10 @@ aggregate_of_instance::ptr IfcFile::getInverse(int instance_id, const IfcParse::
 }
 
 int IfcFile::getTotalInverses(int instance_id) {
+    if (has_inverse_index_) {
+        auto range = inverse_index_range_(instance_id);
+        return (int)(range.second - range.first);
+    }
     return byref_excl[instance_id].size();
 }
 
@@ -2667,6 +3389,7 @@ std::pair<IfcUtil::IfcBaseClass*, double> IfcFile::getUnit(const std::string& un
 }
 
 void IfcParse::IfcFile::build_inverses_(IfcUtil::IfcBaseClass* inst) {
+    expand_inverse_index_();
     std::function<void(IfcUtil::IfcBaseClass*, int)> fn = [this, inst](IfcUtil::IfcBaseClass* attr, int idx) {
         if (attr->declaration().as_entity()) {
             unsigned entity_attribute_id = attr->data().id();
@@ -2692,3 +3415,12 @@ std::atomic_uint32_t IfcUtil::IfcBaseClass::counter_(0);
 
 bool IfcParse::IfcFile::lazy_load_ = true;
 bool IfcParse::IfcFile::guid_map_ = true;
+unsigned IfcParse::IfcFile::num_threads_ = 0;
+
+unsigned IfcParse::IfcFile::effective_num_threads() {
+    return num_threads_ ? num_threads_ : (std::max)(1U, std::thread::hardware_concurrency());
+}
+bool IfcParse::IfcFile::sidecar_index_ = false;
+bool IfcParse::IfcFile::compact_inverses_ = false;
+std::vector<std::string> IfcParse::IfcFile::type_filter_;
+bool IfcParse::IfcFile::passthrough_unmodified_ = false;
@@ -46,10 +46,12 @@
 #include <boost/shared_ptr.hpp>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace IfcParse {
@@ -72,7 +74,7 @@ enum TokenType {
 
 struct Token {
     IfcSpfLexer* lexer; //TODO: remove it from here
-    unsigned startPos;
+    size_t startPos;
     TokenType type;
     union {
         char value_char;     //types: OPERATOR
@@ -83,7 +85,7 @@ struct Token {
     Token() : lexer(0),
               startPos(0),
               type(Token_NONE) {}
-    Token(IfcSpfLexer* _lexer, unsigned _startPos, unsigned /*_endPos*/, TokenType _type)
+    Token(IfcSpfLexer* _lexer, size_t _startPos, size_t /*_endPos*/, TokenType _type)
         : lexer(_lexer),
           startPos(_startPos),
           type(_type) {}
@@ -134,6 +136,10 @@ class IFC_PARSE_API TokenFunc {
     static std::string asString(const Token& t);
     /// Returns the token as a string in internal buffer (for optimization purposes)
     static const std::string& asStringRef(const Token& t);
+    /// Returns the token as a string (without the dot or apostrophe) from the
+    /// string pool of the file, which is only decoded and copied when the
+    /// pool does not contain it yet
+    static std::string_view asInternedString(const Token& t);
     /// Returns the token as a string (without the dot or apostrophe)
     static boost::dynamic_bitset<> asBinary(const Token& t);
     /// Returns a string representation of the token (including the dot or apostrophe)
@@ -144,16 +150,18 @@ class IFC_PARSE_API TokenFunc {
 // Functions for creating Tokens from an arbitary file offset
 // The first 4 bits are reserved for Tokens of type ()=,;$*
 //
-Token OperatorTokenPtr(IfcSpfLexer* tokens, unsigned start, unsigned end);
-Token GeneralTokenPtr(IfcSpfLexer* tokens, unsigned start, unsigned end);
+Token OperatorTokenPtr(IfcSpfLexer* tokens, size_t start, size_t end);
+Token GeneralTokenPtr(IfcSpfLexer* tokens, size_t start, size_t end);
 Token NoneTokenPtr();
 
 /// A stream of tokens to be read from a IfcSpfStream.
 class IFC_PARSE_API IfcSpfLexer {
   private:
-    IfcCharacterDecoder* decoder;
-    unsigned int skipWhitespace();
-    unsigned int skipComment();
+    // Held by value, as lexers are constructed for every instance that is
+    // loaded lazily or copied verbatim, see IfcEntityInstanceData::load().
+    IfcCharacterDecoder decoder;
+    size_t skipWhitespace();
+    size_t skipComment();
 
   public:
     std::string& GetTempString() const {
@@ -165,7 +173,14 @@ class IFC_PARSE_API IfcSpfLexer {
     IfcSpfLexer(IfcSpfStream* s, IfcFile* f);
     Token Next();
     ~IfcSpfLexer();
-    void TokenString(unsigned int offset, std::string& result);
+    /// Sets result to the value of the token at offset. Does not change the
+    /// state of the lexer, so that tokens of a file can be read concurrently.
+    void TokenString(size_t offset, std::string& result) const;
+    /// Sets result to the characters of the string literal at offset, without
+    /// the apostrophes, when they can be used as is: printable ASCII without
+    /// escape sequences or doubled apostrophes. Returns false otherwise, in
+    /// which case the literal needs to be decoded by the IfcCharacterDecoder.
+    bool PlainString(size_t offset, std::string_view& result) const;
 };
 
 /// Argument of type list, e.g.
@@ -180,7 +195,7 @@ class IFC_PARSE_API ArgumentList : public Argument {
     ArgumentList() : size_(0),
                      list_(0) {}
     ArgumentList(size_t n) : size_(n),
-                             list_(new Argument* [size_] { 0 }) {}
+                             list_(allocate_argument_array(size_)) {}
     ~ArgumentList();
 
     void read(IfcSpfLexer* t, std::vector<unsigned int>& ids);
@@ -203,6 +218,7 @@ class IFC_PARSE_API ArgumentList : public Argument {
     Argument* operator[](unsigned int i) const;
 
     std::string toString(bool upper = false) const;
+    void write(std::string& out, bool upper = false) const;
 
     Argument**& arguments() { return list_; }
     size_t& size() { return size_; }
@@ -218,6 +234,7 @@ class IFC_PARSE_API NullArgument : public Argument {
     unsigned int size() const { return 1; }
     Argument* operator[](unsigned int /*i*/) const { throw IfcException("Argument is not a list of attributes"); }
     std::string toString(bool /*upper=false*/) const { return "$"; }
+    void write(std::string& out, bool /*upper=false*/) const { out += '$'; }
 };
 
 /// Argument of type scalar or string, e.g.
@@ -238,12 +255,15 @@ class IFC_PARSE_API TokenArgument : public Argument {
     operator std::string() const;
     operator boost::dynamic_bitset<>() const;
     operator IfcUtil::IfcBaseClass*() const;
+    std::string_view interned_string() const;
+    unsigned int reference_id() const;
 
     bool isNull() const;
     unsigned int size() const;
 
     Argument* operator[](unsigned int i) const;
     std::string toString(bool upper = false) const;
+    void write(std::string& out, bool upper = false) const;
 };
 
 /// Argument of an IFC simple type
@@ -255,6 +275,8 @@ class IFC_PARSE_API EntityArgument : public Argument {
 
   public:
     EntityArgument(const Token& t);
+    explicit EntityArgument(IfcUtil::IfcBaseClass* instance)
+        : entity(instance) {}
     ~EntityArgument();
 
     IfcUtil::ArgumentType type() const;
@@ -266,13 +288,34 @@ class IFC_PARSE_API EntityArgument : public Argument {
 
     Argument* operator[](unsigned int i) const;
     std::string toString(bool upper = false) const;
+    void write(std::string& out, bool upper = false) const;
 };
 
-IFC_PARSE_API IfcEntityInstanceData* read(unsigned int i, IfcFile* t, boost::optional<unsigned> offset = boost::none);
+IFC_PARSE_API IfcEntityInstanceData* read(unsigned int i, IfcFile* t, boost::optional<size_t> offset = boost::none);
+
+/// Parses a real in the SPF grammar, which all of pStart needs to match,
+/// independently of the locale and with the same result as strtod() in the
+/// "C" locale. Returns false when pStart is not a real.
+IFC_PARSE_API bool ParseFloat(const char* pStart, double& val);
 
 IFC_PARSE_API aggregate_of_instance::ptr traverse(IfcUtil::IfcBaseClass* instance, int max_level = -1);
 
 IFC_PARSE_API aggregate_of_instance::ptr traverse_breadth_first(IfcUtil::IfcBaseClass* instance, int max_level = -1);
+
+/// Called with every instance reached by a traversal and its distance in
+/// references from the roots, or for traverse() the depth at which it is
+/// first reached.
+typedef std::function<void(IfcUtil::IfcBaseClass*, int)> traversal_visitor;
+
+/// Visits the instances reachable from roots depth-first, in the order of
+/// traverse(), each instance once, also when it is reachable from several
+/// roots. References are followed up to max_level when it is positive.
+IFC_PARSE_API void traverse(const std::vector<IfcUtil::IfcBaseClass*>& roots, const traversal_visitor& visitor, int max_level = -1);
+
+/// Visits the instances reachable from roots level by level. The references
+/// of the instances of a level are read on up to IfcFile::num_threads()
+/// threads, visitor is only called from the calling thread.
+IFC_PARSE_API void traverse_breadth_first(const std::vector<IfcUtil::IfcBaseClass*>& roots, const traversal_visitor& visitor, int max_level = -1);
 } // namespace IfcParse
 
 IFC_PARSE_API std::ostream& operator<<(std::ostream& os, const IfcParse::IfcFile& f);
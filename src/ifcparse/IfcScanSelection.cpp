@@ -0,0 +1,203 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Scanning of only the instances of the types set by IfcFile::type_filter()
+// and of the instances they depend on, when opening a partial model.
+
+#include "IfcFile.h"
+#include "IfcSpfStream.h"
+
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+using namespace IfcParse;
+
+namespace {
+// Calls fn with the attribute index and id of the instance references in the
+// entity instance whose name is at offset, which is read with its own cursor.
+template <typename Fn>
+void read_references(IfcFile* file, size_t offset, Fn fn) {
+    IfcSpfStream view(*file->stream, offset);
+    IfcSpfLexer lexer(&view, file);
+    // Skip the name, the equals sign and the keyword
+    for (int i = 0; i < 3; ++i) {
+        lexer.Next();
+    }
+    int depth = 0;
+    int attribute_index = 0;
+    while (!view.eof) {
+        Token t = lexer.Next();
+        if (TokenFunc::isOperator(t, '(')) {
+            ++depth;
+        } else if (TokenFunc::isOperator(t, ')')) {
+            if (--depth == 0) {
+                return;
+            }
+        } else if (depth == 1 && TokenFunc::isOperator(t, ',')) {
+            ++attribute_index;
+        } else if (TokenFunc::isIdentifier(t)) {
+            fn(attribute_index, TokenFunc::asIdentifier(t));
+        } else if (t.type == Token_NONE) {
+            return;
+        }
+    }
+}
+} // namespace
+
+//
+// Scans only the instances of the given types, the instances they refer to and
+// the spatial structure they are contained in. A first pass records the name
+// offsets of all instances, after which the selected instances are scanned
+// as ranges of consecutive instances.
+//
+void IfcFile::scan_selection_(const std::vector<const IfcParse::declaration*>& types) {
+    struct record {
+        unsigned id;
+        const IfcParse::declaration* type;
+        size_t offset;
+    };
+
+    std::vector<record> records;
+    walk_instances_([&records](unsigned id, const IfcParse::declaration* type, size_t name_offset, size_t) {
+        records.push_back({id, type, name_offset});
+    });
+
+    std::vector<size_t> by_id(records.size());
+    for (size_t i = 0; i < by_id.size(); ++i) {
+        by_id[i] = i;
+    }
+    std::sort(by_id.begin(), by_id.end(), [&records](size_t a, size_t b) {
+        return records[a].id < records[b].id;
+    });
+    auto find = [&records, &by_id](int id) {
+        auto it = std::lower_bound(by_id.begin(), by_id.end(), id, [&records](size_t i, int v) {
+            return records[i].id < (unsigned)v;
+        });
+        return it != by_id.end() && records[*it].id == (unsigned)id ? *it : (std::numeric_limits<size_t>::max)();
+    };
+
+    // Relationships that are only followed towards their relating instance.
+    // Decomposition is only followed upwards from spatial structure elements.
+    struct relationship {
+        const IfcParse::entity* type;
+        ptrdiff_t related_attribute;
+        bool spatial_only;
+    };
+    std::vector<relationship> relationships;
+    for (auto& r : {std::make_tuple("IfcRelContainedInSpatialStructure", "RelatedElements", false), std::make_tuple("IfcRelAggregates", "RelatedObjects", true)}) {
+        try {
+            const IfcParse::entity* e = schema_->declaration_by_name(std::get<0>(r))->as_entity();
+            relationships.push_back({e, e->attribute_index(std::get<1>(r)), std::get<2>(r)});
+        } catch (const IfcException&) {
+        }
+    }
+    const IfcParse::declaration* spatial_type = nullptr;
+    for (auto& name : {"IfcSpatialElement", "IfcSpatialStructureElement"}) {
+        try {
+            spatial_type = schema_->declaration_by_name(name);
+            break;
+        } catch (const IfcException&) {
+        }
+    }
+
+    // For selected instances the index of the attribute whose references are
+    // not followed, or -1 to follow all references.
+    const ptrdiff_t not_selected = -2;
+    std::vector<ptrdiff_t> selected(records.size(), not_selected);
+    std::vector<size_t> queue;
+    auto select = [&selected, &queue](size_t i, ptrdiff_t skipped_attribute) {
+        if (i < selected.size() && selected[i] == not_selected) {
+            selected[i] = skipped_attribute;
+            queue.push_back(i);
+        }
+    };
+    auto select_closure = [this, &records, &selected, &queue, &select, &find]() {
+        while (!queue.empty()) {
+            const size_t i = queue.back();
+            queue.pop_back();
+            const ptrdiff_t skipped_attribute = selected[i];
+            read_references(this, records[i].offset, [&](int attribute_index, int id) {
+                if (attribute_index != skipped_attribute) {
+                    select(find(id), -1);
+                }
+            });
+        }
+    };
+
+    std::vector<std::pair<size_t, size_t>> candidates;
+    for (size_t i = 0; i < records.size(); ++i) {
+        for (auto& t : types) {
+            if (records[i].type->is(*t)) {
+                select(i, -1);
+                break;
+            }
+        }
+        for (size_t j = 0; j < relationships.size(); ++j) {
+            if (records[i].type->is(*relationships[j].type)) {
+                candidates.emplace_back(i, j);
+            }
+        }
+    }
+    select_closure();
+
+    // Containment of selected elements adds a spatial structure element, which in
+    // turn is decomposed from its parent, so this is repeated until the top.
+    for (bool added = true; added;) {
+        added = false;
+        for (auto& c : candidates) {
+            if (selected[c.first] != not_selected) {
+                continue;
+            }
+            const relationship& r = relationships[c.second];
+            bool relevant = false;
+            read_references(this, records[c.first].offset, [&](int attribute_index, int id) {
+                if (attribute_index == r.related_attribute) {
+                    const size_t j = find(id);
+                    if (j < selected.size() && selected[j] != not_selected && (!r.spatial_only || (spatial_type && records[j].type->is(*spatial_type)))) {
+                        relevant = true;
+                    }
+                }
+            });
+            if (relevant) {
+                select(c.first, r.related_attribute);
+                added = true;
+            }
+        }
+        select_closure();
+    }
+
+    scan_fragment fragment;
+    for (size_t i = 0; i < records.size();) {
+        if (selected[i] == not_selected) {
+            ++i;
+            continue;
+        }
+        const size_t begin = records[i].offset;
+        while (i < records.size() && selected[i] != not_selected) {
+            ++i;
+        }
+        const size_t end = i < records.size() ? records[i].offset : (std::numeric_limits<size_t>::max)();
+        IfcSpfStream view(*stream, begin);
+        IfcSpfLexer lexer(&view, this);
+        scan_(&lexer, end, false, fragment);
+    }
+    merge_(fragment);
+}
@@ -137,6 +137,25 @@ IfcParse::schema_definition::schema_definition(const std::string& name, const st
             entities_.push_back((**it).as_entity());
         }
     }
+
+    for (auto& e : entities_) {
+        const_cast<entity*>(e)->build_attribute_index_();
+        const_cast<entity*>(e)->build_subtype_closure_();
+    }
+
+    size_t table_size = 1;
+    while (table_size < declarations_.size() * 4) {
+        table_size *= 2;
+    }
+    declarations_by_name_.resize(table_size, nullptr);
+    for (auto& decl : declarations_) {
+        size_t i = name_hash_(decl->name_uc()) & (table_size - 1);
+        while (declarations_by_name_[i]) {
+            i = (i + 1) & (table_size - 1);
+        }
+        declarations_by_name_[i] = decl;
+    }
+
     schemas[name_] = this;
 }
 
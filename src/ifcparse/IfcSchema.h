@@ -25,8 +25,11 @@
 #include <algorithm>
 #include <boost/algorithm/string.hpp>
 #include <cctype>
+#include <cstdint>
+#include <cstring>
 #include <iterator>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 // Forward declarations
@@ -294,17 +297,57 @@ class IFC_PARSE_API inverse_attribute {
     const attribute* attribute_reference() const { return attribute_reference_; }
 };
 
+/// An attribute resolved by name once, with entity::resolve_attribute(), so
+/// that it is accessed by index on instances of the entity and its subtypes.
+struct attribute_handle {
+    const entity* entity_reference;
+    size_t index;
+};
+
 class IFC_PARSE_API entity : public declaration {
+    friend class schema_definition;
+
   protected:
     bool is_abstract_;
     const entity* supertype_; /* NB: IFC explicitly allows only single inheritance */
     std::vector<const entity*> subtypes_;
 
+    /// The entity followed by its direct and indirect subtypes, in pre-order.
+    /// Built by the schema_definition once the subtypes of all entities are
+    /// set.
+    std::vector<const entity*> subtypes_incl_self_;
+
     std::vector<const attribute*> attributes_;
     std::vector<bool> derived_;
 
     std::vector<const inverse_attribute*> inverse_attributes_;
 
+    /// The indices of all attributes, including those of the supertypes, by
+    /// name. Built by the schema_definition once the attributes of all
+    /// entities are set.
+    std::unordered_map<std::string, size_t> attribute_index_by_name_;
+
+    void build_attribute_index_() {
+        const std::vector<const attribute*> attrs = all_attributes();
+        attribute_index_by_name_.clear();
+        // Attributes are ordered from the root supertype, so that a name that
+        // is declared again by a subtype resolves to the most derived one
+        for (size_t i = 0; i < attrs.size(); ++i) {
+            attribute_index_by_name_.insert_or_assign(attrs[i]->name(), i);
+        }
+    }
+
+    void build_subtype_closure_() {
+        subtypes_incl_self_.clear();
+        std::vector<const entity*> stack = {this};
+        while (!stack.empty()) {
+            const entity* e = stack.back();
+            stack.pop_back();
+            subtypes_incl_self_.push_back(e);
+            stack.insert(stack.end(), e->subtypes_.rbegin(), e->subtypes_.rend());
+        }
+    }
+
     class attribute_by_name_cmp {
       private:
         std::string name_;
@@ -355,6 +398,8 @@ class IFC_PARSE_API entity : public declaration {
     }
 
     const std::vector<const entity*>& subtypes() const { return subtypes_; }
+    /// Returns the entity itself and all of its direct and indirect subtypes
+    const std::vector<const entity*>& subtypes_incl_self() const { return subtypes_incl_self_; }
     const std::vector<const attribute*>& attributes() const { return attributes_; }
     const std::vector<bool>& derived() const { return derived_; }
 
@@ -413,6 +458,10 @@ class IFC_PARSE_API entity : public declaration {
     }
 
     ptrdiff_t attribute_index(const std::string& attr_name) const {
+        if (!attribute_index_by_name_.empty()) {
+            auto it = attribute_index_by_name_.find(attr_name);
+            return it == attribute_index_by_name_.end() ? -1 : (ptrdiff_t)it->second;
+        }
         const entity* current = this;
         ptrdiff_t index = -1;
         attribute_by_name_cmp cmp(attr_name);
@@ -430,6 +479,15 @@ class IFC_PARSE_API entity : public declaration {
         return index;
     }
 
+    /// Throws an IfcException when the entity has no attribute named attr_name
+    attribute_handle resolve_attribute(const std::string& attr_name) const {
+        const ptrdiff_t index = attribute_index(attr_name);
+        if (index == -1) {
+            throw IfcParse::IfcException(attr_name + " not found on " + name_);
+        }
+        return {this, (size_t)index};
+    }
+
     const entity* supertype() const { return supertype_; }
 
     virtual const entity* as_entity() const { return this; }
@@ -453,13 +511,6 @@ class IFC_PARSE_API schema_definition {
     std::vector<const enumeration_type*> enumeration_types_;
     std::vector<const entity*> entities_;
 
-    class declaration_by_name_cmp {
-      public:
-        bool operator()(const declaration* decl, const std::string& name) {
-            return decl->name_uc() < name;
-        }
-    };
-
     class declaration_by_index_sort {
       public:
         bool operator()(const declaration* a, const declaration* b) {
@@ -469,9 +520,37 @@ class IFC_PARSE_API schema_definition {
 
     instance_factory* factory_;
 
-    std::string& temp_string_() const {
-        static my_thread_local std::string s;
-        return s;
+    /// The declarations by the hash of their uppercase name, with linear
+    /// probing in a table that is at least four times as large as the number
+    /// of declarations, so that keywords are found with about one comparison.
+    std::vector<const declaration*> declarations_by_name_;
+
+    static char upper_(char c) {
+        return c >= 'a' && c <= 'z' ? c - ('a' - 'A') : c;
+    }
+
+    /// A hash of name that does not depend on the case of its letters, as
+    /// bit 5 of every character is cleared, eight characters at a time.
+    static uint64_t name_hash_(const std::string& name) {
+        const uint64_t fold = 0xDFDFDFDFDFDFDFDFULL;
+        const uint64_t m = 0x9E3779B97F4A7C15ULL;
+        uint64_t h = name.size();
+        size_t i = 0;
+        for (; i + 8 <= name.size(); i += 8) {
+            uint64_t w;
+            std::memcpy(&w, name.data() + i, 8);
+            h = (h ^ (w & fold)) * m;
+            h ^= h >> 29;
+        }
+        uint64_t w = 0;
+        std::memcpy(&w, name.data() + i, name.size() - i);
+        h = (h ^ (w & fold)) * m;
+        return h ^ (h >> 32);
+    }
+
+    static bool name_equals_(const std::string& name_uc, const std::string& name) {
+        return name_uc.size() == name.size() &&
+               (name_uc == name || std::equal(name.begin(), name.end(), name_uc.begin(), [](char a, char b) { return upper_(a) == b; }));
     }
 
   public:
@@ -479,18 +558,18 @@ class IFC_PARSE_API schema_definition {
 
     ~schema_definition();
 
+    /// Looks up a declaration by its case-insensitive name, e.g. the keyword
+    /// of an instance, without converting the name to uppercase.
     const declaration* declaration_by_name(const std::string& name) const {
-        const std::string* name_ptr = &name;
-        if (std::any_of(name.begin(), name.end(), [](char c) { return std::islower(c); })) {
-            temp_string_() = name;
-            boost::to_upper(temp_string_());
-            name_ptr = &temp_string_();
-        }
-        std::vector<const declaration*>::const_iterator it = std::lower_bound(declarations_.begin(), declarations_.end(), *name_ptr, declaration_by_name_cmp());
-        if (it == declarations_.end() || (**it).name_uc() != *name_ptr) {
-            throw IfcParse::IfcException("Entity with name '" + name + "' not found in schema '" + name_ + "'");
-        } else {
-            return *it;
+        const size_t mask = declarations_by_name_.size() - 1;
+        for (size_t i = name_hash_(name) & mask;; i = (i + 1) & mask) {
+            const declaration* decl = declarations_by_name_[i];
+            if (decl == nullptr) {
+                throw IfcParse::IfcException("Entity with name '" + name + "' not found in schema '" + name_ + "'");
+            }
+            if (name_equals_(decl->name_uc(), name)) {
+                return decl;
+            }
         }
     }
 
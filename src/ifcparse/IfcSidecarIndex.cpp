@@ -0,0 +1,302 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Reading and writing of the sidecar index, which stores the results of
+// scanning a file next to it, so that unchanged files are not scanned again.
+
+#include "IfcFile.h"
+#include "IfcHash.h"
+#include "IfcSpfStream.h"
+
+#include <boost/unordered_map.hpp>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <sys/stat.h>
+
+using namespace IfcParse;
+
+namespace {
+const char sidecar_index_magic[8] = {'I', 'F', 'C', 'I', 'D', 'X', 0, 0};
+const uint32_t sidecar_index_version = 3;
+// Indices written on a machine with a different byte order are rejected
+const uint32_t sidecar_index_byte_order = 0x01020304;
+
+// The GlobalIds follow the instances and references as a sequence of
+// (uint32_t instance index, uint32_t length, characters) records. The size
+// and modification time are those of the file on disk, the content size and
+// hash those of the decompressed buffer for compressed files. The body hash
+// is that of the records that follow the header.
+struct sidecar_index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t file_size;
+    int64_t file_mtime;
+    uint64_t content_size;
+    uint64_t content_hash;
+    uint64_t num_instances;
+    uint64_t num_references;
+    uint64_t num_guids;
+    uint64_t body_hash;
+    char schema[32];
+};
+
+struct sidecar_index_instance {
+    uint32_t id;
+    int32_t type;
+    uint64_t offset;
+};
+
+struct sidecar_index_reference {
+    // Index of the referring instance in the instance records
+    uint32_t from;
+    int32_t id_to;
+    int32_t attribute_index;
+};
+
+bool stat_file(const std::string& fn, uint64_t& size, int64_t& mtime) {
+#ifdef _MSC_VER
+    struct _stat64 st;
+    if (_stat64(fn.c_str(), &st) != 0) {
+        return false;
+    }
+#else
+    struct stat st;
+    if (stat(fn.c_str(), &st) != 0) {
+        return false;
+    }
+#endif
+    size = (uint64_t)st.st_size;
+    mtime = (int64_t)st.st_mtime;
+    return true;
+}
+
+template <typename T>
+void write_record(std::ostream& os, const T& t) {
+    os.write(reinterpret_cast<const char*>(&t), sizeof(T));
+}
+
+template <typename T>
+bool read_record(const char*& ptr, const char* end, T& t) {
+    if ((size_t)(end - ptr) < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&t, ptr, sizeof(T));
+    ptr += sizeof(T);
+    return true;
+}
+} // namespace
+
+bool IfcFile::read_sidecar_index_(const std::string& fn, const std::string& index_fn) {
+    uint64_t file_size, index_size;
+    int64_t file_mtime, index_mtime;
+    if (!stat_file(fn, file_size, file_mtime) || !stat_file(index_fn, index_size, index_mtime)) {
+        return false;
+    }
+
+#ifdef USE_MMAP
+    boost::iostreams::mapped_file_source mapped;
+    try {
+        mapped.open(index_fn);
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (!mapped.is_open()) {
+        return false;
+    }
+    const char* ptr = mapped.data();
+    const char* const end = ptr + mapped.size();
+#else
+    std::ifstream is(index_fn.c_str(), std::ios::binary);
+    std::vector<char> buffer((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+    const char* ptr = buffer.data();
+    const char* const end = ptr + buffer.size();
+#endif
+
+    sidecar_index_header header;
+    if (!read_record(ptr, end, header) ||
+        std::memcmp(header.magic, sidecar_index_magic, sizeof(sidecar_index_magic)) != 0 ||
+        header.version != sidecar_index_version ||
+        header.byte_order != sidecar_index_byte_order ||
+        header.file_size != file_size ||
+        header.file_mtime != file_mtime ||
+        header.content_size != stream->size ||
+        std::string(header.schema, strnlen(header.schema, sizeof(header.schema))) != schema_->name()) {
+        Logger::Notice("Sidecar index " + index_fn + " is outdated");
+        return false;
+    }
+
+    if (header.content_hash != hash_buffer(stream->data_at(0), stream->size)) {
+        Logger::Notice("Sidecar index " + index_fn + " is outdated");
+        return false;
+    }
+
+    if ((uint64_t)(end - ptr) < header.num_instances * sizeof(sidecar_index_instance) + header.num_references * sizeof(sidecar_index_reference) ||
+        header.body_hash != hash_buffer(ptr, end - ptr)) {
+        Logger::Warning("Sidecar index " + index_fn + " is corrupt");
+        return false;
+    }
+
+    const auto& declarations = schema_->declarations();
+
+    scan_fragment fragment;
+    fragment.instances.reserve(header.num_instances);
+    fragment.references.reserve(header.num_references);
+
+    bool valid = true;
+
+    for (uint64_t i = 0; valid && i < header.num_instances; ++i) {
+        sidecar_index_instance record;
+        read_record(ptr, end, record);
+        if (record.type < 0 || (size_t)record.type >= declarations.size() || !declarations[record.type]->as_entity() || record.offset >= stream->size) {
+            valid = false;
+            break;
+        }
+        fragment.instances.push_back(schema_->instantiate(new (arena_) IfcEntityInstanceData(declarations[record.type], this, record.id, record.offset)));
+    }
+
+    for (uint64_t i = 0; valid && i < header.num_references; ++i) {
+        sidecar_index_reference record;
+        read_record(ptr, end, record);
+        if (record.from >= fragment.instances.size()) {
+            valid = false;
+            break;
+        }
+        fragment.references.push_back({record.from, record.id_to, record.attribute_index});
+    }
+
+    for (uint64_t i = 0; valid && i < header.num_guids; ++i) {
+        uint32_t index, length;
+        if (!read_record(ptr, end, index) || !read_record(ptr, end, length) || index >= fragment.instances.size() || (size_t)(end - ptr) < length) {
+            valid = false;
+            break;
+        }
+        fragment.add_guid(fragment.instances[index], ptr, length);
+        ptr += length;
+    }
+
+    if (!valid) {
+        Logger::Warning("Sidecar index " + index_fn + " is corrupt");
+        for (auto& inst : fragment.instances) {
+            delete inst;
+        }
+        return false;
+    }
+
+    merge_(fragment);
+
+    return true;
+}
+
+void IfcFile::write_sidecar_index_(const std::string& fn, const std::string& index_fn) {
+    uint64_t file_size;
+    int64_t file_mtime;
+    if (!stat_file(fn, file_size, file_mtime)) {
+        return;
+    }
+
+    // Instances are stored in file order so that reading the index
+    // populates the type maps in the same order as scanning does.
+    std::vector<IfcUtil::IfcBaseClass*> instances;
+    instances.reserve(byid.size());
+    for (auto& p : byid) {
+        instances.push_back(p.second);
+    }
+    std::sort(instances.begin(), instances.end(), [](IfcUtil::IfcBaseClass* a, IfcUtil::IfcBaseClass* b) {
+        return a->data().offset_in_file() < b->data().offset_in_file();
+    });
+
+    boost::unordered_map<unsigned int, uint32_t> index_by_id;
+    for (size_t i = 0; i < instances.size(); ++i) {
+        index_by_id[instances[i]->data().id()] = (uint32_t)i;
+    }
+
+    std::vector<sidecar_index_reference> references;
+    references.reserve(pending_inverses_.size());
+    for (auto& p : pending_inverses_) {
+        auto it = index_by_id.find(p.second.referrer);
+        if (it != index_by_id.end()) {
+            references.push_back({it->second, p.first, p.second.attribute_index});
+        }
+    }
+
+    sidecar_index_header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, sidecar_index_magic, sizeof(sidecar_index_magic));
+    header.version = sidecar_index_version;
+    header.byte_order = sidecar_index_byte_order;
+    header.file_size = file_size;
+    header.file_mtime = file_mtime;
+    header.content_size = stream->size;
+    header.content_hash = hash_buffer(stream->data_at(0), stream->size);
+    header.num_instances = instances.size();
+    header.num_references = references.size();
+    header.num_guids = byguid.size();
+    std::strncpy(header.schema, schema_->name().c_str(), sizeof(header.schema) - 1);
+
+    std::ostringstream body;
+    for (auto& inst : instances) {
+        write_record(body, sidecar_index_instance{inst->data().id(), inst->declaration().index_in_schema(), inst->data().offset_in_file()});
+    }
+    for (auto& r : references) {
+        write_record(body, r);
+    }
+    for (auto& p : byguid.sorted()) {
+        write_record(body, index_by_id[p.second->data().id()]);
+        write_record(body, (uint32_t)p.first.size());
+        body.write(p.first.data(), p.first.size());
+    }
+    const std::string body_data = body.str();
+    header.body_hash = hash_buffer(body_data.data(), body_data.size());
+
+    // Written to a temporary file first, so that concurrent readers never
+    // observe a partial index. The name is unique, so that processes that
+    // open the same file at the same time each write their own.
+    std::random_device random;
+    std::ostringstream temp_name;
+    temp_name << index_fn << "." << std::hex << random() << random() << ".tmp";
+    const std::string temp_fn = temp_name.str();
+    {
+        std::ofstream os(temp_fn.c_str(), std::ios::binary);
+        write_record(os, header);
+        os.write(body_data.data(), body_data.size());
+        if (!os.good()) {
+            Logger::Warning("Unable to write sidecar index " + index_fn);
+            os.close();
+            std::remove(temp_fn.c_str());
+            return;
+        }
+    }
+
+    // Renaming replaces the index atomically on POSIX, on Windows it fails
+    // when the index exists, in which case it is removed first.
+    bool renamed = std::rename(temp_fn.c_str(), index_fn.c_str()) == 0;
+    if (!renamed) {
+        std::remove(index_fn.c_str());
+        renamed = std::rename(temp_fn.c_str(), index_fn.c_str()) == 0;
+    }
+    if (!renamed) {
+        Logger::Warning("Unable to write sidecar index " + index_fn);
+        std::remove(temp_fn.c_str());
+    }
+}
@@ -0,0 +1,664 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#include "IfcSnapshot.h"
+
+#include "IfcFile.h"
+#include "IfcHash.h"
+#include "IfcSpfStream.h"
+#include "IfcWrite.h"
+
+#include <algorithm>
+#include <boost/unordered_map.hpp>
+#include <charconv>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+
+using namespace IfcParse;
+
+bool IfcParse::snapshot::locate_header(const char* data, size_t size, size_t& header_offset) {
+    if (size < sizeof(magic) || std::memcmp(data, magic, sizeof(magic)) != 0) {
+        return false;
+    }
+    header h;
+    if (size < sizeof(h)) {
+        throw IfcException("Truncated snapshot");
+    }
+    std::memcpy(&h, data, sizeof(h));
+    if (h.byte_order != byte_order) {
+        throw IfcException("Snapshot was written on a machine with a different byte order");
+    }
+    if (h.version != version) {
+        throw IfcException("Unsupported snapshot version " + std::to_string(h.version));
+    }
+    if (h.header_offset >= size) {
+        throw IfcException("Corrupt snapshot");
+    }
+    header_offset = (size_t)h.header_offset;
+    return true;
+}
+
+snapshot::cell SnapshotArgument::cell_() const {
+    snapshot::cell c;
+    std::memcpy(&c, file_->stream->data_at(offset_), sizeof(c));
+    return c;
+}
+
+std::string_view SnapshotArgument::characters_() const {
+    const snapshot::cell c = cell_();
+    if (c.kind != snapshot::CELL_STRING && c.kind != snapshot::CELL_ENUMERATION && c.kind != snapshot::CELL_BINARY) {
+        throw IfcException("Argument is not a string");
+    }
+    if (c.value > file_->stream->size || c.size > file_->stream->size - c.value) {
+        throw IfcException("Corrupt string in snapshot");
+    }
+    return std::string_view(file_->stream->data_at(c.value), c.size);
+}
+
+IfcUtil::ArgumentType SnapshotArgument::type() const {
+    switch (cell_().kind) {
+    case snapshot::CELL_NULL:
+        return IfcUtil::Argument_NULL;
+    case snapshot::CELL_DERIVED:
+        return IfcUtil::Argument_DERIVED;
+    case snapshot::CELL_INT:
+        return IfcUtil::Argument_INT;
+    case snapshot::CELL_BOOL:
+        return IfcUtil::Argument_BOOL;
+    case snapshot::CELL_LOGICAL:
+        return IfcUtil::Argument_LOGICAL;
+    case snapshot::CELL_DOUBLE:
+        return IfcUtil::Argument_DOUBLE;
+    case snapshot::CELL_STRING:
+        return IfcUtil::Argument_STRING;
+    case snapshot::CELL_ENUMERATION:
+        return IfcUtil::Argument_ENUMERATION;
+    case snapshot::CELL_BINARY:
+        return IfcUtil::Argument_BINARY;
+    case snapshot::CELL_REFERENCE:
+        return IfcUtil::Argument_ENTITY_INSTANCE;
+    default:
+        return IfcUtil::Argument_UNKNOWN;
+    }
+}
+
+//
+// Functions for casting the SnapshotArgument to other types
+//
+SnapshotArgument::operator int() const {
+    const snapshot::cell c = cell_();
+    if (c.kind != snapshot::CELL_INT) {
+        throw IfcException("Argument is not an integer");
+    }
+    return (int)(int64_t)c.value;
+}
+
+SnapshotArgument::operator bool() const {
+    const snapshot::cell c = cell_();
+    if (c.kind != snapshot::CELL_BOOL && !(c.kind == snapshot::CELL_LOGICAL && c.value != 2)) {
+        throw IfcException("Argument is not a boolean");
+    }
+    return c.value == 1;
+}
+
+SnapshotArgument::operator boost::logic::tribool() const {
+    const snapshot::cell c = cell_();
+    if (c.kind != snapshot::CELL_BOOL && c.kind != snapshot::CELL_LOGICAL) {
+        throw IfcException("Argument is not a logical");
+    }
+    if (c.value == 2) {
+        return boost::logic::indeterminate;
+    }
+    return c.value == 1;
+}
+
+SnapshotArgument::operator double() const {
+    const snapshot::cell c = cell_();
+    if (c.kind == snapshot::CELL_INT) {
+        return (double)(int64_t)c.value;
+    }
+    if (c.kind != snapshot::CELL_DOUBLE) {
+        throw IfcException("Argument is not a number");
+    }
+    double d;
+    std::memcpy(&d, &c.value, sizeof(d));
+    return d;
+}
+
+SnapshotArgument::operator std::string() const {
+    return std::string(characters_());
+}
+
+std::string_view SnapshotArgument::interned_string() const {
+    // Read in place, the snapshot buffer lives as long as the file
+    return characters_();
+}
+
+SnapshotArgument::operator boost::dynamic_bitset<>() const {
+    if (cell_().kind != snapshot::CELL_BINARY) {
+        throw IfcException("Argument is not a binary");
+    }
+    return boost::dynamic_bitset<>(std::string(characters_()));
+}
+
+SnapshotArgument::operator IfcUtil::IfcBaseClass*() const {
+    const snapshot::cell c = cell_();
+    if (c.kind != snapshot::CELL_REFERENCE) {
+        throw IfcException("Argument is not an entity instance");
+    }
+    return file_->instance_by_id((int)c.size);
+}
+
+unsigned int SnapshotArgument::reference_id() const {
+    const snapshot::cell c = cell_();
+    if (c.kind != snapshot::CELL_REFERENCE) {
+        throw IfcException("Argument is not an entity instance");
+    }
+    return (unsigned int)c.size;
+}
+
+bool SnapshotArgument::isNull() const { return cell_().kind == snapshot::CELL_NULL; }
+unsigned int SnapshotArgument::size() const { return 1; }
+Argument* SnapshotArgument::operator[](unsigned int /*i*/) const { throw IfcException("Argument is not a list of attributes"); }
+
+std::string SnapshotArgument::toString(bool upper) const {
+    std::string out;
+    write(out, upper);
+    return out;
+}
+
+void SnapshotArgument::write(std::string& out, bool /*upper=false*/) const {
+    const snapshot::cell c = cell_();
+    switch (c.kind) {
+    case snapshot::CELL_NULL:
+        out += '$';
+        break;
+    case snapshot::CELL_DERIVED:
+        out += '*';
+        break;
+    case snapshot::CELL_INT:
+    case snapshot::CELL_REFERENCE: {
+        if (c.kind == snapshot::CELL_REFERENCE) {
+            out += '#';
+        }
+        char buffer[24];
+        const int64_t v = c.kind == snapshot::CELL_REFERENCE ? (int64_t)c.size : (int64_t)c.value;
+        out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), v).ptr);
+        break;
+    }
+    case snapshot::CELL_BOOL:
+    case snapshot::CELL_LOGICAL:
+        out += c.value == 2 ? ".U." : (c.value == 1 ? ".T." : ".F.");
+        break;
+    case snapshot::CELL_STRING:
+        out += static_cast<std::string>(IfcWrite::IfcCharacterEncoder(std::string(characters_())));
+        break;
+    case snapshot::CELL_ENUMERATION:
+        out += '.';
+        out += characters_();
+        out += '.';
+        break;
+    case snapshot::CELL_DOUBLE:
+    case snapshot::CELL_BINARY: {
+        // Formatted like values of attributes that are set programmatically
+        IfcWrite::IfcWriteArgument formatted;
+        if (c.kind == snapshot::CELL_DOUBLE) {
+            formatted.set(static_cast<double>(*this));
+        } else {
+            formatted.set(static_cast<boost::dynamic_bitset<>>(*this));
+        }
+        out += formatted.toString();
+        break;
+    }
+    default:
+        throw IfcException("Corrupt cell in snapshot");
+    }
+}
+
+void snapshot::encoder::encode_characters(size_t i, snapshot::cell_kind kind, const std::string& s) {
+    set(i, kind, (uint32_t)s.size(), strings.size());
+    strings += s;
+}
+
+void snapshot::encoder::encode_reference(size_t i, int id) {
+    set(i, snapshot::CELL_REFERENCE, (uint32_t)id);
+    references.push_back({from, id, attribute_index});
+}
+
+void snapshot::encoder::encode(size_t i, int v) {
+    set(i, snapshot::CELL_INT, 0, (uint64_t)(int64_t)v);
+}
+
+void snapshot::encoder::encode(size_t i, double v) {
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    set(i, snapshot::CELL_DOUBLE, 0, bits);
+}
+
+void snapshot::encoder::encode(size_t i, const std::string& s) {
+    encode_characters(i, snapshot::CELL_STRING, s);
+}
+
+void snapshot::encoder::encode(size_t i, const boost::dynamic_bitset<>& b) {
+    std::string s;
+    boost::to_string(b, s);
+    encode_characters(i, snapshot::CELL_BINARY, s);
+}
+
+void snapshot::encoder::encode(size_t i, IfcUtil::IfcBaseClass* instance) {
+    if (instance->declaration().as_entity()) {
+        encode_reference(i, instance->data().id());
+    } else {
+        const size_t value = allocate(1);
+        set(i, snapshot::CELL_TYPED, (uint32_t)instance->declaration().index_in_schema(), value);
+        encode(value, instance->data().getArgument(0));
+    }
+}
+
+void snapshot::encoder::encode(size_t i, const Argument* a) {
+    if (const ArgumentList* list = dynamic_cast<const ArgumentList*>(a)) {
+        const size_t n = list->size();
+        const size_t first = allocate(n);
+        set(i, snapshot::CELL_AGGREGATE, (uint32_t)n, first);
+        for (size_t j = 0; j < n; ++j) {
+            encode(first + j, (*list)[(unsigned int)j]);
+        }
+        return;
+    }
+
+    switch (a->type()) {
+    case IfcUtil::Argument_NULL:
+        set(i, snapshot::CELL_NULL);
+        break;
+    case IfcUtil::Argument_DERIVED:
+        set(i, snapshot::CELL_DERIVED);
+        break;
+    case IfcUtil::Argument_INT:
+        encode(i, static_cast<int>(*a));
+        break;
+    case IfcUtil::Argument_BOOL:
+        set(i, snapshot::CELL_BOOL, 0, static_cast<bool>(*a) ? 1 : 0);
+        break;
+    case IfcUtil::Argument_LOGICAL: {
+        const boost::logic::tribool v = *a;
+        set(i, snapshot::CELL_LOGICAL, 0, boost::logic::indeterminate(v) ? 2 : (v ? 1 : 0));
+        break;
+    }
+    case IfcUtil::Argument_DOUBLE:
+        encode(i, static_cast<double>(*a));
+        break;
+    case IfcUtil::Argument_STRING: {
+        const std::string v = *a;
+        encode(i, v);
+        break;
+    }
+    case IfcUtil::Argument_ENUMERATION: {
+        const std::string v = *a;
+        encode_characters(i, snapshot::CELL_ENUMERATION, v);
+        break;
+    }
+    case IfcUtil::Argument_BINARY: {
+        const boost::dynamic_bitset<> v = *a;
+        encode(i, v);
+        break;
+    }
+    case IfcUtil::Argument_ENTITY_INSTANCE: {
+        // References are stored by id, so that they do not need to be resolved
+        const TokenArgument* token = dynamic_cast<const TokenArgument*>(a);
+        if (token && TokenFunc::isIdentifier(token->token)) {
+            encode_reference(i, TokenFunc::asIdentifier(token->token));
+        } else {
+            encode(i, static_cast<IfcUtil::IfcBaseClass*>(*a));
+        }
+        break;
+    }
+    case IfcUtil::Argument_EMPTY_AGGREGATE:
+    case IfcUtil::Argument_AGGREGATE_OF_EMPTY_AGGREGATE:
+        set(i, snapshot::CELL_AGGREGATE, 0, cells.size());
+        break;
+    case IfcUtil::Argument_AGGREGATE_OF_INT:
+        encode(i, static_cast<std::vector<int>>(*a));
+        break;
+    case IfcUtil::Argument_AGGREGATE_OF_DOUBLE:
+        encode(i, static_cast<std::vector<double>>(*a));
+        break;
+    case IfcUtil::Argument_AGGREGATE_OF_STRING:
+        encode(i, static_cast<std::vector<std::string>>(*a));
+        break;
+    case IfcUtil::Argument_AGGREGATE_OF_BINARY:
+        encode(i, static_cast<std::vector<boost::dynamic_bitset<>>>(*a));
+        break;
+    case IfcUtil::Argument_AGGREGATE_OF_ENTITY_INSTANCE: {
+        const aggregate_of_instance::ptr v = *a;
+        encode(i, std::vector<IfcUtil::IfcBaseClass*>(v->begin(), v->end()));
+        break;
+    }
+    case IfcUtil::Argument_AGGREGATE_OF_AGGREGATE_OF_INT:
+        encode(i, static_cast<std::vector<std::vector<int>>>(*a));
+        break;
+    case IfcUtil::Argument_AGGREGATE_OF_AGGREGATE_OF_DOUBLE:
+        encode(i, static_cast<std::vector<std::vector<double>>>(*a));
+        break;
+    case IfcUtil::Argument_AGGREGATE_OF_AGGREGATE_OF_ENTITY_INSTANCE: {
+        const aggregate_of_aggregate_of_instance::ptr v = *a;
+        encode(i, std::vector<std::vector<IfcUtil::IfcBaseClass*>>(v->begin(), v->end()));
+        break;
+    }
+    default:
+        throw IfcException("Unable to store attribute of type " + std::string(IfcUtil::ArgumentTypeToString(a->type())) + " in snapshot");
+    }
+}
+
+namespace {
+uint64_t align_snapshot_offset(uint64_t offset) {
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+// Appends a description of the type of an attribute or defined type, named
+// types are described by their name to not follow recursive definitions.
+void describe_parameter_type(const IfcParse::parameter_type* pt, std::string& out) {
+    if (pt == nullptr) {
+        out += '?';
+    } else if (auto nt = pt->as_named_type()) {
+        out += nt->declared_type()->name_uc();
+    } else if (auto st = pt->as_simple_type()) {
+        out += '#';
+        out += std::to_string((int)st->declared_type());
+    } else if (auto at = pt->as_aggregation_type()) {
+        out += std::to_string((int)at->type_of_aggregation());
+        out += '[';
+        out += std::to_string(at->bound1());
+        out += ':';
+        out += std::to_string(at->bound2());
+        out += "](";
+        describe_parameter_type(at->type_of_element(), out);
+        out += ')';
+    }
+}
+} // namespace
+
+uint64_t IfcParse::snapshot::declarations_hash(const IfcParse::schema_definition* schema) {
+    std::string description;
+    for (auto& decl : schema->declarations()) {
+        description += decl->name_uc();
+        if (auto entity = decl->as_entity()) {
+            const auto attributes = entity->all_attributes();
+            description += ' ';
+            description += std::to_string(attributes.size());
+            for (auto& attr : attributes) {
+                description += ' ';
+                describe_parameter_type(attr->type_of_attribute(), description);
+                if (attr->optional()) {
+                    description += '?';
+                }
+            }
+        } else if (auto type = decl->as_type_declaration()) {
+            description += ' ';
+            describe_parameter_type(type->declared_type(), description);
+        } else if (auto select = decl->as_select_type()) {
+            for (auto& item : select->select_list()) {
+                description += ' ';
+                description += item->name_uc();
+            }
+        } else if (auto enumeration = decl->as_enumeration_type()) {
+            for (auto& item : enumeration->enumeration_items()) {
+                description += ' ';
+                description += item;
+            }
+        }
+        description += '\n';
+    }
+    return hash_buffer(description.data(), description.size());
+}
+
+void IfcFile::write_snapshot(std::ostream& os) const {
+    // Instances are stored in file order, followed by instances that were added
+    std::vector<IfcUtil::IfcBaseClass*> instances;
+    instances.reserve(byid.size());
+    for (auto& p : byid) {
+        instances.push_back(p.second);
+    }
+    std::sort(instances.begin(), instances.end(), [](IfcUtil::IfcBaseClass* a, IfcUtil::IfcBaseClass* b) {
+        const size_t oa = a->data().offset_in_file();
+        const size_t ob = b->data().offset_in_file();
+        if ((oa == 0) != (ob == 0)) {
+            return ob == 0;
+        }
+        return oa != ob ? oa < ob : a->data().id() < b->data().id();
+    });
+
+    snapshot::encoder encoder;
+    std::vector<snapshot::instance> records;
+    records.reserve(instances.size());
+    boost::unordered_map<unsigned int, uint32_t> index_by_id;
+    for (size_t i = 0; i < instances.size(); ++i) {
+        const IfcEntityInstanceData& data = instances[i]->data();
+        const size_t n = data.getArgumentCount();
+        const size_t first = encoder.allocate(n);
+        records.push_back({data.id(), instances[i]->declaration().index_in_schema(), first});
+        index_by_id[data.id()] = (uint32_t)i;
+        encoder.from = (uint32_t)i;
+        for (size_t j = 0; j < n; ++j) {
+            encoder.attribute_index = (int)j;
+            encoder.encode(first + j, data.getArgument(j));
+        }
+    }
+
+    std::vector<snapshot::guid> guids;
+    guids.reserve(byguid.size());
+    for (auto& p : byguid.sorted()) {
+        auto it = index_by_id.find(p.second->data().id());
+        if (it != index_by_id.end()) {
+            guids.push_back({it->second, (uint32_t)p.first.size(), encoder.strings.size()});
+            encoder.strings += p.first;
+        }
+    }
+
+    std::ostringstream header_section;
+    header_section.imbue(std::locale::classic());
+    _header.write(header_section);
+    const std::string header_text = header_section.str();
+
+    snapshot::header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, snapshot::magic, sizeof(snapshot::magic));
+    h.version = snapshot::version;
+    h.byte_order = snapshot::byte_order;
+    h.header_offset = sizeof(h);
+    h.num_instances = records.size();
+    h.instances_offset = align_snapshot_offset(h.header_offset + header_text.size());
+    h.num_references = encoder.references.size();
+    h.references_offset = h.instances_offset + records.size() * sizeof(snapshot::instance);
+    h.num_guids = guids.size();
+    h.guids_offset = align_snapshot_offset(h.references_offset + encoder.references.size() * sizeof(snapshot::reference));
+    h.num_cells = encoder.cells.size();
+    h.cells_offset = h.guids_offset + guids.size() * sizeof(snapshot::guid);
+    h.strings_size = encoder.strings.size();
+    h.strings_offset = h.cells_offset + encoder.cells.size() * sizeof(snapshot::cell);
+    std::strncpy(h.schema, schema_->name().c_str(), sizeof(h.schema) - 1);
+    h.num_declarations = schema_->declarations().size();
+    h.declarations_hash = snapshot::declarations_hash(schema_);
+
+    for (auto& r : records) {
+        r.offset = h.cells_offset + r.offset * sizeof(snapshot::cell);
+    }
+    for (auto& g : guids) {
+        g.offset += h.strings_offset;
+    }
+    for (auto& c : encoder.cells) {
+        if (c.kind == snapshot::CELL_STRING || c.kind == snapshot::CELL_ENUMERATION || c.kind == snapshot::CELL_BINARY) {
+            c.value += h.strings_offset;
+        } else if (c.kind == snapshot::CELL_AGGREGATE || c.kind == snapshot::CELL_TYPED) {
+            c.value = h.cells_offset + c.value * sizeof(snapshot::cell);
+        }
+    }
+
+    uint64_t position = 0;
+    auto write_at = [&os, &position](uint64_t offset, const void* data, size_t size) {
+        static const char padding[8] = {0};
+        os.write(padding, (std::streamsize)(offset - position));
+        os.write(static_cast<const char*>(data), (std::streamsize)size);
+        position = offset + size;
+    };
+    write_at(0, &h, sizeof(h));
+    write_at(h.header_offset, header_text.data(), header_text.size());
+    write_at(h.instances_offset, records.data(), records.size() * sizeof(snapshot::instance));
+    write_at(h.references_offset, encoder.references.data(), encoder.references.size() * sizeof(snapshot::reference));
+    write_at(h.guids_offset, guids.data(), guids.size() * sizeof(snapshot::guid));
+    write_at(h.cells_offset, encoder.cells.data(), encoder.cells.size() * sizeof(snapshot::cell));
+    write_at(h.strings_offset, encoder.strings.data(), encoder.strings.size());
+}
+
+void IfcFile::read_snapshot_() {
+    snapshot::header h;
+    std::memcpy(&h, stream->data_at(0), sizeof(h));
+
+    const uint64_t size = stream->size;
+    auto fits = [size](uint64_t offset, uint64_t count, uint64_t record_size) {
+        return offset <= size && count <= (size - offset) / record_size;
+    };
+
+    if (!fits(h.instances_offset, h.num_instances, sizeof(snapshot::instance)) ||
+        !fits(h.references_offset, h.num_references, sizeof(snapshot::reference)) ||
+        !fits(h.guids_offset, h.num_guids, sizeof(snapshot::guid)) ||
+        !fits(h.cells_offset, h.num_cells, sizeof(snapshot::cell)) ||
+        !fits(h.strings_offset, h.strings_size, 1)) {
+        Logger::Error("Snapshot is corrupt");
+        good_ = file_open_status::READ_ERROR;
+        return;
+    }
+
+    if (std::string(h.schema, strnlen(h.schema, sizeof(h.schema))) != schema_->name() ||
+        h.num_declarations != schema_->declarations().size() ||
+        h.declarations_hash != snapshot::declarations_hash(schema_)) {
+        Logger::Error("Snapshot is written for a different revision of schema " + schema_->name());
+        good_ = file_open_status::UNSUPPORTED_SCHEMA;
+        return;
+    }
+
+    const char* data = stream->data_at(0);
+    const uint64_t cells_end = h.cells_offset + h.num_cells * sizeof(snapshot::cell);
+    const uint64_t strings_end = h.strings_offset + h.strings_size;
+    const auto& declarations = schema_->declarations();
+
+    scan_fragment fragment;
+    fragment.instances.reserve(h.num_instances);
+    fragment.references.reserve(h.num_references);
+
+    bool valid = true;
+
+    for (uint64_t i = 0; valid && i < h.num_instances; ++i) {
+        snapshot::instance record;
+        std::memcpy(&record, data + h.instances_offset + i * sizeof(record), sizeof(record));
+        const IfcParse::entity* e = record.type >= 0 && (size_t)record.type < declarations.size() ? declarations[record.type]->as_entity() : nullptr;
+        if (!e || record.offset < h.cells_offset || record.offset > cells_end ||
+            (record.offset - h.cells_offset) % sizeof(snapshot::cell) != 0 ||
+            (cells_end - record.offset) / sizeof(snapshot::cell) < e->attribute_count()) {
+            valid = false;
+            break;
+        }
+        fragment.instances.push_back(schema_->instantiate(new (arena_) IfcEntityInstanceData(e, this, record.id, record.offset)));
+    }
+
+    for (uint64_t i = 0; valid && i < h.num_references; ++i) {
+        snapshot::reference record;
+        std::memcpy(&record, data + h.references_offset + i * sizeof(record), sizeof(record));
+        if (record.from >= fragment.instances.size()) {
+            valid = false;
+            break;
+        }
+        fragment.references.push_back({record.from, record.id_to, record.attribute_index});
+    }
+
+    for (uint64_t i = 0; valid && i < h.num_guids; ++i) {
+        snapshot::guid record;
+        std::memcpy(&record, data + h.guids_offset + i * sizeof(record), sizeof(record));
+        if (record.instance >= fragment.instances.size() || record.offset < h.strings_offset || record.offset > strings_end || record.length > strings_end - record.offset) {
+            valid = false;
+            break;
+        }
+        fragment.add_guid(fragment.instances[record.instance], data + record.offset, record.length);
+    }
+
+    if (!valid) {
+        Logger::Error("Snapshot is corrupt");
+        for (auto& inst : fragment.instances) {
+            delete inst;
+        }
+        good_ = file_open_status::READ_ERROR;
+        return;
+    }
+
+    merge_(fragment);
+}
+
+namespace {
+// Far deeper than the nesting of aggregates and simple types in any schema,
+// limits the recursion on corrupt snapshots.
+const int max_snapshot_nesting = 64;
+} // namespace
+
+Argument* IfcFile::snapshot_argument_(size_t offset, int depth) {
+    snapshot::cell c;
+    std::memcpy(&c, stream->data_at(offset), sizeof(c));
+
+    // Nested cells follow their parent, which rules out cycles
+    const bool nested_valid = c.value > offset && depth < max_snapshot_nesting;
+
+    if (c.kind == snapshot::CELL_AGGREGATE) {
+        if (!nested_valid || c.value > stream->size || c.size > (stream->size - c.value) / sizeof(snapshot::cell)) {
+            throw IfcException("Corrupt aggregate in snapshot at offset " + std::to_string(offset));
+        }
+        ArgumentList* list = new (arena_) ArgumentList();
+        if (c.size) {
+            list->arguments() = allocate_argument_array(c.size, &arena_);
+            list->size() = c.size;
+            for (uint32_t i = 0; i < c.size; ++i) {
+                list->arguments()[i] = snapshot_argument_(c.value + i * sizeof(snapshot::cell), depth + 1);
+            }
+        }
+        return list;
+    }
+
+    if (c.kind == snapshot::CELL_TYPED) {
+        const auto& declarations = schema_->declarations();
+        if (!nested_valid || c.size >= declarations.size() || c.value > stream->size - sizeof(snapshot::cell)) {
+            throw IfcException("Corrupt simple type in snapshot at offset " + std::to_string(offset));
+        }
+        // The value is assigned directly rather than loaded on access, as this
+        // happens while the instance that contains the simple type is locked.
+        IfcEntityInstanceData* data = new (arena_) IfcEntityInstanceData(declarations[c.size]);
+        data->file = this;
+        data->attributes()[0] = snapshot_argument_(c.value, depth + 1);
+        IfcUtil::IfcBaseClass* instance = schema_->instantiate(data);
+        add_inline_instance_(instance);
+        return new (arena_) EntityArgument(instance);
+    }
+
+    return new (arena_) SnapshotArgument(this, offset);
+}
+
+Argument** IfcFile::load_snapshot(size_t offset, size_t num_attributes) {
+    Argument** attributes = allocate_argument_array(num_attributes, &arena_);
+    for (size_t i = 0; i < num_attributes; ++i) {
+        attributes[i] = snapshot_argument_(offset + i * sizeof(snapshot::cell));
+    }
+    return attributes;
+}
@@ -0,0 +1,243 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+/********************************************************************************
+ *                                                                              *
+ * A binary snapshot of a parsed file, written by IfcFile::write_snapshot()     *
+ * and opened by the IfcFile constructors in place of an IFC-SPF file. It is    *
+ * laid out so that it can be used directly from a memory mapping:              *
+ *                                                                              *
+ *   header                                                                     *
+ *   the IFC-SPF header section, as text                                        *
+ *   instance[num_instances]      id, type and offset of the first attribute    *
+ *   reference[num_references]    the inverse references                        *
+ *   guid[num_guids]              GlobalIds, stored in the string heap          *
+ *   cell[num_cells]              the attribute values                          *
+ *   string heap                  strings, enumerations and binaries            *
+ *                                                                              *
+ * Every attribute value is a fixed size cell that holds a number, a reference, *
+ * or the location of a string or of the cells of an aggregate, so that values  *
+ * are read without parsing. All integers are stored in the byte order of the   *
+ * machine that wrote the snapshot, other machines reject it.                   *
+ *                                                                              *
+ * The cells of an instance are stored as a row, in the order of its            *
+ * attributes, rather than in a column per attribute and entity: attributes     *
+ * are accessed by instance and index, and aggregates and simple types nest     *
+ * cells of other kinds that are not known from the schema alone.               *
+ *                                                                              *
+ ********************************************************************************/
+
+#ifndef IFCSNAPSHOT_H
+#define IFCSNAPSHOT_H
+
+#include "ifc_parse_api.h"
+#include "IfcParse.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace IfcParse {
+
+namespace snapshot {
+
+const char magic[8] = {'I', 'F', 'C', 'S', 'N', 'A', 'P', 0};
+const uint32_t version = 3;
+const uint32_t byte_order = 0x01020304;
+
+/// Offsets are relative to the start of the snapshot
+struct header {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t header_offset;
+    uint64_t num_instances;
+    uint64_t instances_offset;
+    uint64_t num_references;
+    uint64_t references_offset;
+    uint64_t num_guids;
+    uint64_t guids_offset;
+    uint64_t num_cells;
+    uint64_t cells_offset;
+    uint64_t strings_size;
+    uint64_t strings_offset;
+    /// The name of the schema, the number of its declarations and the
+    /// declarations_hash() of the schema, snapshots written for another
+    /// schema or by a build with a different revision of the schema are
+    /// rejected.
+    char schema[32];
+    uint64_t num_declarations;
+    uint64_t declarations_hash;
+};
+
+struct instance {
+    uint32_t id;
+    int32_t type;
+    /// The offset of the cell of the first attribute, followed by the other
+    /// attributes, their number is the attribute count of the entity.
+    uint64_t offset;
+};
+
+struct reference {
+    /// Index of the referring instance in the instance records
+    uint32_t from;
+    int32_t id_to;
+    int32_t attribute_index;
+};
+
+struct guid {
+    uint32_t instance;
+    uint32_t length;
+    uint64_t offset;
+};
+
+enum cell_kind : uint8_t {
+    CELL_NULL,
+    CELL_DERIVED,
+    /// value is the integer
+    CELL_INT,
+    /// value is 0 or 1
+    CELL_BOOL,
+    /// value is 0, 1 or 2 for unknown
+    CELL_LOGICAL,
+    /// value holds the bits of the double
+    CELL_DOUBLE,
+    /// size is the length and value the offset of the characters, which
+    /// are decoded, or of the '0' and '1' characters of a binary
+    CELL_STRING,
+    CELL_ENUMERATION,
+    CELL_BINARY,
+    /// size is the id of the referenced instance
+    CELL_REFERENCE,
+    /// size is the number of elements and value the offset of their cells
+    CELL_AGGREGATE,
+    /// A simple type, e.g. IFCLABEL('x'). size is the index of the type in
+    /// the schema and value the offset of the cell that holds its value.
+    /// The cells that aggregates and simple types point to always follow
+    /// the cell that points to them, so that nested values form no cycles.
+    CELL_TYPED
+};
+
+struct cell {
+    uint8_t kind;
+    uint8_t reserved[3];
+    uint32_t size;
+    uint64_t value;
+};
+
+static_assert(sizeof(cell) == 16, "Unexpected snapshot cell size");
+
+/// A hash of the declarations of the schema in order: their names, the
+/// number and types of the attributes of entities and the underlying types
+/// of the other declarations. Identifies the revision of a schema, as types
+/// are stored as the index of their declaration and attributes by position.
+IFC_PARSE_API uint64_t declarations_hash(const schema_definition* schema);
+
+/// Encodes attribute values into the cells and string heap of a snapshot.
+/// The values of cells are relative to the start of the cells and of the
+/// string heap, as their offsets in the snapshot are only known once all are
+/// encoded. Also used to hash the content of instances.
+class encoder {
+  public:
+    std::vector<cell> cells;
+    std::string strings;
+    std::vector<reference> references;
+
+    /// The instance and attribute for which references are recorded
+    uint32_t from = 0;
+    int attribute_index = 0;
+
+    /// Appends n null cells and returns the index of the first
+    size_t allocate(size_t n) {
+        const size_t i = cells.size();
+        cells.resize(i + n, cell{CELL_NULL, {0, 0, 0}, 0, 0});
+        return i;
+    }
+
+    void set(size_t i, cell_kind kind, uint32_t size = 0, uint64_t value = 0) {
+        cells[i].kind = kind;
+        cells[i].size = size;
+        cells[i].value = value;
+    }
+
+    void encode_characters(size_t i, cell_kind kind, const std::string& s);
+    void encode_reference(size_t i, int id);
+
+    void encode(size_t i, int v);
+    void encode(size_t i, double v);
+    void encode(size_t i, const std::string& s);
+    void encode(size_t i, const boost::dynamic_bitset<>& b);
+    void encode(size_t i, IfcUtil::IfcBaseClass* instance);
+    void encode(size_t i, const Argument* a);
+
+    template <typename T>
+    void encode(size_t i, const std::vector<T>& values) {
+        const size_t first = allocate(values.size());
+        set(i, CELL_AGGREGATE, (uint32_t)values.size(), first);
+        for (size_t j = 0; j < values.size(); ++j) {
+            encode(first + j, values[j]);
+        }
+    }
+};
+
+/// Returns whether data is a snapshot and sets header_offset to the offset of
+/// its IFC-SPF header section. Throws an IfcException for snapshots that were
+/// written by an incompatible version or on a machine with another byte order.
+IFC_PARSE_API bool locate_header(const char* data, size_t size, size_t& header_offset);
+
+} // namespace snapshot
+
+/// Argument of type scalar, string or reference that is read from its cell in
+/// the buffer of a snapshot every time it is converted.
+class IFC_PARSE_API SnapshotArgument : public Argument {
+  private:
+    IfcFile* file_;
+    size_t offset_;
+
+    snapshot::cell cell_() const;
+    std::string_view characters_() const;
+
+  public:
+    SnapshotArgument(IfcFile* file, size_t offset)
+        : file_(file),
+          offset_(offset) {}
+
+    IfcUtil::ArgumentType type() const;
+
+    operator int() const;
+    operator bool() const;
+    operator boost::logic::tribool() const;
+    operator double() const;
+    operator std::string() const;
+    operator boost::dynamic_bitset<>() const;
+    operator IfcUtil::IfcBaseClass*() const;
+    std::string_view interned_string() const;
+    unsigned int reference_id() const;
+
+    bool isNull() const;
+    unsigned int size() const;
+
+    Argument* operator[](unsigned int i) const;
+    std::string toString(bool upper = false) const;
+    void write(std::string& out, bool upper = false) const;
+};
+
+} // namespace IfcParse
+
+#endif
@@ -41,7 +41,7 @@ HeaderEntity::HeaderEntity(const char* const datatype, size_t size, IfcFile* fil
       size_(size) {
     if (file) {
         offset_in_file_ = file->stream->Tell();
-        load();
+        load(file->tokens);
     }
 }
 
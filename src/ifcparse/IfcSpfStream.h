@@ -47,37 +47,67 @@ class IFC_PARSE_API IfcSpfStream {
 #endif
     FILE* stream;
     const char* buffer;
-    unsigned int ptr;
-    unsigned int len;
+    size_t ptr;
+    size_t len;
+    bool owns_buffer;
+
+    /// Replaces a gzip, zstd or ifcZIP compressed buffer by its contents
+    void decompress_();
 
   public:
     bool valid;
     bool eof;
-    unsigned int size;
+    size_t size;
 #ifdef USE_MMAP
-    IfcSpfStream(const std::string& fn, bool mmap = false);
+    IfcSpfStream(const std::string& fn, bool mmap = true);
 #else
     IfcSpfStream(const std::string& fn);
 #endif
-    IfcSpfStream(std::istream& f, int len);
-    IfcSpfStream(void* data, int len);
+    IfcSpfStream(std::istream& f, size_t len);
+    IfcSpfStream(void* data, size_t len);
+    /// Creates a view on the buffer of another stream with an independent
+    /// cursor positioned at offset. The buffer remains owned by other.
+    IfcSpfStream(const IfcSpfStream& other, size_t offset);
     ~IfcSpfStream();
     /// Returns the character at the cursor
     char Peek();
     /// Returns the character at specified offset
-    char Read(unsigned int offset);
+    char Read(size_t offset);
     /// Increment the file cursor and reads new page if necessary
     void Inc();
     void Close();
     /// Moves the file cursor to an arbitrary offset in the file
-    void Seek(unsigned int offset);
+    void Seek(size_t offset);
     /// Returns the cursor position
-    unsigned int Tell();
+    size_t Tell();
+
+    bool is_eof_at(size_t);
+    void increment_at(size_t&);
+    char peek_at(size_t);
 
-    bool is_eof_at(unsigned int);
-    void increment_at(unsigned int&);
-    char peek_at(unsigned int);
+    /// Moves the file cursor to an offset in the file, or past its end
+    /// in which case eof is set. Line breaks at offset are not skipped.
+    void move_to(size_t offset);
+    /// Returns the offset of the first non-whitespace character at or
+    /// after offset, or the file length
+    size_t skip_whitespace_at(size_t offset);
+    /// Returns the offset of the first token delimiter, i.e. one of
+    /// ()=,;/ or a quote, at or after offset, or the file length
+    size_t find_delimiter_at(size_t offset);
+    /// Returns the offset of the solidus that closes the comment opened
+    /// by the asterisk at offset, or the file length
+    size_t find_comment_end_at(size_t offset);
+    /// Returns the offset of the first apostrophe, backslash or character
+    /// outside of printable ASCII at or after offset, or the file length
+    size_t find_string_special_at(size_t offset);
+    /// Returns a pointer into the contiguous file buffer
+    const char* data_at(size_t offset) const { return buffer + offset; }
 };
+
+/// Returns whether c separates tokens, i.e. is a space, tab or line break
+inline bool is_separator(char c) {
+    return c == ' ' || c == '\r' || c == '\n' || c == '\t';
+}
 } // namespace IfcParse
 
 #endif
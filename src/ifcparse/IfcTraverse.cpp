@@ -0,0 +1,221 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Depth-first and breadth-first traversal of the instances referenced by
+// one or more root instances.
+
+#include "IfcFile.h"
+#include "IfcInstanceVisitor.h"
+#include "IfcParallel.h"
+
+#include <boost/unordered_set.hpp>
+#include <cstdint>
+#include <vector>
+
+using namespace IfcParse;
+
+namespace {
+// The instances visited by a traversal. Instances of the file are marked in
+// a bitset indexed by id, once enough of them are visited to outweigh
+// clearing it, before that and for other instances, such as instances of
+// simple types which have no id, a set is used.
+class visited_instances {
+    const IfcFile* file_;
+    size_t num_words_;
+    std::vector<uint64_t> bits_;
+    boost::unordered_set<const IfcUtil::IfcBaseClass*> others_;
+
+    bool indexed_(const IfcUtil::IfcBaseClass* instance, size_t& id) const {
+        const IfcEntityInstanceData& data = instance->data();
+        id = data.id();
+        return id != 0 && data.file == file_ && id / 64 < num_words_;
+    }
+
+    void allocate_() {
+        bits_.assign(num_words_, 0);
+        size_t id;
+        for (auto it = others_.begin(); it != others_.end();) {
+            if (indexed_(*it, id)) {
+                bits_[id / 64] |= (uint64_t)1 << (id % 64);
+                it = others_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+  public:
+    explicit visited_instances(const IfcFile* file)
+        : file_(file),
+          num_words_(file ? file->getMaxId() / 64 + 1 : 0) {}
+
+    /// Can be called concurrently, as long as there are no calls to insert()
+    bool contains(const IfcUtil::IfcBaseClass* instance) const {
+        size_t id;
+        if (!bits_.empty() && indexed_(instance, id)) {
+            return (bits_[id / 64] >> (id % 64)) & 1;
+        }
+        return others_.find(instance) != others_.end();
+    }
+
+    /// Marks instance as visited, returns false when it already was
+    bool insert(const IfcUtil::IfcBaseClass* instance) {
+        size_t id;
+        if (!bits_.empty() && indexed_(instance, id)) {
+            uint64_t& word = bits_[id / 64];
+            const uint64_t mask = (uint64_t)1 << (id % 64);
+            if (word & mask) {
+                return false;
+            }
+            word |= mask;
+            return true;
+        }
+        if (!others_.insert(instance).second) {
+            return false;
+        }
+        if (bits_.empty() && others_.size() * 16 >= num_words_ && num_words_ != 0) {
+            allocate_();
+        }
+        return true;
+    }
+};
+
+// Appends the instances referenced by the attributes of an instance that
+// have not been visited yet.
+class unvisited_references {
+    const visited_instances& visited_;
+    std::vector<IfcUtil::IfcBaseClass*>& references_;
+
+  public:
+    unvisited_references(const visited_instances& visited, std::vector<IfcUtil::IfcBaseClass*>& references)
+        : visited_(visited),
+          references_(references) {}
+
+    void operator()(IfcUtil::IfcBaseClass* inst, int /* index */) {
+        if (inst && !visited_.contains(inst)) {
+            references_.push_back(inst);
+        }
+    }
+};
+
+const IfcFile* file_of(const std::vector<IfcUtil::IfcBaseClass*>& instances) {
+    for (auto& inst : instances) {
+        if (inst) {
+            return inst->data().file;
+        }
+    }
+    return nullptr;
+}
+
+bool expands(int level, int max_level) {
+    return max_level <= 0 || level < max_level;
+}
+} // namespace
+
+void IfcParse::traverse(const std::vector<IfcUtil::IfcBaseClass*>& roots, const traversal_visitor& visitor, int max_level) {
+    visited_instances visited(file_of(roots));
+    // Children are pushed in reverse and checked again when popped, so that
+    // instances are visited in the same order as by recursion.
+    std::vector<std::pair<IfcUtil::IfcBaseClass*, int>> stack;
+    std::vector<IfcUtil::IfcBaseClass*> references;
+    for (auto it = roots.rbegin(); it != roots.rend(); ++it) {
+        if (*it) {
+            stack.emplace_back(*it, 0);
+        }
+    }
+    while (!stack.empty()) {
+        IfcUtil::IfcBaseClass* inst = stack.back().first;
+        const int level = stack.back().second;
+        stack.pop_back();
+        if (!visited.insert(inst)) {
+            continue;
+        }
+        visitor(inst, level);
+        if (!expands(level, max_level)) {
+            continue;
+        }
+        references.clear();
+        unvisited_references collect(visited, references);
+        apply_individual_instance_visitor(&inst->data()).apply(collect);
+        for (auto it = references.rbegin(); it != references.rend(); ++it) {
+            stack.emplace_back(*it, level + 1);
+        }
+    }
+}
+
+void IfcParse::traverse_breadth_first(const std::vector<IfcUtil::IfcBaseClass*>& roots, const traversal_visitor& visitor, int max_level) {
+    const unsigned int n_threads = IfcFile::effective_num_threads();
+    visited_instances visited(file_of(roots));
+    std::vector<IfcUtil::IfcBaseClass*> frontier, next;
+    for (auto& inst : roots) {
+        if (inst && visited.insert(inst)) {
+            frontier.push_back(inst);
+            visitor(inst, 0);
+        }
+    }
+    // The references of a level are read in parallel, which parses the
+    // instances when they are not loaded yet, and are then marked as visited
+    // in the order of the level, so that the result is the same as that of
+    // a sequential traversal.
+    std::vector<std::vector<IfcUtil::IfcBaseClass*>> references;
+    for (int level = 0; !frontier.empty() && expands(level, max_level); ++level) {
+        if (references.size() < frontier.size()) {
+            references.resize(frontier.size());
+        }
+        parallel_for(
+            frontier.size(), n_threads, [&](size_t i) {
+                references[i].clear();
+                unvisited_references collect(visited, references[i]);
+                apply_individual_instance_visitor(&frontier[i]->data()).apply(collect);
+            },
+            min_instances_per_thread);
+        next.clear();
+        for (size_t i = 0; i < frontier.size(); ++i) {
+            for (auto& inst : references[i]) {
+                if (visited.insert(inst)) {
+                    next.push_back(inst);
+                    visitor(inst, level + 1);
+                }
+            }
+        }
+        frontier.swap(next);
+    }
+}
+
+aggregate_of_instance::ptr IfcParse::traverse(IfcUtil::IfcBaseClass* instance, int max_level) {
+    aggregate_of_instance::ptr l(new aggregate_of_instance);
+    traverse(std::vector<IfcUtil::IfcBaseClass*>{instance}, [&l](IfcUtil::IfcBaseClass* inst, int) { l->push(inst); }, max_level);
+    return l;
+}
+
+aggregate_of_instance::ptr IfcParse::traverse_breadth_first(IfcUtil::IfcBaseClass* instance, int max_level) {
+    aggregate_of_instance::ptr l(new aggregate_of_instance);
+    traverse_breadth_first(std::vector<IfcUtil::IfcBaseClass*>{instance}, [&l](IfcUtil::IfcBaseClass* inst, int) { l->push(inst); }, max_level);
+    return l;
+}
+
+/// @note: for backwards compatibility
+aggregate_of_instance::ptr IfcFile::traverse(IfcUtil::IfcBaseClass* instance, int max_level) {
+    return IfcParse::traverse(instance, max_level);
+}
+
+/// @note: for backwards compatibility
+aggregate_of_instance::ptr IfcFile::traverse_breadth_first(IfcUtil::IfcBaseClass* instance, int max_level) {
+    return IfcParse::traverse_breadth_first(instance, max_level);
+}
@@ -93,6 +93,13 @@ void aggregate_of_instance::remove(IfcUtil::IfcBaseClass* instance) {
     }
 }
 
+void aggregate_of_instance::remove(const std::set<IfcUtil::IfcBaseClass*>& instances) {
+    ls.erase(std::remove_if(ls.begin(), ls.end(), [&instances](IfcUtil::IfcBaseClass* instance) {
+                 return instances.find(instance) != instances.end();
+             }),
+             ls.end());
+}
+
 aggregate_of_instance::ptr aggregate_of_instance::filtered(const std::set<const IfcParse::declaration*>& entities) {
     aggregate_of_instance::ptr return_value(new aggregate_of_instance);
     for (it it = begin(); it != end(); ++it) {
@@ -128,8 +135,10 @@ Argument::operator bool() const { throw IfcParse::IfcException("Argument is not
 Argument::operator boost::logic::tribool() const { throw IfcParse::IfcException("Argument is not a logical"); }
 Argument::operator double() const { throw IfcParse::IfcException("Argument is not a number"); }
 Argument::operator std::string() const { throw IfcParse::IfcException("Argument is not a string"); }
+std::string_view Argument::interned_string() const { throw IfcParse::IfcException("Argument is not a string"); }
 Argument::operator boost::dynamic_bitset<>() const { throw IfcParse::IfcException("Argument is not a binary"); }
 Argument::operator IfcUtil::IfcBaseClass*() const { throw IfcParse::IfcException("Argument is not an entity instance"); }
+unsigned int Argument::reference_id() const { throw IfcParse::IfcException("Argument is not an entity instance"); }
 Argument::operator std::vector<double>() const { throw IfcParse::IfcException("Argument is not a list of floats"); }
 Argument::operator std::vector<int>() const { throw IfcParse::IfcException("Argument is not a list of ints"); }
 Argument::operator std::vector<std::string>() const { throw IfcParse::IfcException("Argument is not a list of strings"); }
@@ -201,7 +210,21 @@ void IfcUtil::unescape_xml(std::string& str) {
 }
 
 Argument* IfcUtil::IfcBaseEntity::get(const std::string& name) const {
-    return data().getArgument(declaration().attribute_index(name));
+    const ptrdiff_t index = declaration().attribute_index(name);
+    if (index == -1) {
+        throw IfcParse::IfcException(name + " not found on " + declaration().name());
+    }
+    return data().getArgument(index);
+}
+
+Argument* IfcUtil::IfcBaseEntity::get(const IfcParse::attribute_handle& attr) const {
+    const IfcParse::entity* decl = &declaration();
+    while (decl != attr.entity_reference) {
+        if ((decl = decl->supertype()) == nullptr) {
+            throw IfcParse::IfcException(declaration().name() + " is not a subtype of " + attr.entity_reference->name());
+        }
+    }
+    return data().getArgument(attr.index);
 }
 
 aggregate_of_instance::ptr IfcUtil::IfcBaseEntity::get_inverse(const std::string& name) const {
@@ -22,8 +22,10 @@
 #include "IfcCharacterDecoder.h"
 #include "IfcFile.h"
 #include "IfcParse.h"
+#include "IfcWriteUtils.h"
 
 #include <boost/algorithm/string.hpp>
+#include <charconv>
 #include <iomanip>
 #include <limits>
 #include <locale>
@@ -75,25 +77,29 @@ class StringBuilderVisitor : public boost::static_visitor<void> {
     // the output of the C++ ostream formatting operation.
     // REAL = [ SIGN ] DIGIT { DIGIT } "." { DIGIT } [ "E" [ SIGN ] DIGIT { DIGIT } ] .
     std::string format_double(const double& d) {
+#ifdef __cpp_lib_to_chars
+        // Identical to the stream formatting below, i.e. %.15g, but locale-independent by definition
+        char buffer[32];
+        const std::string str(buffer, std::to_chars(buffer, buffer + sizeof(buffer), d, std::chars_format::general, std::numeric_limits<double>::digits10).ptr);
+#else
         std::ostringstream oss;
         oss.imbue(std::locale::classic());
         oss << std::setprecision(std::numeric_limits<double>::digits10) << d;
         const std::string str = oss.str();
-        oss.str("");
+#endif
         std::string::size_type e = str.find('e');
         if (e == std::string::npos) {
             e = str.find('E');
         }
-        const std::string mantissa = str.substr(0, e);
-        oss << mantissa;
-        if (mantissa.find('.') == std::string::npos) {
-            oss << ".";
+        std::string result = str.substr(0, e);
+        if (result.find('.') == std::string::npos) {
+            result += '.';
         }
         if (e != std::string::npos) {
-            oss << "E";
-            oss << str.substr(e + 1);
+            result += 'E';
+            result += str.substr(e + 1);
         }
-        return oss.str();
+        return result;
     }
 
     std::string format_binary(const boost::dynamic_bitset<>& b) {
@@ -259,7 +265,14 @@ IfcWriteArgument::operator std::string() const {
     }
     return as<std::string>();
 }
+std::string_view IfcWriteArgument::interned_string() const {
+    if (type() == IfcUtil::Argument_ENUMERATION) {
+        return as<EnumerationReference>().enumeration_value;
+    }
+    return as<std::string>();
+}
 IfcWriteArgument::operator IfcUtil::IfcBaseClass*() const { return as<IfcUtil::IfcBaseClass*>(); }
+unsigned int IfcWriteArgument::reference_id() const { return as<IfcUtil::IfcBaseClass*>()->data().id(); }
 IfcWriteArgument::operator boost::dynamic_bitset<>() const { return as<boost::dynamic_bitset<>>(); }
 IfcWriteArgument::operator std::vector<double>() const { return as<std::vector<double>>(); }
 IfcWriteArgument::operator std::vector<int>() const { return as<std::vector<int>>(); }
@@ -318,3 +331,59 @@ void IfcWriteArgument::set(IfcUtil::IfcBaseInterface* const& v) {
         container = boost::blank();
     }
 }
+
+bool IfcWrite::is_length_measure(const IfcParse::declaration& decl, size_t i, const IfcParse::declaration& length_measure) {
+    if (!decl.as_entity()) {
+        return false;
+    }
+    const IfcParse::parameter_type* pt = decl.as_entity()->attribute_by_index(i)->type_of_attribute();
+    while (pt->as_aggregation_type()) {
+        pt = pt->as_aggregation_type()->type_of_element();
+    }
+    return pt->as_named_type() && pt->as_named_type()->declared_type()->is(length_measure);
+}
+
+double IfcWrite::length_unit_conversion(IfcParse::IfcFile& to, IfcParse::IfcFile& from) {
+    std::pair<IfcUtil::IfcBaseClass*, double> to_unit = {nullptr, 1.0};
+    std::pair<IfcUtil::IfcBaseClass*, double> from_unit = {nullptr, 1.0};
+    try {
+        to_unit = to.getUnit("LENGTHUNIT");
+        from_unit = from.getUnit("LENGTHUNIT");
+    } catch (IfcParse::IfcException&) {
+    }
+    if (to_unit.first && from_unit.first) {
+        return from_unit.second / to_unit.second;
+    }
+    return 1.;
+}
+
+IfcWrite::IfcWriteArgument* IfcWrite::scaled_length(Argument* attr, IfcUtil::ArgumentType attr_type, double factor) {
+    IfcWrite::IfcWriteArgument* copy = nullptr;
+    if (attr_type == IfcUtil::Argument_DOUBLE) {
+        double v = *attr;
+        v *= factor;
+
+        copy = new IfcWrite::IfcWriteArgument();
+        copy->set(v);
+    } else if (attr_type == IfcUtil::Argument_AGGREGATE_OF_DOUBLE) {
+        std::vector<double> v = *attr;
+        for (std::vector<double>::iterator it = v.begin(); it != v.end(); ++it) {
+            (*it) *= factor;
+        }
+
+        copy = new IfcWrite::IfcWriteArgument();
+        copy->set(v);
+    } else if (attr_type == IfcUtil::Argument_AGGREGATE_OF_AGGREGATE_OF_DOUBLE) {
+        std::vector<std::vector<double>> v = *attr;
+        for (std::vector<std::vector<double>>::iterator it = v.begin(); it != v.end(); ++it) {
+            std::vector<double>& v2 = (*it);
+            for (std::vector<double>::iterator jt = v2.begin(); jt != v2.end(); ++jt) {
+                (*jt) *= factor;
+            }
+        }
+
+        copy = new IfcWrite::IfcWriteArgument();
+        copy->set(v);
+    }
+    return copy;
+}
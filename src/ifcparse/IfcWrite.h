@@ -149,8 +149,10 @@ class IFC_PARSE_API IfcWriteArgument : public Argument {
 
     operator double() const;
     operator std::string() const;
+    std::string_view interned_string() const;
     operator boost::dynamic_bitset<>() const;
     operator IfcUtil::IfcBaseClass*() const;
+    unsigned int reference_id() const;
 
     operator std::vector<int>() const;
     operator std::vector<double>() const;
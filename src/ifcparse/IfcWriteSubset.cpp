@@ -0,0 +1,190 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Writing of the instances that are referenced by a set of root instances
+// as a file of their own, renumbered in the order of their ids.
+
+#include "IfcFile.h"
+#include "IfcLogger.h"
+#include "IfcParallel.h"
+#include "IfcSpfStream.h"
+
+#include <algorithm>
+#include <array>
+#include <boost/lexical_cast.hpp>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace IfcParse;
+
+namespace {
+// Copies the instance text at p, up to and including the parenthesis that
+// closes its attributes, to out, replacing references #n outside of strings
+// and comments by #new_ids[n]. When n has no new id, the reference is dropped
+// from the aggregate that contains it, or written as $ with an error logged
+// when it is the value of an attribute. Returns the end of the copied text,
+// or nullptr when end is reached before that.
+const char* copy_renumbered(const char* p, const char* end, const std::vector<unsigned int>& new_ids, std::string& out) {
+    static const auto special = []() {
+        std::array<bool, 256> table{};
+        for (unsigned char c : std::string("'/#()")) {
+            table[c] = true;
+        }
+        return table;
+    }();
+    const char* copied = p;
+    int depth = 0;
+    while (p < end) {
+        while (p < end && !special[(unsigned char)*p]) {
+            ++p;
+        }
+        if (p == end) {
+            break;
+        }
+        const char c = *p;
+        if (c == '\'') {
+            // An escaped apostrophe is doubled, which closes and reopens the string
+            p = static_cast<const char*>(std::memchr(p + 1, '\'', end - p - 1));
+            if (p == nullptr) {
+                return nullptr;
+            }
+            ++p;
+        } else if (c == '/') {
+            if (p + 1 < end && p[1] == '*') {
+                p += 2;
+                while (p + 1 < end && !(p[0] == '*' && p[1] == '/')) {
+                    ++p;
+                }
+                if (p + 1 >= end) {
+                    return nullptr;
+                }
+            }
+            ++p;
+        } else if (c == '#') {
+            const char* digits = p + 1;
+            const char* digits_end = digits;
+            size_t id = 0;
+            while (digits_end < end && *digits_end >= '0' && *digits_end <= '9') {
+                // Once out of range, the id stays out of range without overflowing
+                if (id < new_ids.size()) {
+                    id = id * 10 + (*digits_end - '0');
+                }
+                ++digits_end;
+            }
+            if (digits_end == digits) {
+                ++p;
+                continue;
+            }
+            out.append(copied, p);
+            if (id < new_ids.size() && new_ids[id] != 0) {
+                char buffer[16];
+                out += '#';
+                out.append(buffer, std::to_chars(buffer, buffer + sizeof(buffer), new_ids[id]).ptr);
+            } else if (depth > 1) {
+                // Drops the element with the comma that precedes it, or the
+                // comma that follows it when it is the first element
+                while (is_separator(out.back())) {
+                    out.pop_back();
+                }
+                if (out.back() == ',') {
+                    out.pop_back();
+                } else {
+                    while (digits_end < end && is_separator(*digits_end)) {
+                        ++digits_end;
+                    }
+                    if (digits_end < end && *digits_end == ',') {
+                        ++digits_end;
+                        while (digits_end < end && is_separator(*digits_end)) {
+                            ++digits_end;
+                        }
+                    }
+                }
+            } else {
+                Logger::Error("Reference to " + std::string(p, digits_end) + " is not part of the subset and is written as $");
+                out += '$';
+            }
+            copied = p = digits_end;
+        } else {
+            ++p;
+            if (c == '(') {
+                ++depth;
+            } else if (--depth == 0) {
+                out.append(copied, p);
+                return p;
+            }
+        }
+    }
+    return nullptr;
+}
+} // namespace
+
+size_t IfcFile::write_subset(std::ostream& os, const std::vector<IfcUtil::IfcBaseClass*>& roots) const {
+    std::vector<IfcUtil::IfcBaseClass*> instances;
+    unsigned int max_id = 0;
+    IfcParse::traverse_breadth_first(roots, [this, &instances, &max_id](IfcUtil::IfcBaseClass* inst, int) {
+        const IfcEntityInstanceData& data = inst->data();
+        if (!inst->declaration().as_entity() || data.id() == 0) {
+            // Instances of simple types are written as part of the instance that refers to them
+            return;
+        }
+        if (data.file != this) {
+            throw IfcException("Instance #" + boost::lexical_cast<std::string>(data.id()) + " is not part of this file");
+        }
+        instances.push_back(inst);
+        max_id = (std::max)(max_id, data.id());
+    });
+
+    std::sort(instances.begin(), instances.end(), [](IfcUtil::IfcBaseClass* a, IfcUtil::IfcBaseClass* b) {
+        return a->data().id() < b->data().id();
+    });
+    std::vector<unsigned int> new_ids(instances.empty() ? 0 : (size_t)max_id + 1, 0);
+    for (size_t i = 0; i < instances.size(); ++i) {
+        new_ids[instances[i]->data().id()] = (unsigned int)i + 1;
+    }
+
+    header().write(os);
+
+    const char* buffer_end = stream && !from_snapshot_ ? stream->data_at(stream->size) : nullptr;
+    write_in_chunks(os, instances.size(), IfcFile::effective_num_threads(), [this, &instances, &new_ids, buffer_end](size_t i, std::string& buffer) {
+        const IfcEntityInstanceData& data = instances[i]->data();
+        if (buffer_end && data.offset_in_file() != 0 && !data.modified()) {
+            const size_t size = buffer.size();
+            char id[16];
+            buffer += '#';
+            buffer.append(id, std::to_chars(id, id + sizeof(id), i + 1).ptr);
+            buffer += '=';
+            if (copy_renumbered(stream->data_at(data.offset_in_file()), buffer_end, new_ids, buffer)) {
+                buffer += ";\n";
+                return;
+            }
+            buffer.resize(size);
+        }
+        std::string formatted;
+        data.write(formatted, true);
+        copy_renumbered(formatted.data(), formatted.data() + formatted.size(), new_ids, buffer);
+        buffer += ";\n";
+    });
+
+    os << "ENDSEC;\n";
+    os << "END-ISO-10303-21;" << std::endl;
+
+    return instances.size();
+}
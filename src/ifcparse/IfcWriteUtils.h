@@ -0,0 +1,104 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#ifndef IFCWRITEUTILS_H
+#define IFCWRITEUTILS_H
+
+// Helpers for copying and rewriting the attribute values of instances, used
+// by IfcFile::addEntity(), IfcFile::append() and IfcFile::merge_duplicates().
+
+#include "IfcWrite.h"
+
+#include <vector>
+
+namespace IfcParse {
+class IfcFile;
+}
+
+namespace IfcWrite {
+
+/// The argument type as which attribute i of decl is copied by setArgument()
+IfcUtil::ArgumentType get_argument_type(const IfcParse::declaration* decl, size_t i);
+
+/// Whether attribute i of decl, or the elements of it when it is an
+/// aggregate, are of type length_measure
+bool is_length_measure(const IfcParse::declaration& decl, size_t i, const IfcParse::declaration& length_measure);
+
+/// The factor by which lengths in from are multiplied to express them in the
+/// length unit of to, 1 when either has no length unit
+double length_unit_conversion(IfcParse::IfcFile& to, IfcParse::IfcFile& from);
+
+/// Returns a copy of the numbers in a length measure attribute multiplied by
+/// factor, or nullptr when it does not hold numbers
+IfcWriteArgument* scaled_length(Argument* attr, IfcUtil::ArgumentType attr_type, double factor);
+
+/// Returns a copy of attribute in which every instance is replaced by
+/// replace(instance), or nullptr when that does not change any of them.
+template <typename Fn>
+IfcWriteArgument* replace_instances(Argument* attribute, Fn&& replace) {
+    IfcWriteArgument* copy = nullptr;
+    switch (attribute->type()) {
+    case IfcUtil::Argument_ENTITY_INSTANCE: {
+        IfcUtil::IfcBaseClass* instance = *attribute;
+        IfcUtil::IfcBaseClass* replacement = replace(instance);
+        if (replacement != instance) {
+            copy = new IfcWriteArgument();
+            copy->set(replacement);
+        }
+    } break;
+    case IfcUtil::Argument_AGGREGATE_OF_ENTITY_INSTANCE: {
+        aggregate_of_instance::ptr instances = *attribute;
+        aggregate_of_instance::ptr mapped_instances(new aggregate_of_instance);
+        bool any = false;
+        for (aggregate_of_instance::it it = instances->begin(); it != instances->end(); ++it) {
+            IfcUtil::IfcBaseClass* replacement = replace(*it);
+            mapped_instances->push(replacement);
+            any = any || replacement != *it;
+        }
+        if (any) {
+            copy = new IfcWriteArgument();
+            copy->set(mapped_instances);
+        }
+    } break;
+    case IfcUtil::Argument_AGGREGATE_OF_AGGREGATE_OF_ENTITY_INSTANCE: {
+        aggregate_of_aggregate_of_instance::ptr instances = *attribute;
+        aggregate_of_aggregate_of_instance::ptr mapped_instances(new aggregate_of_aggregate_of_instance);
+        bool any = false;
+        for (aggregate_of_aggregate_of_instance::outer_it it = instances->begin(); it != instances->end(); ++it) {
+            std::vector<IfcUtil::IfcBaseClass*> inner;
+            for (aggregate_of_aggregate_of_instance::inner_it jt = it->begin(); jt != it->end(); ++jt) {
+                inner.push_back(replace(*jt));
+                any = any || inner.back() != *jt;
+            }
+            mapped_instances->push(inner);
+        }
+        if (any) {
+            copy = new IfcWriteArgument();
+            copy->set(mapped_instances);
+        }
+    } break;
+    default:
+        break;
+    }
+    return copy;
+}
+
+} // namespace IfcWrite
+
+#endif
@@ -22,8 +22,11 @@
 
 #include "IfcBaseClass.h"
 
+#include <algorithm>
 #include <boost/shared_ptr.hpp>
+#include <iterator>
 #include <set>
+#include <type_traits>
 
 template <class T>
 class aggregate_of;
@@ -53,6 +56,8 @@ class IFC_PARSE_API aggregate_of_instance {
         return r;
     }
     void remove(IfcUtil::IfcBaseClass*);
+    /// Removes all occurrences of the instances in a single pass
+    void remove(const std::set<IfcUtil::IfcBaseClass*>& instances);
     aggregate_of_instance::ptr filtered(const std::set<const IfcParse::declaration*>& entities);
     aggregate_of_instance::ptr unique();
 };
@@ -79,6 +84,7 @@ class aggregate_of {
     it begin() { return ls.begin(); }
     it end() { return ls.end(); }
     unsigned int size() const { return (unsigned int)ls.size(); }
+    void reserve(unsigned capacity) { ls.reserve(capacity); }
     aggregate_of_instance::ptr generalize() {
         aggregate_of_instance::ptr r(new aggregate_of_instance());
         for (it i = begin(); i != end(); ++i) {
@@ -106,6 +112,160 @@ class aggregate_of {
     }
 };
 
+/// A concatenation of lists of instances that is iterated without copying
+/// the lists, such as the lists by exact type of an entity and its subtypes
+/// that make up the instances of that entity in an IfcFile. Iteration visits
+/// the lists one after the other, so the instances are grouped by list
+/// rather than in file order, see flatten(). Like iterators
+/// of the lists, the range is invalidated when instances are added to or
+/// removed from them.
+class joined_instance_range {
+    std::vector<aggregate_of_instance::ptr> lists_;
+    size_t size_ = 0;
+
+  public:
+    class iterator {
+        const std::vector<aggregate_of_instance::ptr>* lists_ = nullptr;
+        size_t list_ = 0;
+        aggregate_of_instance::it it_{};
+
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef IfcUtil::IfcBaseClass* value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef IfcUtil::IfcBaseClass* const* pointer;
+        typedef IfcUtil::IfcBaseClass* reference;
+
+        iterator() {}
+        iterator(const std::vector<aggregate_of_instance::ptr>* lists, size_t list)
+            : lists_(lists),
+              list_(list) {
+            if (list_ < lists_->size()) {
+                it_ = (*lists_)[list_]->begin();
+            }
+        }
+
+        IfcUtil::IfcBaseClass* operator*() const { return *it_; }
+
+        iterator& operator++() {
+            // Lists are never empty, so the next list starts at a valid element
+            if (++it_ == (*lists_)[list_]->end() && ++list_ < lists_->size()) {
+                it_ = (*lists_)[list_]->begin();
+            }
+            return *this;
+        }
+        iterator operator++(int) {
+            iterator tmp(*this);
+            ++*this;
+            return tmp;
+        }
+
+        bool operator==(const iterator& other) const {
+            return list_ == other.list_ && (lists_ == nullptr || list_ == lists_->size() || it_ == other.it_);
+        }
+        bool operator!=(const iterator& other) const { return !(*this == other); }
+    };
+
+    /// Appends the instances of a list to the range, null and empty lists are ignored
+    void push(const aggregate_of_instance::ptr& list) {
+        if (list && list->size()) {
+            lists_.push_back(list);
+            size_ += list->size();
+        }
+    }
+
+    iterator begin() const { return iterator(&lists_, 0); }
+    iterator end() const { return iterator(&lists_, lists_.size()); }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    /// Copies the instances into a single list in file order, null when the
+    /// range is empty. The lists are each in file order, so they are merged
+    /// by instance id rather than concatenated as the iterators do.
+    aggregate_of_instance::ptr flatten() const {
+        if (lists_.empty()) {
+            return aggregate_of_instance::ptr();
+        }
+        if (lists_.size() == 1) {
+            return lists_.front();
+        }
+
+        typedef std::pair<aggregate_of_instance::it, aggregate_of_instance::it> cursor;
+        auto later = [](const cursor& a, const cursor& b) {
+            return (*a.first)->data().id() > (*b.first)->data().id();
+        };
+        std::vector<cursor> heap;
+        heap.reserve(lists_.size());
+        for (auto& l : lists_) {
+            heap.emplace_back(l->begin(), l->end());
+        }
+        std::make_heap(heap.begin(), heap.end(), later);
+
+        aggregate_of_instance::ptr r(new aggregate_of_instance);
+        r->reserve((unsigned)size_);
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            cursor& c = heap.back();
+            r->push(*c.first);
+            if (++c.first == c.second) {
+                heap.pop_back();
+            } else {
+                std::push_heap(heap.begin(), heap.end(), later);
+            }
+        }
+        return r;
+    }
+};
+
+/// A view of instances that are all known to be instances of entity T or
+/// its subtypes, such as the instances by type of an IfcFile. Elements are
+/// cast to T on access, rather than copied into an aggregate_of<T> after
+/// checking their type. The view shares the lists of the file and is
+/// invalidated, like their iterators, when instances are added or removed.
+template <class T>
+class typed_instance_view {
+    static_assert(std::is_base_of<IfcUtil::IfcBaseEntity, T>::value, "Views are only provided for entity types");
+
+    joined_instance_range range_;
+
+  public:
+    class iterator {
+        joined_instance_range::iterator it_;
+
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T* value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef T* const* pointer;
+        typedef T* reference;
+
+        iterator()
+            : it_() {}
+        explicit iterator(joined_instance_range::iterator it)
+            : it_(it) {}
+
+        T* operator*() const { return static_cast<T*>(*it_); }
+
+        iterator& operator++() {
+            ++it_;
+            return *this;
+        }
+        iterator operator++(int) { return iterator(it_++); }
+
+        bool operator==(const iterator& other) const { return it_ == other.it_; }
+        bool operator!=(const iterator& other) const { return it_ != other.it_; }
+    };
+
+    typed_instance_view() {}
+    explicit typed_instance_view(const joined_instance_range& range)
+        : range_(range) {}
+
+    iterator begin() const { return iterator(range_.begin()); }
+    iterator end() const { return iterator(range_.end()); }
+    size_t size() const { return range_.size(); }
+    bool empty() const { return range_.empty(); }
+};
+
 template <class T>
 class aggregate_of_aggregate_of;
 
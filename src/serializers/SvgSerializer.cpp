@@ -2106,10 +2106,10 @@ void SvgSerializer::finalize() {
 			addTextAnnotations({ nullptr, drawing_name });
 
 			if (file && storey_height_display_ != SH_NONE && pln && std::abs(pln->Position().Direction().Z()) < 1.e-5) {
-				auto storeys = file->instances_by_type("IfcBuildingStorey");
-				if (storeys) {
+				auto storeys = file->instances_by_type_range(file->schema()->declaration_by_name("IfcBuildingStorey"));
+				if (!storeys.empty()) {
 					const double lu = file->getUnit("LENGTHUNIT").second;
-					for (auto& s : *storeys) {
+					for (auto* s : storeys) {
 						auto storey = (IfcUtil::IfcBaseEntity*) s;
 						auto a = storey->get("Elevation");
 						if (!a->isNull()) {
@@ -2338,8 +2338,7 @@ std::string SvgSerializer::nameElement(const IfcUtil::IfcBaseEntity* elem) {
 void SvgSerializer::setFile(IfcParse::IfcFile* f) {
 	file = f;
 
-	auto storeys = f->instances_by_type("IfcBuildingStorey");
-	if (!storeys || storeys->size() == 0) {
+	if (f->instances_by_type_range(f->schema()->declaration_by_name("IfcBuildingStorey")).empty()) {
 		auto mapping = ifcopenshell::geometry::impl::mapping_implementations().construct(file, settings_);
 
 		std::vector<const IfcParse::declaration*> to_derive_from;
@@ -2386,10 +2385,10 @@ void SvgSerializer::setSectionHeightsFromStoreys(double offset) {
 	}
 	with_section_heights_from_storey_ = true;
 	section_data_.emplace();
-	auto storeys = file->instances_by_type("IfcBuildingStorey");
+	auto storeys = file->instances_by_type_range(file->schema()->declaration_by_name("IfcBuildingStorey"));
 	const double lu = file->getUnit("LENGTHUNIT").second;
-	if (storeys && storeys->size() > 0) {
-		for (auto& s : *storeys) {
+	if (!storeys.empty()) {
+		for (auto* s : storeys) {
 			auto attr_value = ((IfcUtil::IfcBaseEntity*)s)->get("Elevation");
 			if (!attr_value->isNull()) {
 				double elev;
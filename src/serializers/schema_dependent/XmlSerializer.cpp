@@ -607,9 +607,7 @@ void POSTFIX_SCHEMA(XmlSerializer)::finalize() {
 	descend(mapping_, project, decomposition);
 
 	// Write all property sets and values as XML nodes.
-	IfcSchema::IfcPropertySet::list::ptr psets = file->instances_by_type<IfcSchema::IfcPropertySet>();
-	for (IfcSchema::IfcPropertySet::list::it it = psets->begin(); it != psets->end(); ++it) {
-		IfcSchema::IfcPropertySet* pset = *it;
+	for (IfcSchema::IfcPropertySet* pset : file->instances_by_type_view<IfcSchema::IfcPropertySet>()) {
 		ptree* node = format_entity_instance(mapping_, pset, properties);
 		if (node) {
 			format_properties(mapping_, pset->HasProperties(), *node);
@@ -617,10 +615,9 @@ void POSTFIX_SCHEMA(XmlSerializer)::finalize() {
 	}
 
 	// Write all group sets and values as XML nodes.
-	IfcSchema::IfcGroup::list::ptr gsets = file->instances_by_type<IfcSchema::IfcGroup>();
 	std::set<std::string> notRootGroups; //selfname, fathername
-	for (IfcSchema::IfcGroup::list::it it = gsets->begin(); it != gsets->end(); ++it) {
-		writeGroupToNode(mapping_, *it, groups, notRootGroups);
+	for (IfcSchema::IfcGroup* group : file->instances_by_type_view<IfcSchema::IfcGroup>()) {
+		writeGroupToNode(mapping_, group, groups, notRootGroups);
 	}
 	for (auto it = groups.begin(); it != groups.end();) {
 		if (notRootGroups.find(it->second.get<std::string>("<xmlattr>.Name")) != notRootGroups.end()) {
@@ -631,9 +628,7 @@ void POSTFIX_SCHEMA(XmlSerializer)::finalize() {
 	}
 
 	// Write all quantities and values as XML nodes.
-	IfcSchema::IfcElementQuantity::list::ptr qtosets = file->instances_by_type<IfcSchema::IfcElementQuantity>();
-	for (IfcSchema::IfcElementQuantity::list::it it = qtosets->begin(); it != qtosets->end(); ++it) {
-		IfcSchema::IfcElementQuantity* qto = *it;
+	for (IfcSchema::IfcElementQuantity* qto : file->instances_by_type_view<IfcSchema::IfcElementQuantity>()) {
 		ptree* node = format_entity_instance(mapping_, qto, quantities);
 		if (node) {
 			format_quantities(mapping_, qto->Quantities(), *node);
@@ -642,9 +637,7 @@ void POSTFIX_SCHEMA(XmlSerializer)::finalize() {
 
 	// Write all work schedules and values as XML nodes.
 	ptree pwork_schedules;
-	IfcSchema::IfcWorkSchedule::list::ptr pschedules = file->instances_by_type<IfcSchema::IfcWorkSchedule>();
-	for (IfcSchema::IfcWorkSchedule::list::it it = pschedules->begin(); it != pschedules->end(); ++it) {
-		IfcSchema::IfcWorkSchedule* schedule = *it;
+	for (IfcSchema::IfcWorkSchedule* schedule : file->instances_by_type_view<IfcSchema::IfcWorkSchedule>()) {
 		ptree* nschedule = format_entity_instance(mapping_, schedule, pwork_schedules);
 		
 		if(nschedule) {
@@ -668,9 +661,7 @@ void POSTFIX_SCHEMA(XmlSerializer)::finalize() {
 
 	// Write all work plans and values as XML nodes.
 	ptree pwork_plans;
-	IfcSchema::IfcWorkPlan::list::ptr pplans = file->instances_by_type<IfcSchema::IfcWorkPlan>();
-	for (IfcSchema::IfcWorkPlan::list::it it = pplans->begin(); it != pplans->end(); ++it) {
-		IfcSchema::IfcWorkPlan* plan = *it;
+	for (IfcSchema::IfcWorkPlan* plan : file->instances_by_type_view<IfcSchema::IfcWorkPlan>()) {
 		ptree* nschedule = format_entity_instance(mapping_, plan, pwork_plans);
 
 		if (nschedule) {
@@ -694,9 +685,7 @@ void POSTFIX_SCHEMA(XmlSerializer)::finalize() {
 	
 	// Write all work calendars and values as XML nodes.
 #ifdef SCHEMA_HAS_IfcWorkCalendar
-	IfcSchema::IfcWorkCalendar::list::ptr pcalendars = file->instances_by_type<IfcSchema::IfcWorkCalendar>();
-	for (IfcSchema::IfcWorkCalendar::list::it it = pcalendars->begin(); it != pcalendars->end(); ++it) {
-		IfcSchema::IfcWorkCalendar* calendar = *it;
+	for (IfcSchema::IfcWorkCalendar* calendar : file->instances_by_type_view<IfcSchema::IfcWorkCalendar>()) {
 		ptree* ncalendar = format_entity_instance(mapping_, calendar, calendars);
 		
 		if (ncalendar) {
@@ -712,10 +701,7 @@ void POSTFIX_SCHEMA(XmlSerializer)::finalize() {
 	}
 #endif
 	
-	IfcSchema::IfcRelConnectsElements::list::ptr pconnections = file->instances_by_type<IfcSchema::IfcRelConnectsElements>();
-	for (IfcSchema::IfcRelConnectsElements::list::it it = pconnections->begin(); it != pconnections->end(); ++it) {
-		IfcSchema::IfcRelConnectsElements* connection = *it;
-
+	for (IfcSchema::IfcRelConnectsElements* connection : file->instances_by_type_view<IfcSchema::IfcRelConnectsElements>()) {
 		ptree* nconnection = format_entity_instance(mapping_, connection, connections);
 
 		ptree nrelatedElement;
@@ -729,9 +715,7 @@ void POSTFIX_SCHEMA(XmlSerializer)::finalize() {
 	}
 
 	// Write all type objects as XML nodes.
-	IfcSchema::IfcTypeObject::list::ptr type_objects = file->instances_by_type<IfcSchema::IfcTypeObject>();
-	for (IfcSchema::IfcTypeObject::list::it it = type_objects->begin(); it != type_objects->end(); ++it) {
-		IfcSchema::IfcTypeObject* type_object = *it;
+	for (IfcSchema::IfcTypeObject* type_object : file->instances_by_type_view<IfcSchema::IfcTypeObject>()) {
 		ptree* node = descend(mapping_, type_object, types);
 		
 		if (node && type_object->HasPropertySets()) {
@@ -774,10 +758,9 @@ void POSTFIX_SCHEMA(XmlSerializer)::finalize() {
         }
     }
 
-	IfcSchema::IfcRelAssociatesMaterial::list::ptr materal_associations = file->instances_by_type<IfcSchema::IfcRelAssociatesMaterial>();
 	std::set<IfcSchema::IfcMaterialSelect*> emitted_materials;
-	for (IfcSchema::IfcRelAssociatesMaterial::list::it it = materal_associations->begin(); it != materal_associations->end(); ++it) {
-		IfcSchema::IfcMaterialSelect* mat = (**it).RelatingMaterial();
+	for (IfcSchema::IfcRelAssociatesMaterial* association : file->instances_by_type_view<IfcSchema::IfcRelAssociatesMaterial>()) {
+		IfcSchema::IfcMaterialSelect* mat = association->RelatingMaterial();
 		if (emitted_materials.find(mat) == emitted_materials.end()) {
 			emitted_materials.insert(mat);
 			ptree node;
@@ -0,0 +1,141 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks IfcFile::append() on files with different length units, and on
+// files that share their owner history, units and representation context,
+// both with the inverse maps and with the compact inverse index.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+// A file with an owner history, units and a representation context that are
+// the same in all files, apart from the prefix of the length unit
+std::string file_contents(const std::string& length_prefix, const std::string& project, const std::string& coordinates) {
+    return TEST_IFC4_HEADER
+           "#1=IFCPERSON($,'Doe','John',$,$,$,$,$);\n"
+           "#2=IFCORGANIZATION($,'Org',$,$,$);\n"
+           "#3=IFCPERSONANDORGANIZATION(#1,#2,$);\n"
+           "#4=IFCAPPLICATION(#2,'1.0','App','App');\n"
+           "#5=IFCOWNERHISTORY(#3,#4,$,.ADDED.,$,$,$,1700000000);\n"
+           "#6=IFCSIUNIT(*,.LENGTHUNIT.," +
+           length_prefix +
+           ",.METRE.);\n"
+           "#7=IFCSIUNIT(*,.PLANEANGLEUNIT.,$,.RADIAN.);\n"
+           "#8=IFCUNITASSIGNMENT((#6,#7));\n"
+           "#9=IFCCARTESIANPOINT((0.,0.,0.));\n"
+           "#10=IFCAXIS2PLACEMENT3D(#9,$,$);\n"
+           "#11=IFCGEOMETRICREPRESENTATIONCONTEXT($,'Model',3,1.E-05,#10,$);\n"
+           "#12=" +
+           project +
+           ";\n"
+           "#13=IFCCARTESIANPOINT((" +
+           coordinates +
+           "));\n"
+           "#14=IFCPOLYLINE((#9,#13));\n"
+           TEST_IFC_FOOTER;
+}
+
+const std::string project_a = "IFCPROJECT('0YvctVUKr0kugbFTf53O9L',#5,'A',$,$,$,$,(#11),#8)";
+const std::string project_b = "IFCPROJECT('2O2Fr$t4X7Zf8NOew3FLOH',#5,'B',$,$,$,$,(#11),#8)";
+
+std::string instance_text(IfcParse::IfcFile& file, unsigned int id) {
+    return file.instance_by_id(id)->data().toString(true);
+}
+
+// Appends a file in metres to one in millimetres
+void check_different_units(bool unify_resources) {
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(file_contents(".MILLI.", project_a, "1000.,2000.,0.")));
+    std::unique_ptr<IfcParse::IfcFile> other(test_utils::open_buffer(file_contents("$", project_b, "1.,2.,0.")));
+    CHECK(file->good() && other->good());
+
+    // The owner history and context are the same, but the unit assignment differs
+    const size_t appended = file->append(*other, unify_resources);
+    CHECK_EQUAL(appended, unify_resources ? (size_t)6 : (size_t)14);
+    CHECK_EQUAL(test_utils::ids_of(*file).size(), 14 + appended);
+    CHECK_EQUAL(file->getMaxId(), (unsigned int)28);
+
+    // Copies have their id in other offset by 14, lengths are converted to millimetres
+    const std::vector<double> coordinates = *file->instance_by_id(27)->data().getArgument(0);
+    CHECK((coordinates == std::vector<double>{1000., 2000., 0.}));
+    CHECK_EQUAL(instance_text(*file, 20), "#20=IFCSIUNIT(*,.LENGTHUNIT.,$,.METRE.)");
+    CHECK_EQUAL(instance_text(*file, 21), "#21=IFCSIUNIT(*,.PLANEANGLEUNIT.,$,.RADIAN.)");
+    CHECK_EQUAL(instance_text(*file, 22), "#22=IFCUNITASSIGNMENT((#20,#21))");
+
+    const IfcParse::schema_definition* schema = file->schema();
+    const IfcParse::declaration* polyline = schema->declaration_by_name("IfcPolyline");
+    const IfcParse::declaration* project = schema->declaration_by_name("IfcProject");
+    if (unify_resources) {
+        CHECK(test_utils::ids_of(*file).count(15) == 0);
+        CHECK_EQUAL(instance_text(*file, 26), "#26=IFCPROJECT('2O2Fr$t4X7Zf8NOew3FLOH',#5,'B',$,$,$,$,(#11),#22)");
+        CHECK_EQUAL(instance_text(*file, 28), "#28=IFCPOLYLINE((#9,#27))");
+        CHECK((test_utils::ids_of(file->getInverse(9, polyline, 0)) == std::set<unsigned int>{14, 28}));
+        CHECK((test_utils::ids_of(file->getInverse(5, project, 1)) == std::set<unsigned int>{12, 26}));
+        CHECK((test_utils::ids_of(file->instances_by_reference(11)) == std::set<unsigned int>{12, 26}));
+    } else {
+        CHECK_EQUAL(instance_text(*file, 26), "#26=IFCPROJECT('2O2Fr$t4X7Zf8NOew3FLOH',#19,'B',$,$,$,$,(#25),#22)");
+        CHECK_EQUAL(instance_text(*file, 28), "#28=IFCPOLYLINE((#23,#27))");
+        CHECK((test_utils::ids_of(file->getInverse(9, polyline, 0)) == std::set<unsigned int>{14}));
+        CHECK((test_utils::ids_of(file->getInverse(23, polyline, 0)) == std::set<unsigned int>{28}));
+        CHECK((test_utils::ids_of(file->getInverse(19, project, 1)) == std::set<unsigned int>{26}));
+    }
+    CHECK((test_utils::ids_of(file->getInverse(27, polyline, 0)) == std::set<unsigned int>{28}));
+    CHECK((test_utils::ids_of(file->getInverse(22, project, -1)) == std::set<unsigned int>{26}));
+    CHECK_EQUAL(file->getTotalInverses(20), 1);
+    CHECK((test_utils::ids_of(file->instance_by_id(13)->data().getInverse(polyline, 0)) == std::set<unsigned int>{14}));
+}
+
+// Appends a file that also has the same units
+void check_same_units() {
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(file_contents(".MILLI.", project_a, "1000.,2000.,0.")));
+    std::unique_ptr<IfcParse::IfcFile> other(test_utils::open_buffer(file_contents(".MILLI.", project_b, "1000.,0.,0.")));
+    CHECK(file->good() && other->good());
+
+    // Only the project and the polyline with its point are copied
+    CHECK_EQUAL(file->append(*other, true), (size_t)3);
+    CHECK_EQUAL(test_utils::ids_of(*file).size(), (size_t)17);
+    CHECK_EQUAL(file->getMaxId(), (unsigned int)28);
+
+    const std::vector<double> coordinates = *file->instance_by_id(27)->data().getArgument(0);
+    CHECK((coordinates == std::vector<double>{1000., 0., 0.}));
+    CHECK_EQUAL(instance_text(*file, 26), "#26=IFCPROJECT('2O2Fr$t4X7Zf8NOew3FLOH',#5,'B',$,$,$,$,(#11),#8)");
+
+    const IfcParse::declaration* project = file->schema()->declaration_by_name("IfcProject");
+    CHECK((test_utils::ids_of(file->getInverse(8, project, -1)) == std::set<unsigned int>{12, 26}));
+    CHECK((test_utils::ids_of(file->instances_by_reference(6)) == std::set<unsigned int>{8}));
+    CHECK_EQUAL(file->getTotalInverses(9), 3);
+}
+} // namespace
+
+int main() {
+    for (bool compact : {false, true}) {
+        IfcParse::IfcFile::compact_inverses(compact);
+        check_different_units(true);
+        check_different_units(false);
+        check_same_units();
+    }
+    IfcParse::IfcFile::compact_inverses(false);
+
+    return test_utils::report("append");
+}
@@ -0,0 +1,205 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks the arena of a file: alignment, rewinding to a marker, blocks of
+// their own for oversized allocations, concurrent allocation, deleting
+// arena_allocated objects from the heap and from an arena, argument arrays,
+// and that the views of a string_pool stay valid while it grows.
+
+#include "../src/ifcparse/IfcArena.h"
+#include "test_utils.h"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+const size_t block_size = 1024;
+
+bool aligned(const void* p) {
+    return reinterpret_cast<uintptr_t>(p) % IfcParse::arena::alignment == 0;
+}
+
+int destructed = 0;
+
+struct allocated : public IfcParse::arena_allocated {
+    char data[24];
+    explicit allocated(bool fail = false) {
+        std::memset(data, 0xAB, sizeof(data));
+        if (fail) {
+            throw std::runtime_error("constructor failed");
+        }
+    }
+    ~allocated() { ++destructed; }
+};
+
+void test_allocate_and_rewind() {
+    IfcParse::arena a(block_size);
+    CHECK_EQUAL(a.capacity(), (size_t)0);
+
+    const IfcParse::arena::marker empty = a.mark();
+    char* first = static_cast<char*>(a.allocate(3));
+    char* second = static_cast<char*>(a.allocate(5));
+    CHECK(aligned(first) && aligned(second));
+    CHECK_EQUAL(second - first, (std::ptrdiff_t)IfcParse::arena::alignment);
+    CHECK_EQUAL(a.capacity(), block_size);
+
+    // Allocations after the marker span several blocks and are released by rewinding
+    const IfcParse::arena::marker m = a.mark();
+    char* after_mark = static_cast<char*>(a.allocate(16));
+    for (int i = 0; i < 100; ++i) {
+        std::memset(a.allocate(200), i, 200);
+    }
+    CHECK(a.capacity() > 10 * block_size);
+    a.rewind(m);
+    CHECK_EQUAL(a.capacity(), block_size);
+    CHECK(a.allocate(16) == after_mark);
+
+    // Rewinding to before the first allocation keeps a block for reuse
+    a.rewind(empty);
+    CHECK_EQUAL(a.capacity(), block_size);
+    CHECK(aligned(a.allocate(1)));
+}
+
+void test_oversized() {
+    IfcParse::arena a(block_size);
+    char* small = static_cast<char*>(a.allocate(8));
+
+    // Allocations larger than a quarter of a block get a block of their own,
+    // the current block is used for the next small allocation
+    const IfcParse::arena::marker m = a.mark();
+    char* large = static_cast<char*>(a.allocate(block_size * 3 + 1));
+    CHECK(aligned(large));
+    std::memset(large, 1, block_size * 3 + 1);
+    CHECK_EQUAL(a.capacity(), block_size + block_size * 3 + IfcParse::arena::alignment);
+    CHECK_EQUAL(static_cast<char*>(a.allocate(8)) - small, (std::ptrdiff_t)8);
+
+    a.rewind(m);
+    CHECK_EQUAL(a.capacity(), block_size);
+}
+
+void test_concurrent_allocation() {
+    IfcParse::arena a(block_size);
+    const int n_threads = 4, n_allocations = 20000;
+    std::vector<std::vector<char*>> allocations(n_threads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&a, &allocations, t]() {
+            for (int i = 0; i < n_allocations; ++i) {
+                char* p = static_cast<char*>(a.allocate(1 + (i % 40)));
+                std::memset(p, t, 1 + (i % 40));
+                allocations[t].push_back(p);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // Every allocation still holds what its thread wrote, so none overlap
+    bool intact = true;
+    for (int t = 0; t < n_threads; ++t) {
+        for (int i = 0; i < n_allocations; ++i) {
+            for (int j = 0; j < 1 + (i % 40); ++j) {
+                intact = intact && allocations[t][i][j] == (char)t && aligned(allocations[t][i]);
+            }
+        }
+    }
+    CHECK(intact);
+}
+
+void test_arena_allocated() {
+    IfcParse::arena a(block_size);
+    destructed = 0;
+
+    allocated* on_heap = new allocated;
+    allocated* in_arena = new (a) allocated;
+    CHECK(aligned(on_heap) && aligned(in_arena));
+    CHECK_EQUAL(a.capacity(), block_size);
+
+    // Both run their destructor, only the heap object returns its memory
+    delete on_heap;
+    delete in_arena;
+    CHECK_EQUAL(destructed, 2);
+
+    // A throwing constructor releases the memory through the matching operator delete
+    int thrown = 0;
+    for (IfcParse::arena* owner : {(IfcParse::arena*)nullptr, &a}) {
+        try {
+            allocated* never = owner ? new (*owner) allocated(true) : new allocated(true);
+            delete never;
+        } catch (const std::runtime_error&) {
+            ++thrown;
+        }
+    }
+    CHECK_EQUAL(thrown, 2);
+    CHECK_EQUAL(destructed, 2);
+
+    for (IfcParse::arena* owner : {(IfcParse::arena*)nullptr, &a}) {
+        Argument** arguments = IfcParse::allocate_argument_array(5, owner);
+        CHECK(aligned(arguments));
+        bool zeroed = true;
+        for (int i = 0; i < 5; ++i) {
+            zeroed = zeroed && arguments[i] == nullptr;
+        }
+        CHECK(zeroed);
+        IfcParse::free_argument_array(arguments);
+    }
+}
+
+void test_string_pool() {
+    IfcParse::string_pool pool;
+    CHECK(pool.intern("").empty());
+    CHECK_EQUAL(pool.size(), (size_t)0);
+
+    // Strings that only differ after the first eight characters are distinct
+    const std::string_view a = pool.intern("IFCCARTESIANPOINT");
+    const std::string_view b = pool.intern("IFCCARTESIANPOINTLIST");
+    CHECK(a == "IFCCARTESIANPOINT" && b == "IFCCARTESIANPOINTLIST");
+    CHECK(a.data() != b.data());
+
+    // Many more strings than the initial table holds, interned twice
+    std::vector<std::string_view> views;
+    for (int i = 0; i < 5000; ++i) {
+        views.push_back(pool.intern("Name " + std::to_string(i)));
+    }
+    CHECK_EQUAL(pool.size(), (size_t)5002);
+    bool stable = true;
+    for (int i = 0; i < 5000; ++i) {
+        const std::string s = "Name " + std::to_string(i);
+        const std::string_view again = pool.intern(s);
+        stable = stable && again.data() == views[i].data() && views[i] == s;
+    }
+    CHECK(stable);
+    CHECK(pool.intern(std::string("IFCCARTESIANPOINT")).data() == a.data());
+    CHECK_EQUAL(pool.size(), (size_t)5002);
+}
+} // namespace
+
+int main() {
+    test_allocate_and_rewind();
+    test_oversized();
+    test_concurrent_allocation();
+    test_arena_allocated();
+    test_string_pool();
+    return test_utils::report("arena");
+}
@@ -0,0 +1,106 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks access to attributes by name and by handle: a handle resolved on a
+// supertype reads the attribute of instances of its subtypes, and is
+// rejected on instances of unrelated entities, unknown names throw, and a
+// name that a subtype declares again resolves to the most derived entity.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <memory>
+#include <string>
+
+namespace {
+const char* file_contents =
+    TEST_IFC4_HEADER
+    "#1=IFCCARTESIANPOINT((1.,2.,3.));\n"
+    "#2=IFCWALL('0u4wgLe6n0ABVaiXyikbkA',$,'Wall',$,$,$,$,$,$);\n"
+    "#3=IFCPROPERTYSET('2O2Fr$t4X7Zf8NOew3FLOH',$,'Pset',$,(#4));\n"
+    "#4=IFCPROPERTYSINGLEVALUE('Width',$,IFCLENGTHMEASURE(2.),$);\n"
+    TEST_IFC_FOOTER;
+
+template <typename Fn>
+bool throws(Fn fn) {
+    try {
+        fn();
+    } catch (const IfcParse::IfcException&) {
+        return true;
+    }
+    return false;
+}
+
+// A schema in which Derived declares the Name attribute of Base again
+const IfcParse::schema_definition* redeclaring_schema() {
+    using namespace IfcParse;
+    entity* base = new entity("Base", false, 0, nullptr);
+    entity* derived = new entity("Derived", false, 1, base);
+    base->set_subtypes({derived});
+    base->set_attributes({new attribute("Name", new simple_type(simple_type::string_type), false),
+                          new attribute("Tag", new simple_type(simple_type::string_type), true)},
+                         {false, false});
+    derived->set_attributes({new attribute("Name", new simple_type(simple_type::string_type), true)}, {false});
+    // Registered schemas are never destroyed
+    return new schema_definition("TEST_REDECLARED_ATTRIBUTES", {base, derived}, nullptr);
+}
+} // namespace
+
+int main() {
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(file_contents));
+    CHECK(file->good());
+    const IfcParse::schema_definition* schema = file->schema();
+
+    auto* wall = file->instance_by_id(2)->as<IfcUtil::IfcBaseEntity>();
+    auto* pset = file->instance_by_id(3)->as<IfcUtil::IfcBaseEntity>();
+    auto* point = file->instance_by_id(1)->as<IfcUtil::IfcBaseEntity>();
+
+    // A handle resolved on a supertype is used on instances of its subtypes
+    const IfcParse::attribute_handle name = schema->declaration_by_name("IfcRoot")->as_entity()->resolve_attribute("Name");
+    CHECK_EQUAL(name.index, (size_t)2);
+    CHECK_EQUAL((std::string)*wall->get(name), "Wall");
+    CHECK_EQUAL((std::string)*pset->get(name), "Pset");
+    CHECK(wall->get(name) == wall->get("Name"));
+
+    // A handle resolved on the exact type of the instance
+    const IfcParse::attribute_handle coordinates = schema->declaration_by_name("IfcCartesianPoint")->as_entity()->resolve_attribute("Coordinates");
+    CHECK(point->get(coordinates) == point->get("Coordinates"));
+
+    // Handles of unrelated entities, and of subtypes, are rejected
+    CHECK(throws([&]() { point->get(name); }));
+    CHECK(throws([&]() { wall->get(coordinates); }));
+    const IfcParse::attribute_handle wall_name = schema->declaration_by_name("IfcWall")->as_entity()->resolve_attribute("Name");
+    CHECK(throws([&]() { pset->get(wall_name); }));
+
+    // Unknown names throw, also on entities that have them in a subtype
+    CHECK(throws([&]() { schema->declaration_by_name("IfcRoot")->as_entity()->resolve_attribute("ObjectPlacement"); }));
+    CHECK(throws([&]() { schema->declaration_by_name("IfcWall")->as_entity()->resolve_attribute("NoSuchAttribute"); }));
+    CHECK(throws([&]() { wall->get("NoSuchAttribute"); }));
+
+    // A name that is declared again resolves to the attribute of the subtype
+    const IfcParse::schema_definition* redeclared = redeclaring_schema();
+    const IfcParse::entity* base = redeclared->declaration_by_name("Base")->as_entity();
+    const IfcParse::entity* derived = redeclared->declaration_by_name("Derived")->as_entity();
+    CHECK_EQUAL(base->resolve_attribute("Name").index, (size_t)0);
+    CHECK_EQUAL(derived->resolve_attribute("Name").index, (size_t)2);
+    CHECK_EQUAL(derived->resolve_attribute("Tag").index, (size_t)1);
+    CHECK_EQUAL(derived->attribute_index("Name"), (ptrdiff_t)2);
+
+    return test_utils::report("attribute_handle");
+}
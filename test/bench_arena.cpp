@@ -0,0 +1,137 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Times allocating and deleting small arena_allocated objects from the heap
+// and from an arena, and opening, loading and destroying a synthetic file of
+// which the instances and attributes are placed in its arena, with the peak
+// resident set size after each step where the platform reports it.
+//
+// Usage: bench_arena [number of instances in millions]
+
+#include "../src/ifcparse/IfcArena.h"
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef _MSC_VER
+#include <sys/resource.h>
+#endif
+
+namespace {
+struct allocated : public IfcParse::arena_allocated {
+    char data[40];
+};
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+std::string peak_rss() {
+#ifdef _MSC_VER
+    return "";
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    const long megabytes = usage.ru_maxrss >> 20;
+#else
+    const long megabytes = usage.ru_maxrss >> 10;
+#endif
+    return ", peak RSS " + std::to_string(megabytes) + "MB";
+#endif
+}
+
+void time_allocation(size_t n) {
+    std::vector<allocated*> objects(n);
+
+    auto start = std::chrono::steady_clock::now();
+    for (auto& o : objects) {
+        o = new allocated;
+    }
+    const double heap_allocate = seconds_since(start);
+    start = std::chrono::steady_clock::now();
+    for (auto& o : objects) {
+        delete o;
+    }
+    const double heap_delete = seconds_since(start);
+
+    double arena_allocate, arena_delete;
+    {
+        IfcParse::arena a;
+        start = std::chrono::steady_clock::now();
+        for (auto& o : objects) {
+            o = new (a) allocated;
+        }
+        arena_allocate = seconds_since(start);
+        start = std::chrono::steady_clock::now();
+        for (auto& o : objects) {
+            delete o;
+        }
+    }
+    arena_delete = seconds_since(start);
+
+    std::cout << n << " objects of " << sizeof(allocated) << " bytes" << std::endl;
+    std::cout << "heap:  allocate " << heap_allocate << "s, delete " << heap_delete << "s" << std::endl;
+    std::cout << "arena: allocate " << arena_allocate << "s, delete and release " << arena_delete << "s" << std::endl;
+}
+
+std::string file_contents(size_t n) {
+    std::string data = TEST_IFC4_HEADER;
+    data.reserve(n * 60);
+    for (size_t i = 1; i <= n; i += 2) {
+        const std::string id = std::to_string(i);
+        data += "#" + id + "=IFCCARTESIANPOINT((" + id + ".,0.5,-1.25));\n";
+        data += "#" + std::to_string(i + 1) + "=IFCPOLYLINE((#" + id + ",#1));\n";
+    }
+    data += TEST_IFC_FOOTER;
+    return data;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t n = (size_t)((argc > 1 ? std::atof(argv[1]) : 2.) * 1000000);
+
+    time_allocation(n);
+
+    const std::string data = file_contents(n);
+    std::cout << "file of " << n << " instances, " << (data.size() >> 20) << "MB" << peak_rss() << std::endl;
+
+    auto start = std::chrono::steady_clock::now();
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(data));
+    std::cout << "open:    " << seconds_since(start) << "s" << peak_rss() << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    size_t attributes = 0;
+    for (auto& p : *file) {
+        attributes += p.second->data().getArgument(0)->size();
+    }
+    std::cout << "load:    " << seconds_since(start) << "s" << peak_rss() << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    file.reset();
+    std::cout << "destroy: " << seconds_since(start) << "s" << std::endl;
+
+    return attributes ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Measures schema_definition::declaration_by_name() for all schemas in the
+// build, on the uppercase names found as keywords in files and on the mixed
+// case names used by the API. The binary search over the uppercase names
+// that the lookup used before is timed for comparison.
+//
+// Usage: bench_declaration_lookup [number of lookups per schema]
+
+#include "../src/ifcparse/IfcSchema.h"
+
+#include <boost/algorithm/string/case_conv.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+template <typename Fn>
+double time_per_lookup(const std::vector<const std::string*>& names, Fn fn) {
+    size_t sum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (auto& name : names) {
+        sum += fn(*name)->index_in_schema();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    // Keep the lookups from being optimized away
+    if (sum == 1) {
+        std::cerr << sum << std::endl;
+    }
+    return std::chrono::duration<double, std::nano>(end - start).count() / names.size();
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 2000000;
+
+    int exit_code = 0;
+    for (auto& schema_name : IfcParse::schema_names()) {
+        const IfcParse::schema_definition* schema = IfcParse::schema_by_name(schema_name);
+        const auto& declarations = schema->declarations();
+
+        std::vector<std::pair<std::string, const IfcParse::declaration*>> sorted;
+        for (auto& decl : declarations) {
+            sorted.emplace_back(decl->name_uc(), decl);
+        }
+        std::sort(sorted.begin(), sorted.end());
+        auto binary_search = [&sorted](const std::string& name) {
+            std::string name_uc = name;
+            if (std::any_of(name.begin(), name.end(), [](char c) { return c >= 'a' && c <= 'z'; })) {
+                boost::to_upper(name_uc);
+            }
+            auto it = std::lower_bound(sorted.begin(), sorted.end(), name_uc, [](const std::pair<std::string, const IfcParse::declaration*>& p, const std::string& s) { return p.first < s; });
+            return it->second;
+        };
+        auto hash_lookup = [schema](const std::string& name) {
+            return schema->declaration_by_name(name);
+        };
+
+        std::mt19937_64 rng(10303);
+        std::vector<const std::string*> uppercase, mixed_case;
+        uppercase.reserve(n);
+        mixed_case.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            const IfcParse::declaration* decl = declarations[rng() % declarations.size()];
+            uppercase.push_back(&decl->name_uc());
+            mixed_case.push_back(&decl->name());
+        }
+
+        for (auto& decl : declarations) {
+            if (hash_lookup(decl->name()) != decl || hash_lookup(decl->name_uc()) != decl) {
+                std::cerr << schema_name << ": wrong declaration for " << decl->name() << std::endl;
+                exit_code = 1;
+            }
+        }
+
+        std::cout << schema_name << " (" << declarations.size() << " declarations)" << std::endl;
+        std::cout << "  declaration_by_name, uppercase:  " << time_per_lookup(uppercase, hash_lookup) << " ns/lookup" << std::endl;
+        std::cout << "  declaration_by_name, mixed case: " << time_per_lookup(mixed_case, hash_lookup) << " ns/lookup" << std::endl;
+        std::cout << "  binary search, uppercase:        " << time_per_lookup(uppercase, binary_search) << " ns/lookup" << std::endl;
+        std::cout << "  binary search, mixed case:       " << time_per_lookup(mixed_case, binary_search) << " ns/lookup" << std::endl;
+    }
+    return exit_code;
+}
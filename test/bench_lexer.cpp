@@ -0,0 +1,129 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Measures the throughput of IfcSpfLexer on coordinate-heavy data, which is
+// dominated by short real tokens and delimiters, and of the range scans of
+// IfcSpfStream that the lexer uses to find the end of these tokens.
+//
+// Usage: bench_lexer [filename | size in MB]
+//
+// Without a filename, a synthetic buffer of 64 MB of point lists, points and
+// comments is lexed.
+
+#include "../src/ifcparse/IfcParse.h"
+#include "../src/ifcparse/IfcSpfStream.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+
+namespace {
+std::string synthetic_data(size_t size) {
+    std::mt19937_64 rng(10303);
+    std::uniform_real_distribution<double> coordinate(-1.e4, 1.e4);
+    std::string data = "DATA;\n";
+    data.reserve(size + 4096);
+    char buf[128];
+    unsigned int id = 0;
+    while (data.size() < size) {
+        if (++id % 10 == 0) {
+            data += "/* a comment between instances */\n";
+        }
+        data += "#" + std::to_string(id);
+        if (id % 2) {
+            data += "=IFCCARTESIANPOINTLIST3D((";
+            for (int i = 0; i < 256; ++i) {
+                snprintf(buf, sizeof(buf), "%s(%.15G,%.6f,%.1f)", i ? "," : "", coordinate(rng), coordinate(rng), (double)(rng() % 100));
+                data += buf;
+            }
+            data += "),$);\n";
+        } else {
+            snprintf(buf, sizeof(buf), "=IFCCARTESIANPOINT((%.15G,%.15G,0.));\n", coordinate(rng), coordinate(rng));
+            data += buf;
+        }
+    }
+    data += "ENDSEC;\n";
+    return data;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* arg = argc > 1 ? argv[1] : "64";
+    const size_t megabytes = std::strtoul(arg, nullptr, 10);
+
+    std::unique_ptr<IfcParse::IfcSpfStream> stream;
+    if (megabytes) {
+        const std::string data = synthetic_data(megabytes << 20);
+        char* buffer = new char[data.size()];
+        std::memcpy(buffer, data.data(), data.size());
+        stream.reset(new IfcParse::IfcSpfStream(buffer, data.size()));
+    } else {
+        stream.reset(new IfcParse::IfcSpfStream(std::string(arg)));
+    }
+    if (!stream->valid) {
+        std::cerr << "Failed to open " << arg << std::endl;
+        return 1;
+    }
+    const double mb = stream->size / double(1 << 20);
+
+    // The range scan that skips over the characters of a token
+    auto start = std::chrono::steady_clock::now();
+    size_t delimiters = 0;
+    for (size_t offset = 0; offset < stream->size; offset = stream->find_delimiter_at(offset) + 1) {
+        ++delimiters;
+    }
+    const double scan = seconds_since(start);
+
+    // The same scan, one character at a time
+    start = std::chrono::steady_clock::now();
+    size_t delimiters_scalar = 0;
+    const char* data = stream->data_at(0);
+    for (size_t offset = 0; offset < stream->size; ++offset) {
+        const char c = data[offset];
+        if (c == '(' || c == ')' || c == '=' || c == ',' || c == ';' || c == '/' || c == '\'') {
+            ++delimiters_scalar;
+        }
+    }
+    const double scan_scalar = seconds_since(start);
+
+    // Lexing all tokens, including the conversion of reals and integers
+    IfcParse::IfcSpfLexer lexer(stream.get(), nullptr);
+    stream->Seek(0);
+    start = std::chrono::steady_clock::now();
+    size_t tokens = 0;
+    while (lexer.Next().type != IfcParse::Token_NONE) {
+        ++tokens;
+    }
+    const double lex = seconds_since(start);
+
+    std::cout << "size:                 " << mb << " MB" << std::endl;
+    std::cout << "find_delimiter_at:    " << mb / scan << " MB/s (" << delimiters << " delimiters)" << std::endl;
+    std::cout << "per character:        " << mb / scan_scalar << " MB/s (" << delimiters_scalar << " delimiters)" << std::endl;
+    std::cout << "IfcSpfLexer::Next:    " << mb / lex << " MB/s, " << tokens / lex * 1.e-6 << " M tokens/s (" << tokens << " tokens)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,102 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Writes a synthetic IFC-SPF file, by default of 6 GB so that the instances
+// at its end lie beyond the 4 GB that 32-bit offsets can address, and times
+// opening it. The last instance is then loaded to check that its attributes
+// are read from the right offset.
+//
+// Usage: bench_open_large <filename> [size in GB]
+//
+// The file is removed afterwards.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+/// Writes points with the id as their coordinates until the file reaches size bytes
+unsigned int write_synthetic_file(const std::string& filename, uint64_t size) {
+    std::ofstream f(filename, std::ios::binary);
+    f << TEST_IFC4_HEADER;
+    unsigned int id = 0;
+    uint64_t written = 0;
+    char line[128];
+    while (written < size) {
+        ++id;
+        const int n = snprintf(line, sizeof(line), "#%u=IFCCARTESIANPOINT((%u.,%u.5,-%u.25));\n", id, id, id, id);
+        f.write(line, n);
+        written += n;
+    }
+    f << TEST_IFC_FOOTER;
+    return f ? id : 0;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <filename> [size in GB]" << std::endl;
+        return 1;
+    }
+    const std::string filename = argv[1];
+    const double gigabytes = argc > 2 ? std::atof(argv[2]) : 6.;
+
+    auto start = std::chrono::steady_clock::now();
+    const unsigned int num_instances = write_synthetic_file(filename, (uint64_t)(gigabytes * (1ULL << 30)));
+    if (num_instances == 0) {
+        std::cerr << "Failed to write " << filename << std::endl;
+        return 1;
+    }
+    std::cout << "write: " << seconds_since(start) << "s, " << num_instances << " instances" << std::endl;
+
+    int exit_code = 0;
+    {
+        start = std::chrono::steady_clock::now();
+        IfcParse::IfcFile file(filename);
+        std::cout << "open:  " << seconds_since(start) << "s" << std::endl;
+
+        if (!file.good() || file.getMaxId() != num_instances) {
+            std::cerr << "Failed to open " << filename << std::endl;
+            exit_code = 1;
+        } else {
+            start = std::chrono::steady_clock::now();
+            const std::vector<double> coordinates = *file.instance_by_id(num_instances)->data().getArgument(0);
+            std::cout << "load:  " << seconds_since(start) << "s" << std::endl;
+            const double x = num_instances;
+            if (coordinates != std::vector<double>{x, x + 0.5, -(x + 0.25)}) {
+                std::cerr << "The last instance was not read correctly" << std::endl;
+                exit_code = 1;
+            }
+        }
+    }
+
+    std::remove(filename.c_str());
+    return exit_code;
+}
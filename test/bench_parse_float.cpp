@@ -0,0 +1,90 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Measures the throughput of IfcParse::ParseFloat() against strtod() on the
+// kind of reals found in coordinate-heavy IFC files.
+//
+// Usage: bench_parse_float [number of values]
+
+#include "../src/ifcparse/IfcParse.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+template <typename Fn>
+double time_per_value(const std::vector<std::string>& values, Fn fn) {
+    double sum = 0.;
+    const auto start = std::chrono::steady_clock::now();
+    for (auto& s : values) {
+        sum += fn(s.c_str());
+    }
+    const auto end = std::chrono::steady_clock::now();
+    // Keep the conversions from being optimized away
+    if (sum == 0.123456789) {
+        std::cerr << sum << std::endl;
+    }
+    return std::chrono::duration<double, std::nano>(end - start).count() / values.size();
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    const size_t n = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 5000000;
+
+    std::mt19937_64 rng(10303);
+    std::uniform_real_distribution<double> coordinate(-1.e5, 1.e5);
+    std::vector<std::string> values;
+    values.reserve(n);
+    char buf[64];
+    for (size_t i = 0; i < n; ++i) {
+        switch (i % 4) {
+        case 0:
+            snprintf(buf, sizeof(buf), "%.17G", coordinate(rng));
+            break;
+        case 1:
+            snprintf(buf, sizeof(buf), "%.6f", coordinate(rng));
+            break;
+        case 2:
+            snprintf(buf, sizeof(buf), "%.1f", (double)(rng() % 1000));
+            break;
+        default:
+            snprintf(buf, sizeof(buf), "%.14E", coordinate(rng) * 1.e-7);
+        }
+        values.push_back(buf);
+    }
+
+    const double parse_float = time_per_value(values, [](const char* s) {
+        double d = 0.;
+        IfcParse::ParseFloat(s, d);
+        return d;
+    });
+    const double strtod_ = time_per_value(values, [](const char* s) {
+        return strtod(s, nullptr);
+    });
+
+    std::cout << "values:     " << n << std::endl;
+    std::cout << "ParseFloat: " << parse_float << " ns/value" << std::endl;
+    std::cout << "strtod:     " << strtod_ << " ns/value" << std::endl;
+    return 0;
+}
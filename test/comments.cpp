@@ -0,0 +1,76 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks that the lexer skips comments up to the first asterisk and solidus
+// after the opening sequence, also when line breaks separate the two, and
+// that the asterisk of the opening sequence does not close the comment.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <memory>
+#include <set>
+#include <string>
+
+namespace {
+// A file of three points of which the second is commented out by comment,
+// which is given with %s in place of the instance
+std::string file_contents(const std::string& comment) {
+    std::string inner = "#2=IFCCARTESIANPOINT((1.,0.,0.));";
+    std::string commented = comment;
+    commented.replace(commented.find("%s"), 2, inner);
+    return TEST_IFC4_HEADER
+        "#1=IFCCARTESIANPOINT((0.,0.,0.));\n" +
+        commented + "\n"
+        "#3=IFCCARTESIANPOINT((2.,0.,0.));\n"
+        TEST_IFC_FOOTER;
+}
+} // namespace
+
+int main() {
+    const std::set<unsigned int> without_second = {1, 3};
+
+    for (const char* comment : {
+             "/* %s */",
+             "/*%s*/",
+             "/**%s**/",
+             "/* %s *\n/",
+             "/* %s *\r\n/",
+             // The asterisk of the opening sequence is not part of the closing one
+             "/*/ %s */",
+             "/*\n/ %s */",
+             "/*\r\n/ %s */",
+         }) {
+        std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(file_contents(comment)));
+        CHECK_MESSAGE(file->good(), comment);
+        CHECK_MESSAGE(test_utils::ids_of(*file) == without_second, comment);
+    }
+
+    // Comments in between the attributes of an instance
+    {
+        std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(
+            TEST_IFC4_HEADER
+            "#1=IFCCARTESIANPOINT(/**/(0.,/*/ 3., */1.,/*\n/,*/2.));\n"
+            TEST_IFC_FOOTER));
+        CHECK(file->good());
+        CHECK(file->instance_by_id(1)->data().getArgument(0)->toString() == "(0.,1.,2.)");
+    }
+
+    return test_utils::report("comments");
+}
@@ -0,0 +1,107 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks that the compact inverse index answers instances_by_reference(),
+// getInverse() and getTotalInverses() like the inverse maps do, also after
+// a modification expands it into the maps.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+const char* file_contents =
+    TEST_IFC4_HEADER
+    "#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+    "#2=IFCCARTESIANPOINT((1.,0.,0.));\n"
+    "#3=IFCDIRECTION((0.,0.,1.));\n"
+    // Repeated references, in lists and in multiple attributes
+    "#4=IFCPOLYLINE((#1,#2,#1));\n"
+    "#5=IFCAXIS2PLACEMENT3D(#1,#3,#3);\n"
+    "#6=IFCLOCALPLACEMENT($,#5);\n"
+    "#7=IFCWALL('2O2Fr$t4X7Zf8NOew3FLOH',$,'A',$,$,#6,$,$,$);\n"
+    "#8=IFCWALL('0u4wgLe6n0ABVaiXyikbkA',$,'B',$,$,#6,$,$,$);\n"
+    "#9=IFCPROPERTYSINGLEVALUE('Width',$,IFCLENGTHMEASURE(2.),$);\n"
+    "#10=IFCPROPERTYSET('1kTvXnbbzCWw8lcMd1dR4o',$,'Pset',$,(#9));\n"
+    "#11=IFCRELDEFINESBYPROPERTIES('3MlZRLaHf4QBcOFgtyXb6g',$,$,$,(#7,#8),#10);\n"
+    // A reference to an instance that is defined later
+    "#12=IFCRELDEFINESBYPROPERTIES('1H4iZVkOP9bBqmCXRiNuPq',$,$,$,(#13),#10);\n"
+    "#13=IFCWALL('0ZyvMzRBH3dAcUjOzGPZJu',$,'C',$,$,$,$,$,$);\n"
+    TEST_IFC_FOOTER;
+
+const char* types[] = {"IfcRoot", "IfcRelDefinesByProperties", "IfcWall", "IfcRepresentationItem", "IfcPolyline", "IfcAxis2Placement3D"};
+
+// The inverse references of all instances, as answered by the file
+std::vector<std::string> inverses(IfcParse::IfcFile& file) {
+    std::vector<std::string> result;
+    auto add = [&result](const std::string& query, const std::vector<unsigned int>& ids) {
+        std::string line = query + ":";
+        for (auto& id : ids) {
+            line += " #" + std::to_string(id);
+        }
+        result.push_back(line);
+    };
+    for (auto& p : file) {
+        const std::string id = "#" + std::to_string(p.first);
+        add(id, test_utils::ids_in_order(file.instances_by_reference(p.first)));
+        add(id + " total", {(unsigned int)file.getTotalInverses(p.first)});
+        for (auto& type : types) {
+            for (int attribute_index = -1; attribute_index < 6; ++attribute_index) {
+                add(id + " " + type + " " + std::to_string(attribute_index), test_utils::ids_in_order(file.getInverse(p.first, file.schema()->declaration_by_name(type), attribute_index)));
+            }
+        }
+    }
+    return result;
+}
+
+// Redirects the representation of wall #8 and removes the polyline
+void modify(IfcParse::IfcFile& file) {
+    IfcEntityInstanceData& wall = file.instance_by_id(8)->data();
+    wall.setArgument(5, file.instance_by_id(7)->data().getArgument(5), IfcUtil::Argument_UNKNOWN, true);
+    file.removeEntity(file.instance_by_id(4));
+}
+} // namespace
+
+int main() {
+    IfcParse::IfcFile::compact_inverses(false);
+    std::unique_ptr<IfcParse::IfcFile> maps(test_utils::open_buffer(file_contents));
+    IfcParse::IfcFile::compact_inverses(true);
+    std::unique_ptr<IfcParse::IfcFile> compact(test_utils::open_buffer(file_contents));
+    IfcParse::IfcFile::compact_inverses(false);
+    CHECK(maps->good() && compact->good());
+
+    const auto expected = inverses(*maps);
+    const auto result = inverses(*compact);
+    CHECK_EQUAL(result.size(), expected.size());
+    for (size_t i = 0; i < result.size() && i < expected.size(); ++i) {
+        CHECK_MESSAGE(result[i] == expected[i], result[i] + " instead of " + expected[i]);
+    }
+    CHECK(test_utils::ids_in_order(compact->instances_by_reference(1)) == (std::vector<unsigned int>{4, 4, 5}));
+    CHECK(test_utils::ids_in_order(compact->getInverse(13, compact->schema()->declaration_by_name("IfcRelDefinesByProperties"), 4)) == std::vector<unsigned int>{12});
+
+    modify(*maps);
+    modify(*compact);
+    CHECK(inverses(*compact) == inverses(*maps));
+    CHECK(test_utils::ids_in_order(compact->instances_by_reference(1)) == std::vector<unsigned int>{5});
+
+    return test_utils::report("compact_inverses");
+}
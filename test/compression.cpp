@@ -0,0 +1,316 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks the decompression of gzip, block gzip (BGZF) and ifcZIP files,
+// including ZIP64 archives, and that truncated or corrupt files are
+// rejected. Without zlib, checks that these formats are reported as not
+// supported by the build.
+
+#include "../src/ifcparse/IfcCompression.h"
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef WITH_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+const char* file_contents =
+    TEST_IFC4_HEADER
+    "#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+    "#2=IFCCARTESIANPOINT((1.,0.,0.));\n"
+    "#3=IFCPOLYLINE((#1,#2));\n"
+    TEST_IFC_FOOTER;
+
+/// Decompresses a copy of data in a buffer of its exact size, so that reads
+/// past its end are detected by memory checkers, returns false when an
+/// IfcException was thrown
+bool decompress(IfcParse::compression_format format, const std::string& data, std::string& result, unsigned num_threads = 1) {
+    std::unique_ptr<char[]> input(new char[data.size()]);
+    std::memcpy(input.get(), data.data(), data.size());
+    size_t size = 0;
+    try {
+        std::unique_ptr<char[]> buffer(IfcParse::decompress(format, input.get(), data.size(), size, num_threads));
+        result.assign(buffer.get(), size);
+        return true;
+    } catch (const IfcParse::IfcException&) {
+        return false;
+    }
+}
+
+#ifdef WITH_ZLIB
+
+void append_u16(std::string& s, uint16_t v) {
+    s += (char)(v & 0xff);
+    s += (char)(v >> 8);
+}
+
+void append_u32(std::string& s, uint32_t v) {
+    append_u16(s, (uint16_t)(v & 0xffff));
+    append_u16(s, (uint16_t)(v >> 16));
+}
+
+void append_u64(std::string& s, uint64_t v) {
+    append_u32(s, (uint32_t)(v & 0xffffffff));
+    append_u32(s, (uint32_t)(v >> 32));
+}
+
+uint32_t crc32_of(const std::string& s) {
+    return (uint32_t)crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<const Bytef*>(s.data()), (uInt)s.size());
+}
+
+/// Compresses data as a raw deflate stream, or with window_bits 31 as gzip
+std::string deflated(const std::string& data, int window_bits = -MAX_WBITS) {
+    z_stream z{};
+    deflateInit2(&z, Z_BEST_COMPRESSION, Z_DEFLATED, window_bits, 8, Z_DEFAULT_STRATEGY);
+    std::string result(deflateBound(&z, (uLong)data.size()), '\0');
+    z.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    z.avail_in = (uInt)data.size();
+    z.next_out = reinterpret_cast<Bytef*>(&result[0]);
+    z.avail_out = (uInt)result.size();
+    deflate(&z, Z_FINISH);
+    result.resize(z.total_out);
+    deflateEnd(&z);
+    return result;
+}
+
+std::string gzipped(const std::string& data) {
+    return deflated(data, MAX_WBITS + 16);
+}
+
+/// A block gzip file with a member for every block, of which the header
+/// records the size of the member in a BC extra field
+std::string bgzf(const std::vector<std::string>& blocks) {
+    std::string result;
+    for (auto& block : blocks) {
+        const std::string data = deflated(block);
+        result += "\x1f\x8b\x08\x04";
+        append_u32(result, 0);
+        result += std::string("\x00\xff", 2);
+        append_u16(result, 6);
+        result += "BC";
+        append_u16(result, 2);
+        append_u16(result, (uint16_t)(12 + 6 + data.size() + 8 - 1));
+        result += data;
+        append_u32(result, crc32_of(block));
+        append_u32(result, (uint32_t)block.size());
+    }
+    return result;
+}
+
+/// A ZIP archive of the given entries, of which the sizes and offsets are
+/// stored in ZIP64 extended information fields when zip64 is set
+std::string zipped(const std::vector<std::pair<std::string, std::string>>& entries, bool deflate, bool zip64) {
+    std::string archive, central_directory;
+    for (auto& entry : entries) {
+        const std::string data = deflate ? deflated(entry.second) : entry.second;
+        const uint32_t crc = crc32_of(entry.second);
+        const uint64_t local_header = archive.size();
+
+        append_u32(archive, 0x04034b50);
+        append_u16(archive, zip64 ? 45 : 20);
+        append_u16(archive, 0);
+        append_u16(archive, deflate ? Z_DEFLATED : 0);
+        append_u32(archive, 0);
+        append_u32(archive, crc);
+        append_u32(archive, zip64 ? 0xffffffff : (uint32_t)data.size());
+        append_u32(archive, zip64 ? 0xffffffff : (uint32_t)entry.second.size());
+        append_u16(archive, (uint16_t)entry.first.size());
+        append_u16(archive, zip64 ? 20 : 0);
+        archive += entry.first;
+        if (zip64) {
+            append_u16(archive, 0x0001);
+            append_u16(archive, 16);
+            append_u64(archive, entry.second.size());
+            append_u64(archive, data.size());
+        }
+        archive += data;
+
+        append_u32(central_directory, 0x02014b50);
+        append_u16(central_directory, zip64 ? 45 : 20);
+        append_u16(central_directory, zip64 ? 45 : 20);
+        append_u16(central_directory, 0);
+        append_u16(central_directory, deflate ? Z_DEFLATED : 0);
+        append_u32(central_directory, 0);
+        append_u32(central_directory, crc);
+        append_u32(central_directory, zip64 ? 0xffffffff : (uint32_t)data.size());
+        append_u32(central_directory, zip64 ? 0xffffffff : (uint32_t)entry.second.size());
+        append_u16(central_directory, (uint16_t)entry.first.size());
+        append_u16(central_directory, zip64 ? 28 : 0);
+        append_u16(central_directory, 0);
+        append_u16(central_directory, 0);
+        append_u16(central_directory, 0);
+        append_u32(central_directory, 0);
+        append_u32(central_directory, zip64 ? 0xffffffff : (uint32_t)local_header);
+        central_directory += entry.first;
+        if (zip64) {
+            append_u16(central_directory, 0x0001);
+            append_u16(central_directory, 24);
+            append_u64(central_directory, entry.second.size());
+            append_u64(central_directory, data.size());
+            append_u64(central_directory, local_header);
+        }
+    }
+
+    const uint64_t central_directory_offset = archive.size();
+    archive += central_directory;
+    if (zip64) {
+        const uint64_t record = archive.size();
+        append_u32(archive, 0x06064b50);
+        append_u64(archive, 44);
+        append_u16(archive, 45);
+        append_u16(archive, 45);
+        append_u32(archive, 0);
+        append_u32(archive, 0);
+        append_u64(archive, entries.size());
+        append_u64(archive, entries.size());
+        append_u64(archive, central_directory.size());
+        append_u64(archive, central_directory_offset);
+
+        append_u32(archive, 0x07064b50);
+        append_u32(archive, 0);
+        append_u64(archive, record);
+        append_u32(archive, 1);
+    }
+    append_u32(archive, 0x06054b50);
+    append_u16(archive, 0);
+    append_u16(archive, 0);
+    append_u16(archive, zip64 ? 0xffff : (uint16_t)entries.size());
+    append_u16(archive, zip64 ? 0xffff : (uint16_t)entries.size());
+    append_u32(archive, (uint32_t)central_directory.size());
+    append_u32(archive, zip64 ? 0xffffffff : (uint32_t)central_directory_offset);
+    append_u16(archive, 0);
+    return archive;
+}
+
+void check_gzip() {
+    std::string result;
+
+    const std::string gz = gzipped(file_contents);
+    CHECK(IfcParse::detect_compression(gz.data(), gz.size()) == IfcParse::COMPRESSION_GZIP);
+    CHECK(decompress(IfcParse::COMPRESSION_GZIP, gz, result) && result == file_contents);
+
+    // Concatenated members form a single file
+    const std::string text(file_contents);
+    const std::string first = text.substr(0, 100), second = text.substr(100);
+    CHECK(decompress(IfcParse::COMPRESSION_GZIP, gzipped(first) + gzipped(second), result) && result == text);
+
+    // Block gzip, of which the members are inflated concurrently
+    const std::string blocks = bgzf({text.substr(0, 50), text.substr(50, 150), text.substr(200)});
+    for (unsigned num_threads : {1U, 4U}) {
+        CHECK(decompress(IfcParse::COMPRESSION_GZIP, blocks, result, num_threads) && result == text);
+    }
+
+    // Opened as a file
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(gz));
+    CHECK(file->good());
+    CHECK_EQUAL(file->instance_by_id(3)->data().toString(true), "#3=IFCPOLYLINE((#1,#2))");
+
+    // Truncated and corrupt files
+    CHECK(!decompress(IfcParse::COMPRESSION_GZIP, gz.substr(0, gz.size() / 2), result));
+    CHECK(!decompress(IfcParse::COMPRESSION_GZIP, gz.substr(0, 5), result));
+    CHECK(!decompress(IfcParse::COMPRESSION_GZIP, blocks.substr(0, blocks.size() - 10), result));
+    std::string corrupt_crc = blocks;
+    corrupt_crc[corrupt_crc.size() - 8] ^= 1;
+    CHECK(!decompress(IfcParse::COMPRESSION_GZIP, corrupt_crc, result));
+    std::string corrupt_data = gz;
+    for (size_t i = 20; i < 40; ++i) {
+        corrupt_data[i] = (char)0xff;
+    }
+    CHECK(!decompress(IfcParse::COMPRESSION_GZIP, corrupt_data, result));
+
+    std::unique_ptr<IfcParse::IfcFile> truncated(test_utils::open_buffer(gz.substr(0, gz.size() / 2)));
+    CHECK(!truncated->good());
+}
+
+void check_ifczip() {
+    std::string result;
+    const std::vector<std::pair<std::string, std::string>> entries = {{"readme.txt", "Not the model"}, {"model/Model.IFC", file_contents}};
+
+    for (bool deflate : {false, true}) {
+        for (bool zip64 : {false, true}) {
+            const std::string archive = zipped(entries, deflate, zip64);
+            CHECK(IfcParse::detect_compression(archive.data(), archive.size()) == IfcParse::COMPRESSION_IFCZIP);
+            CHECK_MESSAGE(decompress(IfcParse::COMPRESSION_IFCZIP, archive, result) && result == file_contents,
+                          std::string(deflate ? "deflated" : "stored") + (zip64 ? " ZIP64" : ""));
+
+            // Truncated before the end of central directory, and within the data
+            CHECK(!decompress(IfcParse::COMPRESSION_IFCZIP, archive.substr(0, archive.size() - 10), result));
+            CHECK(!decompress(IfcParse::COMPRESSION_IFCZIP, archive.substr(0, 80) + archive.substr(archive.size() - (zip64 ? 98 : 22)), result));
+        }
+    }
+
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(zipped(entries, true, false)));
+    CHECK(file->good());
+
+    // A stored entry of which the data does not match its checksum
+    std::string corrupt = zipped(entries, false, false);
+    corrupt[corrupt.find("#3=")] = '%';
+    CHECK(!decompress(IfcParse::COMPRESSION_IFCZIP, corrupt, result));
+
+    CHECK(!decompress(IfcParse::COMPRESSION_IFCZIP, zipped({{"readme.txt", "Not the model"}}, true, false), result));
+
+    // A ZIP64 locator that points beyond the end of an input that is shorter
+    // than a ZIP64 end of central directory record
+    std::string short_archive;
+    append_u32(short_archive, 0x07064b50);
+    append_u32(short_archive, 0);
+    append_u64(short_archive, 40);
+    append_u32(short_archive, 1);
+    append_u32(short_archive, 0x06054b50);
+    short_archive += std::string(18, '\0');
+    CHECK_EQUAL(short_archive.size(), (size_t)42);
+    CHECK(!decompress(IfcParse::COMPRESSION_IFCZIP, short_archive, result));
+
+    // An end of central directory record and nothing else
+    std::string empty_archive;
+    append_u32(empty_archive, 0x06054b50);
+    empty_archive += std::string(18, '\0');
+    CHECK(!decompress(IfcParse::COMPRESSION_IFCZIP, empty_archive, result));
+
+    CHECK(!decompress(IfcParse::COMPRESSION_IFCZIP, std::string("PK\x03\x04", 4) + std::string(100, 'x'), result));
+}
+
+#endif
+} // namespace
+
+int main() {
+    CHECK(IfcParse::detect_compression(file_contents, std::strlen(file_contents)) == IfcParse::COMPRESSION_NONE);
+
+#ifdef WITH_ZLIB
+    check_gzip();
+    check_ifczip();
+#else
+    // Compressed files are recognized, but can not be read
+    const std::string gz("\x1f\x8b\x08\x00", 4);
+    std::string result;
+    CHECK(IfcParse::detect_compression(gz.data(), gz.size()) == IfcParse::COMPRESSION_GZIP);
+    CHECK(!decompress(IfcParse::COMPRESSION_GZIP, gz, result));
+    CHECK(!decompress(IfcParse::COMPRESSION_IFCZIP, std::string("PK\x03\x04", 4), result));
+#endif
+
+    return test_utils::report("compression");
+}
@@ -0,0 +1,157 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks that the attributes of instances that are shared between threads
+// read the same as when they are read on a single thread, with lazy and
+// eager loading, and that writing a file and breadth-first traversal, which
+// load instances on several threads, do not depend on the number of
+// threads. CI runs this test built with -fsanitize=thread, where a data
+// race fails the test, without it the test only checks the results.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <atomic>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+const unsigned int num_points = 12000;
+const unsigned int num_polylines = 6000;
+const unsigned int num_persons = 500;
+const unsigned int num_properties = 500;
+const unsigned int first_polyline = num_points + 1;
+const unsigned int first_person = first_polyline + num_polylines;
+const unsigned int first_property = first_person + num_persons;
+const unsigned int root = first_property + num_properties;
+const unsigned int num_instances = root;
+
+// More instances than are written in a single chunk, with string literals
+// that need to be decoded, half of which select another code page, inline
+// simple type instances, and a curve set that references all polylines so
+// that a level of a breadth-first traversal is read on several threads.
+std::string file_contents() {
+    using test_utils::ref;
+    std::string data = TEST_IFC4_HEADER + test_utils::cartesian_points(1, num_points);
+    for (unsigned int i = 0; i < num_polylines; ++i) {
+        data += ref(first_polyline + i) + "=IFCPOLYLINE((" + ref(1 + i) + "," + ref(1 + (i * 7) % num_points) + "));\n";
+    }
+    for (unsigned int i = 0; i < num_persons; ++i) {
+        const std::string code_page = i % 2 ? "\\PE\\" : "";
+        data += ref(first_person + i) + "=IFCPERSON('" + std::to_string(i) + "','Ren\\X\\E9','J\\X2\\00F6\\X0\\rg',$,$,('" + code_page + "\\S\\i'),$,$);\n";
+    }
+    for (unsigned int i = 0; i < num_properties; ++i) {
+        data += ref(first_property + i) + "=IFCPROPERTYSINGLEVALUE('" + std::to_string(i) + "',$,IFCLABEL('Ren\\X\\E9'),$);\n";
+    }
+    std::string curves;
+    for (unsigned int i = 0; i < num_polylines; ++i) {
+        curves += (i ? "," : "") + ref(first_polyline + i);
+    }
+    data += ref(root) + "=IFCGEOMETRICCURVESET((" + curves + "));\n";
+    data += TEST_IFC_FOOTER;
+    return data;
+}
+
+// The representation of an instance and of each of its attributes
+std::string describe(IfcUtil::IfcBaseClass* inst) {
+    std::string result = inst->data().toString();
+    for (size_t i = 0; i < inst->data().getArgumentCount(); ++i) {
+        result += "|" + inst->data().getArgument(i)->toString();
+    }
+    return result;
+}
+
+// Reads all instances of a freshly opened file on several threads at once,
+// half of which visit the instances in reverse, and returns the number of
+// instances that read differently from expected.
+size_t read_concurrently(IfcParse::IfcFile& file, const std::vector<std::string>& expected) {
+    std::vector<IfcUtil::IfcBaseClass*> instances;
+    for (unsigned int id = 1; id <= num_instances; ++id) {
+        instances.push_back(file.instance_by_id(id));
+    }
+    std::atomic<size_t> mismatches(0);
+    std::vector<std::thread> threads;
+    for (unsigned int t = 0; t < 8; ++t) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = 0; i < instances.size(); ++i) {
+                const size_t j = t % 2 ? instances.size() - 1 - i : i;
+                if (describe(instances[j]) != expected[j]) {
+                    ++mismatches;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return mismatches;
+}
+} // namespace
+
+int main() {
+    const std::string data = file_contents();
+
+    std::vector<std::string> expected;
+    IfcParse::IfcFile::num_threads(1);
+    {
+        std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(data));
+        CHECK(file->good());
+        for (unsigned int id = 1; id <= num_instances; ++id) {
+            expected.push_back(describe(file->instance_by_id(id)));
+        }
+    }
+    CHECK(expected[first_person - 1].find("'J\xC3\xB6rg'") != std::string::npos);
+    CHECK(expected[first_person - 1].find("('\xC3\xA9')") != std::string::npos);
+    CHECK(expected[first_person].find("('\xD1\x89')") != std::string::npos);
+    CHECK(expected[first_property - 1].find("IfcLabel('Ren\xC3\xA9')") != std::string::npos);
+
+    IfcParse::IfcFile::num_threads(4);
+    for (bool lazy : {true, false}) {
+        IfcParse::IfcFile::lazy_load(lazy);
+        std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(data));
+        CHECK_MESSAGE(read_concurrently(*file, expected) == 0, lazy ? "lazy" : "eager");
+    }
+    IfcParse::IfcFile::lazy_load(true);
+
+    // Writing and traversal load the instances of a fresh file as they go
+    std::string written;
+    std::vector<unsigned int> traversed;
+    for (unsigned int n_threads : {1U, 4U}) {
+        IfcParse::IfcFile::num_threads(n_threads);
+        std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(data));
+        std::ostringstream os;
+        os << *file;
+        std::unique_ptr<IfcParse::IfcFile> other(test_utils::open_buffer(data));
+        const std::vector<unsigned int> ids = test_utils::ids_in_order(other->traverse_breadth_first(other->instance_by_id(root)));
+        if (n_threads == 1) {
+            written = os.str();
+            traversed = ids;
+            CHECK(traversed.size() > num_polylines);
+        } else {
+            CHECK(os.str() == written);
+            CHECK(ids == traversed);
+        }
+    }
+    IfcParse::IfcFile::num_threads(0);
+
+    return test_utils::report("concurrent_load");
+}
@@ -0,0 +1,138 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks IfcFile::content_hash() and IfcFile::content_hashes() on shared,
+// duplicated and cyclic subgraphs, on cycles that only differ in how their
+// members refer to each other, and on a reference cycle that is too long to
+// be hashed recursively.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+int main() {
+    {
+        std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(
+            TEST_IFC4_HEADER
+            "#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+            "#2=IFCCARTESIANPOINT((0.,0.,0.));\n"
+            "#3=IFCCARTESIANPOINT((1.,0.,0.));\n"
+            "#4=IFCAXIS2PLACEMENT3D(#1,$,$);\n"
+            "#5=IFCAXIS2PLACEMENT3D(#2,$,$);\n"
+            // Two reference cycles of the same structure
+            "#10=IFCLOCALPLACEMENT(#11,#4);\n"
+            "#11=IFCLOCALPLACEMENT(#10,#5);\n"
+            "#20=IFCLOCALPLACEMENT(#21,#5);\n"
+            "#21=IFCLOCALPLACEMENT(#20,#4);\n"
+            // And one that differs
+            "#22=IFCAXIS2PLACEMENT3D(#3,$,$);\n"
+            "#23=IFCLOCALPLACEMENT(#24,#22);\n"
+            "#24=IFCLOCALPLACEMENT(#23,#4);\n"
+            // Instances that refer to the cycles
+            "#30=IFCLOCALPLACEMENT(#11,#4);\n"
+            "#31=IFCLOCALPLACEMENT(#21,#4);\n"
+            "#32=IFCLOCALPLACEMENT(#24,#4);\n"
+            // A self reference
+            "#40=IFCLOCALPLACEMENT(#40,#4);\n"
+            "#41=IFCLOCALPLACEMENT(#41,#5);\n"
+            TEST_IFC_FOOTER));
+        CHECK(file->good());
+
+        // Hashed one by one, in an order that enters the cycles elsewhere
+        std::map<unsigned int, uint64_t> hashes;
+        for (unsigned int id : {31, 11, 1, 20, 24, 30, 10, 21, 2, 3, 4, 5, 22, 23, 32, 41, 40}) {
+            hashes[id] = file->content_hash(file->instance_by_id(id));
+        }
+
+        const auto all = file->content_hashes();
+        CHECK_EQUAL(all.size(), hashes.size());
+        for (auto& p : hashes) {
+            CHECK_MESSAGE(all.at(p.first) == p.second, "#" + std::to_string(p.first));
+        }
+
+        CHECK_EQUAL(hashes[1], hashes[2]);
+        CHECK(hashes[1] != hashes[3]);
+        CHECK_EQUAL(hashes[4], hashes[5]);
+        CHECK_EQUAL(hashes[10], hashes[20]);
+        CHECK_EQUAL(hashes[11], hashes[21]);
+        CHECK(hashes[10] != hashes[23]);
+        CHECK_EQUAL(hashes[30], hashes[31]);
+        CHECK(hashes[30] != hashes[32]);
+        CHECK_EQUAL(hashes[40], hashes[41]);
+        CHECK(hashes[40] != hashes[10]);
+    }
+
+    {
+        std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(
+            TEST_IFC4_HEADER
+            "#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+            "#2=IFCCARTESIANPOINT((1.,0.,0.));\n"
+            "#3=IFCCARTESIANPOINT((2.,0.,0.));\n"
+            "#4=IFCAXIS2PLACEMENT3D(#1,$,$);\n"
+            "#5=IFCAXIS2PLACEMENT3D(#2,$,$);\n"
+            "#6=IFCAXIS2PLACEMENT3D(#3,$,$);\n"
+            // Cycles with the same members, wired in opposite directions
+            "#10=IFCLOCALPLACEMENT(#11,#4);\n"
+            "#11=IFCLOCALPLACEMENT(#12,#5);\n"
+            "#12=IFCLOCALPLACEMENT(#10,#6);\n"
+            "#20=IFCLOCALPLACEMENT(#22,#4);\n"
+            "#21=IFCLOCALPLACEMENT(#20,#5);\n"
+            "#22=IFCLOCALPLACEMENT(#21,#6);\n"
+            // And wired like the first one
+            "#30=IFCLOCALPLACEMENT(#31,#4);\n"
+            "#31=IFCLOCALPLACEMENT(#32,#5);\n"
+            "#32=IFCLOCALPLACEMENT(#30,#6);\n"
+            TEST_IFC_FOOTER));
+        CHECK(file->good());
+
+        const auto all = file->content_hashes();
+        for (unsigned int id : {32, 21, 10}) {
+            CHECK_MESSAGE(file->content_hash(file->instance_by_id(id)) == all.at(id), "#" + std::to_string(id));
+        }
+        for (unsigned int i = 0; i < 3; ++i) {
+            CHECK(all.at(10 + i) != all.at(20 + i));
+            CHECK_EQUAL(all.at(10 + i), all.at(30 + i));
+        }
+    }
+
+    {
+        // A cycle of 200000 placements
+        const unsigned int n = 200000;
+        std::string data = TEST_IFC4_HEADER;
+        data += "#1=IFCCARTESIANPOINT((0.,0.,0.));\n#2=IFCAXIS2PLACEMENT3D(#1,$,$);\n";
+        for (unsigned int i = 0; i < n; ++i) {
+            data += "#" + std::to_string(i + 3) + "=IFCLOCALPLACEMENT(#" + std::to_string((i + 1) % n + 3) + ",#2);\n";
+        }
+        data += TEST_IFC_FOOTER;
+        std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(data));
+        CHECK(file->good());
+
+        const auto all = file->content_hashes();
+        CHECK_EQUAL(all.size(), (size_t)n + 2);
+        CHECK_EQUAL(file->content_hash(file->instance_by_id(3)), all.at(3));
+        CHECK_EQUAL(file->content_hash(file->instance_by_id(n + 2)), all.at(n + 2));
+        // All members of the cycle have the same content
+        CHECK_EQUAL(all.at(3), all.at(n / 2));
+    }
+
+    return test_utils::report("content_hash");
+}
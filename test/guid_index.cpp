@@ -0,0 +1,134 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks IfcParse::guid_index against a std::map on random insertions and
+// removals, which displace keys around the end of the table, on repeated
+// GlobalIds and on values that do not decode as a GlobalId.
+
+#include "../src/ifcparse/IfcGlobalId.h"
+#include "test_utils.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+// The index only stores the pointers, so distinct values suffice
+IfcUtil::IfcBaseClass* instance(size_t i) {
+    return reinterpret_cast<IfcUtil::IfcBaseClass*>((uintptr_t)(i + 1) * 8);
+}
+
+typedef std::map<std::pair<uint64_t, uint64_t>, IfcUtil::IfcBaseClass*> model_t;
+
+bool matches(const IfcParse::guid_index& index, const model_t& model, const std::vector<IfcParse::IfcGlobalId::key>& keys) {
+    if (index.size() != model.size()) {
+        return false;
+    }
+    for (auto& k : keys) {
+        auto it = model.find({k.hi, k.lo});
+        if (index.find(k) != (it == model.end() ? nullptr : it->second)) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+int main() {
+    std::mt19937_64 rng(42);
+
+    // Fills small tables to their maximum load and empties them in a random
+    // order, many times, so that probe sequences wrap around the end of the
+    // table and erasing a key shifts back keys that were displaced by it.
+    for (size_t n : {(size_t)32, (size_t)200}) {
+        for (int round = 0; round < 500; ++round) {
+            IfcParse::guid_index index;
+            model_t model;
+            std::vector<IfcParse::IfcGlobalId::key> keys;
+            for (size_t i = 0; i < n; ++i) {
+                keys.push_back({rng(), rng()});
+                CHECK(index.assign(keys.back(), instance(i)) == nullptr);
+                model[{keys.back().hi, keys.back().lo}] = instance(i);
+            }
+            bool ok = matches(index, model, keys);
+            std::shuffle(keys.begin(), keys.end(), rng);
+            for (size_t i = 0; i < keys.size() && ok; ++i) {
+                ok = index.erase(keys[i]) && !index.erase(keys[i]);
+                model.erase({keys[i].hi, keys[i].lo});
+                ok = ok && matches(index, model, keys);
+            }
+            CHECK_MESSAGE(ok, "n = " + std::to_string(n) + ", round " + std::to_string(round));
+            if (!ok) {
+                break;
+            }
+        }
+    }
+
+    const std::string guid = "2O2Fr$t4X7Zf8NOew3FLOH";
+    IfcParse::IfcGlobalId::key k;
+    CHECK(IfcParse::IfcGlobalId::decode(guid, k));
+    CHECK_EQUAL(IfcParse::IfcGlobalId::encode(k), guid);
+
+    // Repeated GlobalIds replace the previous instance
+    {
+        IfcParse::guid_index index;
+        CHECK(index.assign(guid, instance(0)) == nullptr);
+        CHECK(index.assign(guid, instance(1)) == instance(0));
+        CHECK_EQUAL(index.size(), (size_t)1);
+        CHECK(index.find(k) == instance(1));
+        CHECK(index.assign(guid, nullptr) == instance(1));
+        CHECK_EQUAL(index.size(), (size_t)0);
+        CHECK(index.find(guid) == nullptr);
+    }
+
+    // Values that are not a GlobalId, too short or long, with characters
+    // outside of the alphabet or a first character that encodes more than
+    // two bits, are kept by their string
+    {
+        const std::vector<std::string> malformed{"", "2O2Fr$t4X7Zf8NOew3FLO", "2O2Fr$t4X7Zf8NOew3FLOHX", "2O2Fr-t4X7Zf8NOew3FLOH", "4O2Fr$t4X7Zf8NOew3FLOH"};
+        IfcParse::guid_index index;
+        index.assign(guid, instance(0));
+        for (size_t i = 0; i < malformed.size(); ++i) {
+            IfcParse::IfcGlobalId::key unused;
+            CHECK_MESSAGE(!IfcParse::IfcGlobalId::decode(malformed[i], unused), malformed[i]);
+            CHECK(index.assign(malformed[i], instance(i + 1)) == nullptr);
+        }
+        CHECK_EQUAL(index.size(), malformed.size() + 1);
+        for (size_t i = 0; i < malformed.size(); ++i) {
+            CHECK_MESSAGE(index.find(malformed[i]) == instance(i + 1), malformed[i]);
+        }
+        CHECK(index.find(guid) == instance(0));
+
+        const auto sorted = index.sorted();
+        CHECK_EQUAL(sorted.size(), index.size());
+        CHECK(std::is_sorted(sorted.begin(), sorted.end()));
+
+        CHECK(index.erase(malformed[3]));
+        CHECK(!index.erase(malformed[3]));
+        CHECK(index.find(malformed[3]) == nullptr);
+        CHECK(index.find(malformed[4]) == instance(5));
+        CHECK_EQUAL(index.size(), malformed.size());
+    }
+
+    return test_utils::report("guid_index");
+}
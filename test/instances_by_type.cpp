@@ -0,0 +1,80 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks that instances_by_type() includes the instances of subtypes in file
+// order and that its results follow instances that are added or removed later on.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace {
+const char* file_contents =
+    TEST_IFC4_HEADER
+    "#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+    "#2=IFCCARTESIANPOINT((1.,0.,0.));\n"
+    "#3=IFCDIRECTION((0.,0.,1.));\n"
+    "#4=IFCPOLYLINE((#1,#2));\n"
+    "#5=IFCPERSON($,'Doe','John',$,$,$,$,$);\n"
+    TEST_IFC_FOOTER;
+} // namespace
+
+int main() {
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(file_contents));
+    std::unique_ptr<IfcParse::IfcFile> other(test_utils::open_buffer(file_contents));
+    CHECK(file->good() && other->good());
+
+    const std::string items = "IfcGeometricRepresentationItem";
+    CHECK((test_utils::ids_of(file->instances_by_type(items)) == std::set<unsigned int>{1, 2, 3, 4}));
+    CHECK((test_utils::ids_of(file->instances_by_type("IfcPoint")) == std::set<unsigned int>{1, 2}));
+    CHECK(!file->instances_by_type("IfcWall"));
+
+    // The lists by exact type are merged back into file order
+    std::vector<unsigned int> in_order;
+    aggregate_of_instance::ptr instances = file->instances_by_type(items);
+    for (auto& inst : *instances) {
+        in_order.push_back(inst->data().id());
+    }
+    CHECK((in_order == std::vector<unsigned int>{1, 2, 3, 4}));
+
+    // Added instances are included in the lists of their supertypes
+    file->addEntity(other->instance_by_id(3), 6);
+    CHECK((test_utils::ids_of(file->instances_by_type(items)) == std::set<unsigned int>{1, 2, 3, 4, 6}));
+    CHECK((test_utils::ids_of(file->instances_by_type("IfcPoint")) == std::set<unsigned int>{1, 2}));
+
+    file->removeEntity(file->instance_by_id(6));
+    CHECK((test_utils::ids_of(file->instances_by_type(items)) == std::set<unsigned int>{1, 2, 3, 4}));
+
+    // As are removals in batch mode and appended instances
+    file->batch();
+    file->removeEntity(file->instance_by_id(4));
+    file->removeEntity(file->instance_by_id(3));
+    file->unbatch();
+    CHECK((test_utils::ids_of(file->instances_by_type(items)) == std::set<unsigned int>{1, 2}));
+
+    file->append(*other, false);
+    CHECK_EQUAL(file->instances_by_type(items)->size(), (unsigned int)6);
+    CHECK_EQUAL(file->instances_by_type("IfcPoint")->size(), (unsigned int)4);
+
+    return test_utils::report("instances_by_type");
+}
@@ -0,0 +1,112 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks IfcFile::merge_duplicates() on duplicated points, directions and
+// property values, on nested duplicates and on reference cycles, both with
+// the inverse maps and with the compact inverse index.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+const char* file_contents =
+    TEST_IFC4_HEADER
+    "#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+    "#2=IFCCARTESIANPOINT((1.,0.,0.));\n"
+    "#3=IFCCARTESIANPOINT((0.,0.,0.));\n"
+    "#4=IFCCARTESIANPOINT((1.,0.,0.));\n"
+    "#5=IFCPOLYLINE((#1,#2));\n"
+    // Only a duplicate once its points are
+    "#6=IFCPOLYLINE((#3,#4));\n"
+    "#7=IFCDIRECTION((0.,0.,1.));\n"
+    "#8=IFCDIRECTION((0.,0.,1.));\n"
+    "#9=IFCAXIS2PLACEMENT3D(#1,#7,$);\n"
+    "#10=IFCAXIS2PLACEMENT3D(#3,#8,$);\n"
+    "#11=IFCPROPERTYSINGLEVALUE('Width',$,IFCLENGTHMEASURE(2.),$);\n"
+    "#12=IFCPROPERTYSINGLEVALUE('Width',$,IFCLENGTHMEASURE(2.),$);\n"
+    "#13=IFCPROPERTYSINGLEVALUE('Width',$,IFCLENGTHMEASURE(3.),$);\n"
+    // Instances of IfcRoot subtypes are never merged
+    "#14=IFCPROPERTYSET('2O2Fr$t4X7Zf8NOew3FLOH',$,'Pset',$,(#11,#13));\n"
+    "#15=IFCPROPERTYSET('0u4wgLe6n0ABVaiXyikbkA',$,'Pset',$,(#12));\n"
+    // Neither are instances in reference cycles
+    "#20=IFCLOCALPLACEMENT(#21,#9);\n"
+    "#21=IFCLOCALPLACEMENT(#20,#10);\n"
+    "#22=IFCLOCALPLACEMENT(#23,#9);\n"
+    "#23=IFCLOCALPLACEMENT(#22,#10);\n"
+    TEST_IFC_FOOTER;
+
+void check_merged(IfcParse::IfcFile& file) {
+    CHECK_EQUAL(file.merge_duplicates(), (size_t)6);
+
+    const std::set<unsigned int> surviving{1, 2, 5, 7, 9, 11, 13, 14, 15, 20, 21, 22, 23};
+    CHECK(test_utils::ids_of(file) == surviving);
+
+    // References to the duplicates are rewritten
+    CHECK_EQUAL(file.instance_by_id(15)->data().toString(true), "#15=IFCPROPERTYSET('0u4wgLe6n0ABVaiXyikbkA',$,'Pset',$,(#11))");
+    CHECK_EQUAL(file.instance_by_id(21)->data().toString(true), "#21=IFCLOCALPLACEMENT(#20,#9)");
+    CHECK_EQUAL(file.instance_by_id(23)->data().toString(true), "#23=IFCLOCALPLACEMENT(#22,#9)");
+    // Instances that are kept are unchanged
+    CHECK_EQUAL(file.instance_by_id(5)->data().toString(true), "#5=IFCPOLYLINE((#1,#2))");
+    CHECK_EQUAL(file.instance_by_id(9)->data().toString(true), "#9=IFCAXIS2PLACEMENT3D(#1,#7,$)");
+
+    // The inverse references of the instances that are kept
+    CHECK((test_utils::ids_of(file.instances_by_reference(1)) == std::set<unsigned int>{5, 9}));
+    CHECK((test_utils::ids_of(file.instances_by_reference(7)) == std::set<unsigned int>{9}));
+    CHECK((test_utils::ids_of(file.instances_by_reference(9)) == std::set<unsigned int>{20, 21, 22, 23}));
+    CHECK((test_utils::ids_of(file.instances_by_reference(11)) == std::set<unsigned int>{14, 15}));
+    CHECK_EQUAL(file.getTotalInverses(9), 4);
+
+    const IfcParse::schema_definition* schema = file.schema();
+    CHECK((test_utils::ids_of(file.getInverse(1, schema->declaration_by_name("IfcPolyline"), 0)) == std::set<unsigned int>{5}));
+    CHECK((test_utils::ids_of(file.getInverse(9, schema->declaration_by_name("IfcLocalPlacement"), 1)) == std::set<unsigned int>{20, 21, 22, 23}));
+    CHECK((test_utils::ids_of(file.getInverse(11, schema->declaration_by_name("IfcPropertySet"), -1)) == std::set<unsigned int>{14, 15}));
+    CHECK((test_utils::ids_of(file.instance_by_id(2)->data().getInverse(schema->declaration_by_name("IfcPolyline"), 0)) == std::set<unsigned int>{5}));
+
+    // The written file holds the instances that are kept, and reads back as such
+    std::ostringstream os;
+    os << file;
+    const std::string written = os.str();
+    CHECK(written.find("#15=IFCPROPERTYSET('0u4wgLe6n0ABVaiXyikbkA',$,'Pset',$,(#11));") != std::string::npos);
+    CHECK(written.find("#3=") == std::string::npos);
+    CHECK(written.find("#12=") == std::string::npos);
+
+    std::unique_ptr<IfcParse::IfcFile> reread(test_utils::open_buffer(written));
+    CHECK(reread->good());
+    CHECK(test_utils::ids_of(*reread) == surviving);
+    CHECK_EQUAL(reread->merge_duplicates(), (size_t)0);
+}
+} // namespace
+
+int main() {
+    for (bool compact : {false, true}) {
+        IfcParse::IfcFile::compact_inverses(compact);
+        std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(file_contents));
+        CHECK(file->good());
+        check_merged(*file);
+    }
+    IfcParse::IfcFile::compact_inverses(false);
+
+    return test_utils::report("merge_duplicates");
+}
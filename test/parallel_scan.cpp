@@ -0,0 +1,92 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks that scanning the DATA section of a large file in parallel reads
+// the same instances and inverse references as scanning it sequentially,
+// also when the ranges would start inside string literals that look like
+// the start of an instance, in which case the file is rescanned.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+// A file large enough to be divided over two threads. When deceptive is set,
+// the instance in the middle has a long string literal that looks like
+// instances when it is not read as a string, so that the range of the
+// second thread starts inside of it.
+std::string file_contents(bool deceptive) {
+    const unsigned int n = 60000;
+    std::string data = TEST_IFC4_HEADER;
+    data.reserve((size_t)n * 200);
+    for (unsigned int i = 0; i < n; ++i) {
+        const std::string id = std::to_string(i * 3 + 1);
+        const std::string p1 = "#" + id, p2 = "#" + std::to_string(i * 3 + 2), p3 = "#" + std::to_string(i * 3 + 3);
+        std::string name = "Name " + id;
+        if (deceptive && i == n / 2) {
+            name.clear();
+            while (name.size() < (1 << 20)) {
+                name += ";\n" + p1 + "=IFCPOLYLINE((#1));";
+            }
+        }
+        data += p1 + "=IFCCARTESIANPOINT((" + id + ".,0.,0.));\n";
+        data += p2 + "=IFCPOLYLINE((" + p1 + "," + (i ? "#1" : p1) + "));\n";
+        data += p3 + "=IFCPROPERTYSINGLEVALUE('" + name + "',$,IFCLABEL('Value'),$);\n";
+    }
+    data += TEST_IFC_FOOTER;
+    return data;
+}
+
+// The instances and the number of references to them
+std::vector<std::string> contents(IfcParse::IfcFile& file) {
+    std::vector<std::string> result;
+    for (auto& p : file) {
+        result.push_back(p.second->data().toString() + " " + std::to_string(file.getTotalInverses(p.first)));
+    }
+    return result;
+}
+} // namespace
+
+int main() {
+    for (bool deceptive : {false, true}) {
+        const std::string data = file_contents(deceptive);
+        CHECK(data.size() > (size_t)2 << 22);
+
+        std::vector<std::string> expected;
+        for (unsigned int n_threads : {1U, 2U}) {
+            IfcParse::IfcFile::num_threads(n_threads);
+            std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(data));
+            CHECK(file->good());
+            const auto result = contents(*file);
+            if (n_threads == 1) {
+                expected = result;
+                CHECK_EQUAL(expected.size(), (size_t)180000);
+                CHECK_EQUAL(file->getTotalInverses(1), 60001);
+            } else {
+                CHECK_MESSAGE(result == expected, std::to_string(n_threads) + " threads");
+            }
+        }
+    }
+    IfcParse::IfcFile::num_threads(0);
+
+    return test_utils::report("parallel_scan");
+}
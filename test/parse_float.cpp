@@ -0,0 +1,177 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks that IfcParse::ParseFloat() and the lexer produce results that are
+// bit-identical to strtod() in the "C" locale, for random reals in the SPF
+// grammar and for the edge cases of the conversion.
+
+#include "../src/ifcparse/IfcParse.h"
+#include "../src/ifcparse/IfcSpfStream.h"
+#include "test_utils.h"
+
+#include <cerrno>
+#include <cfloat>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+bool bit_equal(double a, double b) {
+    return std::memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+std::string hex(double d) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%a", d);
+    return buf;
+}
+
+bool reference_strtod(const std::string& s, double& val) {
+    if (s.empty()) {
+        return false;
+    }
+    char* end;
+    val = strtod(s.c_str(), &end);
+    return end == s.c_str() + s.size();
+}
+
+void check_against_strtod(const std::string& s) {
+    double expected = 0., actual = 0.;
+    const bool expected_ok = reference_strtod(s, expected);
+    const bool actual_ok = IfcParse::ParseFloat(s.c_str(), actual);
+    if (CHECK_MESSAGE(actual_ok == expected_ok, s) && expected_ok) {
+        CHECK_MESSAGE(bit_equal(actual, expected), s + ": " + hex(actual) + " != " + hex(expected));
+    }
+}
+
+std::string digits(std::mt19937_64& rng, int n) {
+    std::string s;
+    for (int i = 0; i < n; ++i) {
+        s += (char)('0' + rng() % 10);
+    }
+    return s;
+}
+
+/// A random real in the SPF grammar: [+-]digits.[digits][(E|e)[+-]digits],
+/// with the exponent reaching past the range of double in both directions.
+std::string random_real(std::mt19937_64& rng) {
+    static const char* signs[] = {"", "", "-", "+"};
+    std::string s = signs[rng() % 4];
+    s += digits(rng, 1 + (int)(rng() % 20));
+    s += '.';
+    s += digits(rng, (int)(rng() % 21));
+    if (rng() % 4) {
+        s += (rng() % 2) ? 'E' : 'e';
+        s += signs[rng() % 4];
+        s += std::to_string(rng() % 351);
+    }
+    return s;
+}
+
+/// A real, with all significant digits, of random bits, which includes
+/// subnormals, but not infinities and NaNs.
+std::string random_double(std::mt19937_64& rng) {
+    double d;
+    do {
+        uint64_t bits = rng();
+        std::memcpy(&d, &bits, sizeof(double));
+    } while (d != d || d - d != 0.);
+    char buf[64];
+    snprintf(buf, sizeof(buf), (rng() % 2) ? "%.17E" : "%.17e", d);
+    return buf;
+}
+
+/// Lexes the reals as an aggregate and checks the tokens against strtod()
+void check_lexer(const std::vector<std::string>& reals) {
+    std::string data = "(";
+    for (auto& s : reals) {
+        if (data.size() > 1) {
+            data += ',';
+        }
+        data += s;
+    }
+    data += ")";
+
+    char* buffer = new char[data.size()];
+    std::memcpy(buffer, data.data(), data.size());
+    IfcParse::IfcSpfStream stream(buffer, data.size());
+    IfcParse::IfcSpfLexer lexer(&stream, nullptr);
+
+    size_t i = 0;
+    for (IfcParse::Token t = lexer.Next(); t.type != IfcParse::Token_NONE; t = lexer.Next()) {
+        if (IfcParse::TokenFunc::isOperator(t)) {
+            continue;
+        }
+        if (!CHECK(i < reals.size())) {
+            break;
+        }
+        const std::string& s = reals[i++];
+        double expected;
+        reference_strtod(s, expected);
+        if (CHECK_MESSAGE(IfcParse::TokenFunc::isFloat(t), s)) {
+            CHECK_MESSAGE(bit_equal(IfcParse::TokenFunc::asFloat(t), expected), s);
+        }
+    }
+    CHECK_EQUAL(i, reals.size());
+}
+} // namespace
+
+int main() {
+    // Edge cases of the grammar
+    const char* edge_cases[] = {
+        "0.", "-0.", "+0.", "0.E0", "1.", "+1.5", "-1.5", "+.5", "-.5", ".5", "5.",
+        "1.E-5", "1.e-5", "1.E+5", "1.e+5", "1.5E5", "1.5e5", "1E5", "1e5", "001.2500",
+        // Subnormals and the boundaries of the range of double
+        "4.9406564584124654E-324", "2.2250738585072009E-308", "2.2250738585072014E-308",
+        "1.7976931348623157E308", "1.5E-320", "-1.5E-320",
+        // Halfway to the smallest subnormal, below and above
+        "2.4703282292062327E-324", "2.4703282292062328E-324",
+        // Out of range, which strtod() rounds to zero or infinity
+        "1.E-400", "-1.E-400", "1.E400", "-1.E400", "1.7976931348623159E308", "1.E99999",
+        // Not a real
+        "", "+", "-", ".", "E5", "1.E", "1.E+", "+-1.", "-+1.", "--1.", "1.2.3", "1.5E5.",
+        "1.0x", "1,0", "1 "};
+    for (auto& s : edge_cases) {
+        check_against_strtod(s);
+    }
+
+    std::mt19937_64 rng(10303);
+    std::vector<std::string> lexable;
+    for (int i = 0; i < 200000; ++i) {
+        const std::string s = (i % 2) ? random_real(rng) : random_double(rng);
+        check_against_strtod(s);
+        if (i % 20 == 0) {
+            lexable.push_back(s);
+        }
+    }
+    for (auto& s : edge_cases) {
+        double d;
+        // Reals which the lexer would otherwise take as integers or enumerations
+        if (reference_strtod(s, d) && s[0] != '.' && strpbrk(s, ".Ee")) {
+            lexable.push_back(s);
+        }
+    }
+    check_lexer(lexable);
+
+    return test_utils::report("parse_float");
+}
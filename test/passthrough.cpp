@@ -0,0 +1,89 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks that writing unmodified instances by copying their text gives the
+// same file as formatting them when the file was written by IfcOpenShell,
+// the same instances otherwise, and that modified instances are formatted.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "../src/ifcparse/IfcWrite.h"
+#include "test_utils.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+namespace {
+const char* file_contents =
+    TEST_IFC4_HEADER
+    "#1=IFCCARTESIANPOINT( (0.,0., 0.) );\n"
+    "#2 = IFCCARTESIANPOINT((1.0E0,0.,0.));\n"
+    "#3=IFCPOLYLINE((#1,/* comment */#2));\n"
+    "#4=IFCPROPERTYSINGLEVALUE('It''s \\X2\\00E9\\X0\\',$,IFCLABEL('Value'),$);\n"
+    "#5=IFCPROPERTYSET('2O2Fr$t4X7Zf8NOew3FLOH',$,'Pset',$,(#4));\n"
+    TEST_IFC_FOOTER;
+
+std::string write(IfcParse::IfcFile& file, bool passthrough) {
+    IfcParse::IfcFile::passthrough_unmodified(passthrough);
+    std::ostringstream os;
+    os << file;
+    IfcParse::IfcFile::passthrough_unmodified(false);
+    return os.str();
+}
+
+// The instances of the file as formatted by IfcOpenShell
+std::string reserialized(const std::string& data) {
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(data));
+    CHECK(file->good());
+    return write(*file, false);
+}
+} // namespace
+
+int main() {
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(file_contents));
+    CHECK(file->good());
+
+    // The original text is copied, which reads back as the same instances
+    const std::string copied = write(*file, true);
+    const std::string formatted = write(*file, false);
+    CHECK(copied.find("#1=IFCCARTESIANPOINT( (0.,0., 0.) );\n") != std::string::npos);
+    CHECK(copied.find("#2=IFCCARTESIANPOINT((1.0E0,0.,0.));\n") != std::string::npos);
+    CHECK(copied.find("#3=IFCPOLYLINE((#1,/* comment */#2));\n") != std::string::npos);
+    CHECK(copied != formatted);
+    CHECK_EQUAL(reserialized(copied), formatted);
+
+    // A file written by IfcOpenShell is copied as it is formatted
+    {
+        std::unique_ptr<IfcParse::IfcFile> written(test_utils::open_buffer(formatted));
+        CHECK_EQUAL(write(*written, true), formatted);
+    }
+
+    // Modified instances are formatted, the others are still copied
+    {
+        IfcWrite::IfcWriteArgument* name = new IfcWrite::IfcWriteArgument();
+        name->set<std::string>("Other");
+        file->instance_by_id(5)->data().setArgument(2, name);
+    }
+    const std::string modified = write(*file, true);
+    CHECK(modified.find("#1=IFCCARTESIANPOINT( (0.,0., 0.) );\n") != std::string::npos);
+    CHECK(modified.find("#5=IFCPROPERTYSET('2O2Fr$t4X7Zf8NOew3FLOH',$,'Other',$,(#4));\n") != std::string::npos);
+    CHECK_EQUAL(reserialized(modified), write(*file, false));
+
+    return test_utils::report("passthrough");
+}
@@ -0,0 +1,119 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks that the string literals the lexer returns without decoding are
+// exactly the ones the character decoder would return unchanged, also for
+// literals long enough for the vectorized scan, and that attribute values
+// read through either path agree.
+
+#include "../src/ifcparse/IfcCharacterDecoder.h"
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+/// Compares the fast path with the decoder for a single literal. Returns
+/// whether the fast path was taken.
+bool compare_with_decoder(const std::string& literal) {
+    // The decoder needs a character after the closing apostrophe
+    const std::string contents = literal + ",";
+    char* buffer = new char[contents.size()];
+    std::memcpy(buffer, contents.data(), contents.size());
+    IfcParse::IfcSpfStream stream(buffer, contents.size());
+    IfcParse::IfcSpfLexer lexer(&stream, nullptr);
+
+    std::string_view plain;
+    const bool fast = lexer.PlainString(0, plain);
+    if (fast) {
+        IfcParse::IfcCharacterDecoder decoder(&stream);
+        size_t offset = 1;
+        const std::string decoded = decoder.get(offset);
+        CHECK_MESSAGE(decoded == "'" + std::string(plain) + "'", literal);
+    }
+    return fast;
+}
+} // namespace
+
+int main() {
+    CHECK(compare_with_decoder("''"));
+    CHECK(compare_with_decoder("'abc'"));
+    CHECK(compare_with_decoder("'2O2Fr$t4X7Zf8NOew3FLOH'"));
+    CHECK(compare_with_decoder("'~ !\"#%&()*+,-./:;<=>?@[]^_`{|}'"));
+
+    // Doubled apostrophes, escape sequences, control characters and bytes
+    // outside of ASCII all need the decoder
+    CHECK(!compare_with_decoder("'It''s'"));
+    CHECK(!compare_with_decoder("''''"));
+    CHECK(!compare_with_decoder("'a\\\\b'"));
+    CHECK(!compare_with_decoder("'\\X2\\00E9\\X0\\'"));
+    CHECK(!compare_with_decoder("'\\X\\E9'"));
+    CHECK(!compare_with_decoder("'\\S\\a'"));
+    CHECK(!compare_with_decoder("'\\PA\\'"));
+    CHECK(!compare_with_decoder("'a\tb'"));
+    CHECK(!compare_with_decoder("'caf\xc3\xa9'"));
+    CHECK(!compare_with_decoder("'a\x7f'"));
+
+    // Unterminated literals and other tokens are not plain strings
+    CHECK(!compare_with_decoder("'abc"));
+    CHECK(!compare_with_decoder("abc"));
+    CHECK(!compare_with_decoder(".T."));
+
+    // Every position of a special character relative to the 16 byte blocks
+    // of the vectorized scan
+    const std::vector<std::string> specials = {"''", "\\\\", "\\X2\\0041\\X0\\", "\t", "\xc3\xa9"};
+    for (size_t n = 0; n < 40; ++n) {
+        const std::string prefix(n, 'a');
+        CHECK_MESSAGE(compare_with_decoder("'" + prefix + "'"), std::to_string(n));
+        CHECK_MESSAGE(compare_with_decoder("'" + prefix + "'" + std::string(20, 'b')), std::to_string(n));
+        for (const auto& special : specials) {
+            CHECK_MESSAGE(!compare_with_decoder("'" + prefix + special + std::string(40 - n, 'b') + "'"), std::to_string(n));
+        }
+    }
+
+    // Attribute values are the same whether the literal was plain or decoded,
+    // also when interned
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(
+        TEST_IFC4_HEADER
+        "#1=IFCPROPERTYSINGLEVALUE('Name with enough characters to be scanned in blocks',$,$,$);\n"
+        "#2=IFCPROPERTYSINGLEVALUE('\\X2\\004E\\X0\\ame with enough characters to be scanned in blocks',$,$,$);\n"
+        "#3=IFCPROPERTYSINGLEVALUE('It''s',$,$,$);\n"
+        "#4=IFCPROPERTYSINGLEVALUE('caf\\X2\\00E9\\X0\\',$,$,$);\n"
+        TEST_IFC_FOOTER));
+    CHECK(file->good());
+    const auto name = [&file](int id) {
+        return static_cast<std::string>(*file->instance_by_id(id)->data().getArgument(0));
+    };
+    const auto interned = [&file](int id) {
+        return file->instance_by_id(id)->data().getArgument(0)->interned_string();
+    };
+    CHECK_EQUAL(name(1), "Name with enough characters to be scanned in blocks");
+    CHECK_EQUAL(name(2), name(1));
+    CHECK_EQUAL(name(3), "It's");
+    CHECK_EQUAL(name(4), "caf\xc3\xa9");
+    CHECK_EQUAL(interned(1), name(1));
+    CHECK_EQUAL(interned(2), interned(1));
+    CHECK(interned(2).data() == interned(1).data());
+    CHECK_EQUAL(interned(3), name(3));
+
+    return test_utils::report("plain_string");
+}
@@ -0,0 +1,161 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks that a file opened with its sidecar index reads the same instances
+// and inverse references as scanning it, and that the index is rejected once
+// the file changes, also when its size and modification time do not, or
+// when the index itself is damaged.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+const std::string file_contents =
+    TEST_IFC4_HEADER
+    "#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+    "#2=IFCCARTESIANPOINT((1.,0.,0.));\n"
+    "#3=IFCPOLYLINE((#1,#2,#1));\n"
+    "#4=IFCPROPERTYSINGLEVALUE('Width',$,IFCLENGTHMEASURE(2.),$);\n"
+    "#5=IFCPROPERTYSET('2O2Fr$t4X7Zf8NOew3FLOH',$,'Pset',$,(#4));\n"
+    "#6=IFCWALL('0u4wgLe6n0ABVaiXyikbkA',$,'Wall',$,$,$,$,$,$);\n"
+    "#7=IFCRELDEFINESBYPROPERTIES('1kTvXnbbzCWw8lcMd1dR4o',$,$,$,(#6),#5);\n"
+    TEST_IFC_FOOTER;
+
+void write(const std::filesystem::path& path, const std::string& data) {
+    std::ofstream os(path, std::ios::binary);
+    os << data;
+}
+
+// The instances, the GlobalIds and the references to every instance
+std::vector<std::string> contents(IfcParse::IfcFile& file) {
+    std::vector<std::string> result;
+    for (auto& p : file) {
+        std::string line = p.second->data().toString() + " <-";
+        const aggregate_of_instance::ptr references = file.instances_by_reference(p.first);
+        for (auto& inst : *references) {
+            line += " #" + std::to_string(inst->data().id());
+        }
+        result.push_back(line);
+    }
+    result.push_back(file.instance_by_guid("0u4wgLe6n0ABVaiXyikbkA")->data().toString());
+    return result;
+}
+
+std::ostringstream log_messages;
+
+// Opens the file, returns its contents and sets rejected when the log says
+// that the index is outdated
+std::vector<std::string> open(const std::filesystem::path& path, bool& rejected) {
+    log_messages.str("");
+    std::unique_ptr<IfcParse::IfcFile> file(new IfcParse::IfcFile(path.string()));
+    CHECK(file->good());
+    rejected = log_messages.str().find("outdated") != std::string::npos;
+    return contents(*file);
+}
+} // namespace
+
+int main() {
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "ifcopenshell_test_sidecar_index.ifc";
+    const std::filesystem::path index_path = path.string() + ".idx";
+    std::filesystem::remove(index_path);
+    write(path, file_contents);
+
+    Logger::SetOutput(nullptr, &log_messages);
+    Logger::Verbosity(Logger::LOG_NOTICE);
+    IfcParse::IfcFile::sidecar_index(true);
+
+    for (bool compact : {false, true}) {
+        IfcParse::IfcFile::compact_inverses(compact);
+        std::unique_ptr<IfcParse::IfcFile> scanned(test_utils::open_buffer(file_contents));
+        const auto expected = contents(*scanned);
+
+        bool rejected;
+        std::filesystem::remove(index_path);
+        CHECK(open(path, rejected) == expected);
+        CHECK(std::filesystem::exists(index_path));
+
+        // Read from the index
+        CHECK(open(path, rejected) == expected);
+        CHECK(!rejected);
+    }
+    IfcParse::IfcFile::compact_inverses(false);
+
+    // The same size and modification time, but another width
+    {
+        const auto mtime = std::filesystem::last_write_time(path);
+        std::string changed = file_contents;
+        changed.replace(changed.find("(2.)"), 4, "(3.)");
+        write(path, changed);
+        std::filesystem::last_write_time(path, mtime);
+
+        std::unique_ptr<IfcParse::IfcFile> scanned(test_utils::open_buffer(changed));
+        bool rejected;
+        CHECK(open(path, rejected) == contents(*scanned));
+        CHECK(rejected);
+        CHECK(open(path, rejected) == contents(*scanned));
+        CHECK(!rejected);
+    }
+
+    // Another size
+    {
+        std::string changed = file_contents;
+        changed.replace(changed.find("'Wall'"), 6, "'Other wall'");
+        write(path, changed);
+
+        std::unique_ptr<IfcParse::IfcFile> scanned(test_utils::open_buffer(changed));
+        bool rejected;
+        CHECK(open(path, rejected) == contents(*scanned));
+        CHECK(rejected);
+    }
+
+    // A damaged index of the same size is detected by the hash of its body
+    {
+        std::ifstream is(index_path, std::ios::binary);
+        std::string index((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+        is.close();
+        index[index.size() - 3] ^= 0x20;
+        write(index_path, index);
+
+        log_messages.str("");
+        std::unique_ptr<IfcParse::IfcFile> file(new IfcParse::IfcFile(path.string()));
+        CHECK(file->good());
+        CHECK(log_messages.str().find("corrupt") != std::string::npos);
+        CHECK(file->instance_by_guid("0u4wgLe6n0ABVaiXyikbkA") != nullptr);
+    }
+
+    // No temporary files are left next to the index
+    for (auto& entry : std::filesystem::directory_iterator(path.parent_path())) {
+        const std::string name = entry.path().filename().string();
+        CHECK_MESSAGE(name.rfind(index_path.filename().string() + ".", 0) != 0, name);
+    }
+
+    IfcParse::IfcFile::sidecar_index(false);
+    std::filesystem::remove(path);
+    std::filesystem::remove(index_path);
+
+    return test_utils::report("sidecar_index");
+}
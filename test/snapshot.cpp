@@ -0,0 +1,174 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks that a snapshot written by IfcFile::write_snapshot() reads back as
+// the same instances, that snapshots of another schema are rejected, and that
+// corrupt nested cells are rejected instead of being followed. Also checks
+// that the hash of the schema covers the number and types of attributes.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "../src/ifcparse/IfcSnapshot.h"
+#include "test_utils.h"
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+const char* file_contents =
+    TEST_IFC4_HEADER
+    "#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+    "#2=IFCCARTESIANPOINT((1.,0.,0.));\n"
+    "#3=IFCPOLYLINE((#1,#2));\n"
+    "#4=IFCCARTESIANPOINTLIST3D(((0.,0.,0.),(1.,2.,3.)),$);\n"
+    "#5=IFCPROPERTYSINGLEVALUE('Name',$,IFCLABEL('Value'),$);\n"
+    TEST_IFC_FOOTER;
+
+/// Returns the serialization of the instances by id, loading all of them
+std::map<unsigned int, std::string> instances(IfcParse::IfcFile& file, int& num_errors) {
+    std::map<unsigned int, std::string> result;
+    num_errors = 0;
+    for (auto& p : file) {
+        try {
+            result[p.first] = p.second->data().toString();
+        } catch (const IfcParse::IfcException& e) {
+            CHECK_MESSAGE(std::string(e.what()).find("Corrupt") == 0, e.what());
+            ++num_errors;
+        }
+    }
+    return result;
+}
+
+/// Returns a copy of the snapshot in which the value of the first cell of
+/// the given kind is replaced by fn(offset of the cell)
+template <typename Fn>
+std::string corrupt_cell(const std::string& snapshot, IfcParse::snapshot::cell_kind kind, Fn fn) {
+    std::string result = snapshot;
+    IfcParse::snapshot::header h;
+    std::memcpy(&h, result.data(), sizeof(h));
+    for (uint64_t i = 0; i < h.num_cells; ++i) {
+        const uint64_t offset = h.cells_offset + i * sizeof(IfcParse::snapshot::cell);
+        IfcParse::snapshot::cell c;
+        std::memcpy(&c, result.data() + offset, sizeof(c));
+        if (c.kind == kind) {
+            c.value = fn(offset);
+            std::memcpy(&result[offset], &c, sizeof(c));
+            return result;
+        }
+    }
+    CHECK_MESSAGE(false, "No cell of kind " + std::to_string(kind));
+    return result;
+}
+
+/// A schema with a single entity with attributes of the given simple types,
+/// the last of which is an aggregate of them when aggregate is set
+IfcParse::schema_definition* make_schema(const std::vector<IfcParse::simple_type::data_type>& types, bool aggregate = false) {
+    auto e = new IfcParse::entity("IfcThing", false, 0, nullptr);
+    std::vector<const IfcParse::attribute*> attributes;
+    for (size_t i = 0; i < types.size(); ++i) {
+        IfcParse::parameter_type* t = new IfcParse::simple_type(types[i]);
+        if (aggregate && i + 1 == types.size()) {
+            t = new IfcParse::aggregation_type(IfcParse::aggregation_type::list_type, 1, -1, t);
+        }
+        attributes.push_back(new IfcParse::attribute("Attribute" + std::to_string(i), t, false));
+    }
+    e->set_attributes(attributes, std::vector<bool>(attributes.size(), false));
+    return new IfcParse::schema_definition("TEST", {e}, nullptr);
+}
+} // namespace
+
+int main() {
+    // The hash of the schema covers the attributes and not only the names
+    {
+        using st = IfcParse::simple_type;
+        std::unique_ptr<IfcParse::schema_definition> a(make_schema({st::string_type, st::real_type}));
+        std::unique_ptr<IfcParse::schema_definition> same(make_schema({st::string_type, st::real_type}));
+        std::unique_ptr<IfcParse::schema_definition> type(make_schema({st::string_type, st::integer_type}));
+        std::unique_ptr<IfcParse::schema_definition> count(make_schema({st::string_type}));
+        std::unique_ptr<IfcParse::schema_definition> list(make_schema({st::string_type, st::real_type}, true));
+        const uint64_t h = IfcParse::snapshot::declarations_hash(a.get());
+        CHECK_EQUAL(IfcParse::snapshot::declarations_hash(same.get()), h);
+        CHECK(IfcParse::snapshot::declarations_hash(type.get()) != h);
+        CHECK(IfcParse::snapshot::declarations_hash(count.get()) != h);
+        CHECK(IfcParse::snapshot::declarations_hash(list.get()) != h);
+    }
+
+    std::unique_ptr<IfcParse::IfcFile> original(test_utils::open_buffer(file_contents));
+    CHECK(original->good());
+
+    std::ostringstream os;
+    original->write_snapshot(os);
+    const std::string snapshot = os.str();
+
+    int num_errors;
+    const auto expected = instances(*original, num_errors);
+
+    {
+        std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(snapshot));
+        CHECK(file->good());
+        CHECK(file->from_snapshot());
+        CHECK(instances(*file, num_errors) == expected);
+        CHECK_EQUAL(num_errors, 0);
+    }
+
+    // Snapshots written for another schema or revision of the schema
+    {
+        std::string other = snapshot;
+        IfcParse::snapshot::header h;
+        std::memcpy(&h, other.data(), sizeof(h));
+        h.declarations_hash ^= 1;
+        std::memcpy(&other[0], &h, sizeof(h));
+        std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(other));
+        CHECK(file->good().value() == IfcParse::file_open_status::UNSUPPORTED_SCHEMA);
+    }
+    {
+        std::string other = snapshot;
+        IfcParse::snapshot::header h;
+        std::memcpy(&h, other.data(), sizeof(h));
+        std::strncpy(h.schema, "IFC2X3", sizeof(h.schema));
+        std::memcpy(&other[0], &h, sizeof(h));
+        std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(other));
+        CHECK(file->good().value() == IfcParse::file_open_status::UNSUPPORTED_SCHEMA);
+    }
+
+    const size_t cell_size = sizeof(IfcParse::snapshot::cell);
+
+    // Cells of aggregates and simple types that point to themselves or to an
+    // earlier cell would be followed indefinitely
+    for (auto kind : {IfcParse::snapshot::CELL_AGGREGATE, IfcParse::snapshot::CELL_TYPED}) {
+        for (uint64_t delta : {(uint64_t)0, (uint64_t)cell_size}) {
+            std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(corrupt_cell(snapshot, kind, [delta](uint64_t offset) { return offset - delta; })));
+            CHECK(file->good());
+            instances(*file, num_errors);
+            CHECK_EQUAL(num_errors, 1);
+        }
+    }
+
+    // Past the end of the snapshot
+    {
+        std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(corrupt_cell(snapshot, IfcParse::snapshot::CELL_AGGREGATE, [&snapshot](uint64_t) { return snapshot.size(); })));
+        instances(*file, num_errors);
+        CHECK_EQUAL(num_errors, 1);
+    }
+
+    return test_utils::report("snapshot");
+}
@@ -0,0 +1,94 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks that IfcFile::stream_instances() visits the instances in file order
+// and that their references are read as ids with Argument::reference_id().
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+const char* file_contents =
+    TEST_IFC4_HEADER
+    "#2=IFCSIUNIT(*,.LENGTHUNIT.,.MILLI.,.METRE.);\n"
+    "#3=IFCSIUNIT(*,.AREAUNIT.,$,.SQUARE_METRE.);\n"
+    "#4=IFCUNITASSIGNMENT((#2,#3));\n"
+    "#5=IFCCARTESIANPOINT((0.,0.,0.));\n"
+    "#7=IFCAXIS2PLACEMENT3D(#5,$,$);\n"
+    "#6=IFCLOCALPLACEMENT($,#7);\n"
+    TEST_IFC_FOOTER;
+
+IfcParse::IfcSpfStream* open_stream() {
+    const size_t len = std::strlen(file_contents);
+    char* buffer = new char[len];
+    std::memcpy(buffer, file_contents, len);
+    return new IfcParse::IfcSpfStream(buffer, len);
+}
+} // namespace
+
+int main() {
+    std::vector<unsigned int> ids;
+    std::vector<std::string> types;
+    std::vector<unsigned int> units;
+    unsigned int location = 0, relative_placement = 0;
+    bool placement_rel_to_null = false;
+
+    const auto status = IfcParse::IfcFile::stream_instances(open_stream(), [&](const IfcEntityInstanceData& data) {
+        ids.push_back(data.id());
+        types.push_back(data.type()->name());
+        if (data.type()->name() == "IfcUnitAssignment") {
+            Argument* list = data.getArgument(0);
+            for (unsigned int i = 0; i < list->size(); ++i) {
+                units.push_back((*list)[i]->reference_id());
+            }
+        } else if (data.type()->name() == "IfcAxis2Placement3D") {
+            location = data.getArgument(0)->reference_id();
+        } else if (data.type()->name() == "IfcLocalPlacement") {
+            placement_rel_to_null = data.getArgument(0)->isNull();
+            relative_placement = data.getArgument(1)->reference_id();
+        } else if (data.type()->name() == "IfcCartesianPoint") {
+            // Not a reference
+            bool thrown = false;
+            try {
+                data.getArgument(0)->reference_id();
+            } catch (const IfcParse::IfcException&) {
+                thrown = true;
+            }
+            CHECK(thrown);
+        }
+    });
+
+    CHECK(status.value() == IfcParse::file_open_status::SUCCESS);
+    CHECK((ids == std::vector<unsigned int>{2, 3, 4, 5, 7, 6}));
+    CHECK((types == std::vector<std::string>{"IfcSIUnit", "IfcSIUnit", "IfcUnitAssignment", "IfcCartesianPoint", "IfcAxis2Placement3D", "IfcLocalPlacement"}));
+    CHECK((units == std::vector<unsigned int>{2, 3}));
+    CHECK_EQUAL(location, 5U);
+    CHECK_EQUAL(relative_placement, 7U);
+    CHECK(placement_rel_to_null);
+
+    // The same ids when the references are read from a file in memory
+    IfcParse::IfcFile file(open_stream());
+    CHECK_EQUAL(file.instance_by_id(7)->data().getArgument(0)->reference_id(), 5U);
+
+    return test_utils::report("stream_instances");
+}
@@ -0,0 +1,134 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+#ifndef IFCPARSE_TEST_UTILS_H
+#define IFCPARSE_TEST_UTILS_H
+
+// Minimal checks for the IfcParse tests, which are plain executables that
+// ctest runs and that fail by returning a non-zero exit code.
+
+#include "../src/ifcparse/IfcFile.h"
+
+#include <cstring>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+/// The start of an IFC4 file up to the instances, and the end after them,
+/// as literals so that they concatenate with the instances of a test file
+#define TEST_IFC4_HEADER                                                \
+    "ISO-10303-21;\n"                                                   \
+    "HEADER;\n"                                                         \
+    "FILE_DESCRIPTION(('ViewDefinition [CoordinationView]'),'2;1');\n"  \
+    "FILE_NAME('','',(''),(''),'','','');\n"                            \
+    "FILE_SCHEMA(('IFC4'));\n"                                          \
+    "ENDSEC;\n"                                                         \
+    "DATA;\n"
+#define TEST_IFC_FOOTER \
+    "ENDSEC;\n"         \
+    "END-ISO-10303-21;\n"
+
+namespace test_utils {
+/// Opens a file from a copy of data, of which the file takes ownership
+inline IfcParse::IfcFile* open_buffer(const std::string& data) {
+    char* buffer = new char[data.size()];
+    std::memcpy(buffer, data.data(), data.size());
+    return new IfcParse::IfcFile(buffer, data.size());
+}
+
+/// A reference to the instance with the given id, as it is written in a file
+inline std::string ref(unsigned int id) {
+    return "#" + std::to_string(id);
+}
+
+/// Lines of n cartesian points with consecutive ids from first, of which the
+/// x coordinate is the index of the point
+inline std::string cartesian_points(unsigned int first, unsigned int n) {
+    std::string data;
+    for (unsigned int i = 0; i < n; ++i) {
+        data += ref(first + i) + "=IFCCARTESIANPOINT((" + std::to_string(i) + ".,0.,0.));\n";
+    }
+    return data;
+}
+
+/// The ids of the instances of a file
+inline std::set<unsigned int> ids_of(IfcParse::IfcFile& file) {
+    std::set<unsigned int> ids;
+    for (auto& p : file) {
+        ids.insert(p.first);
+    }
+    return ids;
+}
+
+/// The ids of the instances of a list, which may be null
+inline std::set<unsigned int> ids_of(const aggregate_of_instance::ptr& instances) {
+    std::set<unsigned int> ids;
+    if (instances) {
+        for (auto& inst : *instances) {
+            ids.insert(inst->data().id());
+        }
+    }
+    return ids;
+}
+
+/// The ids of the instances of a list in the order of the list, with duplicates
+inline std::vector<unsigned int> ids_in_order(const aggregate_of_instance::ptr& instances) {
+    std::vector<unsigned int> ids;
+    if (instances) {
+        for (auto& inst : *instances) {
+            ids.push_back(inst->data().id());
+        }
+    }
+    return ids;
+}
+
+inline int& failures() {
+    static int n = 0;
+    return n;
+}
+
+inline bool check(bool condition, const char* expression, const char* file, int line, const std::string& message = "") {
+    if (!condition) {
+        ++failures();
+        std::cerr << file << ":" << line << ": check failed: " << expression;
+        if (!message.empty()) {
+            std::cerr << " (" << message << ")";
+        }
+        std::cerr << std::endl;
+    }
+    return condition;
+}
+
+/// Returns the exit code of a test
+inline int report(const char* name) {
+    if (failures()) {
+        std::cerr << name << ": " << failures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << name << ": passed" << std::endl;
+    return 0;
+}
+} // namespace test_utils
+
+#define CHECK(expr) test_utils::check((expr), #expr, __FILE__, __LINE__)
+#define CHECK_MESSAGE(expr, message) test_utils::check((expr), #expr, __FILE__, __LINE__, (message))
+#define CHECK_EQUAL(a, b) test_utils::check((a) == (b), #a " == " #b, __FILE__, __LINE__)
+
+#endif
@@ -0,0 +1,283 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks depth-first and breadth-first traversal from several roots that
+// share parts of a graph with cycles against straightforward traversals
+// with a std::set, with and without a maximum level, that traversing from
+// several roots visits the union of the instances reachable from each root,
+// at the shortest distance for breadth-first traversal, and that the result
+// of breadth-first traversal does not depend on the number of threads.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+typedef std::vector<std::pair<unsigned int, int>> visits;
+
+const unsigned int num_points = 2000;
+const unsigned int num_polylines = 3000;
+const unsigned int num_segments = 600;
+const unsigned int num_composites = 400;
+const unsigned int first_polyline = num_points + 1;
+const unsigned int first_segment = first_polyline + num_polylines;
+const unsigned int first_composite = first_segment + num_segments;
+const unsigned int first_root = first_composite + num_composites;
+
+// Points, polylines of points, and composite curves of segments of
+// polylines and of other composite curves, which form cycles, with four
+// curve sets as roots: one referencing all polylines, so that a level is
+// wide enough to be read on several threads, and three overlapping ones
+// referencing composite curves and points.
+std::string file_contents() {
+    uint32_t state = 12345;
+    const auto random = [&state](unsigned int n) {
+        state = state * 1664525 + 1013904223;
+        return (state >> 8) % n;
+    };
+    using test_utils::ref;
+
+    std::string data = TEST_IFC4_HEADER + test_utils::cartesian_points(1, num_points);
+    for (unsigned int i = 0; i < num_polylines; ++i) {
+        std::string points;
+        for (unsigned int j = 0, n = 2 + random(3); j < n; ++j) {
+            points += (j ? "," : "") + ref(1 + random(num_points));
+        }
+        data += ref(first_polyline + i) + "=IFCPOLYLINE((" + points + "));\n";
+    }
+    for (unsigned int i = 0; i < num_segments; ++i) {
+        const unsigned int curve = random(4) ? first_polyline + random(num_polylines) : first_composite + random(num_composites);
+        data += ref(first_segment + i) + "=IFCCOMPOSITECURVESEGMENT(.CONTINUOUS.,.T.," + ref(curve) + ");\n";
+    }
+    for (unsigned int i = 0; i < num_composites; ++i) {
+        std::string segments;
+        for (unsigned int j = 0, n = 1 + random(3); j < n; ++j) {
+            segments += (j ? "," : "") + ref(first_segment + random(num_segments));
+        }
+        data += ref(first_composite + i) + "=IFCCOMPOSITECURVE((" + segments + "),.F.);\n";
+    }
+    std::string polylines;
+    for (unsigned int i = 0; i < num_polylines; ++i) {
+        polylines += (i ? "," : "") + ref(first_polyline + i);
+    }
+    data += ref(first_root) + "=IFCGEOMETRICCURVESET((" + polylines + "));\n";
+    for (unsigned int i = 1; i < 4; ++i) {
+        std::string elements;
+        for (unsigned int j = 0; j < 20; ++j) {
+            elements += ref(first_composite + i * 50 + j * 3) + ",";
+        }
+        data += ref(first_root + i) + "=IFCGEOMETRICCURVESET((" + elements + ref(1 + i) + "));\n";
+    }
+    data += TEST_IFC_FOOTER;
+    return data;
+}
+
+// The instances referenced by the attributes of inst, in order
+std::vector<IfcUtil::IfcBaseClass*> references(IfcUtil::IfcBaseClass* inst) {
+    std::vector<IfcUtil::IfcBaseClass*> result;
+    const IfcEntityInstanceData& data = inst->data();
+    for (size_t i = 0; i < data.getArgumentCount(); ++i) {
+        Argument* argument = data.getArgument(i);
+        if (argument->type() == IfcUtil::Argument_ENTITY_INSTANCE) {
+            result.push_back(*argument);
+        } else if (argument->type() == IfcUtil::Argument_AGGREGATE_OF_ENTITY_INSTANCE) {
+            const aggregate_of_instance::ptr list = *argument;
+            result.insert(result.end(), list->begin(), list->end());
+        }
+    }
+    return result;
+}
+
+bool expands(int level, int max_level) {
+    return max_level <= 0 || level < max_level;
+}
+
+void expected_depth_first(IfcUtil::IfcBaseClass* inst, int level, int max_level, std::set<IfcUtil::IfcBaseClass*>& visited, visits& result) {
+    if (!visited.insert(inst).second) {
+        return;
+    }
+    result.emplace_back(inst->data().id(), level);
+    if (expands(level, max_level)) {
+        for (auto& reference : references(inst)) {
+            expected_depth_first(reference, level + 1, max_level, visited, result);
+        }
+    }
+}
+
+visits expected_depth_first(const std::vector<IfcUtil::IfcBaseClass*>& roots, int max_level) {
+    std::set<IfcUtil::IfcBaseClass*> visited;
+    visits result;
+    for (auto& root : roots) {
+        if (root) {
+            expected_depth_first(root, 0, max_level, visited, result);
+        }
+    }
+    return result;
+}
+
+visits expected_breadth_first(const std::vector<IfcUtil::IfcBaseClass*>& roots, int max_level) {
+    std::set<IfcUtil::IfcBaseClass*> visited;
+    std::deque<std::pair<IfcUtil::IfcBaseClass*, int>> queue;
+    visits result;
+    for (auto& root : roots) {
+        if (root && visited.insert(root).second) {
+            queue.emplace_back(root, 0);
+        }
+    }
+    while (!queue.empty()) {
+        const auto p = queue.front();
+        queue.pop_front();
+        result.emplace_back(p.first->data().id(), p.second);
+        if (expands(p.second, max_level)) {
+            for (auto& reference : references(p.first)) {
+                if (visited.insert(reference).second) {
+                    queue.emplace_back(reference, p.second + 1);
+                }
+            }
+        }
+    }
+    return result;
+}
+
+template <typename Fn>
+visits traversed(Fn&& traverse, const std::vector<IfcUtil::IfcBaseClass*>& roots, int max_level) {
+    visits result;
+    traverse(roots, [&result](IfcUtil::IfcBaseClass* inst, int level) { result.emplace_back(inst->data().id(), level); }, max_level);
+    return result;
+}
+
+visits depth_first(const std::vector<IfcUtil::IfcBaseClass*>& roots, int max_level) {
+    return traversed(static_cast<void (*)(const std::vector<IfcUtil::IfcBaseClass*>&, const IfcParse::traversal_visitor&, int)>(&IfcParse::traverse), roots, max_level);
+}
+
+visits breadth_first(const std::vector<IfcUtil::IfcBaseClass*>& roots, int max_level) {
+    return traversed(static_cast<void (*)(const std::vector<IfcUtil::IfcBaseClass*>&, const IfcParse::traversal_visitor&, int)>(&IfcParse::traverse_breadth_first), roots, max_level);
+}
+
+bool visited_once(const visits& result) {
+    std::set<unsigned int> ids;
+    for (auto& p : result) {
+        if (!ids.insert(p.first).second) {
+            return false;
+        }
+    }
+    return true;
+}
+} // namespace
+
+int main() {
+    const std::string data = file_contents();
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(data));
+    CHECK(file->good());
+
+    IfcUtil::IfcBaseClass* wide = file->instance_by_id(first_root);
+    IfcUtil::IfcBaseClass* a = file->instance_by_id(first_root + 1);
+    IfcUtil::IfcBaseClass* b = file->instance_by_id(first_root + 2);
+    IfcUtil::IfcBaseClass* c = file->instance_by_id(first_root + 3);
+
+    const std::vector<std::vector<IfcUtil::IfcBaseClass*>> root_sets = {
+        {a},
+        {wide},
+        {a, b},
+        {c, b, a, wide},
+        {b, b, nullptr, a, c},
+        {file->instance_by_id(first_polyline), a},
+    };
+    for (auto& roots : root_sets) {
+        for (int max_level : {-1, 0, 1, 2, 5}) {
+            const std::string message = std::to_string(roots.size()) + " roots, max_level " + std::to_string(max_level);
+            const visits dfs = depth_first(roots, max_level);
+            const visits bfs = breadth_first(roots, max_level);
+            CHECK_MESSAGE(dfs == expected_depth_first(roots, max_level), message);
+            CHECK_MESSAGE(bfs == expected_breadth_first(roots, max_level), message);
+            CHECK_MESSAGE(visited_once(dfs) && visited_once(bfs), message);
+        }
+    }
+
+    // Traversing from several roots visits the union of what is reachable
+    // from each, breadth-first at the least distance from any of them
+    const std::vector<IfcUtil::IfcBaseClass*> roots = {a, b, c};
+    for (int max_level : {-1, 2}) {
+        std::set<unsigned int> depth_first_union;
+        std::map<unsigned int, int> breadth_first_union;
+        for (auto& root : roots) {
+            if (max_level <= 0) {
+                const aggregate_of_instance::ptr reached = IfcParse::traverse(root);
+                for (auto& inst : *reached) {
+                    depth_first_union.insert(inst->data().id());
+                }
+            }
+            for (auto& p : breadth_first({root}, max_level)) {
+                auto it = breadth_first_union.insert(p).first;
+                it->second = (std::min)(it->second, p.second);
+            }
+        }
+        if (max_level <= 0) {
+            std::set<unsigned int> reached;
+            for (auto& p : depth_first(roots, max_level)) {
+                reached.insert(p.first);
+            }
+            CHECK(reached == depth_first_union);
+        }
+        const visits bfs = breadth_first(roots, max_level);
+        const std::map<unsigned int, int> reached(bfs.begin(), bfs.end());
+        CHECK(reached == breadth_first_union);
+    }
+
+    // The list returning functions visit the same instances in the same order
+    const aggregate_of_instance::ptr dfs_list = file->traverse(a, 3);
+    const aggregate_of_instance::ptr bfs_list = file->traverse_breadth_first(a, 3);
+    const visits dfs = depth_first({a}, 3);
+    const visits bfs = breadth_first({a}, 3);
+    CHECK_EQUAL(dfs_list->size(), (unsigned int)dfs.size());
+    CHECK_EQUAL(bfs_list->size(), (unsigned int)bfs.size());
+    for (unsigned int i = 0; i < dfs_list->size() && i < dfs.size(); ++i) {
+        CHECK_EQUAL((*dfs_list)[i]->data().id(), dfs[i].first);
+    }
+    for (unsigned int i = 0; i < bfs_list->size() && i < bfs.size(); ++i) {
+        CHECK_EQUAL((*bfs_list)[i]->data().id(), bfs[i].first);
+    }
+
+    // The wide level of all polylines is read on several threads, from files
+    // in which the instances are parsed during the traversal
+    visits expected;
+    for (unsigned int n_threads : {1U, 4U}) {
+        IfcParse::IfcFile::num_threads(n_threads);
+        std::unique_ptr<IfcParse::IfcFile> other(test_utils::open_buffer(data));
+        const std::vector<IfcUtil::IfcBaseClass*> other_roots = {other->instance_by_id(first_root + 2), other->instance_by_id(first_root)};
+        const visits result = breadth_first(other_roots, -1);
+        if (n_threads == 1) {
+            expected = result;
+            CHECK(expected.size() > num_polylines);
+        } else {
+            CHECK(result == expected);
+        }
+    }
+    IfcParse::IfcFile::num_threads(0);
+
+    return test_utils::report("traverse_roots");
+}
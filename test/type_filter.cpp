@@ -0,0 +1,85 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks that a type filter reads the instances of the types and their
+// subtypes, the instances they refer to and the spatial structure that
+// contains them up to the project, and skips the other instances.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <memory>
+#include <set>
+#include <string>
+
+namespace {
+const char* file_contents =
+    TEST_IFC4_HEADER
+    "#1=IFCPROJECT('2O2Fr$t4X7Zf8NOew3FLOH',$,'Project',$,$,$,$,$,$);\n"
+    "#2=IFCSITE('0u4wgLe6n0ABVaiXyikbkA',$,'Site',$,$,$,$,$,$,$,$,$,$,$);\n"
+    "#3=IFCBUILDINGSTOREY('1kTvXnbbzCWw8lcMd1dR4o',$,'Storey',$,$,$,$,$,$,$);\n"
+    "#4=IFCRELAGGREGATES('3MlZRLaHf4QBcOFgtyXb6g',$,$,$,#1,(#2));\n"
+    "#5=IFCRELAGGREGATES('1H4iZVkOP9bBqmCXRiNuPq',$,$,$,#2,(#3));\n"
+    "#6=IFCCARTESIANPOINT((0.,0.,0.));\n"
+    "#7=IFCAXIS2PLACEMENT3D(#6,$,$);\n"
+    "#8=IFCLOCALPLACEMENT($,#7);\n"
+    "#9=IFCWALL('0ZyvMzRBH3dAcUjOzGPZJu',$,'Wall',$,$,#8,$,$,$);\n"
+    "#10=IFCSLAB('2wD9Fp4vX0RRvHfbSXNmP5',$,'Slab',$,$,#8,$,$,$);\n"
+    "#11=IFCRELCONTAINEDINSPATIALSTRUCTURE('3oRw5$K0f1VA2lL1X5hH9Q',$,$,$,(#9,#10),#3);\n"
+    // Not referenced by the walls
+    "#12=IFCPROPERTYSET('0wW$2OYBv1NuN2pQUtB1vS',$,'Pset',$,());\n"
+    "#13=IFCRELDEFINESBYPROPERTIES('1A3bCk0Xr0GPbM8Wv0PA5a',$,$,$,(#9),#12);\n"
+    // A storey that contains no walls
+    "#14=IFCBUILDINGSTOREY('2eV5C8BUn5Wxk1WgV9$Ziy',$,'Other',$,$,$,$,$,$,$);\n"
+    "#15=IFCRELAGGREGATES('0K2WcdPAD5Bf4dE0TQJ$9h',$,$,$,#2,(#14));\n"
+    // A subtype, which is not contained in the spatial structure
+    "#16=IFCWALLSTANDARDCASE('1pY1tHfAH0QuzfFsCbx1bq',$,'Standard',$,$,$,$,$,$);\n"
+    TEST_IFC_FOOTER;
+} // namespace
+
+int main() {
+    std::unique_ptr<IfcParse::IfcFile> complete(test_utils::open_buffer(file_contents));
+    CHECK(complete->good());
+    CHECK_EQUAL(test_utils::ids_of(*complete).size(), (size_t)16);
+
+    // Names that are not part of the schema are ignored
+    IfcParse::IfcFile::type_filter({"IfcWall", "IfcNotAType"});
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(file_contents));
+    IfcParse::IfcFile::type_filter({});
+    CHECK(file->good());
+
+    const std::set<unsigned int> expected{1, 2, 3, 4, 5, 6, 7, 8, 9, 11, 16};
+    CHECK(test_utils::ids_of(*file) == expected);
+    for (auto& id : expected) {
+        if (id != 11) {
+            CHECK_MESSAGE(file->instance_by_id(id)->data().toString() == complete->instance_by_id(id)->data().toString(), "#" + std::to_string(id));
+        }
+    }
+    CHECK_EQUAL(file->instances_by_type("IfcWall")->size(), (unsigned int)2);
+    CHECK(!file->instances_by_type("IfcSlab"));
+    CHECK_EQUAL(file->instance_by_guid("0u4wgLe6n0ABVaiXyikbkA")->data().id(), (unsigned int)2);
+
+    // A filter of only a spatial element reads no elements
+    IfcParse::IfcFile::type_filter({"IfcBuildingStorey"});
+    std::unique_ptr<IfcParse::IfcFile> storeys(test_utils::open_buffer(file_contents));
+    IfcParse::IfcFile::type_filter({});
+    CHECK((test_utils::ids_of(*storeys) == std::set<unsigned int>{1, 2, 3, 4, 5, 14, 15}));
+
+    return test_utils::report("type_filter");
+}
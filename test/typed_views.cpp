@@ -0,0 +1,133 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks the iterators of joined_instance_range and typed_instance_view:
+// default-constructed and empty ranges, ranges over several lists, and the
+// views of the instances by type of a file including and excluding subtypes.
+
+#include "../src/ifcparse/Ifc4.h"
+#include "../src/ifcparse/IfcFile.h"
+#include "test_utils.h"
+
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace {
+const char* file_contents =
+    TEST_IFC4_HEADER
+    "#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+    "#2=IFCDIRECTION((0.,0.,1.));\n"
+    "#3=IFCPOLYLINE((#1,#5));\n"
+    "#4=IFCDIRECTION((1.,0.,0.));\n"
+    "#5=IFCCARTESIANPOINT((1.,0.,0.));\n"
+    "#6=IFCPERSON($,'Doe','John',$,$,$,$,$);\n"
+    TEST_IFC_FOOTER;
+
+template <typename Range>
+std::vector<unsigned int> ids_in_order(Range& range) {
+    std::vector<unsigned int> ids;
+    for (auto* inst : range) {
+        ids.push_back(inst->data().id());
+    }
+    return ids;
+}
+} // namespace
+
+int main() {
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(file_contents));
+    CHECK(file->good());
+
+    // Default-constructed ranges and views, and their iterators
+    {
+        const joined_instance_range range;
+        CHECK(range.begin() == range.end());
+        CHECK(range.empty() && range.size() == 0);
+        CHECK(!range.flatten());
+        CHECK(joined_instance_range::iterator() == joined_instance_range::iterator());
+
+        const typed_instance_view<Ifc4::IfcCartesianPoint> view;
+        CHECK(view.begin() == view.end());
+        CHECK(view.empty() && view.size() == 0);
+        CHECK(typed_instance_view<Ifc4::IfcCartesianPoint>::iterator() == typed_instance_view<Ifc4::IfcCartesianPoint>::iterator());
+    }
+
+    // Null and empty lists are not part of a range
+    {
+        joined_instance_range range;
+        range.push(aggregate_of_instance::ptr());
+        range.push(aggregate_of_instance::ptr(new aggregate_of_instance));
+        CHECK(range.begin() == range.end());
+        CHECK(range.empty());
+    }
+
+    // Several lists are iterated one after the other, flattened in file order
+    {
+        aggregate_of_instance::ptr a(new aggregate_of_instance), b(new aggregate_of_instance), c(new aggregate_of_instance);
+        a->push(file->instance_by_id(2));
+        a->push(file->instance_by_id(4));
+        b->push(file->instance_by_id(3));
+        c->push(file->instance_by_id(1));
+        c->push(file->instance_by_id(5));
+        joined_instance_range range;
+        range.push(a);
+        range.push(aggregate_of_instance::ptr(new aggregate_of_instance));
+        range.push(b);
+        range.push(c);
+        CHECK_EQUAL(range.size(), (size_t)5);
+        CHECK_EQUAL(std::distance(range.begin(), range.end()), (std::ptrdiff_t)5);
+        CHECK((ids_in_order(range) == std::vector<unsigned int>{2, 4, 3, 1, 5}));
+        CHECK((test_utils::ids_in_order(range.flatten()) == std::vector<unsigned int>{1, 2, 3, 4, 5}));
+
+        joined_instance_range::iterator it = range.begin();
+        CHECK_EQUAL((*it++)->data().id(), (unsigned int)2);
+        CHECK_EQUAL((*it)->data().id(), (unsigned int)4);
+        CHECK_EQUAL((*++it)->data().id(), (unsigned int)3);
+        CHECK(it != range.end());
+    }
+
+    // Views of the instances by type, including and excluding subtypes
+    {
+        auto items = file->instances_by_type_view<Ifc4::IfcGeometricRepresentationItem>();
+        CHECK_EQUAL(items.size(), (size_t)5);
+        std::vector<unsigned int> ids = ids_in_order(items);
+        std::sort(ids.begin(), ids.end());
+        CHECK((ids == std::vector<unsigned int>{1, 2, 3, 4, 5}));
+
+        auto points = file->instances_by_type_view<Ifc4::IfcCartesianPoint>();
+        CHECK((ids_in_order(points) == std::vector<unsigned int>{1, 5}));
+        CHECK_EQUAL((*points.begin())->Coordinates().size(), (size_t)3);
+
+        auto exact_points = file->instances_by_type_excl_subtypes_view<Ifc4::IfcCartesianPoint>();
+        CHECK((ids_in_order(exact_points) == std::vector<unsigned int>{1, 5}));
+
+        // An abstract supertype has no instances of its own
+        auto exact_points_of_any_kind = file->instances_by_type_excl_subtypes_view<Ifc4::IfcPoint>();
+        CHECK(exact_points_of_any_kind.begin() == exact_points_of_any_kind.end());
+        CHECK(exact_points_of_any_kind.empty());
+
+        auto walls = file->instances_by_type_view<Ifc4::IfcWall>();
+        CHECK(walls.begin() == walls.end());
+        auto exact_walls = file->instances_by_type_excl_subtypes_view<Ifc4::IfcWall>();
+        CHECK(exact_walls.begin() == exact_walls.end());
+    }
+
+    return test_utils::report("typed_views");
+}
@@ -0,0 +1,132 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks that reals are written as they were formatted with a stream and
+// setprecision(15), also at the edges of the range of doubles, and that a
+// file of several chunks is written identically on one and on four threads.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "../src/ifcparse/IfcWrite.h"
+#include "test_utils.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <locale>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+// The formatting of reals before std::to_chars was used
+std::string stream_formatted(double d) {
+    std::ostringstream oss;
+    oss.imbue(std::locale::classic());
+    oss << std::setprecision(std::numeric_limits<double>::digits10) << d;
+    const std::string str = oss.str();
+    const std::string::size_type e = str.find_first_of("eE");
+    std::string result = str.substr(0, e);
+    if (result.find('.') == std::string::npos) {
+        result += '.';
+    }
+    if (e != std::string::npos) {
+        result += 'E' + str.substr(e + 1);
+    }
+    return result;
+}
+
+std::vector<double> test_values() {
+    std::vector<double> values = {
+        0., -0., 1., -1., 100., 0.1, 1. / 3., -2. / 3., 0.1 + 0.2, 123.456,
+        // 15, 16 and 17 significant digits
+        123456789012345., 1234567890123456., 12345678901234567., 0.30000000000000004, 2.9999999999999996,
+        // Around the switch to exponent notation
+        1e-5, 1e-4, 0.000123456789012345678, 1e14, 1e15, 1e16, 1e21, -1e21, 1e22, 9.999999999999999e22, 1e-21,
+        // Subnormals and the limits
+        std::numeric_limits<double>::denorm_min(), 3 * std::numeric_limits<double>::denorm_min(),
+        2.2250738585072009e-308, std::numeric_limits<double>::min(), std::numeric_limits<double>::max(),
+        std::numeric_limits<double>::lowest(), std::numeric_limits<double>::epsilon()};
+
+    // Finite doubles with random bit patterns
+    uint64_t state = 88172645463325252ULL;
+    while (values.size() < 5000) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        double d;
+        std::memcpy(&d, &state, sizeof(d));
+        if (d == d && d - d == 0.) {
+            values.push_back(d);
+        }
+    }
+    return values;
+}
+
+const unsigned int num_points = 40000;
+
+std::string file_contents() {
+    return TEST_IFC4_HEADER + test_utils::cartesian_points(1, num_points) + TEST_IFC_FOOTER;
+}
+
+std::string write(IfcParse::IfcFile& file, unsigned int n_threads) {
+    IfcParse::IfcFile::num_threads(n_threads);
+    std::ostringstream os;
+    os << file;
+    IfcParse::IfcFile::num_threads(0);
+    return os.str();
+}
+} // namespace
+
+int main() {
+    const std::vector<double> values = test_values();
+
+    for (double d : values) {
+        IfcWrite::IfcWriteArgument argument;
+        argument.set<double>(d);
+        CHECK_MESSAGE(argument.toString() == stream_formatted(d), stream_formatted(d));
+    }
+    {
+        IfcWrite::IfcWriteArgument argument;
+        argument.set(std::vector<double>{-0., 1e21, std::numeric_limits<double>::denorm_min()});
+        CHECK_EQUAL(argument.toString(), "(-0.,1.E+21,4.94065645841247E-324)");
+    }
+
+    // Points of which the coordinates are formatted, in several chunks
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(file_contents()));
+    CHECK(file->good());
+    for (unsigned int i = 1; i <= num_points; ++i) {
+        IfcWrite::IfcWriteArgument* coordinates = new IfcWrite::IfcWriteArgument();
+        coordinates->set(std::vector<double>{values[i % values.size()], values[(i * 7) % values.size()], -values[(i * 13) % values.size()]});
+        file->instance_by_id(i)->data().setArgument(0, coordinates);
+    }
+    const std::string written = write(*file, 1);
+    CHECK(written == write(*file, 4));
+
+    for (unsigned int i : {1U, 16384U, 16385U, num_points}) {
+        const std::string line = "#" + std::to_string(i) + "=IFCCARTESIANPOINT((" +
+                                 stream_formatted(values[i % values.size()]) + "," +
+                                 stream_formatted(values[(i * 7) % values.size()]) + "," +
+                                 stream_formatted(-values[(i * 13) % values.size()]) + "));\n";
+        CHECK_MESSAGE(written.find(line) != std::string::npos, line);
+    }
+
+    return test_utils::report("write_reals");
+}
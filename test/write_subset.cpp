@@ -0,0 +1,156 @@
+/********************************************************************************
+ *                                                                              *
+ * This file is part of IfcOpenShell.                                           *
+ *                                                                              *
+ * IfcOpenShell is free software: you can redistribute it and/or modify         *
+ * it under the terms of the Lesser GNU General Public License as published by  *
+ * the Free Software Foundation, either version 3.0 of the License, or          *
+ * (at your option) any later version.                                          *
+ *                                                                              *
+ * IfcOpenShell is distributed in the hope that it will be useful,              *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of               *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the                 *
+ * Lesser GNU General Public License for more details.                          *
+ *                                                                              *
+ * You should have received a copy of the Lesser GNU General Public License     *
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.         *
+ *                                                                              *
+ ********************************************************************************/
+
+// Checks IfcFile::write_subset() on instances with escaped apostrophes and
+// comments, on references that leave the subset, also from aggregates that
+// are wrapped over several lines, and on modified instances, by reading the
+// subset back and comparing content hashes.
+
+#include "../src/ifcparse/IfcFile.h"
+#include "../src/ifcparse/IfcWrite.h"
+#include "test_utils.h"
+
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+const char* file_contents =
+    TEST_IFC4_HEADER
+    "#10=IFCCARTESIANPOINT((0.,0.,0.));\n"
+    "#11=IFCCARTESIANPOINT((1.,0.,0.));\n"
+    "#12=IFCDIRECTION((0.,0.,1.));\n"
+    "#13=IFCAXIS2PLACEMENT3D(#10,#12,$);\n"
+    "#14=IFCLOCALPLACEMENT($,/* relative to #10 */#13);\n"
+    // Refers to the subset, but is not referenced by it
+    "#15=IFCPOLYLINE((#10,#11));\n"
+    "#16=IFCPROPERTYSINGLEVALUE('It''s #12',$,IFCLABEL('/* #13 */ ''#14'''),$);\n"
+    // #98 and #99 are not in the file and are dropped from the list
+    "#17=IFCPROPERTYSET('2O2Fr$t4X7Zf8NOew3FLOH',$,'Pset',$,(#98, #16,#99));\n"
+    TEST_IFC_FOOTER;
+
+// Aggregates wrapped over several lines, of which the references to #97,
+// #98 and #99 are dropped together with the line breaks around them
+const char* wrapped_contents =
+    TEST_IFC4_HEADER
+    "#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+    "#2=IFCCARTESIANPOINT((1.,0.,0.));\n"
+    "#3=IFCPOLYLINE((#1,\r\n\t#98,\n  #2,\n#99));\n"
+    "#4=IFCPOLYLINE((#97,\n#1));\n"
+    TEST_IFC_FOOTER;
+
+// The ids of the subset in file_contents in the order in which they are renumbered
+const std::vector<unsigned int> subset_ids{10, 12, 13, 14, 16, 17};
+
+std::string write_subset(IfcParse::IfcFile& file) {
+    std::vector<IfcUtil::IfcBaseClass*> roots{file.instance_by_id(14), file.instance_by_id(17)};
+    std::ostringstream os;
+    CHECK_EQUAL(file.write_subset(os, roots), subset_ids.size());
+    return os.str();
+}
+
+// Sets the first attribute of instance to a copy of itself, so that the
+// instance is formatted rather than copied from the file buffer
+void touch(IfcUtil::IfcBaseClass* instance) {
+    IfcEntityInstanceData& data = instance->data();
+    data.setArgument(0, data.getArgument(0), IfcUtil::Argument_UNKNOWN, true);
+    CHECK(data.modified());
+}
+} // namespace
+
+int main() {
+    std::unique_ptr<IfcParse::IfcFile> file(test_utils::open_buffer(file_contents));
+    CHECK(file->good());
+
+    // Unmodified instances are copied from the file buffer with their references renumbered
+    const std::string copied = write_subset(*file);
+    CHECK(copied.find("#1=IFCCARTESIANPOINT((0.,0.,0.));\n"
+                      "#2=IFCDIRECTION((0.,0.,1.));\n"
+                      "#3=IFCAXIS2PLACEMENT3D(#1,#2,$);\n"
+                      "#4=IFCLOCALPLACEMENT($,/* relative to #10 */#3);\n"
+                      "#5=IFCPROPERTYSINGLEVALUE('It''s #12',$,IFCLABEL('/* #13 */ ''#14'''),$);\n"
+                      "#6=IFCPROPERTYSET('2O2Fr$t4X7Zf8NOew3FLOH',$,'Pset',$,(#5));\n"
+                      "ENDSEC;\n") != std::string::npos);
+    CHECK(copied.find("IFCPOLYLINE") == std::string::npos);
+
+    std::unique_ptr<IfcParse::IfcFile> reread_copied(test_utils::open_buffer(copied));
+    CHECK(reread_copied->good());
+    CHECK_EQUAL(reread_copied->getMaxId(), (unsigned int)subset_ids.size());
+    CHECK_EQUAL(static_cast<std::string>(*reread_copied->instance_by_id(5)->data().getArgument(0)), "It's #12");
+
+    // The same subset with all instances formatted
+    std::unique_ptr<IfcParse::IfcFile> modified(test_utils::open_buffer(file_contents));
+    for (auto& id : subset_ids) {
+        touch(modified->instance_by_id(id));
+    }
+    const std::string formatted = write_subset(*modified);
+    CHECK(formatted.find("#4=IFCLOCALPLACEMENT($,#3);\n") != std::string::npos);
+    CHECK(formatted.find("#6=IFCPROPERTYSET('2O2Fr$t4X7Zf8NOew3FLOH',$,'Pset',$,(#5));\n") != std::string::npos);
+    CHECK(formatted.find("#5=IFCPROPERTYSINGLEVALUE('It''s #12',$,IFCLABEL('/* #13 */ ''#14'''),$);\n") != std::string::npos);
+
+    std::unique_ptr<IfcParse::IfcFile> reread_formatted(test_utils::open_buffer(formatted));
+    CHECK(reread_formatted->good());
+
+    for (unsigned int new_id = 1; new_id <= subset_ids.size(); ++new_id) {
+        const unsigned int old_id = subset_ids[new_id - 1];
+        const uint64_t hash = reread_copied->content_hash(reread_copied->instance_by_id(new_id));
+        CHECK_MESSAGE(hash == reread_formatted->content_hash(reread_formatted->instance_by_id(new_id)), "#" + std::to_string(new_id));
+        // Content hashes do not depend on ids, so they equal those of the
+        // original instances, except where the references to #98 and #99 were dropped
+        if (old_id != 17) {
+            CHECK_MESSAGE(hash == file->content_hash(file->instance_by_id(old_id)), "#" + std::to_string(old_id));
+        }
+    }
+
+    // A modified instance is formatted with its new value, the others are still copied
+    std::unique_ptr<IfcParse::IfcFile> changed(test_utils::open_buffer(file_contents));
+    {
+        IfcWrite::IfcWriteArgument* description = new IfcWrite::IfcWriteArgument();
+        description->set<std::string>("Isn't #13");
+        changed->instance_by_id(16)->data().setArgument(1, description);
+    }
+    const std::string written = write_subset(*changed);
+    CHECK(written.find("#4=IFCLOCALPLACEMENT($,/* relative to #10 */#3);\n") != std::string::npos);
+    CHECK(written.find("#5=IFCPROPERTYSINGLEVALUE('It''s #12','Isn''t #13',IFCLABEL('/* #13 */ ''#14'''),$);\n") != std::string::npos);
+
+    std::unique_ptr<IfcParse::IfcFile> reread_changed(test_utils::open_buffer(written));
+    CHECK(reread_changed->good());
+    CHECK_EQUAL(static_cast<std::string>(*reread_changed->instance_by_id(5)->data().getArgument(1)), "Isn't #13");
+    CHECK(reread_changed->content_hash(reread_changed->instance_by_id(5)) != reread_copied->content_hash(reread_copied->instance_by_id(5)));
+    CHECK_EQUAL(reread_changed->content_hash(reread_changed->instance_by_id(3)), reread_copied->content_hash(reread_copied->instance_by_id(3)));
+
+    // References that leave the subset are dropped from wrapped aggregates
+    {
+        std::unique_ptr<IfcParse::IfcFile> wrapped(test_utils::open_buffer(wrapped_contents));
+        std::vector<IfcUtil::IfcBaseClass*> roots{wrapped->instance_by_id(3), wrapped->instance_by_id(4)};
+        std::ostringstream os;
+        CHECK_EQUAL(wrapped->write_subset(os, roots), (size_t)4);
+        const std::string written_wrapped = os.str();
+        CHECK(written_wrapped.find("#3=IFCPOLYLINE((#1,\n  #2));\n"
+                                   "#4=IFCPOLYLINE((#1));\n") != std::string::npos);
+
+        std::unique_ptr<IfcParse::IfcFile> reread_wrapped(test_utils::open_buffer(written_wrapped));
+        CHECK(reread_wrapped->good());
+        CHECK((test_utils::ids_in_order(*reread_wrapped->instance_by_id(3)->data().getArgument(0)) == std::vector<unsigned int>{1, 2}));
+        CHECK((test_utils::ids_in_order(*reread_wrapped->instance_by_id(4)->data().getArgument(0)) == std::vector<unsigned int>{1}));
+    }
+
+    return test_utils::report("write_subset");
+}